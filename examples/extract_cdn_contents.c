@@ -102,7 +102,8 @@ int main(int argc, char *argv[])
 				goto out1;
 		}
 
-		res = nnc_copy(NNC_RSP(&cs), NNC_WSP(&writer), NULL);
+		/* the contents are decrypted on all processors, encrypting them for the CDN is done on this thread */
+		res = nnc_decrypt_section_parallel(NNC_RSP(&cs), NNC_WSP(&writer), 0);
 
 		if(encrypted) { NNC_WS_CALL0(writer.dec.r0, close); NNC_WS_CALL0(writer.enc.r1, close); }
 		else          { NNC_WS_CALL0(writer.enc.r0, close); }
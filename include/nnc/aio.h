@@ -0,0 +1,91 @@
+/** \file  aio.h
+ *  \brief Asynchronous reading from streams.
+ */
+#ifndef inc_nnc_aio_h
+#define inc_nnc_aio_h
+
+#include <nnc/stream.h>
+#include <nnc/base.h>
+NNC_BEGIN
+
+/** A single read, owned by the caller until it is returned by \ref nnc_aio_complete. */
+typedef struct nnc_aio_request {
+	nnc_u64 offset;    ///< Offset in the stream to read from.
+	nnc_u8 *buf;       ///< Buffer to read into.
+	nnc_u32 len;       ///< Amount of data to read.
+	nnc_u32 read;      ///< Amount of data actually read, set on completion.
+	nnc_result res;    ///< Result of the read, set on completion.
+	void *udata;       ///< User data, not used by the library.
+} nnc_aio_request;
+
+/** Method used to perform reads. */
+enum nnc_aio_backend {
+	NNC_AIO_SYNC,     ///< Reads are done in \ref nnc_aio_submit.
+	NNC_AIO_THREADS,  ///< Reads are done by a pool of threads using \ref nnc_rs_read_at.
+	NNC_AIO_IO_URING, ///< Reads are done by the kernel using io_uring.
+};
+
+/** Flags for \ref nnc_aio_open. */
+enum nnc_aio_flags {
+	NNC_AIO_DEFAULT     = 0, ///< Use the best available backend.
+	NNC_AIO_NO_IO_URING = 1, ///< Don't use io_uring.
+	NNC_AIO_NO_THREADS  = 2, ///< Don't use threads.
+};
+
+typedef struct nnc_aio nnc_aio;
+
+/** \brief        Create an asynchronous reader for a stream.
+ *  \param self   Output reader.
+ *  \param rs     Stream to read from, must stay open until the reader is closed.
+ *  \param depth  Maximum amount of requests in flight.
+ *  \param flags  See \ref nnc_aio_flags.
+ *  \note         io_uring is used if \p rs can be resolved to a file with \ref nnc_rs_locate
+ *                and the kernel supports it, else a thread pool is used if \p rs implements \p read_at,
+ *                else the reads are done synchronously.
+ *  \note         Reads through the thread pool call \ref nnc_rs_read_at concurrently. Streams in this
+ *                library only implement \p read_at if that is safe, a subview over a stream without
+ *                positional reads for example doesn't.
+ *  \note         The thread pool is started here and stopped by \ref nnc_aio_close.
+ *  \returns
+ *  \p NNC_R_INVAL => \p depth is 0.\n
+ *  \p NNC_R_NOMEM => Failed to allocate the reader.
+ */
+nnc_result nnc_aio_open(nnc_aio **self, nnc_rstream *rs, nnc_u32 depth, int flags);
+
+/** \brief       Queue a read.
+ *  \param self  Reader from \ref nnc_aio_open.
+ *  \param req   Request to queue, must stay valid until it is returned by \ref nnc_aio_complete.
+ *  \note        With io_uring, queued reads are handed to the kernel in one batch on the next
+ *               call to \ref nnc_aio_complete.
+ *  \returns
+ *  \p NNC_R_TOO_LARGE => \p depth requests are already in flight.
+ */
+nnc_result nnc_aio_submit(nnc_aio *self, nnc_aio_request *req);
+
+/** \brief       Wait for any queued read to finish.
+ *  \param self  Reader from \ref nnc_aio_open.
+ *  \param req   Output pointer to the finished request, check its \p res field for the status of the read.
+ *  \note        Requests can complete in a different order than they were submitted.
+ *  \returns
+ *  \p NNC_R_NOT_FOUND => No requests are in flight.
+ */
+nnc_result nnc_aio_complete(nnc_aio *self, nnc_aio_request **req);
+
+/** \brief       Get the amount of requests in flight.
+ *  \param self  Reader from \ref nnc_aio_open.
+ */
+nnc_u32 nnc_aio_pending(nnc_aio *self);
+
+/** \brief       Get the method used to perform reads.
+ *  \param self  Reader from \ref nnc_aio_open.
+ */
+enum nnc_aio_backend nnc_aio_get_backend(nnc_aio *self);
+
+/** \brief       Wait for all requests in flight and free the reader.
+ *  \param self  Reader from \ref nnc_aio_open.
+ */
+void nnc_aio_close(nnc_aio *self);
+
+NNC_END
+#endif
+
@@ -0,0 +1,72 @@
+/** \file  cache.h
+ *  \brief Process-wide block cache for read streams.
+ */
+#ifndef inc_nnc_cache_h
+#define inc_nnc_cache_h
+
+#include <nnc/stream.h>
+#include <nnc/base.h>
+NNC_BEGIN
+
+/** Default size of a cache block. */
+#define NNC_CACHE_DEFAULT_BLOCK_SIZE 0x4000
+
+/** Cache statistics, see \ref nnc_cache_get_stats. */
+typedef struct nnc_cache_stats {
+	nnc_u64 hits;        ///< Block lookups that were served from the cache.
+	nnc_u64 misses;      ///< Block lookups that had to read from the child stream.
+	nnc_u64 evictions;   ///< Blocks dropped to make room for new ones.
+	nnc_u64 blocks;      ///< Blocks currently in the cache.
+	nnc_u64 capacity;    ///< Maximum amount of blocks in the cache.
+	nnc_u32 block_size;  ///< Size of a single block.
+} nnc_cache_stats;
+
+/** Stream that reads its child through the process-wide block cache. */
+typedef struct nnc_cached_rstream {
+	const nnc_rstream_funcs *funcs;
+	nnc_rstream *child;
+	nnc_u64 id;
+	nnc_u64 pos;
+} nnc_cached_rstream;
+
+/** \brief             Enable the process-wide block cache.
+ *  \param capacity    Maximum amount of memory used for cached data.
+ *  \param block_size  Size of a block, 0 for #NNC_CACHE_DEFAULT_BLOCK_SIZE.
+ *  \note              The cache is split in independently locked shards which each evict
+ *                     their least recently used block when full.
+ *  \note              Calling this function again discards the current cache.
+ *  \warning           This function must not be called while another thread reads from a \ref nnc_cached_rstream.
+ *  \returns
+ *  \p NNC_R_INVAL => \p capacity is smaller than a block.\n
+ *  \p NNC_R_NOMEM => Failed to allocate the cache.
+ */
+nnc_result nnc_cache_init(nnc_u64 capacity, nnc_u32 block_size);
+
+/** \brief  Disable the block cache and free all cached data.
+ *  \note   \ref nnc_cached_rstream streams keep working but read from their child directly.
+ */
+void nnc_cache_free(void);
+
+/** \brief        Get the cache statistics.
+ *  \param stats  Output statistics, all zero if the cache is not enabled.
+ */
+void nnc_cache_get_stats(nnc_cache_stats *stats);
+
+/** \brief  Reset the hit, miss and eviction counters. */
+void nnc_cache_reset_stats(void);
+
+/** \brief        Create a stream that reads through the block cache.
+ *  \param self   Output stream.
+ *  \param child  Stream to cache, the data in it must not change while this stream is open.
+ *  \note         Blocks are keyed by this stream, so open one cached stream per underlying
+ *                data source and share it (e.g. by opening subviews on it).
+ *  \note         The stream only implements \p read_at if \p child does, reads from multiple threads are safe then.
+ *  \note         Closing this stream does not close \p child, its blocks stay in the cache until they are evicted.
+ *  \note         Clones from \ref nnc_rs_clone share the blocks of this stream.
+ *  \note         If the cache is not enabled reads go to \p child directly.
+ */
+void nnc_cached_rstream_open(nnc_cached_rstream *self, nnc_rstream *child);
+
+NNC_END
+#endif
+
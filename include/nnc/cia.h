@@ -78,6 +78,25 @@ enum nnc_cia_wflags {
 	NNC_CIA_WF_TMD_STREAM       = 32,  ///< Copy a TMD from a read stream.
 };
 
+/** Layout of a CIA as written by \ref nnc_write_cia, see \ref nnc_plan_cia. */
+typedef struct nnc_cia_plan {
+	nnc_u64 certchain_offset; ///< Offset of the certificate chain.
+	nnc_u64 ticket_offset;    ///< Offset of the ticket.
+	nnc_u64 tmd_offset;       ///< Offset of the TMD.
+	nnc_u64 content_offset;   ///< Offset of the contents section.
+	nnc_u32 cert_chain_size;  ///< Size of the certificate chain section, as in \ref nnc_cia_header.
+	nnc_u32 ticket_size;      ///< Size of the ticket section, as in \ref nnc_cia_header.
+	nnc_u32 tmd_size;         ///< Size of the TMD section, as in \ref nnc_cia_header.
+	nnc_u64 content_size;     ///< Size of the contents section, as in \ref nnc_cia_header.
+	nnc_u64 size;             ///< Total size of the CIA.
+} nnc_cia_plan;
+
+/** Position of a single content in a \ref nnc_cia_plan. */
+typedef struct nnc_cia_content_plan {
+	nnc_u64 offset; ///< Offset of the content in the CIA, 0 if it is not written.
+	nnc_u64 size;   ///< Size of the content without padding, as in its chunk record.
+} nnc_cia_content_plan;
+
 /** A pseudo-stream to hold all possible required streams, yet still
  *  usable like all other streams with \ref NNC_RSP */
 typedef struct nnc_cia_content_stream {
@@ -191,6 +210,31 @@ nnc_result nnc_write_cia(
 	nnc_wstream *ws
 );
 
+/** \brief                  Calculates the layout of a CIA without writing it.
+ *  \param wflags           Write flags, see #nnc_cia_wflags.
+ *  \param certchain        Certificate chain parameter, see #nnc_cia_wflags.
+ *  \param ticket           Ticket parameter, see #nnc_cia_wflags.
+ *  \param tmd              TMD parameter, see #nnc_cia_wflags.
+ *  \param amount_contents  Amount of contents in this CIA.
+ *  \param contents         Writable NCCH contents, see \ref nnc_write_cia.
+ *  \param plan             Output layout.
+ *  \param content_plans    Optional output array of \p amount_contents entries for the position of each content, may be NULL.
+ *  \note                   Only the sizes of the streams and VFS nodes are used, no data is read.
+ *                          A built ticket is written to a \ref nnc_wcounter to find its size.
+ *  \returns
+ *  The same errors about the parameters as \ref nnc_write_cia.
+ */
+nnc_result nnc_plan_cia(
+	nnc_u8 wflags,
+	nnc_certchain_or_stream certchain,
+	nnc_ticket_or_stream ticket,
+	nnc_tmd_or_stream tmd,
+	nnc_u16 amount_contents,
+	nnc_cia_writable_ncch *contents,
+	nnc_cia_plan *plan,
+	nnc_cia_content_plan *content_plans
+);
+
 NNC_END
 #endif
 
@@ -47,6 +47,8 @@ typedef struct nnc_seeddb {
 		nnc_u8 seed[NNC_SEED_SIZE];
 		nnc_u64 title_id;
 	} *entries;
+	nnc_u32 *index;     ///< Title ID hash table of positions in \p entries plus one, see \ref nnc_index_seeddb.
+	nnc_u32 index_size; ///< Amount of slots in \p index.
 } nnc_seeddb;
 
 enum nnc_section {
@@ -59,18 +61,19 @@ typedef struct nnc_aes_ctr {
 	const void *funcs;
 	void *crypto_ctx; ///< Context for the cryptographic library used.
 	nnc_rstream *child;
-	nnc_u8 last_unaligned_block[0x10];
-	nnc_u8 ctr[0x10];
 	nnc_u128 iv;
+	nnc_u64 pos;      ///< Stream position, the child is read positionally. In write mode the child position the stream starts at.
+	nnc_u32 threads; ///< Maximum amount of threads for large reads, see \ref nnc_aes_ctr_set_threads.
 } nnc_aes_ctr;
 
 typedef struct nnc_aes_cbc {
 	const void *funcs;
 	void *crypto_ctx; ///< Context for the cryptographic library used.
 	nnc_rstream *child;
-	nnc_u8 last_unaligned_block[0x10];
 	nnc_u8 init_iv[0x10];
-	nnc_u8 iv[0x10];
+	nnc_u8 iv[0x10];  ///< IV of the next block in write mode.
+	nnc_u64 pos;      ///< Stream position, the child is read positionally.
+	nnc_u32 threads; ///< Maximum amount of threads for large reads, see \ref nnc_aes_cbc_set_threads.
 } nnc_aes_cbc;
 
 typedef struct nnc_keypair {
@@ -85,9 +88,25 @@ typedef struct nnc_hasher_writer {
 	const nnc_wstream_funcs *funcs;
 	nnc_sha256_incremental_hash hash;
 	nnc_wstream *child;
-	nnc_u32 lim, hashed;
+	nnc_u64 lim, hashed;
 } nnc_hasher_writer;
 
+typedef struct nnc_aes_ctr_hashing {
+	const void *funcs;
+	nnc_aes_ctr *crypt; ///< Stream whose key and child are used.
+	nnc_sha256_incremental_hash hash;
+	nnc_u64 pos;
+} nnc_aes_ctr_hashing;
+
+typedef struct nnc_aes_cbc_hashing {
+	const void *funcs;
+	nnc_aes_cbc *crypt; ///< Stream whose key and child are used.
+	nnc_sha256_incremental_hash hash;
+	nnc_u64 pos;
+	nnc_u8 iv[0x10];
+	nnc_u8 block[0x10]; ///< Decrypted block a read ended in.
+} nnc_aes_cbc_hashing;
+
 /** \brief An enumeration containing the possible (builtin) keysets */
 enum nnc_keyset_selector {
 	NNC_KEYSET_RETAIL,
@@ -136,7 +155,7 @@ void nnc_crypto_sha256_free(nnc_sha256_incremental_hash self);
  *  \note         This stream does not support seeking. If something like hashing the header is
  *                required #nnc_header_saver in combination with #nnc_crypto_sha256_buffer is normally used.
  */
-nnc_result nnc_open_hasher_writer(nnc_hasher_writer *self, nnc_wstream *child, nnc_u32 limit);
+nnc_result nnc_open_hasher_writer(nnc_hasher_writer *self, nnc_wstream *child, nnc_u64 limit);
 
 /** \brief         Output the digest of a hasher writer and close it.
  *  \param self    Hasher writer to get the digest of and close.
@@ -157,10 +176,12 @@ void nnc_hasher_writer_digest_reset(nnc_hasher_writer *self, nnc_sha256_hash dig
  *  \param rs      Stream to hash.
  *  \param digest  Output digest.
  *  \param size    Amount of data to hash.
+ *  \note          Streams from \ref nnc_aes_ctr_open and \ref nnc_aes_cbc_open are decrypted
+ *                 and hashed in one pass, see \ref nnc_aes_ctr_hashing_open.
  *  \returns
  *  \p NNC_R_TOO_SMALL => \p rs is smaller than \p size.
  */
-nnc_result nnc_crypto_sha256_part(nnc_rstream *rs, nnc_sha256_hash digest, nnc_u32 size);
+nnc_result nnc_crypto_sha256_part(nnc_rstream *rs, nnc_sha256_hash digest, nnc_u64 size);
 
 /** \brief         Hash a \ref nnc_rstream completely.
  *  \param rs      Stream to hash.
@@ -184,7 +205,7 @@ void nnc_crypto_sha256_buffer(nnc_u8 *data, nnc_u32 size, nnc_sha256_hash digest
  *  \returns
  *  \p NNC_R_TOO_SMALL => \p rs is smaller than \p size.
  */
-nnc_result nnc_crypto_sha1_part(nnc_rstream *rs, nnc_sha1_hash digest, nnc_u32 size);
+nnc_result nnc_crypto_sha1_part(nnc_rstream *rs, nnc_sha1_hash digest, nnc_u64 size);
 
 /** \brief    Returns true if \p a and \b are equal.
  *  \param a  Hash A.
@@ -201,6 +222,64 @@ bool nnc_crypto_hasheq(nnc_sha256_hash a, nnc_sha256_hash b);
  */
 nnc_result nnc_crypto_sha256(const nnc_u8 *buf, nnc_sha256_hash digest, nnc_u32 size);
 
+/** Implementations of the SHA-256 compression function. */
+enum nnc_sha256_impl {
+	NNC_SHA256_IMPL_GENERIC = 0, ///< The cryptographic library.
+	NNC_SHA256_IMPL_SHANI   = 1, ///< x86 SHA extensions.
+	NNC_SHA256_IMPL_ARMV8   = 2, ///< ARMv8 SHA2 instructions, only if the library was compiled for a CPU that has them.
+};
+
+/** \brief  Get the implementation the nnc_crypto_sha256_* functions use,
+ *          by default the fastest one the CPU supports, detected on first use.
+ */
+enum nnc_sha256_impl nnc_crypto_sha256_impl(void);
+
+/** \brief       Select the implementation the nnc_crypto_sha256_* functions use, meant for benchmarks and tests.
+ *  \param impl  Implementation to use.
+ *  \note        Incremental hashers keep the implementation they were initialized or reset with.
+ *  \returns
+ *  \p NNC_R_UNSUPPORTED => \p impl is not available on this CPU or in this build.
+ */
+nnc_result nnc_crypto_sha256_set_impl(enum nnc_sha256_impl impl);
+
+/** \brief          Hash multiple independent messages at once.
+ *  \param count    Amount of messages.
+ *  \param bufs     Data of each message.
+ *  \param sizes    Size of each message.
+ *  \param digests  Output digest of each message.
+ *  \note           Messages are hashed side by side in vector lanes, this is the
+ *                  fastest when they have the same size, see \ref nnc_crypto_sha256_multi_impl.
+ */
+void nnc_crypto_sha256_multi(nnc_u32 count, const nnc_u8 *const bufs[], const nnc_u32 sizes[], nnc_sha256_hash digests[]);
+
+/** \brief             Hash consecutive blocks of the same size with \ref nnc_crypto_sha256_multi.
+ *  \param data        Start of the first block.
+ *  \param block_size  Size of each block.
+ *  \param count       Amount of blocks.
+ *  \param digests     Output digest of each block.
+ */
+void nnc_crypto_sha256_blocks(const nnc_u8 *data, nnc_u32 block_size, nnc_u32 count, nnc_sha256_hash digests[]);
+
+/** Implementations of \ref nnc_crypto_sha256_multi. */
+enum nnc_sha256_multi_impl {
+	NNC_SHA256_MULTI_SINGLE = 0, ///< One message at a time with \ref nnc_crypto_sha256.
+	NNC_SHA256_MULTI_SSE2   = 1, ///< 4 messages at once with x86 SSE2.
+	NNC_SHA256_MULTI_AVX2   = 2, ///< 8 messages at once with x86 AVX2.
+	NNC_SHA256_MULTI_AVX512 = 3, ///< 16 messages at once with x86 AVX-512.
+};
+
+/** \brief  Get the implementation \ref nnc_crypto_sha256_multi uses, by default the
+ *          widest vectors the CPU supports unless the SHA-256 instructions are faster.
+ */
+enum nnc_sha256_multi_impl nnc_crypto_sha256_multi_impl(void);
+
+/** \brief       Select the implementation \ref nnc_crypto_sha256_multi uses, meant for benchmarks and tests.
+ *  \param impl  Implementation to use.
+ *  \returns
+ *  \p NNC_R_UNSUPPORTED => \p impl is not available on this CPU or in this build.
+ */
+nnc_result nnc_crypto_sha256_multi_set_impl(enum nnc_sha256_multi_impl impl);
+
 /** \brief         Sets default keys in a keyset.
  *  \param ks      Output keyset.
  *  \param setsel  The keyset selection parameter, see #nnc_keyset_selector.
@@ -215,8 +294,11 @@ nnc_result nnc_keyset_default(nnc_keyset *ks, nnc_u8 setsel);
  *  \param seeddb  Output SeedDB.
  *  \note          This function allocates dynamic memory so be sure to free
  *                 it with \ref nnc_free_seeddb.
+ *  \note          The seeds are parsed straight from memory if \p rs supports \ref nnc_rs_borrow,
+ *                 such as a \ref nnc_mmap_file, and indexed with \ref nnc_index_seeddb.
  *  \returns
  *  Anything \p rs->read() can return.\n
+ *  \p NNC_R_TOO_SMALL => \p rs is too small for the amount of seeds in its header.\n
  *  \p NNC_R_NOMEM => Failed to allocate memory for seeds.
  */
 nnc_result nnc_seeds_seeddb(nnc_rstream *rs, nnc_seeddb *seeddb);
@@ -228,6 +310,7 @@ nnc_result nnc_seeds_seeddb(nnc_rstream *rs, nnc_seeddb *seeddb);
  *  \param seeddb  Output SeedDB.
  *  \note          This function allocates dynamic memory so be sure to free
  *                 it with \ref nnc_free_seeddb.
+ *  \note          The file is memory-mapped while reading it if possible.
  *  \returns
  *  Anything \ref nnc_seeds_seeddb can return.\n
  *  Anything \ref nnc_file_open can return.\n
@@ -238,13 +321,38 @@ nnc_result nnc_scan_seeddb(nnc_seeddb *seeddb);
 /** \brief         Get a seed from a SeedDB.
  *  \param tid     Title ID to search for.
  *  \param seeddb  SeedDB to search in.
+ *  \note          This is a hash table lookup if the SeedDB is indexed, else a linear search.
+ *                 Either way the first seed for \p tid is returned.
  *  \returns       Pointer to seed if found, else NULL.
  */
 nnc_u8 *nnc_get_seed(nnc_seeddb *seeddb, nnc_u64 tid);
 
-/** \brief         Frees dynamic memory allocated by \ref nnc_seeds_seeddb or
- *                 \ref nnc_scan_seeddb.
- *  \param seeddb  SeedDB to free.
+/** \brief         Build the title ID index \ref nnc_get_seed uses.
+ *  \param seeddb  SeedDB to index.
+ *  \note          SeedDBs from \ref nnc_seeds_seeddb, \ref nnc_scan_seeddb and \ref nnc_merge_seeddb are
+ *                 already indexed, call this again after changing their entries. A SeedDB filled in by hand
+ *                 must have \p index set to NULL, after indexing it the index must be freed with \ref nnc_free_seeddb.
+ *  \returns
+ *  \p NNC_R_NOMEM => Failed to allocate the index, \p seeddb is left without one.\n
+ *  \p NNC_R_TOO_LARGE => \p seeddb has too many entries to index.
+ */
+nnc_result nnc_index_seeddb(nnc_seeddb *seeddb);
+
+/** \brief       Add the seeds from one SeedDB to another.
+ *  \param dest  SeedDB to add seeds to, from \ref nnc_seeds_seeddb, \ref nnc_scan_seeddb or \ref nnc_merge_seeddb,
+ *               or one with all fields zero to make a copy of \p src.
+ *  \param src   SeedDB to take seeds from, it is not modified.
+ *  \note        Seeds for titles already in \p dest are not added, so merge the preferred source first.
+ *               Afterwards \p dest has one seed per title and is indexed.
+ *  \returns
+ *  \p NNC_R_NOMEM => Failed to allocate memory, if the seeds were added already \p dest is left unindexed.\n
+ *  \p NNC_R_TOO_LARGE => The combined SeedDB would be too large.
+ */
+nnc_result nnc_merge_seeddb(nnc_seeddb *dest, nnc_seeddb *src);
+
+/** \brief         Frees dynamic memory allocated by \ref nnc_seeds_seeddb,
+ *                 \ref nnc_scan_seeddb, \ref nnc_index_seeddb or \ref nnc_merge_seeddb.
+ *  \param seeddb  SeedDB to free, it is left empty.
  */
 void nnc_free_seeddb(nnc_seeddb *seeddb);
 
@@ -261,6 +369,15 @@ struct nnc_ncch_header;
 nnc_result nnc_keyy_seed(struct nnc_ncch_header *ncch, nnc_u128 *keyy,
 	nnc_u8 seed[NNC_SEED_SIZE]);
 
+/** \brief         Find the seed of an NCCH by checking every seed in a SeedDB against the seed hash in its header.
+ *  \param seeddb  SeedDB to search in.
+ *  \param ncch    NCCH to find the seed of.
+ *  \note          This is meant for when the seed is not stored under the title ID of the NCCH,
+ *                 otherwise \ref nnc_get_seed is faster. The seeds are hashed side by side, see \ref nnc_crypto_sha256_multi.
+ *  \returns       Pointer to the seed that passes \ref nnc_keyy_seed, or NULL if there is none.
+ */
+nnc_u8 *nnc_probe_seed(nnc_seeddb *seeddb, struct nnc_ncch_header *ncch);
+
 /** \brief         Gets the normal key of a region in the menu info group.
  *  \param output  Output key
  *  \param ks      Keyset.
@@ -302,33 +419,162 @@ nnc_result nnc_get_ncch_iv(struct nnc_ncch_header *ncch, nnc_u8 for_section,
  *  \param child  Child stream to decrypt from.
  *  \param key    Encryption key.
  *  \param iv     Initial counter.
- *  \warning      As this stream does not keep it's own offsets, do not open one multiple
- *                times to one substream.
- *  \note         For optimal usage align all operations to 0x10 bytes,
- *                however unaligned reads are possible as well.
+ *  \note         This stream keeps its own position and derives the counter from the offset of
+ *                every read, which is a single positional read of \p child at the same offset
+ *                whether it is aligned to 0x10 bytes or not.
+ *                If \p child doesn't support positional reads they are a seek and a read.
+ *  \note         To read the data from multiple threads at once use \ref nnc_rs_clone,
+ *                clones share the key schedule and read from a clone of \p child.
  *  \note         Calling close on this stream doesn't close the substream.
+ *  \note         If \p child supports positional reads this stream does as well,
+ *                these do not affect the stream position.
  *  \returns
  *  \p NNC_R_NOMEM => Failed to allocate AES-CTR context.
  */
 nnc_result nnc_aes_ctr_open(nnc_aes_ctr *self, nnc_rstream *child, nnc_u128 *key,
 	nnc_u8 iv[0x10]);
 
+/** \brief         Encrypt to an AES-CTR write stream on-the-fly.
+ *  \param self    Output AES-CTR stream.
+ *  \param child   Child stream to write the ciphertext to.
+ *  \param key     Encryption key.
+ *  \param iv      Initial counter, it belongs to the current position of \p child.
+ *  \note          The counter follows the position of \p child, so writes need not be aligned and
+ *                 multiple streams with different keys may write to the same child one after another.
+ *  \note          This stream supports seeking if \p child does, positions are those of \p child
+ *                 and may not go before the position the stream was opened at.
+ *  \note          Calling close on this stream doesn't close the substream.
+ *  \returns
+ *  \p NNC_R_NOMEM => Failed to allocate AES-CTR context.
+ */
+nnc_result nnc_aes_ctr_open_w(nnc_aes_ctr *self, nnc_wstream *child, nnc_u128 *key,
+	nnc_u8 iv[0x10]);
+
+/** \brief          Set the maximum amount of threads an AES-CTR stream uses.
+ *  \param self     Stream from \ref nnc_aes_ctr_open.
+ *  \param threads  Maximum amount of threads, 0 for one per processor (the default) and 1 to never use threads.
+ *  \note           Only reads of several megabytes are split across threads, each thread reads
+ *                  its part with a positional read on the child and decrypts it, so the child must
+ *                  support positional reads.
+ *  \note           The threads come from a pool shared by the library that is started on first use
+ *                  and kept until the process exits.
+ */
+void nnc_aes_ctr_set_threads(nnc_aes_ctr *self, nnc_u32 threads);
+
+/** \brief          Write out a whole stream while reading and decrypting it on multiple threads.
+ *  \param rs       Stream to read, usually a section from \ref nnc_ncch_section_romfs or \ref nnc_ncch_section_exefs_header
+ *                  or a CIA content from \ref nnc_cia_open_content.
+ *  \param ws       Stream to write to, the data is written in order from the start of \p rs.
+ *  \param threads  Amount of threads that read from \p rs, 0 for one per processor.
+ *  \note           The threads read the stream in chunks with \ref nnc_rs_read_at, for an AES-CTR
+ *                  or AES-CBC stream each of them reads the ciphertext itself and decrypts it.
+ *                  If \p rs doesn't implement \p read_at or only one thread is used, this is \ref nnc_copy from offset 0,
+ *                  this is the case for an AES stream over a subview of a stream without positional reads for example.
+ *  \returns
+ *  Anything \ref nnc_rs_read_at or the write function of \p ws can return.\n
+ *  \p NNC_R_NOMEM => Failed to allocate the buffers.\n
+ *  \p NNC_R_OS => Failed to create the threads.
+ */
+nnc_result nnc_decrypt_section_parallel(nnc_rstream *rs, nnc_wstream *ws, nnc_u32 threads);
+
+/** Implementations of AES, used for the AES-CTR keystream and AES-CBC decryption. */
+enum nnc_aes_impl {
+	NNC_AES_IMPL_GENERIC = 0, ///< The cryptographic library.
+	NNC_AES_IMPL_AESNI   = 1, ///< x86 AES-NI instructions.
+	NNC_AES_IMPL_ARMV8   = 2, ///< ARMv8 Cryptography Extensions, only if the library was compiled for a CPU that has them.
+};
+
+/** \brief  Get the implementation of AES used by AES-CTR streams and AES-CBC decryption,
+ *          by default the fastest one the CPU supports.
+ */
+enum nnc_aes_impl nnc_aes_impl(void);
+
+/** \brief       Select the implementation of AES used by AES-CTR streams and AES-CBC decryption, meant for benchmarks and tests.
+ *  \param impl  Implementation to use.
+ *  \warning     This setting is global, no stream may be decrypting while it is changed.
+ *  \returns
+ *  \p NNC_R_UNSUPPORTED => \p impl is not available on this CPU or in this build.
+ */
+nnc_result nnc_aes_set_impl(enum nnc_aes_impl impl);
+
+/** Cryptographic kernels in use, see \ref nnc_crypto_backend_info. */
+typedef struct nnc_crypto_backend {
+	enum nnc_aes_impl aes;        ///< AES-CTR keystream and AES-CBC decryption, see \ref nnc_aes_impl.
+	enum nnc_sha256_impl sha256;  ///< SHA-256, see \ref nnc_crypto_sha256_impl.
+	const char *aes_name;         ///< Short name of \p aes, such as "aes-ni".
+	const char *sha256_name;      ///< Short name of \p sha256, such as "sha-ni".
+	enum nnc_sha256_multi_impl sha256_multi; ///< Multi-buffer SHA-256, see \ref nnc_crypto_sha256_multi_impl.
+	const char *sha256_multi_name;           ///< Short name of \p sha256_multi, such as "avx2".
+} nnc_crypto_backend;
+
+/** \brief       Report which cryptographic kernels are in use.
+ *  \param info  Output information, the names are static strings.
+ */
+void nnc_crypto_backend_info(nnc_crypto_backend *info);
+
+/** Key cache statistics, see \ref nnc_key_cache_get_stats. */
+typedef struct nnc_key_cache_stats {
+	nnc_u64 schedule_hits;     ///< AES streams opened with a key schedule from the cache.
+	nnc_u64 schedule_misses;   ///< AES streams that had to expand their key.
+	nnc_u64 normal_key_hits;   ///< NCCH normal keys taken from the cache.
+	nnc_u64 normal_key_misses; ///< NCCH normal keys that had to be generated.
+	nnc_u32 schedules;         ///< Key schedules currently in the cache, including ones in use.
+	nnc_u32 capacity;          ///< Maximum amount of unused key schedules kept.
+} nnc_key_cache_stats;
+
+/** \brief           Enable the process-wide key cache.
+ *  \param max_keys  Maximum amount of keys to keep, for both kinds of cached keys.
+ *  \note            AES streams opened with the same key share one key schedule instead of each
+ *                   allocating and expanding their own, and schedules of closed streams are kept
+ *                   until they are the least recently used one over \p max_keys.
+ *  \note            NCCH normal keys from \ref nnc_key_content and \ref nnc_key_menu_info are remembered
+ *                   by their keyX, keyY and seed, which skips hashing the seed for seeded titles.
+ *  \note            Calling this function again discards the current cache.
+ *  \warning         This function must not be called while another thread opens AES streams or generates keys.
+ *  \returns
+ *  \p NNC_R_INVAL => \p max_keys is 0.\n
+ *  \p NNC_R_NOMEM => Failed to allocate the cache.
+ */
+nnc_result nnc_key_cache_init(nnc_u32 max_keys);
+
+/** \brief  Disable the key cache and free the keys in it.
+ *  \note   Open streams keep their key schedule, it is freed when the last of them closes.
+ */
+void nnc_key_cache_free(void);
+
+/** \brief        Get the key cache statistics.
+ *  \param stats  Output statistics, the counters restart at \ref nnc_key_cache_init.
+ */
+void nnc_key_cache_get_stats(nnc_key_cache_stats *stats);
+
 /** \brief        Decrypt an AES-CBC stream on-the-fly.
  *  \param self   Output AES-CBC stream.
  *  \param child  Child stream to decrypt from.
  *  \param key    Encryption key.
  *  \param iv     IV.
- *  \warning      As this stream does not keep it's own offsets, do not open one multiple
- *                times to one substream.
- *  \note         For optimal usage align all operations to 0x10 bytes,
- *                however unaligned reads are possible as well.
+ *  \note         This stream keeps its own position, every read takes the block before the
+ *                offset from \p child as its IV and reads the ciphertext positionally,
+ *                unaligned reads decrypt the partial blocks at either end separately.
+ *                If \p child doesn't support positional reads they are a seek and a read.
+ *  \note         To read the data from multiple threads at once use \ref nnc_rs_clone,
+ *                clones share the key schedule and read from a clone of \p child.
  *  \note         Calling close on this stream doesn't close the substream.
+ *  \note         If \p child supports positional reads this stream does as well,
+ *                these do not affect the stream position.
  *  \returns
  *  \p NNC_R_NOMEM => Failed to allocate AES-CBC context.
  */
 nnc_result nnc_aes_cbc_open(nnc_aes_cbc *self, nnc_rstream *child, nnc_u8 key[0x10],
 	nnc_u8 iv[0x10]);
 
+/** \brief          Set the maximum amount of threads an AES-CBC stream uses.
+ *  \param self     Stream from \ref nnc_aes_cbc_open.
+ *  \param threads  Maximum amount of threads, 0 for one per processor (the default) and 1 to never use threads.
+ *  \note           Works like \ref nnc_aes_ctr_set_threads, CBC decryption can be split anywhere
+ *                  since every block only depends on the ciphertext before it.
+ */
+void nnc_aes_cbc_set_threads(nnc_aes_cbc *self, nnc_u32 threads);
+
 /** \brief        Encrypt an AES-CBC stream on-the-fly.
  *  \param self   Output AES-CBC stream.
  *  \param child  Child stream to encrypt from.
@@ -342,6 +588,45 @@ nnc_result nnc_aes_cbc_open(nnc_aes_cbc *self, nnc_rstream *child, nnc_u8 key[0x
 nnc_result nnc_aes_cbc_open_w(nnc_aes_cbc *self, nnc_wstream *child, nnc_u8 key[0x10],
 	nnc_u8 iv[0x10]);
 
+/** \brief        Decrypt an AES-CTR stream and hash the plaintext in the same pass.
+ *  \param self   Output stream.
+ *  \param crypt  Stream from \ref nnc_aes_ctr_open to take the key and ciphertext from.
+ *  \note         Reads fetch the ciphertext from the child of \p crypt, then decrypt and
+ *                hash it a few KiB at a time so the hash reads the plaintext from the cache.
+ *                This is faster than hashing the data read from \p crypt afterwards,
+ *                \ref nnc_crypto_sha256_part does this by itself for AES streams.
+ *  \note         This stream starts at offset 0 of \p crypt and can only seek forwards,
+ *                skipped data is hashed as well. It reads the child of \p crypt positionally
+ *                and doesn't change the position of \p crypt.
+ *  \note         Close the stream or use \ref nnc_aes_ctr_hashing_digest when done,
+ *                neither closes \p crypt.
+ *  \returns
+ *  \p NNC_R_NOMEM => Failed to allocate the hash context.
+ */
+nnc_result nnc_aes_ctr_hashing_open(nnc_aes_ctr_hashing *self, nnc_aes_ctr *crypt);
+
+/** \brief         Output the SHA-256 digest of everything read from a stream and close it.
+ *  \param self    Stream from \ref nnc_aes_ctr_hashing_open.
+ *  \param digest  Output digest.
+ */
+void nnc_aes_ctr_hashing_digest(nnc_aes_ctr_hashing *self, nnc_sha256_hash digest);
+
+/** \brief        Decrypt an AES-CBC stream and hash the plaintext in the same pass.
+ *  \param self   Output stream.
+ *  \param crypt  Stream from \ref nnc_aes_cbc_open to take the key, IV and ciphertext from.
+ *  \note         Works like \ref nnc_aes_ctr_hashing_open, use it to check a CIA content
+ *                against its chunk record while extracting it.
+ *  \returns
+ *  \p NNC_R_NOMEM => Failed to allocate the hash context.
+ */
+nnc_result nnc_aes_cbc_hashing_open(nnc_aes_cbc_hashing *self, nnc_aes_cbc *crypt);
+
+/** \brief         Output the SHA-256 digest of everything read from a stream and close it.
+ *  \param self    Stream from \ref nnc_aes_cbc_hashing_open.
+ *  \param digest  Output digest.
+ */
+void nnc_aes_cbc_hashing_digest(nnc_aes_cbc_hashing *self, nnc_sha256_hash digest);
+
 /** \brief         Get a key pair for an NCCH.
  *  \param output  Output keypair.
  *  \param ks      Keyset from \ref nnc_keyset_default.
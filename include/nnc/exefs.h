@@ -24,6 +24,12 @@ typedef struct nnc_exefs_file_header {
 	nnc_sha256_hash hash; ///< Hash of the content.
 } nnc_exefs_file_header;
 
+/** Layout of an ExeFS as written by \ref nnc_write_exefs, see \ref nnc_plan_exefs. */
+typedef struct nnc_exefs_plan {
+	nnc_exefs_file_header headers[NNC_EXEFS_MAX_FILES]; ///< File headers without hashes, unused headers are zeroed.
+	nnc_u64 size;                                       ///< Total size of the ExeFS.
+} nnc_exefs_plan;
+
 /** Returns whether or not a file header is used, the check is strlen(name) == 0. */
 bool nnc_exefs_file_in_use(nnc_exefs_file_header *fh);
 
@@ -56,6 +62,15 @@ void nnc_exefs_subview(nnc_rstream *rs, nnc_subview *sv, nnc_exefs_file_header *
  */
 nnc_result nnc_write_exefs(nnc_vfs *vfs, nnc_wstream *ws);
 
+/** \brief       Calculates the layout of an ExeFS without writing it.
+ *  \param vfs   The VFS that would be passed to \ref nnc_write_exefs.
+ *  \param plan  Output layout.
+ *  \note        Only the names and sizes of the files are used, no file is opened.
+ *  \returns
+ *  The same errors about the VFS as \ref nnc_write_exefs.
+ */
+nnc_result nnc_plan_exefs(nnc_vfs *vfs, nnc_exefs_plan *plan);
+
 NNC_END
 #endif
 
@@ -42,6 +42,13 @@ typedef struct nnc_ivfc {
 	nnc_ivfc_level_descriptor level[NNC_IVFC_MAX_LEVELS]; ///< Level descriptors, excluding level 0.
 } nnc_ivfc;
 
+/** Layout of an IVFC as written by \ref nnc_open_ivfc_writer, see \ref nnc_plan_ivfc. */
+typedef struct nnc_ivfc_plan {
+	nnc_ivfc header;                            ///< Header the writer will produce.
+	nnc_u64 level_offset[NNC_IVFC_MAX_LEVELS];  ///< Offset of each level relative to the start of the IVFC, the last level holds the data.
+	nnc_u64 size;                               ///< Total size of the IVFC.
+} nnc_ivfc_plan;
+
 typedef struct nnc_ivfc_writer {
 	const nnc_wstream_funcs *funcs;
 	nnc_wstream *child;
@@ -53,7 +60,9 @@ typedef struct nnc_ivfc_writer {
 	nnc_u32 blocks_hashed;
 	nnc_u32 id, levels;
 	nnc_u32 block_size; /* not log2! */
-	nnc_u32 header_pos;
+	nnc_u64 header_pos;
+	nnc_u32 threads;                 ///< Amount of threads hashing, see \ref nnc_ivfc_set_threads.
+	struct nnc_ivfc_hash_pool *pool; ///< Workers hashing the data level, NULL if it is hashed on the writing thread.
 } nnc_ivfc_writer;
 
 /** \brief                  Reads the header of an IVFC.
@@ -76,9 +85,30 @@ nnc_result nnc_read_ivfc_header(nnc_rstream *rs, nnc_ivfc *ivfc, nnc_u32 expecte
  *  \param id          IVFC ID, see #nnc_ivfc_id.
  *  \param block_size  The (power of 2!) block size to use, see #nnc_ivfc_blocksize.
  *  \note              This stream requires the `seek` function in `child`
+ *  \note              On systems with multiple processors the blocks are hashed on worker threads,
+ *                     see \ref nnc_ivfc_set_threads. The output does not depend on the amount of threads.
+ *  \warning           \p self must not be moved while open.
  */
 nnc_result nnc_open_ivfc_writer(nnc_ivfc_writer *self, nnc_wstream *child, nnc_u32 levels, nnc_u32 id, nnc_u32 block_size);
 
+/** \brief          Set the amount of threads an IVFC writer hashes with.
+ *  \param self     IVFC writer from \ref nnc_open_ivfc_writer, nothing may have been written to it yet.
+ *  \param threads  Amount of threads, 0 to use one for each processor (the default) or 1 to hash on the writing thread.
+ *  \note           If the worker threads cannot be created the blocks are hashed on the writing thread.
+ */
+void nnc_ivfc_set_threads(nnc_ivfc_writer *self, nnc_u32 threads);
+
+/** \brief             Calculates the layout of an IVFC without writing it.
+ *  \param plan        Output layout.
+ *  \param data_size   Amount of data that will be written to the writer.
+ *  \param levels      The amount of levels, see \ref nnc_open_ivfc_writer.
+ *  \param id          IVFC ID, see #nnc_ivfc_id.
+ *  \param block_size  The (power of 2!) block size, see #nnc_ivfc_blocksize.
+ *  \returns
+ *  \p NNC_R_INVAL => \p levels or \p block_size is invalid.
+ */
+nnc_result nnc_plan_ivfc(nnc_ivfc_plan *plan, nnc_u64 data_size, nnc_u32 levels, nnc_u32 id, nnc_u32 block_size);
+
 /** \brief       Frees memory in use by an IVFC writer without writing out the rest of the IVFC file.
  *  \param self  The writer to free.
  */
@@ -8,6 +8,7 @@
 #include <nnc/exheader.h>
 #include <nnc/crypto.h>
 #include <nnc/exefs.h>
+#include <nnc/romfs.h>
 #include <nnc/u128.h>
 #include <nnc/base.h>
 NNC_BEGIN
@@ -84,6 +85,15 @@ typedef struct nnc_condensed_ncch_header {
 	char maker_code[3];
 } nnc_condensed_ncch_header;
 
+/** Encryption settings for \ref nnc_write_ncch_encrypted. */
+typedef struct nnc_ncch_encryption {
+	nnc_keyset *ks;       ///< Keyset to derive the keys from, see \ref nnc_keyset_default. May be NULL with #NNC_NCCH_FIXED_KEY.
+	nnc_seeddb *seeddb;   ///< SeedDB to take the seed for the title ID from if #NNC_NCCH_USES_SEED is set.
+	nnc_u128 keyy;        ///< KeyY, written to the start of the otherwise empty signature.
+	nnc_u8 crypt_method;  ///< Determines the keys to use, see \ref nnc_ncch_crypt_methods.
+	nnc_u8 flags;         ///< #NNC_NCCH_FIXED_KEY and #NNC_NCCH_USES_SEED are used, other flags are ignored.
+} nnc_ncch_encryption;
+
 typedef void* nnc_vfs_or_stream;
 typedef void* nnc_exheader_or_stream;
 
@@ -111,6 +121,21 @@ enum nnc_ncch_wflags {
 	NNC_NCCH_WF_EXHEADER_OMIT    = 0,   ///< Omit the exheader from the NCCH, pass NULL for the `exheader` parameter.
 };
 
+/** Layout of an NCCH as written by \ref nnc_write_ncch, see \ref nnc_plan_ncch. */
+typedef struct nnc_ncch_plan {
+	struct nnc_ncch_plan_section {
+		nnc_u64 offset; ///< Offset relative to the start of the NCCH, 0 if the section is not written.
+		nnc_u64 size;   ///< Size without the padding to #NNC_MEDIA_UNIT.
+	}	exheader,       ///< Extended header.
+		logo,           ///< Logo.
+		plain,          ///< Plain section.
+		exefs,          ///< ExeFS.
+		romfs;          ///< RomFS.
+	nnc_exefs_plan exefs_layout; ///< Layout of the ExeFS if it is built from a VFS, zeroed otherwise.
+	nnc_romfs_plan romfs_layout; ///< Layout of the RomFS if it is built from a VFS, zeroed otherwise.
+	nnc_u64 size;                ///< Total size of the NCCH.
+} nnc_ncch_plan;
+
 /** A pseudo-stream to hold all possible required streams, yet still
  *  usable like all other streams with \ref NNC_RSP */
 typedef struct nnc_ncch_section_stream {
@@ -253,6 +278,7 @@ void nnc_condense_ncch(nnc_condensed_ncch_header *cnd, nnc_ncch_header *hdr);
  *  \param romfs     RomFS section, for possible types see #nnc_ncch_wflags.
  *  \param ws        The output write stream.
  *  \note            The write stream *must* support seeking.
+ *  \note            The NCCH is not encrypted, see \ref nnc_write_ncch_encrypted.
  */
 nnc_result nnc_write_ncch(
 	nnc_condensed_ncch_header *header,
@@ -265,6 +291,58 @@ nnc_result nnc_write_ncch(
 	nnc_wstream *ws
 );
 
+/** \brief           Write an encrypted NCCH image.
+ *  \param header    The header to write, see \ref nnc_write_ncch.
+ *  \param crypto    Encryption settings, NULL to write an unencrypted NCCH like \ref nnc_write_ncch.
+ *  \param wflags    Write flags, see #nnc_ncch_wflags.
+ *  \param exheader  Exheader section, for possible types see #nnc_ncch_wflags.
+ *  \param logo      Logo section read stream, NULL if you want none.
+ *  \param plain     Plain section read stream, NULL if you want none.
+ *  \param exefs     ExeFS section, for possible types see #nnc_ncch_wflags.
+ *  \param romfs     RomFS section, for possible types see #nnc_ncch_wflags.
+ *  \param ws        The output write stream.
+ *  \note            The exheader, ExeFS and RomFS are encrypted as they are written, the hashes
+ *                   in the header are of the plaintext. The ExeFS header and the "icon" and "banner"
+ *                   files use the primary key, the other files the secondary key, see \ref nnc_ncch_exefs_subview.
+ *  \note            The write stream *must* support seeking.
+ *  \returns
+ *  Anything \ref nnc_write_ncch can return.\n
+ *  Anything \ref nnc_fill_keypair can return.
+ */
+nnc_result nnc_write_ncch_encrypted(
+	nnc_condensed_ncch_header *header,
+	nnc_ncch_encryption *crypto,
+	nnc_u8 wflags,
+	nnc_exheader_or_stream exheader,
+	nnc_rstream *logo,
+	nnc_rstream *plain,
+	nnc_vfs_or_stream exefs,
+	nnc_vfs_or_stream romfs,
+	nnc_wstream *ws
+);
+
+/** \brief           Calculates the layout of an NCCH without writing it.
+ *  \param wflags    Write flags, see #nnc_ncch_wflags.
+ *  \param exheader  Exheader section, see \ref nnc_write_ncch.
+ *  \param logo      Logo section read stream, NULL if you want none.
+ *  \param plain     Plain section read stream, NULL if you want none.
+ *  \param exefs     ExeFS section, see \ref nnc_write_ncch.
+ *  \param romfs     RomFS section, see \ref nnc_write_ncch.
+ *  \param plan      Output layout.
+ *  \note            Only the sizes of the streams and VFS nodes are used, no data is read.
+ *  \returns
+ *  The same errors about the parameters as \ref nnc_write_ncch.
+ */
+nnc_result nnc_plan_ncch(
+	nnc_u8 wflags,
+	nnc_exheader_or_stream exheader,
+	nnc_rstream *logo,
+	nnc_rstream *plain,
+	nnc_vfs_or_stream exefs,
+	nnc_vfs_or_stream romfs,
+	nnc_ncch_plan *plan
+);
+
 /** \brief        Write an NCCH from a buildable NCCH struct.
  *  \param bncch  "Buildable NCCH" which contains all information required to build in one struct.
  *  \param ws     Output stream.
@@ -274,6 +352,15 @@ static inline nnc_result nnc_write_ncch_from_buildable(nnc_buildable_ncch *bncch
 	return nnc_write_ncch(&bncch->chdr, bncch->wflags, bncch->exheader, bncch->logo, bncch->plain, bncch->exefs, bncch->romfs, ws);
 }
 
+/** \brief        Calculate the layout of an NCCH from a buildable NCCH struct, see \ref nnc_plan_ncch.
+ *  \param bncch  "Buildable NCCH" which contains all information required to build in one struct.
+ *  \param plan   Output layout.
+ */
+static inline nnc_result nnc_plan_ncch_from_buildable(nnc_buildable_ncch *bncch, nnc_ncch_plan *plan)
+{
+	return nnc_plan_ncch(bncch->wflags, bncch->exheader, bncch->logo, bncch->plain, bncch->exefs, bncch->romfs, plan);
+}
+
 NNC_END
 #endif
 
@@ -6,6 +6,7 @@
 #define inc_nnc_romfs_h
 
 #include <nnc/stream.h>
+#include <nnc/ivfc.h>
 #include <nnc/base.h>
 #include <nnc/utf.h>
 NNC_BEGIN
@@ -21,6 +22,14 @@ typedef struct nnc_romfs_header {
 	nnc_u64 data_offset; ///< File data offset.
 } nnc_romfs_header;
 
+/** Layout of a RomFS as written by \ref nnc_write_romfs, see \ref nnc_plan_romfs. */
+typedef struct nnc_romfs_plan {
+	nnc_ivfc_plan ivfc;      ///< Layout of the IVFC around the RomFS.
+	nnc_romfs_header header; ///< Header the writer will produce, with offsets relative to the start of the RomFS like \ref nnc_read_romfs_header.
+	nnc_u64 data_size;       ///< Size of the file data, including the padding between files.
+	nnc_u64 size;            ///< Total size of the RomFS.
+} nnc_romfs_plan;
+
 typedef struct nnc_romfs_ctx {
 	struct nnc_romfs_header header;
 	nnc_utf_conversion_buffer cbuf;
@@ -29,6 +38,7 @@ typedef struct nnc_romfs_ctx {
 	nnc_u8 *file_meta_data;
 	nnc_u8 *dir_meta_data;
 	nnc_rstream *rs;
+	bool borrowed; ///< Whether the tables point directly into \p rs instead of allocated memory.
 } nnc_romfs_ctx;
 
 /** Information about either a directory or file in RomFS. */
@@ -110,15 +120,27 @@ nnc_result nnc_romfs_to_vfs(nnc_romfs_ctx *ctx, nnc_vfs_directory_node *dir);
  *  \param ctx   Context from \ref nnc_init_romfs.
  *  \param sv    Output subview.
  *  \param info  \ref nnc_romfs_info for the desired file.
+ *  \note        The file is hinted to be read sequentially, see \ref nnc_rs_advise.
  */
 nnc_result nnc_romfs_open_subview(nnc_romfs_ctx *ctx, nnc_subview *sv, nnc_romfs_info *info);
 
+/** \brief       Writes the contents of a RomFS file to a stream.
+ *  \param ctx   Context from \ref nnc_init_romfs.
+ *  \param info  \ref nnc_romfs_info for the desired file.
+ *  \param ws    Stream to write the file to, at its current position.
+ *  \note        This uses \ref nnc_copy, so larger files are read ahead asynchronously
+ *               or copied in the kernel where possible.
+ */
+nnc_result nnc_romfs_copy_file(nnc_romfs_ctx *ctx, nnc_romfs_info *info, nnc_wstream *ws);
+
 /** \brief      Prepare a context for use with various other RomFS-related functions.
  *  \param rs   Stream to read RomFS from.
  *  \param ctx  Output context.
  *  \note       This function allocates dynamic memory so make sure to free
  *              \p ctx with \ref nnc_free_romfs.
  *  \note       If this function does not return NNC_R_OK you musn't call \ref nnc_free_romfs
+ *  \note       If \p rs supports \ref nnc_rs_borrow the tables are not copied, in that case
+ *              \p rs must stay open until \ref nnc_free_romfs is called, as it should anyway.
  */
 nnc_result nnc_init_romfs(nnc_rstream *rs, nnc_romfs_ctx *ctx);
 
@@ -141,6 +163,13 @@ nnc_result nnc_read_romfs_header(nnc_rstream *rs, nnc_romfs_header *romfs);
  */
 nnc_result nnc_write_romfs(nnc_vfs *vfs, nnc_wstream *ws);
 
+/** \brief       Calculates the layout of a RomFS without writing it.
+ *  \param vfs   The Virtual FileSystem that would be passed to \ref nnc_write_romfs.
+ *  \param plan  Output layout.
+ *  \note        Only the names and sizes of the nodes are used, no file is opened.
+ */
+nnc_result nnc_plan_romfs(nnc_vfs *vfs, nnc_romfs_plan *plan);
+
 NNC_END
 #endif
 
@@ -31,15 +31,39 @@ struct nnc_rstream;
 typedef nnc_result (*nnc_read_func)(struct nnc_rstream *self, nnc_u8 *buf, nnc_u32 max,
 		nnc_u32 *totalRead);
 /** Seek to absolute position in stream. */
-typedef nnc_result (*nnc_seek_abs_func)(struct nnc_rstream *self, nnc_u32 pos);
+typedef nnc_result (*nnc_seek_abs_func)(struct nnc_rstream *self, nnc_u64 pos);
 /** Seek to relative to current position in stream. */
-typedef nnc_result (*nnc_seek_rel_func)(struct nnc_rstream *self, nnc_u32 pos);
+typedef nnc_result (*nnc_seek_rel_func)(struct nnc_rstream *self, nnc_u64 pos);
 /** Get total size of stream. */
-typedef nnc_u32 (*nnc_size_func)(struct nnc_rstream *self);
+typedef nnc_u64 (*nnc_size_func)(struct nnc_rstream *self);
 /** Close/free the stream */
 typedef void (*nnc_close_func)(struct nnc_rstream *self);
 /** Get current position in stream */
-typedef nnc_u32 (*nnc_tell_func)(struct nnc_rstream *self);
+typedef nnc_u64 (*nnc_tell_func)(struct nnc_rstream *self);
+/** Read from an absolute position in the stream without using or changing the current position. */
+typedef nnc_result (*nnc_read_at_func)(struct nnc_rstream *self, nnc_u64 pos, nnc_u8 *buf, nnc_u32 max,
+		nnc_u32 *totalRead);
+/** Get a pointer to \p len bytes at \p pos that are already in memory, without copying them.
+ *  The pointer stays valid until the stream is closed and the position is not changed. */
+typedef nnc_result (*nnc_borrow_func)(struct nnc_rstream *self, nnc_u64 pos, nnc_u64 len,
+		const nnc_u8 **ptr);
+/** Find the operating system file descriptor and offset at which \p len bytes at \p pos are stored unmodified. */
+typedef nnc_result (*nnc_locate_func)(struct nnc_rstream *self, nnc_u64 pos, nnc_u64 len,
+		int *fd, nnc_u64 *fd_pos);
+
+/** Access pattern hints for \ref nnc_rs_advise. */
+enum nnc_advice {
+	NNC_ADVISE_NORMAL,     ///< No particular access pattern, undoes earlier hints.
+	NNC_ADVISE_SEQUENTIAL, ///< The data will be read front to back.
+	NNC_ADVISE_RANDOM,     ///< The data will be read in no particular order.
+	NNC_ADVISE_WILLNEED,   ///< The data will be read soon.
+	NNC_ADVISE_DONTNEED,   ///< The data will not be read again soon.
+};
+/** Tell the stream how \p len bytes at \p pos will be accessed, see \ref nnc_advice. */
+typedef nnc_result (*nnc_advise_func)(struct nnc_rstream *self, nnc_u64 pos, nnc_u64 len,
+		int advice);
+/** Create a heap allocated stream over the same data with its own position, see \ref nnc_rs_clone. */
+typedef nnc_result (*nnc_clone_func)(struct nnc_rstream *self, struct nnc_rstream **out);
 
 /** All functions a stream should have */
 typedef struct nnc_rstream_funcs {
@@ -49,6 +73,12 @@ typedef struct nnc_rstream_funcs {
 	nnc_size_func size;
 	nnc_close_func close;
 	nnc_tell_func tell;
+	nnc_read_at_func read_at; ///< Note that this may be NULL in streams that do not support positional reads.
+	                          ///< When set it must not use the position of the stream or of its children, so it can be called from several threads at once.
+	nnc_borrow_func borrow;   ///< Note that this may be NULL in streams that are not backed by memory.
+	nnc_locate_func locate;   ///< Note that this may be NULL in streams that are not backed by a file descriptor.
+	nnc_advise_func advise;   ///< Note that this may be NULL in streams that ignore access pattern hints.
+	nnc_clone_func clone;     ///< Note that this may be NULL, \ref nnc_rs_clone falls back to positional reads in that case.
 } nnc_rstream_funcs;
 
 /** Struct containing just a func table which should be
@@ -58,20 +88,23 @@ typedef struct nnc_rstream {
 	/* user-data */
 } nnc_rstream;
 
+struct nnc_readahead;
+
 /** Stream for a file using the standard FILE. */
 typedef struct nnc_file {
 	const nnc_rstream_funcs *funcs;
-	nnc_u32 size;
-	nnc_u32 off;
+	nnc_u64 size;
+	nnc_u64 off;
 	FILE *f;
 	nnc_u8 flags;
+	struct nnc_readahead *ra; ///< Read-ahead buffer, NULL if unbuffered.
 } nnc_file;
 
 /** Stream for memory buffer. */
 typedef struct nnc_memory {
 	const nnc_rstream_funcs *funcs;
-	nnc_u32 size;
-	nnc_u32 pos;
+	nnc_u64 size;
+	nnc_u64 pos;
 	union nnc_memory_un {
 		const void *ptr_const;
 		void *ptr;
@@ -82,28 +115,68 @@ typedef struct nnc_memory {
 typedef struct nnc_subview {
 	const nnc_rstream_funcs *funcs;
 	nnc_rstream *child;
-	nnc_u32 size;
-	nnc_u32 off;
-	nnc_u32 pos;
+	nnc_u64 size;
+	nnc_u64 off;
+	nnc_u64 pos;
 	nnc_u8 flags;
 } nnc_subview;
 
+/** Stream for a file mapped into memory. */
+typedef struct nnc_mmap_file {
+	const nnc_rstream_funcs *funcs;
+	nnc_u64 size;
+	nnc_u64 pos;
+	const nnc_u8 *ptr;
+} nnc_mmap_file;
+
+/** Stream that buffers reads from another stream and reads ahead if accessed sequentially. */
+typedef struct nnc_buffered_rstream {
+	const nnc_rstream_funcs *funcs;
+	nnc_rstream *child;
+	nnc_u64 pos;
+	struct nnc_readahead *ra;
+} nnc_buffered_rstream;
+
+/** Default maximum read-ahead window of buffered streams. */
+#define NNC_BUFFERED_DEFAULT_WINDOW 0x20000
+
 /** \brief       Create a new file stream.
  *  \param self  Output stream.
- *  \param name  Filename to open. */
+ *  \param name  Filename to open.
+ *  \note        Reads are buffered with a window of #NNC_BUFFERED_DEFAULT_WINDOW,
+ *               use \ref nnc_file_set_window to change this. */
 nnc_result nnc_file_open(nnc_file *self, const char *name);
 
+/** \brief         Change the read-ahead window of a file stream.
+ *  \param self    Stream from \ref nnc_file_open.
+ *  \param window  Maximum amount of data to buffer, 0 disables buffering.
+ *  \returns
+ *  \p NNC_R_NOMEM => Failed to allocate the buffer, the stream is left unbuffered.
+ */
+nnc_result nnc_file_set_window(nnc_file *self, nnc_u32 window);
+
+/** \brief       Create a new stream by mapping a file into memory.
+ *  \param self  Output stream.
+ *  \param name  Filename to open.
+ *  \note        Reads from this stream are served from the page cache and it supports #nnc_rs_borrow.
+ *  \returns
+ *  \p NNC_R_FAIL_OPEN => Failed to open or map the file.\n
+ *  \p NNC_R_TOO_LARGE => File does not fit in the address space.\n
+ *  \p NNC_R_UNSUPPORTED => Memory mapping is not supported on this platform.
+ */
+nnc_result nnc_mmap_file_open(nnc_mmap_file *self, const char *name);
+
 /** \brief       Create a new memory stream.
  *  \param self  Output stream.
  *  \param ptr   Pointer to memory.
  *  \param size  Size of memory. */
-void nnc_mem_open(nnc_memory *self, const void *ptr, nnc_u32 size);
+void nnc_mem_open(nnc_memory *self, const void *ptr, nnc_u64 size);
 
 /** \brief       Create a new memory stream that free()s the pointer when closed.
  *  \param self  Output stream.
  *  \param ptr   Pointer to memory.
  *  \param size  Size of memory. */
-void nnc_mem_own_open(nnc_memory *self, void *ptr, nnc_u32 size);
+void nnc_mem_own_open(nnc_memory *self, void *ptr, nnc_u64 size);
 
 /** \brief        Create a new subview stream.
  *  \param self   Output stream.
@@ -111,8 +184,25 @@ void nnc_mem_own_open(nnc_memory *self, void *ptr, nnc_u32 size);
  *  \param off    Starting offset in \p child.
  *  \param len    Length of data in \p child.
  *  \note         Closing this stream has no effect; the child stream is not closed, that is, unless #nnc_subview_delete_on_close is called.
+ *  \note         The subview only implements \p read_at if \p child does, otherwise it seeks \p child for every read.
  */
-void nnc_subview_open(nnc_subview *self, nnc_rstream *child, nnc_u32 off, nnc_u32 len);
+void nnc_subview_open(nnc_subview *self, nnc_rstream *child, nnc_u64 off, nnc_u64 len);
+
+/** \brief         Create a new buffered stream.
+ *  \param self    Output stream.
+ *  \param child   Child stream.
+ *  \param window  Maximum amount of data to buffer, 0 for #NNC_BUFFERED_DEFAULT_WINDOW.
+ *  \note          Small reads are served from a buffer, which is refilled with an amount that
+ *                 grows while the stream is read sequentially and shrinks again on random access.
+ *                 Reads larger than \p window go to the child directly.
+ *  \note          If \p child implements \p read_at, reads from several threads only share the buffer
+ *                 and read from the child in parallel, else they read from the child one at a time.
+ *  \note          Closing this stream does not close the child stream.
+ *  \warning       The child must not change while the buffered stream is open.
+ *  \returns
+ *  \p NNC_R_NOMEM => Failed to allocate the buffer.
+ */
+nnc_result nnc_buffered_rstream_open(nnc_buffered_rstream *self, nnc_rstream *child, nnc_u32 window);
 
 /** \brief       This function makes the substream close and free its child stream when it is closed.
  *  \param self  The stream to enable this functionality on.
@@ -131,48 +221,108 @@ void nnc_subview_delete_on_close(nnc_subview *self);
 
 /** \cond INTERNAL */
 nnc_result nnc_rs_read_(nnc_rstream *rs, nnc_u8 *buf, nnc_u32 max, nnc_u32 *totalRead);
-nnc_result nnc_rs_read_at_(nnc_rstream *rs, nnc_u32 pos, nnc_u8 *buf, nnc_u32 max, nnc_u32 *totalRead);
-nnc_result nnc_rs_seek_abs_(nnc_rstream *rs, nnc_u32 pos);
-nnc_result nnc_rs_seek_rel_(nnc_rstream *rs, nnc_u32 pos);
-nnc_u32 nnc_rs_tell_(nnc_rstream *rs);
-nnc_u32 nnc_rs_size_(nnc_rstream *rs);
+nnc_result nnc_rs_read_at_(nnc_rstream *rs, nnc_u64 pos, nnc_u8 *buf, nnc_u32 max, nnc_u32 *totalRead);
+nnc_result nnc_rs_borrow_(nnc_rstream *rs, nnc_u64 pos, nnc_u64 len, const nnc_u8 **ptr);
+nnc_result nnc_rs_locate_(nnc_rstream *rs, nnc_u64 pos, nnc_u64 len, int *fd, nnc_u64 *fd_pos);
+nnc_result nnc_rs_advise_(nnc_rstream *rs, nnc_u64 pos, nnc_u64 len, int advice);
+nnc_result nnc_rs_clone_(nnc_rstream *rs, nnc_rstream **out);
+nnc_result nnc_rs_seek_abs_(nnc_rstream *rs, nnc_u64 pos);
+nnc_result nnc_rs_seek_rel_(nnc_rstream *rs, nnc_u64 pos);
+nnc_u64 nnc_rs_tell_(nnc_rstream *rs);
+nnc_u64 nnc_rs_size_(nnc_rstream *rs);
 void nnc_rs_close_(nnc_rstream *rs);
 /** \endcond */
 
 /** \brief            Reads data from a stream at an offset.
  *  \param rs         [#nnc_rstream *] Stream to read from.
- *  \param pos        [#nnc_u32] Position in the stream to seek to before.
+ *  \param pos        [#nnc_u64] Position in the stream to read from.
  *  \param buf        [#nnc_u8 *] Buffer to output data in.
  *  \param max        [#nnc_u32] Maximum amount of data to read.
  *  \param totalRead  [#nnc_u32 *] Output pointer to the amount of data actually read.
  *                    If this param is NULL then reading less than `max` is instead treated like an error.
+ *  \note             If the stream implements \p read_at the current position is not changed,
+ *                    otherwise this seeks to \p pos and reads from there.
+ *  \note             Only streams that implement \p read_at may be read like this from several threads at once.
  *  \returns    [#nnc_result] Operation result.
  */
 #define nnc_rs_read_at(rs, pos, buf, max, totalRead) nnc_rs_read_at_((nnc_rstream *) (rs), pos, buf, max, totalRead)
 
+/** \brief      Gets a pointer to data in the stream without copying it.
+ *  \param rs   [#nnc_rstream *] Stream to borrow from.
+ *  \param pos  [#nnc_u64] Position of the data.
+ *  \param len  [#nnc_u64] Length of the data.
+ *  \param ptr  [const #nnc_u8 **] Output pointer, valid until the stream is closed.
+ *  \note       This does not change the current position.
+ *  \returns
+ *  \p NNC_R_UNSUPPORTED => The stream is not backed by memory, use \ref nnc_rs_read_at instead.\n
+ *  \p NNC_R_SEEK_RANGE => The range is not within the stream.
+ */
+#define nnc_rs_borrow(rs, pos, len, ptr) nnc_rs_borrow_((nnc_rstream *) (rs), pos, len, ptr)
+
+/** \brief         Finds the file descriptor that data in the stream is stored in, for use with operating system I/O.
+ *  \param rs      [#nnc_rstream *] Stream to locate data in.
+ *  \param pos     [#nnc_u64] Position of the data.
+ *  \param len     [#nnc_u64] Length of the data.
+ *  \param fd      [int *] Output file descriptor, owned by the stream.
+ *  \param fd_pos  [#nnc_u64 *] Output offset of the data in \p fd.
+ *  \note          Only file streams on unix-like systems and streams that pass data through unmodified support this.
+ *  \returns
+ *  \p NNC_R_UNSUPPORTED => The data is not stored as-is in a file.\n
+ *  \p NNC_R_SEEK_RANGE => The range is not within the stream.
+ */
+#define nnc_rs_locate(rs, pos, len, fd, fd_pos) nnc_rs_locate_((nnc_rstream *) (rs), pos, len, fd, fd_pos)
+
+/** \brief         Hints how data in the stream will be accessed.
+ *  \param rs      [#nnc_rstream *] Stream the data will be read from.
+ *  \param pos     [#nnc_u64] Position of the data.
+ *  \param len     [#nnc_u64] Length of the data, clamped to the end of the stream.
+ *  \param advice  [#nnc_advice] How the data will be accessed.
+ *  \note          Streams translate the range to the data they read from their child and pass the hint on,
+ *                 file streams pass it to the operating system with posix_fadvise or madvise.
+ *  \note          Hints never change the data that is read, so the result can be ignored.
+ *  \returns
+ *  \p NNC_R_UNSUPPORTED => The stream ignores hints.
+ */
+#define nnc_rs_advise(rs, pos, len, advice) nnc_rs_advise_((nnc_rstream *) (rs), pos, len, advice)
+
+/** \brief      Opens another stream over the same data that can be read independently.
+ *  \param rs   [#nnc_rstream *] Stream to clone.
+ *  \param out  [#nnc_rstream **] Output pointer to the clone, allocated with malloc().
+ *  \note       The clone starts at position 0 and has its own position and buffers, but shares
+ *              the file, memory and key schedules with \p rs, so \p rs and its clones
+ *              can be read from different threads without opening the data again.
+ *  \note       Streams that do not implement cloning but support positional reads are cloned
+ *              as a view that reads through \ref nnc_rs_read_at on \p rs.
+ *  \warning    The clone must be closed with \ref nnc_rs_close and free()d before \p rs is closed.
+ *  \returns
+ *  \p NNC_R_UNSUPPORTED => The stream, or a stream it reads from, supports neither cloning nor positional reads.\n
+ *  \p NNC_R_NOMEM => Failed to allocate the clone.
+ */
+#define nnc_rs_clone(rs, out) nnc_rs_clone_((nnc_rstream *) (rs), out)
+
 /** \brief      Seeks to an absolute position in the stream.
  *  \param rs   [#nnc_rstream *] Stream to seek in.
- *  \param pos  [#nnc_u32] Position to seek to.
+ *  \param pos  [#nnc_u64] Position to seek to.
  *  \returns    [#nnc_result] Operation result.
  */
 #define nnc_rs_seek_abs(rs, pos) nnc_rs_seek_abs_((nnc_rstream *) (rs), pos)
 
 /** \brief      Seeks to the result of `nnc_rs_tell(rs) + pos` in the stream.
  *  \param rs   [#nnc_rstream *] Stream to seek in.
- *  \param pos  [#nnc_u32] Position to seek to.
+ *  \param pos  [#nnc_u64] Position to seek to.
  *  \returns    [#nnc_result] Operation result.
  */
 #define nnc_rs_seek_rel(rs, pos) nnc_rs_seek_rel_((nnc_rstream *) (rs), pos)
 
 /** \brief      Retrieves the total size of the stream.
  *  \param rs   [#nnc_rstream *] Stream to get size of.
- *  \returns    [#nnc_u32] Total stream size.
+ *  \returns    [#nnc_u64] Total stream size.
  */
 #define nnc_rs_size(rs) nnc_rs_size_((nnc_rstream *) (rs))
 
 /** \brief      Retrieves the current position of the stream.
  *  \param rs   [#nnc_rstream *] Stream to get the position of.
- *  \returns    [#nnc_u32] Current stream position.
+ *  \returns    [#nnc_u64] Current stream position.
  */
 #define nnc_rs_tell(rs) nnc_rs_tell_((nnc_rstream *) (rs))
 
@@ -203,9 +353,14 @@ void nnc_rs_close_(nnc_rstream *rs);
 struct nnc_wstream;
 typedef nnc_result (*nnc_write_func)(struct nnc_wstream *self, nnc_u8 *buf, nnc_u32 size);
 typedef nnc_result (*nnc_wclose_func)(struct nnc_wstream *self);
-typedef nnc_result (*nnc_wseek_func)(struct nnc_wstream *self, nnc_u32 abspos);
-typedef nnc_u32    (*nnc_wtell_func)(struct nnc_wstream *self);
-typedef nnc_result (*nnc_wsubreadstream_func)(struct nnc_wstream *self, nnc_subview *out, nnc_u32 start, nnc_u32 amount);
+typedef nnc_result (*nnc_wseek_func)(struct nnc_wstream *self, nnc_u64 abspos);
+typedef nnc_u64    (*nnc_wtell_func)(struct nnc_wstream *self);
+typedef nnc_result (*nnc_wsubreadstream_func)(struct nnc_wstream *self, nnc_subview *out, nnc_u64 start, nnc_u64 amount);
+/** Writes out buffered data and resolves the current position to a file descriptor,
+ *  data written to the descriptor directly must be followed by a seek past it. */
+typedef nnc_result (*nnc_wlocate_func)(struct nnc_wstream *self, int *fd, nnc_u64 *fd_pos);
+/** Advance the position by \p count bytes that read back as 0x00, without writing them where possible. */
+typedef nnc_result (*nnc_wskip_func)(struct nnc_wstream *self, nnc_u64 count);
 
 typedef struct nnc_wstream_funcs {
 	nnc_write_func write;
@@ -213,6 +368,8 @@ typedef struct nnc_wstream_funcs {
 	nnc_wseek_func seek; ///< Note that this may be NULL in streams that do not support seeking.
 	nnc_wtell_func tell;
 	nnc_wsubreadstream_func subreadstream; ///< Note that this may be NULL in streams that do not support readback.
+	nnc_wlocate_func locate; ///< Note that this may be NULL in streams that are not backed by a file descriptor.
+	nnc_wskip_func skip; ///< Note that this may be NULL, \ref nnc_write_padding writes zeros in that case.
 } nnc_wstream_funcs;
 
 typedef struct nnc_wstream {
@@ -222,14 +379,48 @@ typedef struct nnc_wstream {
 
 typedef struct nnc_wfile {
 	const nnc_wstream_funcs *funcs;
-	nnc_u32 off;
+	nnc_u64 off;
 	FILE *f;
+	nnc_u64 end; ///< Furthest position skipped to, the file is extended to it on close.
 } nnc_wfile;
 
+/** File write stream that coalesces small writes, see \ref nnc_buffered_wfile_open. */
+typedef struct nnc_buffered_wfile {
+	const nnc_wstream_funcs *funcs;
+	nnc_u64 pos;       ///< Current write position.
+	nnc_u64 buf_start; ///< File offset of the first byte in the buffer.
+	nnc_u64 fpos;      ///< Position of the FILE, -1 if unknown.
+	nnc_u32 buf_len;   ///< Amount of pending data in the buffer.
+	nnc_u32 buf_size;  ///< Capacity of the buffer.
+	nnc_u8 *buf;
+	FILE *f;
+	nnc_u64 end;       ///< Furthest position skipped to, the file is extended to it on close.
+} nnc_buffered_wfile;
+
+/** Write stream into a growable memory buffer, see \ref nnc_wmemory_open. */
+typedef struct nnc_wmemory {
+	const nnc_wstream_funcs *funcs;
+	nnc_u8 *buf;
+	nnc_u64 size;     ///< Amount of data written, the furthest position written to.
+	nnc_u64 capacity; ///< Allocated size of \p buf.
+	nnc_u64 pos;
+} nnc_wmemory;
+
+/** Write stream that discards data and only keeps track of the size, see \ref nnc_wcounter_open. */
+typedef struct nnc_wcounter {
+	const nnc_wstream_funcs *funcs;
+	nnc_u64 size; ///< Amount of data written, the furthest position written or skipped to.
+	nnc_u64 pos;
+} nnc_wcounter;
+
+/** Default buffer size of \ref nnc_buffered_wfile. */
+#define NNC_BUFFERED_WFILE_DEFAULT_SIZE 0x400000
+
 typedef struct nnc_header_saver {
 	const nnc_wstream_funcs *funcs;
 	nnc_wstream *child;
-	nnc_u32 count, pos, start;
+	nnc_u64 pos, start;
+	nnc_u32 count;
 	nnc_u8 *buffer;
 } nnc_header_saver;
 
@@ -239,6 +430,48 @@ typedef struct nnc_header_saver {
  */
 nnc_result nnc_wfile_open(nnc_wfile *self, const char *name);
 
+/** \brief           Opens a file for buffered writing.
+ *  \param self      Output write stream.
+ *  \param name      Filename to open.
+ *  \param buf_size  Size of the write buffer, 0 for #NNC_BUFFERED_WFILE_DEFAULT_SIZE.
+ *  \note            Writes are collected in the buffer and written out once it is full,
+ *                   at offsets that are a multiple of \p buf_size where possible.
+ *                   Whole multiples of \p buf_size at such offsets bypass the buffer.
+ *  \note            Seeking does not flush the buffer if the new position is within
+ *                   the buffered range, so patching a header that was just written is cheap.
+ *  \note            Pending data is written when the stream is closed or a readback stream is opened.
+ *  \returns
+ *  \p NNC_R_FAIL_OPEN => Failed to open the file.\n
+ *  \p NNC_R_NOMEM => Failed to allocate the buffer.
+ */
+nnc_result nnc_buffered_wfile_open(nnc_buffered_wfile *self, const char *name, nnc_u32 buf_size);
+
+/** \brief           Opens a write stream into memory.
+ *  \param self      Output write stream.
+ *  \param capacity  Amount of memory to allocate up front, may be 0.
+ *  \note            The buffer at least doubles in size whenever it is too small.
+ *  \note            Seeking past the end is allowed, the gap is filled with 0x00 once it is written past.
+ *  \note            Readback streams point into the buffer without copying, they become
+ *                   invalid once the stream is written to past its capacity or closed.
+ *  \returns
+ *  \p NNC_R_NOMEM => Failed to allocate \p capacity bytes.
+ */
+nnc_result nnc_wmemory_open(nnc_wmemory *self, nnc_u64 capacity);
+
+/** \brief       Hands the written data over to a read stream.
+ *  \param self  Write stream to take the data from, it is empty afterwards but can still be used.
+ *  \param out   Output memory stream that frees the data when closed, see \ref nnc_mem_own_open.
+ */
+void nnc_wmemory_to_rstream(nnc_wmemory *self, nnc_memory *out);
+
+/** \brief       Opens a write stream that discards all data.
+ *  \param self  Output write stream.
+ *  \note        Useful to find out how large the output of a writer will be without storing it,
+ *               the result is in the \p size field after the writer is done.
+ *  \note        Seeking is supported, readback streams are not.
+ */
+void nnc_wcounter_open(nnc_wcounter *self);
+
 /** \brief        This stream saves the first few bytes of a write stream.
  *  \param self   Output header saver.
  *  \param child  Child stream that when written to the first `count` bytes are saved of.
@@ -251,6 +484,83 @@ nnc_result nnc_open_header_saver(nnc_header_saver *self, nnc_wstream *child, nnc
 
 /** \} */
 
+/** \{
+ *  \anchor compat32
+ *  \name   32-bit Stream Compatibility
+ *  Streams written against the old function tables, in which offsets and sizes were
+ *  32-bit, can be wrapped with these adapters to be used with the rest of the library.
+ *  To port such a stream, change the type of its table to #nnc_rstream_funcs32 or
+ *  #nnc_wstream_funcs32 and open an adapter on top of it.
+ */
+
+typedef nnc_result (*nnc_seek_abs32_func)(struct nnc_rstream *self, nnc_u32 pos);
+typedef nnc_result (*nnc_seek_rel32_func)(struct nnc_rstream *self, nnc_u32 pos);
+typedef nnc_u32    (*nnc_size32_func)(struct nnc_rstream *self);
+typedef nnc_u32    (*nnc_tell32_func)(struct nnc_rstream *self);
+
+/** Read stream function table with 32-bit offsets and sizes. */
+typedef struct nnc_rstream_funcs32 {
+	nnc_read_func read;
+	nnc_seek_abs32_func seek_abs;
+	nnc_seek_rel32_func seek_rel;
+	nnc_size32_func size;
+	nnc_close_func close;
+	nnc_tell32_func tell;
+} nnc_rstream_funcs32;
+
+typedef struct nnc_rstream32 {
+	const nnc_rstream_funcs32 *funcs;
+	/* user-data */
+} nnc_rstream32;
+
+/** Read stream that adapts a stream with a \ref nnc_rstream_funcs32 table. */
+typedef struct nnc_compat_rstream {
+	const nnc_rstream_funcs *funcs;
+	nnc_rstream32 *child;
+} nnc_compat_rstream;
+
+typedef nnc_result (*nnc_wseek32_func)(struct nnc_wstream *self, nnc_u32 abspos);
+typedef nnc_u32    (*nnc_wtell32_func)(struct nnc_wstream *self);
+typedef nnc_result (*nnc_wsubreadstream32_func)(struct nnc_wstream *self, nnc_subview *out, nnc_u32 start, nnc_u32 amount);
+
+/** Write stream function table with 32-bit offsets and sizes. */
+typedef struct nnc_wstream_funcs32 {
+	nnc_write_func write;
+	nnc_wclose_func close;
+	nnc_wseek32_func seek; ///< Note that this may be NULL in streams that do not support seeking.
+	nnc_wtell32_func tell;
+	nnc_wsubreadstream32_func subreadstream; ///< Note that this may be NULL in streams that do not support readback.
+} nnc_wstream_funcs32;
+
+typedef struct nnc_wstream32 {
+	const nnc_wstream_funcs32 *funcs;
+	/* user-data */
+} nnc_wstream32;
+
+/** Write stream that adapts a stream with a \ref nnc_wstream_funcs32 table. */
+typedef struct nnc_compat_wstream {
+	const nnc_wstream_funcs *funcs;
+	nnc_wstream32 *child;
+} nnc_compat_wstream;
+
+/** \brief        Adapts a read stream with 32-bit offsets.
+ *  \param self   Output stream.
+ *  \param child  Stream with a \ref nnc_rstream_funcs32 table.
+ *  \note         Closing this stream closes \p child.
+ *  \note         Seeks past 4 GiB fail with \p NNC_R_SEEK_RANGE.
+ */
+void nnc_compat_rstream_open(nnc_compat_rstream *self, nnc_rstream32 *child);
+
+/** \brief        Adapts a write stream with 32-bit offsets.
+ *  \param self   Output stream.
+ *  \param child  Stream with a \ref nnc_wstream_funcs32 table.
+ *  \note         Closing this stream closes \p child.
+ *  \note         Seeks past 4 GiB fail with \p NNC_R_SEEK_RANGE.
+ */
+void nnc_compat_wstream_open(nnc_compat_wstream *self, nnc_wstream32 *child);
+
+/** \} */
+
 /** \{
  *  \anchor vfs
  *  \name   Virtual FileSystem
@@ -416,14 +726,20 @@ extern const nnc_vfs_reader_generator nnc__internal_vfs_generator_file;
  *  \param from    Source read stream.
  *  \param to      Destination write stream.
  *  \param copied  (Optional) Output for the amount of copied bytes.
+ *  \note          If both streams resolve to files the copy is done by the kernel
+ *                 with copy_file_range or sendfile where available.
+ *  \note          Otherwise reads of large streams are overlapped with the writes using io_uring,
+ *                 or for copies of 16 MiB and more a thread pool if \p from implements \p read_at.
  */
-nnc_result nnc_copy(nnc_rstream *from, nnc_wstream *to, nnc_u32 *copied);
+nnc_result nnc_copy(nnc_rstream *from, nnc_wstream *to, nnc_u64 *copied);
 
 /** \brief        Writes `count` 0x00 bytes as padding.
  *  \param ws     The stream to write padding to.
  *  \param count  The amount of 0x00 bytes to write.
+ *  \note         File streams seek over padding past the end of the file instead of writing it,
+ *                which leaves a hole in the file on file systems that support sparse files.
  */
-nnc_result nnc_write_padding(nnc_wstream *ws, nnc_u32 count);
+nnc_result nnc_write_padding(nnc_wstream *ws, nnc_u64 count);
 
 NNC_END
 #endif
@@ -0,0 +1,106 @@
+/** \file  trace.h
+ *  \brief Stream statistics and tracing.
+ */
+#ifndef inc_nnc_trace_h
+#define inc_nnc_trace_h
+
+#include <nnc/stream.h>
+#include <nnc/base.h>
+#include <stdio.h>
+NNC_BEGIN
+
+/** Amount of buckets in the seek distance histogram of \ref nnc_trace_stats. */
+#define NNC_TRACE_SEEK_BUCKETS 48
+
+/** Statistics collected by a traced stream, times are in nanoseconds and include the time spent in child streams. */
+typedef struct nnc_trace_stats {
+	nnc_u64 reads;          ///< Calls to read and read_at.
+	nnc_u64 read_ats;       ///< Calls to read_at.
+	nnc_u64 bytes_read;     ///< Bytes returned by read and read_at.
+	nnc_u64 read_ns;        ///< Time spent in read and read_at.
+	nnc_u64 borrows;        ///< Successful calls to borrow.
+	nnc_u64 bytes_borrowed; ///< Bytes returned by borrow.
+	nnc_u64 locates;        ///< Successful calls to locate, data then moved through the file descriptor is not counted as read or written.
+	nnc_u64 bytes_located;  ///< Bytes passed to a successful locate on a read stream.
+	nnc_u64 writes;         ///< Calls to write.
+	nnc_u64 bytes_written;  ///< Bytes passed to write.
+	nnc_u64 write_ns;       ///< Time spent in write.
+	nnc_u64 skips;          ///< Calls to skip.
+	nnc_u64 bytes_skipped;  ///< Bytes passed to skip.
+	nnc_u64 seeks;          ///< Calls to seek_abs, seek_rel and seek, and positional reads that did not continue the previous one.
+	nnc_u64 seek_ns;        ///< Time spent in seek_abs, seek_rel and seek.
+	/** Seek distances, bucket 0 counts seeks to the same position and bucket n
+	 *  distances from 2^(n-1) up to 2^n, the last bucket also counts all larger distances. */
+	nnc_u64 seek_hist[NNC_TRACE_SEEK_BUCKETS];
+} nnc_trace_stats;
+
+/** Read stream that collects statistics of the calls to its child, see \ref nnc_traced_rstream_open. */
+typedef struct nnc_traced_rstream {
+	const nnc_rstream_funcs *funcs;
+	nnc_rstream *child;
+	const char *name;
+	nnc_u64 last_end;        ///< End of the last positional read.
+	nnc_trace_stats stats;
+	nnc_rstream_funcs table; ///< Function table with the same optional functions as the child.
+} nnc_traced_rstream;
+
+/** Write stream that collects statistics of the calls to its child, see \ref nnc_traced_wstream_open. */
+typedef struct nnc_traced_wstream {
+	const nnc_wstream_funcs *funcs;
+	nnc_wstream *child;
+	const char *name;
+	nnc_trace_stats stats;
+	nnc_wstream_funcs table; ///< Function table with the same optional functions as the child.
+} nnc_traced_wstream;
+
+/** \brief        Wrap a read stream to collect statistics.
+ *  \param self   Output stream, it must not be moved while open.
+ *  \param child  Stream to forward calls to.
+ *  \param name   Name of the stream in the JSON output, must stay valid while the stream is used.
+ *  \note         The optional functions of the child are forwarded only if the child has them,
+ *                so wrapping a stream does not change how other code uses it.
+ *  \note         Statistics are updated atomically, so positional reads may happen from multiple threads.
+ *  \note         Clones from \ref nnc_rs_clone collect their own statistics and add them to this stream when they are closed.
+ *  \note         Closing this stream closes \p child, the statistics stay readable.
+ */
+void nnc_traced_rstream_open(nnc_traced_rstream *self, nnc_rstream *child, const char *name);
+
+/** \brief        Wrap a write stream to collect statistics.
+ *  \param self   Output stream, it must not be moved while open.
+ *  \param child  Stream to forward calls to.
+ *  \param name   Name of the stream in the JSON output, must stay valid while the stream is used.
+ *  \note         Data written directly to the file descriptor from the child's locate function is not counted in \p bytes_written.
+ *  \note         Closing this stream closes \p child, the statistics stay readable.
+ */
+void nnc_traced_wstream_open(nnc_traced_wstream *self, nnc_wstream *child, const char *name);
+
+/** \brief        Write statistics as a JSON object.
+ *  \param out    File to write to.
+ *  \param name   Value of the "name" member.
+ *  \param stats  Statistics to write.
+ */
+void nnc_trace_dump_json(FILE *out, const char *name, const nnc_trace_stats *stats);
+
+/** \brief  Start tracing the streams the library opens internally.
+ *  \note   While enabled, \ref nnc_ncch_section_romfs, \ref nnc_cia_open_content and
+ *          \ref nnc_romfs_open_subview wrap the streams they read from in traced streams,
+ *          one per combination of wrapped stream and name, which live until \ref nnc_trace_internal_stop.
+ *  \warning This function must not be called while other threads open streams.
+ *  \returns
+ *  \p NNC_R_NOMEM => Failed to allocate the list of traced streams.
+ */
+nnc_result nnc_trace_internal_start(void);
+
+/** \brief   Stop tracing internal streams and free the traced streams.
+ *  \warning All streams opened while tracing was enabled must be closed before this function is called.
+ */
+void nnc_trace_internal_stop(void);
+
+/** \brief      Write the statistics of all internally traced streams as a JSON array.
+ *  \param out  File to write to.
+ */
+void nnc_trace_internal_dump_json(FILE *out);
+
+NNC_END
+#endif
+
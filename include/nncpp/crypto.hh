@@ -152,7 +152,7 @@ namespace nnc
 			int rflags = (int) flags;
 			/* this is allowed even without NNCPP_ALLOW_IGNORE_ERRORS because it doesn't matter if scanning fails */
 			if(rflags & (int) init_flag::scan) (void) this->scan();
-			else                               { this->seeds.size = 0; this->seeds.entries = nullptr; }
+			else                               { this->seeds.size = 0; this->seeds.entries = nullptr; this->seeds.index = nullptr; this->seeds.index_size = 0; }
 			if(rflags & (int) init_flag::use_default)
 				this->use_as_default();
 		}
@@ -181,6 +181,11 @@ namespace nnc
 			return (result) nnc_scan_seeddb(&this->seeds);
 		}
 
+		result merge(seeddb& other)
+		{
+			return (result) nnc_merge_seeddb(&this->seeds, &other.seeds);
+		}
+
 		bool find_seed(seed& res, nnc::title_id tid)
 		{
 			nnc::u8 *cres = nnc_get_seed(&this->seeds, tid);
@@ -60,6 +60,7 @@ namespace nnc
 			this->ctx.dir_hash_tab = nullptr;
 			this->ctx.file_meta_data = nullptr;
 			this->ctx.dir_meta_data = nullptr;
+			this->ctx.borrowed = false;
 		}
 #if NNCPP_ALLOW_IGNORE_ERRORS
 		romfs(read_stream_like& rs) { this->read(rs); }
@@ -16,10 +16,10 @@ namespace nnc
 		virtual nnc_rstream *cstream() = 0;
 
 		virtual result read(void *buf, u32 max, u32& totalRead) = 0;
-		virtual result seek_abs(u32 pos) = 0;
-		virtual result seek_rel(u32 offset) = 0;
-		virtual u32 size() = 0;
-		virtual u32 tell() = 0;
+		virtual result seek_abs(u64 pos) = 0;
+		virtual result seek_rel(u64 offset) = 0;
+		virtual u64 size() = 0;
+		virtual u64 tell() = 0;
 		virtual void close() = 0;
 
 		template <size_t S> result read(byte_array<S>& barr, u32 maxlen, u32& totalRead) { return this->read(barr.data(), maxlen, totalRead); }
@@ -45,10 +45,10 @@ namespace nnc
 		CStreamType *csubstream() { return &this->stream; }
 
 		result read(void *buf, u32 max, u32& totalRead) override { return (nnc::result) this->cstream()->funcs->read(this->cstream(), (u8 *) buf, max, &totalRead); }
-		result seek_abs(u32 pos) override { return (nnc::result) this->cstream()->funcs->seek_abs(this->cstream(), pos); }
-		result seek_rel(u32 offset) override { return (nnc::result) this->cstream()->funcs->seek_rel(this->cstream(), offset); }
-		u32 tell() override { return this->cstream()->funcs->tell(this->cstream()); }
-		u32 size() override { return this->cstream()->funcs->size(this->cstream()); }
+		result seek_abs(u64 pos) override { return (nnc::result) this->cstream()->funcs->seek_abs(this->cstream(), pos); }
+		result seek_rel(u64 offset) override { return (nnc::result) this->cstream()->funcs->seek_rel(this->cstream(), offset); }
+		u64 tell() override { return this->cstream()->funcs->tell(this->cstream()); }
+		u64 size() override { return this->cstream()->funcs->size(this->cstream()); }
 		void close() override
 		{
 			if(this->is_open())
@@ -94,22 +94,22 @@ namespace nnc
 	{
 	public:
 		using c_read_stream::c_read_stream;
-		subview(nnc_rstream *child, u32 offset, u32 len)
+		subview(nnc_rstream *child, u64 offset, u64 len)
 		{
 			this->open(child, offset, len);
 		}
 
-		subview(read_stream_like& child, u32 offset, u32 len)
+		subview(read_stream_like& child, u64 offset, u64 len)
 		{
 			this->open(child, offset, len);
 		}
 
-		void open(read_stream_like& child, u32 offset, u32 len)
+		void open(read_stream_like& child, u64 offset, u64 len)
 		{
 			this->open(child.as_rstream(), offset, len);
 		}
 
-		void open(nnc_rstream *child, u32 offset, u32 len)
+		void open(nnc_rstream *child, u64 offset, u64 len)
 		{
 			this->close();
 			nnc_subview_open(&this->stream, child, offset, len);
@@ -121,7 +121,7 @@ namespace nnc
 	{
 	public:
 		using c_read_stream::c_read_stream;
-		memory(const void *ptr, u32 size)
+		memory(const void *ptr, u64 size)
 		{
 			this->open(ptr, size);
 		}
@@ -138,7 +138,7 @@ namespace nnc
 			this->open(barr.data(), N);
 		}
 
-		void open(const void *ptr, u32 size)
+		void open(const void *ptr, u64 size)
 		{
 			nnc_mem_open(&this->stream, ptr, size);
 			this->set_open_state(true);
@@ -155,28 +155,32 @@ namespace nnc
 		};
 
 		static cresult c_read(nnc_rstream *obj, u8 *buf, u32 max, u32 *totalRead) { return (cresult) ((wrapper_rstream *) obj)->self->read(buf, max, *totalRead); }
-		static cresult c_seek_abs(nnc_rstream *obj, u32 pos) { return (cresult) ((wrapper_rstream *) obj)->self->seek_abs(pos); }
-		static cresult c_seek_rel(nnc_rstream *obj, u32 offset) { return (cresult) ((wrapper_rstream *) obj)->self->seek_rel(offset); }
-		static u32 c_size(nnc_rstream *obj) { return ((wrapper_rstream *) obj)->self->size(); }
+		static cresult c_seek_abs(nnc_rstream *obj, u64 pos) { return (cresult) ((wrapper_rstream *) obj)->self->seek_abs(pos); }
+		static cresult c_seek_rel(nnc_rstream *obj, u64 offset) { return (cresult) ((wrapper_rstream *) obj)->self->seek_rel(offset); }
+		static u64 c_size(nnc_rstream *obj) { return ((wrapper_rstream *) obj)->self->size(); }
 		static void c_close(nnc_rstream *obj) { ((wrapper_rstream *) obj)->self->close(); }
-		static u32 c_tell(nnc_rstream *obj) { return ((wrapper_rstream *) obj)->self->tell(); }
+		static u64 c_tell(nnc_rstream *obj) { return ((wrapper_rstream *) obj)->self->tell(); }
 
 		/* storing this as a member when all members are constant is suboptimal but oh well
 		 *  maybe some day i'll think of a better way to do this */
 		const nnc_rstream_funcs c_funcs = {
 			c_read, c_seek_abs, c_seek_rel,
 			c_size, c_close, c_tell,
+			/* custom streams only have a position to read from, so positional reads,
+			 * borrowing, locating, hints and cloning all use the C fallbacks */
+			nullptr, nullptr, nullptr,
+			nullptr, nullptr,
 		};
 
 	public:
 		using read_stream_like::read_stream_like::read;
 
 		virtual result read(void *buf, u32 max, u32& totalRead) = 0;
-		virtual result seek_abs(u32 pos) = 0;
-		virtual result seek_rel(u32 offset) = 0;
-		virtual u32 size() = 0;
+		virtual result seek_abs(u64 pos) = 0;
+		virtual result seek_rel(u64 offset) = 0;
+		virtual u64 size() = 0;
 		virtual void close() = 0;
-		virtual u32 tell() = 0;
+		virtual u64 tell() = 0;
 
 	protected:
 		nnc_rstream *cstream() override
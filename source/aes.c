@@ -0,0 +1,364 @@
+/* Hardware accelerated AES-128, used for the keystream of the AES-CTR streams
+ *  and for AES-CBC decryption. The kernels work on 8 blocks per iteration so the
+ *  latency of the AES instructions of one block is hidden behind the others, which
+ *  works for CBC decryption since a block only depends on the ciphertext before it.
+ *  Everything that can't be accelerated goes through the cryptographic library in crypto.c */
+
+#include <nnc/crypto.h>
+#include <string.h>
+#include "./internal.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define AES_HAVE_AESNI 1
+	#include <wmmintrin.h>
+	#include <emmintrin.h>
+	#define AESNI_TARGET __attribute__((target("aes,sse2")))
+#endif
+
+/* ARMv8 has no portable way to test for the extension at runtime, so the
+ * kernel is only built if the compiler may already assume it */
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+	#define AES_HAVE_ARMV8 1
+	#include <arm_neon.h>
+#endif
+
+#define AES_PIPELINE 8
+
+static const u8 sbox[256] = {
+	0x63, 0x7C, 0x77, 0x7B, 0xF2, 0x6B, 0x6F, 0xC5, 0x30, 0x01, 0x67, 0x2B, 0xFE, 0xD7, 0xAB, 0x76,
+	0xCA, 0x82, 0xC9, 0x7D, 0xFA, 0x59, 0x47, 0xF0, 0xAD, 0xD4, 0xA2, 0xAF, 0x9C, 0xA4, 0x72, 0xC0,
+	0xB7, 0xFD, 0x93, 0x26, 0x36, 0x3F, 0xF7, 0xCC, 0x34, 0xA5, 0xE5, 0xF1, 0x71, 0xD8, 0x31, 0x15,
+	0x04, 0xC7, 0x23, 0xC3, 0x18, 0x96, 0x05, 0x9A, 0x07, 0x12, 0x80, 0xE2, 0xEB, 0x27, 0xB2, 0x75,
+	0x09, 0x83, 0x2C, 0x1A, 0x1B, 0x6E, 0x5A, 0xA0, 0x52, 0x3B, 0xD6, 0xB3, 0x29, 0xE3, 0x2F, 0x84,
+	0x53, 0xD1, 0x00, 0xED, 0x20, 0xFC, 0xB1, 0x5B, 0x6A, 0xCB, 0xBE, 0x39, 0x4A, 0x4C, 0x58, 0xCF,
+	0xD0, 0xEF, 0xAA, 0xFB, 0x43, 0x4D, 0x33, 0x85, 0x45, 0xF9, 0x02, 0x7F, 0x50, 0x3C, 0x9F, 0xA8,
+	0x51, 0xA3, 0x40, 0x8F, 0x92, 0x9D, 0x38, 0xF5, 0xBC, 0xB6, 0xDA, 0x21, 0x10, 0xFF, 0xF3, 0xD2,
+	0xCD, 0x0C, 0x13, 0xEC, 0x5F, 0x97, 0x44, 0x17, 0xC4, 0xA7, 0x7E, 0x3D, 0x64, 0x5D, 0x19, 0x73,
+	0x60, 0x81, 0x4F, 0xDC, 0x22, 0x2A, 0x90, 0x88, 0x46, 0xEE, 0xB8, 0x14, 0xDE, 0x5E, 0x0B, 0xDB,
+	0xE0, 0x32, 0x3A, 0x0A, 0x49, 0x06, 0x24, 0x5C, 0xC2, 0xD3, 0xAC, 0x62, 0x91, 0x95, 0xE4, 0x79,
+	0xE7, 0xC8, 0x37, 0x6D, 0x8D, 0xD5, 0x4E, 0xA9, 0x6C, 0x56, 0xF4, 0xEA, 0x65, 0x7A, 0xAE, 0x08,
+	0xBA, 0x78, 0x25, 0x2E, 0x1C, 0xA6, 0xB4, 0xC6, 0xE8, 0xDD, 0x74, 0x1F, 0x4B, 0xBD, 0x8B, 0x8A,
+	0x70, 0x3E, 0xB5, 0x66, 0x48, 0x03, 0xF6, 0x0E, 0x61, 0x35, 0x57, 0xB9, 0x86, 0xC1, 0x1D, 0x9E,
+	0xE1, 0xF8, 0x98, 0x11, 0x69, 0xD9, 0x8E, 0x94, 0x9B, 0x1E, 0x87, 0xE9, 0xCE, 0x55, 0x28, 0xDF,
+	0x8C, 0xA1, 0x89, 0x0D, 0xBF, 0xE6, 0x42, 0x68, 0x41, 0x99, 0x2D, 0x0F, 0xB0, 0x54, 0xBB, 0x16,
+};
+
+void aes128_expand_key(nnc_aes128_key *key, const u8 raw[0x10])
+{
+	static const u8 rcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36 };
+	u8 *w = &key->rk[0][0];
+	memcpy(w, raw, 0x10);
+	for(int i = 4; i < 44; ++i)
+	{
+		u8 t[4] = { w[i * 4 - 4], w[i * 4 - 3], w[i * 4 - 2], w[i * 4 - 1] };
+		if(i % 4 == 0)
+		{
+			/* RotWord, SubWord and the round constant */
+			u8 first = t[0];
+			t[0] = sbox[t[1]] ^ rcon[i / 4 - 1];
+			t[1] = sbox[t[2]];
+			t[2] = sbox[t[3]];
+			t[3] = sbox[first];
+		}
+		for(int j = 0; j < 4; ++j)
+			w[i * 4 + j] = w[i * 4 - 16 + j] ^ t[j];
+	}
+}
+
+/* the counter is a 128-bit big-endian number, kept as two halves while encrypting */
+static void load_ctr(const u8 ctr[0x10], u64 *hi, u64 *lo)
+{
+	u64 h, l;
+	memcpy(&h, ctr, 8);
+	memcpy(&l, ctr + 8, 8);
+	*hi = BE64(h);
+	*lo = BE64(l);
+}
+
+static void store_ctr(u8 ctr[0x10], u64 hi, u64 lo)
+{
+	hi = BE64(hi);
+	lo = BE64(lo);
+	memcpy(ctr, &hi, 8);
+	memcpy(ctr + 8, &lo, 8);
+}
+
+#define INC_CTR(hi, lo) if(++(lo) == 0) ++(hi)
+
+#if AES_HAVE_AESNI
+
+static AESNI_TARGET inline __m128i aesni_ctr_block(u64 hi, u64 lo)
+{
+	/* the low half of the register is stored first */
+	return _mm_set_epi64x((long long) BE64(lo), (long long) BE64(hi));
+}
+
+static AESNI_TARGET void aesni_ctr_xor(const nnc_aes128_key *key, u8 ctr[0x10], u8 *buf, size_t len)
+{
+	__m128i rk[11], b[AES_PIPELINE];
+	u64 hi, lo;
+	for(int r = 0; r < 11; ++r)
+		rk[r] = _mm_loadu_si128((const __m128i *) key->rk[r]);
+	load_ctr(ctr, &hi, &lo);
+
+	for(; len >= AES_PIPELINE * 0x10; len -= AES_PIPELINE * 0x10, buf += AES_PIPELINE * 0x10)
+	{
+		for(int i = 0; i < AES_PIPELINE; ++i)
+		{
+			b[i] = _mm_xor_si128(aesni_ctr_block(hi, lo), rk[0]);
+			INC_CTR(hi, lo);
+		}
+		for(int r = 1; r < 10; ++r)
+			for(int i = 0; i < AES_PIPELINE; ++i)
+				b[i] = _mm_aesenc_si128(b[i], rk[r]);
+		for(int i = 0; i < AES_PIPELINE; ++i)
+		{
+			__m128i *p = (__m128i *) (buf + i * 0x10);
+			b[i] = _mm_aesenclast_si128(b[i], rk[10]);
+			_mm_storeu_si128(p, _mm_xor_si128(b[i], _mm_loadu_si128(p)));
+		}
+	}
+
+	while(len)
+	{
+		u8 ks[0x10];
+		size_t n = MIN(len, 0x10);
+		__m128i k = _mm_xor_si128(aesni_ctr_block(hi, lo), rk[0]);
+		INC_CTR(hi, lo);
+		for(int r = 1; r < 10; ++r)
+			k = _mm_aesenc_si128(k, rk[r]);
+		_mm_storeu_si128((__m128i *) ks, _mm_aesenclast_si128(k, rk[10]));
+		for(size_t i = 0; i < n; ++i)
+			buf[i] ^= ks[i];
+		buf += n;
+		len -= n;
+	}
+
+	store_ctr(ctr, hi, lo);
+}
+
+static AESNI_TARGET void aesni_cbc_decrypt(const nnc_aes128_key *key, u8 iv[0x10], u8 *buf, size_t len)
+{
+	__m128i rk[11], b[AES_PIPELINE], c[AES_PIPELINE], prev;
+	/* the decryption round keys are the encryption ones in reverse with InvMixColumns applied */
+	rk[0] = _mm_loadu_si128((const __m128i *) key->rk[10]);
+	for(int r = 1; r < 10; ++r)
+		rk[r] = _mm_aesimc_si128(_mm_loadu_si128((const __m128i *) key->rk[10 - r]));
+	rk[10] = _mm_loadu_si128((const __m128i *) key->rk[0]);
+	prev = _mm_loadu_si128((const __m128i *) iv);
+
+	for(; len >= AES_PIPELINE * 0x10; len -= AES_PIPELINE * 0x10, buf += AES_PIPELINE * 0x10)
+	{
+		/* the ciphertext is kept as it is the IV of the next block */
+		for(int i = 0; i < AES_PIPELINE; ++i)
+		{
+			c[i] = _mm_loadu_si128((const __m128i *) (buf + i * 0x10));
+			b[i] = _mm_xor_si128(c[i], rk[0]);
+		}
+		for(int r = 1; r < 10; ++r)
+			for(int i = 0; i < AES_PIPELINE; ++i)
+				b[i] = _mm_aesdec_si128(b[i], rk[r]);
+		for(int i = 0; i < AES_PIPELINE; ++i)
+		{
+			b[i] = _mm_aesdeclast_si128(b[i], rk[10]);
+			_mm_storeu_si128((__m128i *) (buf + i * 0x10), _mm_xor_si128(b[i], i ? c[i - 1] : prev));
+		}
+		prev = c[AES_PIPELINE - 1];
+	}
+
+	for(; len; len -= 0x10, buf += 0x10)
+	{
+		__m128i k = _mm_loadu_si128((const __m128i *) buf), ct = k;
+		k = _mm_xor_si128(k, rk[0]);
+		for(int r = 1; r < 10; ++r)
+			k = _mm_aesdec_si128(k, rk[r]);
+		_mm_storeu_si128((__m128i *) buf, _mm_xor_si128(_mm_aesdeclast_si128(k, rk[10]), prev));
+		prev = ct;
+	}
+
+	_mm_storeu_si128((__m128i *) iv, prev);
+}
+
+#endif
+
+#if AES_HAVE_ARMV8
+
+static inline uint8x16_t armv8_ctr_block(u64 hi, u64 lo)
+{
+	u8 blk[0x10];
+	store_ctr(blk, hi, lo);
+	return vld1q_u8(blk);
+}
+
+/* AESE includes the round key addition and AESMC the column mixing,
+ * so the rounds are shifted by one compared to AES-NI */
+#define ARMV8_ROUND(b, k) b = vaesmcq_u8(vaeseq_u8(b, k))
+#define ARMV8_LAST(b, k9, k10) b = veorq_u8(vaeseq_u8(b, k9), k10)
+
+static void armv8_ctr_xor(const nnc_aes128_key *key, u8 ctr[0x10], u8 *buf, size_t len)
+{
+	uint8x16_t rk[11], b[AES_PIPELINE];
+	u64 hi, lo;
+	for(int r = 0; r < 11; ++r)
+		rk[r] = vld1q_u8(key->rk[r]);
+	load_ctr(ctr, &hi, &lo);
+
+	for(; len >= AES_PIPELINE * 0x10; len -= AES_PIPELINE * 0x10, buf += AES_PIPELINE * 0x10)
+	{
+		for(int i = 0; i < AES_PIPELINE; ++i)
+		{
+			b[i] = armv8_ctr_block(hi, lo);
+			INC_CTR(hi, lo);
+		}
+		for(int r = 0; r < 9; ++r)
+			for(int i = 0; i < AES_PIPELINE; ++i)
+				ARMV8_ROUND(b[i], rk[r]);
+		for(int i = 0; i < AES_PIPELINE; ++i)
+		{
+			ARMV8_LAST(b[i], rk[9], rk[10]);
+			vst1q_u8(buf + i * 0x10, veorq_u8(b[i], vld1q_u8(buf + i * 0x10)));
+		}
+	}
+
+	while(len)
+	{
+		u8 ks[0x10];
+		size_t n = MIN(len, 0x10);
+		uint8x16_t k = armv8_ctr_block(hi, lo);
+		INC_CTR(hi, lo);
+		for(int r = 0; r < 9; ++r)
+			ARMV8_ROUND(k, rk[r]);
+		ARMV8_LAST(k, rk[9], rk[10]);
+		vst1q_u8(ks, k);
+		for(size_t i = 0; i < n; ++i)
+			buf[i] ^= ks[i];
+		buf += n;
+		len -= n;
+	}
+
+	store_ctr(ctr, hi, lo);
+}
+
+/* AESD includes the round key addition and AESIMC is InvMixColumns */
+#define ARMV8_DROUND(b, k) b = vaesimcq_u8(vaesdq_u8(b, k))
+#define ARMV8_DLAST(b, k9, k10) b = veorq_u8(vaesdq_u8(b, k9), k10)
+
+static void armv8_cbc_decrypt(const nnc_aes128_key *key, u8 iv[0x10], u8 *buf, size_t len)
+{
+	uint8x16_t rk[11], b[AES_PIPELINE], c[AES_PIPELINE], prev;
+	/* the decryption round keys are the encryption ones in reverse with InvMixColumns applied */
+	rk[0] = vld1q_u8(key->rk[10]);
+	for(int r = 1; r < 10; ++r)
+		rk[r] = vaesimcq_u8(vld1q_u8(key->rk[10 - r]));
+	rk[10] = vld1q_u8(key->rk[0]);
+	prev = vld1q_u8(iv);
+
+	for(; len >= AES_PIPELINE * 0x10; len -= AES_PIPELINE * 0x10, buf += AES_PIPELINE * 0x10)
+	{
+		for(int i = 0; i < AES_PIPELINE; ++i)
+			b[i] = c[i] = vld1q_u8(buf + i * 0x10);
+		for(int r = 0; r < 9; ++r)
+			for(int i = 0; i < AES_PIPELINE; ++i)
+				ARMV8_DROUND(b[i], rk[r]);
+		for(int i = 0; i < AES_PIPELINE; ++i)
+		{
+			ARMV8_DLAST(b[i], rk[9], rk[10]);
+			vst1q_u8(buf + i * 0x10, veorq_u8(b[i], i ? c[i - 1] : prev));
+		}
+		prev = c[AES_PIPELINE - 1];
+	}
+
+	for(; len; len -= 0x10, buf += 0x10)
+	{
+		uint8x16_t k = vld1q_u8(buf), ct = k;
+		for(int r = 0; r < 9; ++r)
+			ARMV8_DROUND(k, rk[r]);
+		ARMV8_DLAST(k, rk[9], rk[10]);
+		vst1q_u8(buf, veorq_u8(k, prev));
+		prev = ct;
+	}
+
+	vst1q_u8(iv, prev);
+}
+
+#endif
+
+static bool aes_impl_available(enum nnc_aes_impl impl)
+{
+	switch(impl)
+	{
+	case NNC_AES_IMPL_GENERIC:
+		return true;
+#if AES_HAVE_AESNI
+	case NNC_AES_IMPL_AESNI:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("aes");
+#endif
+#if AES_HAVE_ARMV8
+	case NNC_AES_IMPL_ARMV8:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+/* -1 until the first use, racing threads all store the same value */
+static volatile int aes_impl = -1;
+
+enum nnc_aes_impl nnc_aes_impl(void)
+{
+	if(aes_impl == -1)
+	{
+		if(aes_impl_available(NNC_AES_IMPL_AESNI))      aes_impl = NNC_AES_IMPL_AESNI;
+		else if(aes_impl_available(NNC_AES_IMPL_ARMV8)) aes_impl = NNC_AES_IMPL_ARMV8;
+		else                                            aes_impl = NNC_AES_IMPL_GENERIC;
+	}
+	return (enum nnc_aes_impl) aes_impl;
+}
+
+nnc_result nnc_aes_set_impl(enum nnc_aes_impl impl)
+{
+	if(!aes_impl_available(impl))
+		return NNC_R_UNSUPPORTED;
+	aes_impl = impl;
+	return NNC_R_OK;
+}
+
+bool aes128_ctr_xor(const nnc_aes128_key *key, u8 ctr[0x10], u8 *buf, size_t len)
+{
+	switch(nnc_aes_impl())
+	{
+#if AES_HAVE_AESNI
+	case NNC_AES_IMPL_AESNI:
+		aesni_ctr_xor(key, ctr, buf, len);
+		return true;
+#endif
+#if AES_HAVE_ARMV8
+	case NNC_AES_IMPL_ARMV8:
+		armv8_ctr_xor(key, ctr, buf, len);
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+bool aes128_cbc_decrypt(const nnc_aes128_key *key, u8 iv[0x10], u8 *buf, size_t len)
+{
+	switch(nnc_aes_impl())
+	{
+#if AES_HAVE_AESNI
+	case NNC_AES_IMPL_AESNI:
+		aesni_cbc_decrypt(key, iv, buf, len);
+		return true;
+#endif
+#if AES_HAVE_ARMV8
+	case NNC_AES_IMPL_ARMV8:
+		armv8_cbc_decrypt(key, iv, buf, len);
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
@@ -0,0 +1,404 @@
+/* syscall() for io_uring, this has to come before any system header */
+#if defined(__linux__)
+	#define _DEFAULT_SOURCE
+#endif
+
+#include <nnc/aio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./internal.h"
+
+#if defined(__linux__) && !defined(NNC_NO_IO_URING) && defined(__has_include)
+	#if __has_include(<linux/io_uring.h>)
+		#define IO_URING_API 1
+	#endif
+#endif
+
+#if IO_URING_API
+	/* liburing is not required, the raw system calls are used instead */
+	#include <linux/io_uring.h>
+	#include <sys/syscall.h>
+	#include <sys/mman.h>
+	#include <sys/uio.h>
+	#include <unistd.h>
+	#include <errno.h>
+
+struct uring_slot {
+	nnc_aio_request *req;
+	struct iovec iov;
+	u32 len; /* req->len clamped to the stream size */
+};
+
+struct uring {
+	int fd;        /* io_uring instance */
+	int file;      /* file the stream is stored in */
+	u64 file_base; /* offset of the stream in file */
+	void *sq_ptr, *cq_ptr;
+	size_t sq_len, cq_len, sqes_len;
+	struct io_uring_sqe *sqes;
+	u32 *sq_tail, *sq_mask, *sq_array;
+	u32 *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_cqe *cqes;
+	u32 to_submit;
+	struct uring_slot *slots;
+	u32 *free_slots, nfree;
+};
+#endif
+
+#define AIO_MAX_THREADS 4
+
+struct nnc_aio {
+	nnc_rstream *rs;
+	enum nnc_aio_backend backend;
+	u32 depth, pending;
+	u64 size;
+	/* finished requests, used by all backends */
+	nnc_aio_request **done;
+	u32 done_head, done_count;
+	/* NNC_AIO_THREADS */
+	nnc_aio_request **todo;
+	u32 todo_head, todo_count;
+	nnc_mutex *lock;
+	nnc_cond *work, *finished;
+	nnc_thread *threads[AIO_MAX_THREADS];
+	u32 nthreads;
+	bool quit;
+#if IO_URING_API
+	struct uring ring;
+#endif
+};
+
+/* fixed size queues of self->depth entries */
+
+static void queue_push(nnc_aio *self, nnc_aio_request **queue, u32 head, u32 *count, nnc_aio_request *req)
+{
+	queue[(head + *count) % self->depth] = req;
+	++*count;
+}
+
+static nnc_aio_request *queue_pop(nnc_aio *self, nnc_aio_request **queue, u32 *head, u32 *count)
+{
+	nnc_aio_request *req = queue[*head];
+	*head = (*head + 1) % self->depth;
+	--*count;
+	return req;
+}
+
+static result read_full(nnc_rstream *rs, nnc_aio_request *req)
+{
+	u32 got;
+	result ret;
+	req->read = 0;
+	do {
+		TRY(nnc_rs_read_at(rs, req->offset + req->read, req->buf + req->read, req->len - req->read, &got));
+		req->read += got;
+	} while(got && req->read != req->len);
+	return NNC_R_OK;
+}
+
+/* thread pool */
+
+static void aio_worker(void *arg)
+{
+	nnc_aio *self = arg;
+	mutex_lock(self->lock);
+	for(;;)
+	{
+		while(!self->quit && !self->todo_count)
+			cond_wait(self->work, self->lock);
+		if(!self->todo_count) break;
+		nnc_aio_request *req = queue_pop(self, self->todo, &self->todo_head, &self->todo_count);
+		mutex_unlock(self->lock);
+		req->res = read_full(self->rs, req);
+		mutex_lock(self->lock);
+		queue_push(self, self->done, self->done_head, &self->done_count, req);
+		cond_signal(self->finished);
+	}
+	mutex_unlock(self->lock);
+}
+
+static void threads_close(nnc_aio *self)
+{
+	if(self->lock)
+	{
+		mutex_lock(self->lock);
+		self->quit = true;
+		cond_broadcast(self->work);
+		mutex_unlock(self->lock);
+	}
+	for(u32 i = 0; i < self->nthreads; ++i)
+		thread_join(self->threads[i]);
+	self->nthreads = 0;
+	cond_free(self->work);
+	cond_free(self->finished);
+	mutex_free(self->lock);
+	free(self->todo);
+}
+
+static result threads_open(nnc_aio *self)
+{
+	if(!(self->todo = malloc(self->depth * sizeof(nnc_aio_request *)))
+		|| !(self->lock = mutex_new())
+		|| !(self->work = cond_new())
+		|| !(self->finished = cond_new()))
+		return threads_close(self), NNC_R_NOMEM;
+	u32 count = MIN(self->depth, AIO_MAX_THREADS);
+	for(; self->nthreads < count; ++self->nthreads)
+		if(!(self->threads[self->nthreads] = thread_create(aio_worker, self)))
+			return threads_close(self), NNC_R_OS;
+	return NNC_R_OK;
+}
+
+/* io_uring */
+
+#if IO_URING_API
+
+static void uring_close(struct uring *ring)
+{
+	if(ring->sqes) munmap(ring->sqes, ring->sqes_len);
+	if(ring->cq_ptr && ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_len);
+	if(ring->sq_ptr) munmap(ring->sq_ptr, ring->sq_len);
+	if(ring->fd >= 0) close(ring->fd);
+	free(ring->slots);
+	free(ring->free_slots);
+}
+
+static result uring_open(nnc_aio *self, int file, u64 file_base)
+{
+	struct uring *ring = &self->ring;
+	struct io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	ring->file = file;
+	ring->file_base = file_base;
+	if((ring->fd = syscall(__NR_io_uring_setup, self->depth, &p)) < 0)
+		return NNC_R_UNSUPPORTED;
+
+	ring->sq_len = p.sq_off.array + p.sq_entries * sizeof(u32);
+	ring->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	/* both rings are in one mapping since linux 5.4 */
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+		ring->sq_len = ring->cq_len = MAX(ring->sq_len, ring->cq_len);
+	ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, IORING_OFF_SQ_RING);
+	if(ring->sq_ptr == MAP_FAILED) { ring->sq_ptr = NULL; goto fail; }
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+		ring->cq_ptr = ring->sq_ptr;
+	else
+	{
+		ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, IORING_OFF_CQ_RING);
+		if(ring->cq_ptr == MAP_FAILED) { ring->cq_ptr = NULL; goto fail; }
+	}
+	ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED, ring->fd, IORING_OFF_SQES);
+	if(ring->sqes == MAP_FAILED) { ring->sqes = NULL; goto fail; }
+
+	u8 *sq = ring->sq_ptr, *cq = ring->cq_ptr;
+	ring->sq_tail = (u32 *) (sq + p.sq_off.tail);
+	ring->sq_mask = (u32 *) (sq + p.sq_off.ring_mask);
+	ring->sq_array = (u32 *) (sq + p.sq_off.array);
+	ring->cq_head = (u32 *) (cq + p.cq_off.head);
+	ring->cq_tail = (u32 *) (cq + p.cq_off.tail);
+	ring->cq_mask = (u32 *) (cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+	if(!(ring->slots = malloc(self->depth * sizeof(struct uring_slot)))
+		|| !(ring->free_slots = malloc(self->depth * sizeof(u32))))
+		goto fail;
+	for(ring->nfree = 0; ring->nfree < self->depth; ++ring->nfree)
+		ring->free_slots[ring->nfree] = ring->nfree;
+	return NNC_R_OK;
+fail:
+	uring_close(ring);
+	return NNC_R_UNSUPPORTED;
+}
+
+/* queues the remaining part of the read in the slot */
+static void uring_queue(struct uring *ring, u32 slot_index)
+{
+	struct uring_slot *slot = &ring->slots[slot_index];
+	/* we are the only producer */
+	u32 tail = *ring->sq_tail, index = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[index];
+	slot->iov.iov_base = slot->req->buf + slot->req->read;
+	slot->iov.iov_len = slot->len - slot->req->read;
+	memset(sqe, 0, sizeof(struct io_uring_sqe));
+	/* READV works on all kernels with io_uring, READ needs 5.6 */
+	sqe->opcode = IORING_OP_READV;
+	sqe->fd = ring->file;
+	sqe->off = ring->file_base + slot->req->offset + slot->req->read;
+	sqe->addr = (u64) (uintptr_t) &slot->iov;
+	sqe->len = 1;
+	sqe->user_data = slot_index;
+	ring->sq_array[index] = index;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	++ring->to_submit;
+}
+
+static void uring_submit(nnc_aio *self, nnc_aio_request *req, u32 len)
+{
+	struct uring *ring = &self->ring;
+	u32 slot_index = ring->free_slots[--ring->nfree];
+	ring->slots[slot_index].req = req;
+	ring->slots[slot_index].len = len;
+	uring_queue(ring, slot_index);
+}
+
+static result uring_complete(nnc_aio *self, nnc_aio_request **out)
+{
+	struct uring *ring = &self->ring;
+	for(;;)
+	{
+		/* we are the only consumer */
+		u32 head = *ring->cq_head;
+		if(head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+		{
+			struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+			u32 slot_index = cqe->user_data;
+			i32 res = cqe->res;
+			__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+			nnc_aio_request *req = ring->slots[slot_index].req;
+			if(res == -EINTR || res == -EAGAIN)
+			{
+				uring_queue(ring, slot_index);
+				continue;
+			}
+			if(res > 0)
+			{
+				req->read += res;
+				/* short read before the end of the file, read the rest */
+				if(req->read != ring->slots[slot_index].len)
+				{
+					uring_queue(ring, slot_index);
+					continue;
+				}
+			}
+			req->res = res < 0 ? NNC_R_FAIL_READ : NNC_R_OK;
+			ring->free_slots[ring->nfree++] = slot_index;
+			*out = req;
+			return NNC_R_OK;
+		}
+		/* submits everything queued since the last call in one go */
+		int submitted = syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+		if(submitted < 0)
+		{
+			/* the kernel is short on memory or the completion queue overflowed,
+			 * the requests in flight still have to be reaped so try again */
+			if(errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+			return NNC_R_OS;
+		}
+		ring->to_submit -= submitted;
+	}
+}
+
+#endif
+
+nnc_result nnc_aio_open(nnc_aio **out, nnc_rstream *rs, u32 depth, int flags)
+{
+	if(depth == 0) return NNC_R_INVAL;
+	nnc_aio *self = calloc(1, sizeof(nnc_aio));
+	if(!self) return NNC_R_NOMEM;
+	if(!(self->done = malloc(depth * sizeof(nnc_aio_request *))))
+		return free(self), NNC_R_NOMEM;
+	self->rs = rs;
+	self->depth = depth;
+	self->size = nnc_rs_size(rs);
+
+	self->backend = NNC_AIO_SYNC;
+#if IO_URING_API
+	int fd;
+	u64 fd_pos;
+	if(!(flags & NNC_AIO_NO_IO_URING) && nnc_rs_locate(rs, 0, self->size, &fd, &fd_pos) == NNC_R_OK
+		&& uring_open(self, fd, fd_pos) == NNC_R_OK)
+		self->backend = NNC_AIO_IO_URING;
+	else
+#endif
+	if(!(flags & NNC_AIO_NO_THREADS) && rs->funcs->read_at && threads_open(self) == NNC_R_OK)
+		self->backend = NNC_AIO_THREADS;
+
+	*out = self;
+	return NNC_R_OK;
+}
+
+nnc_result nnc_aio_submit(nnc_aio *self, nnc_aio_request *req)
+{
+	if(self->pending == self->depth) return NNC_R_TOO_LARGE;
+	req->read = 0;
+	req->res = NNC_R_OK;
+	/* nothing to do for reads past the end */
+	u32 len = req->offset < self->size ? MIN(req->len, self->size - req->offset) : 0;
+	++self->pending;
+
+	if(self->backend == NNC_AIO_THREADS)
+	{
+		mutex_lock(self->lock);
+		if(len == 0) queue_push(self, self->done, self->done_head, &self->done_count, req);
+		else
+		{
+			queue_push(self, self->todo, self->todo_head, &self->todo_count, req);
+			cond_signal(self->work);
+		}
+		mutex_unlock(self->lock);
+		return NNC_R_OK;
+	}
+#if IO_URING_API
+	if(self->backend == NNC_AIO_IO_URING && len != 0)
+	{
+		uring_submit(self, req, len);
+		return NNC_R_OK;
+	}
+#endif
+	if(len != 0) req->res = read_full(self->rs, req);
+	queue_push(self, self->done, self->done_head, &self->done_count, req);
+	return NNC_R_OK;
+}
+
+nnc_result nnc_aio_complete(nnc_aio *self, nnc_aio_request **req)
+{
+	if(self->pending == 0) return NNC_R_NOT_FOUND;
+	if(self->backend == NNC_AIO_THREADS)
+	{
+		mutex_lock(self->lock);
+		while(self->done_count == 0)
+			cond_wait(self->finished, self->lock);
+		*req = queue_pop(self, self->done, &self->done_head, &self->done_count);
+		mutex_unlock(self->lock);
+	}
+	else if(self->done_count)
+		*req = queue_pop(self, self->done, &self->done_head, &self->done_count);
+#if IO_URING_API
+	else
+	{
+		result ret;
+		TRY(uring_complete(self, req));
+	}
+#endif
+	--self->pending;
+	return NNC_R_OK;
+}
+
+u32 nnc_aio_pending(nnc_aio *self)
+{
+	return self->pending;
+}
+
+enum nnc_aio_backend nnc_aio_get_backend(nnc_aio *self)
+{
+	return self->backend;
+}
+
+void nnc_aio_close(nnc_aio *self)
+{
+	nnc_aio_request *req;
+	/* the buffers of requests in flight may be freed after this returns */
+	while(self->pending && nnc_aio_complete(self, &req) == NNC_R_OK)
+		;
+	if(self->backend == NNC_AIO_THREADS)
+		threads_close(self);
+#if IO_URING_API
+	else if(self->backend == NNC_AIO_IO_URING)
+		uring_close(&self->ring);
+#endif
+	free(self->done);
+	free(self);
+}
+
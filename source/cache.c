@@ -0,0 +1,357 @@
+#include <nnc/cache.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./internal.h"
+
+#define SHARD_COUNT 16
+
+struct cache_block {
+	u64 id, index;
+	struct cache_block *hnext;       /* next in the hash bucket */
+	struct cache_block *prev, *next; /* lru list, head is the most recently used */
+	u32 len;
+	u8 data[];
+};
+
+struct cache_shard {
+	nnc_mutex *lock;
+	struct cache_block **buckets;
+	struct cache_block *head, *tail;
+	u32 nbuckets, count, max;
+	u64 hits, misses, evictions;
+};
+
+static struct nnc_block_cache {
+	struct cache_shard shards[SHARD_COUNT];
+	u32 block_size;
+	bool enabled;
+} cache;
+
+/* stream ids are never reused so blocks of closed streams can't be mistaken for new ones */
+static u64 next_stream_id = 1;
+static nnc_mutex *id_lock;
+
+static u64 cache_hash(u64 id, u64 index)
+{
+	/* splitmix64 finalizer */
+	u64 x = id * 0x9E3779B97F4A7C15ULL ^ index;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+	return x ^ (x >> 31);
+}
+
+static void lru_unlink(struct cache_shard *shard, struct cache_block *blk)
+{
+	if(blk->prev) blk->prev->next = blk->next;
+	else shard->head = blk->next;
+	if(blk->next) blk->next->prev = blk->prev;
+	else shard->tail = blk->prev;
+}
+
+static void lru_push_front(struct cache_shard *shard, struct cache_block *blk)
+{
+	blk->prev = NULL;
+	blk->next = shard->head;
+	if(shard->head) shard->head->prev = blk;
+	else shard->tail = blk;
+	shard->head = blk;
+}
+
+static struct cache_block **bucket_of(struct cache_shard *shard, u64 hash)
+{
+	/* the low bits select the shard */
+	return &shard->buckets[(hash / SHARD_COUNT) & (shard->nbuckets - 1)];
+}
+
+static struct cache_block *shard_lookup(struct cache_shard *shard, u64 hash, u64 id, u64 index)
+{
+	for(struct cache_block *blk = *bucket_of(shard, hash); blk; blk = blk->hnext)
+		if(blk->id == id && blk->index == index)
+			return blk;
+	return NULL;
+}
+
+static void shard_remove(struct cache_shard *shard, struct cache_block *blk)
+{
+	struct cache_block **it = bucket_of(shard, cache_hash(blk->id, blk->index));
+	while(*it != blk) it = &(*it)->hnext;
+	*it = blk->hnext;
+	lru_unlink(shard, blk);
+	--shard->count;
+	free(blk);
+}
+
+static void shard_insert(struct cache_shard *shard, u64 hash, struct cache_block *blk)
+{
+	struct cache_block **bucket = bucket_of(shard, hash);
+	blk->hnext = *bucket;
+	*bucket = blk;
+	lru_push_front(shard, blk);
+	++shard->count;
+	while(shard->count > shard->max)
+	{
+		shard_remove(shard, shard->tail);
+		++shard->evictions;
+	}
+}
+
+static void free_shards(void)
+{
+	for(int i = 0; i < SHARD_COUNT; ++i)
+	{
+		struct cache_shard *shard = &cache.shards[i];
+		while(shard->head)
+			shard_remove(shard, shard->head);
+		free(shard->buckets);
+		mutex_free(shard->lock);
+	}
+	memset(cache.shards, 0, sizeof(cache.shards));
+	cache.enabled = false;
+}
+
+nnc_result nnc_cache_init(u64 capacity, u32 block_size)
+{
+	if(!block_size) block_size = NNC_CACHE_DEFAULT_BLOCK_SIZE;
+	u64 blocks = capacity / block_size;
+	if(blocks == 0) return NNC_R_INVAL;
+	if(!id_lock && !(id_lock = mutex_new()))
+		return NNC_R_NOMEM;
+
+	free_shards();
+	cache.block_size = block_size;
+	u32 per_shard = MAX(1, MIN(blocks / SHARD_COUNT, UINT32_MAX / 2));
+	u32 nbuckets = 1;
+	while(nbuckets < per_shard) nbuckets *= 2;
+	for(int i = 0; i < SHARD_COUNT; ++i)
+	{
+		struct cache_shard *shard = &cache.shards[i];
+		shard->max = per_shard;
+		shard->nbuckets = nbuckets;
+		if(!(shard->lock = mutex_new()) || !(shard->buckets = calloc(nbuckets, sizeof(struct cache_block *))))
+			return free_shards(), NNC_R_NOMEM;
+	}
+	cache.enabled = true;
+	return NNC_R_OK;
+}
+
+void nnc_cache_free(void)
+{
+	free_shards();
+}
+
+void nnc_cache_get_stats(nnc_cache_stats *stats)
+{
+	memset(stats, 0, sizeof(nnc_cache_stats));
+	if(!cache.enabled) return;
+	stats->block_size = cache.block_size;
+	for(int i = 0; i < SHARD_COUNT; ++i)
+	{
+		struct cache_shard *shard = &cache.shards[i];
+		mutex_lock(shard->lock);
+		stats->hits += shard->hits;
+		stats->misses += shard->misses;
+		stats->evictions += shard->evictions;
+		stats->blocks += shard->count;
+		stats->capacity += shard->max;
+		mutex_unlock(shard->lock);
+	}
+}
+
+void nnc_cache_reset_stats(void)
+{
+	if(!cache.enabled) return;
+	for(int i = 0; i < SHARD_COUNT; ++i)
+	{
+		struct cache_shard *shard = &cache.shards[i];
+		mutex_lock(shard->lock);
+		shard->hits = shard->misses = shard->evictions = 0;
+		mutex_unlock(shard->lock);
+	}
+}
+
+/* copies the data of a block into buf, returns 0 if the block is beyond the end of the stream */
+static u32 copy_block(struct cache_block *blk, u32 off, u8 *buf, u32 max)
+{
+	if(off >= blk->len) return 0;
+	u32 n = MIN(max, blk->len - off);
+	memcpy(buf, blk->data + off, n);
+	return n;
+}
+
+static result cached_read_at(nnc_cached_rstream *self, u64 pos, u8 *buf, u32 max, u32 *totalRead)
+{
+	if(!cache.enabled)
+		return nnc_rs_read_at(self->child, pos, buf, max, totalRead);
+
+	u32 bs = cache.block_size, total = 0, got;
+	result ret;
+	while(total != max)
+	{
+		u64 index = pos / bs;
+		u32 off = pos % bs;
+		u64 hash = cache_hash(self->id, index);
+		struct cache_shard *shard = &cache.shards[hash % SHARD_COUNT];
+
+		mutex_lock(shard->lock);
+		struct cache_block *blk = shard_lookup(shard, hash, self->id, index);
+		if(blk)
+		{
+			++shard->hits;
+			lru_unlink(shard, blk);
+			lru_push_front(shard, blk);
+			got = copy_block(blk, off, buf + total, max - total);
+			mutex_unlock(shard->lock);
+		}
+		else
+		{
+			++shard->misses;
+			mutex_unlock(shard->lock);
+
+			/* the child is read without holding the lock */
+			if(!(blk = malloc(sizeof(struct cache_block) + bs)))
+			{
+				TRY(nnc_rs_read_at(self->child, pos, buf + total, max - total, &got));
+				total += got;
+				break;
+			}
+			blk->id = self->id;
+			blk->index = index;
+			blk->len = 0;
+			do {
+				ret = nnc_rs_read_at(self->child, index * bs + blk->len, blk->data + blk->len, bs - blk->len, &got);
+				if(ret != NNC_R_OK) return free(blk), ret;
+				blk->len += got;
+			} while(got && blk->len != bs);
+
+			mutex_lock(shard->lock);
+			/* another thread may have been faster */
+			struct cache_block *existing = shard_lookup(shard, hash, self->id, index);
+			if(existing)
+			{
+				free(blk);
+				blk = existing;
+			}
+			else shard_insert(shard, hash, blk);
+			got = copy_block(blk, off, buf + total, max - total);
+			mutex_unlock(shard->lock);
+		}
+		/* end of stream */
+		if(got == 0) break;
+		total += got;
+		pos += got;
+	}
+	*totalRead = total;
+	return NNC_R_OK;
+}
+
+static result cached_read(nnc_cached_rstream *self, u8 *buf, u32 max, u32 *totalRead)
+{
+	result ret;
+	TRY(cached_read_at(self, self->pos, buf, max, totalRead));
+	self->pos += *totalRead;
+	return NNC_R_OK;
+}
+
+static result cached_locate(nnc_cached_rstream *self, u64 pos, u64 len, int *fd, u64 *fd_pos)
+{
+	return nnc_rs_locate(self->child, pos, len, fd, fd_pos);
+}
+
+static result cached_advise(nnc_cached_rstream *self, u64 pos, u64 len, int advice)
+{
+	return nnc_rs_advise(self->child, pos, len, advice);
+}
+
+static result cached_seek_abs(nnc_cached_rstream *self, u64 pos)
+{
+	if(pos > NNC_RS_PCALL0(self->child, size)) return NNC_R_SEEK_RANGE;
+	self->pos = pos;
+	return NNC_R_OK;
+}
+
+static result cached_seek_rel(nnc_cached_rstream *self, u64 pos)
+{
+	return cached_seek_abs(self, self->pos + pos);
+}
+
+static u64 cached_size(nnc_cached_rstream *self) { return NNC_RS_PCALL0(self->child, size); }
+static u64 cached_tell(nnc_cached_rstream *self) { return self->pos; }
+
+/* stream ids are never reused, so the blocks of a closed stream can't be hit
+ * again and age out of the LRU lists like any other unused block */
+static void cached_close(nnc_cached_rstream *self)
+{
+	(void) self;
+}
+
+/* a clone shares the blocks of the stream it was made from and owns a clone of the child */
+struct cached_clone {
+	nnc_cached_rstream cached;
+	nnc_rstream_funcs table;
+};
+
+static void cached_clone_close(nnc_cached_rstream *self)
+{
+	nnc_rs_close(self->child);
+	free(self->child);
+}
+
+static result cached_clone(nnc_cached_rstream *self, nnc_rstream **out)
+{
+	struct cached_clone *clone = malloc(sizeof(struct cached_clone));
+	if(!clone) return NNC_R_NOMEM;
+	nnc_rstream *child;
+	result ret = nnc_rs_clone(self->child, &child);
+	if(ret != NNC_R_OK) return free(clone), ret;
+	clone->cached = *self;
+	clone->cached.child = child;
+	clone->cached.pos = 0;
+	clone->table = *self->funcs;
+	clone->table.read_at = child->funcs->read_at ? (nnc_read_at_func) cached_read_at : NULL;
+	clone->table.close = (nnc_close_func) cached_clone_close;
+	clone->cached.funcs = &clone->table;
+	*out = NNC_RSP(clone);
+	return NNC_R_OK;
+}
+
+static const nnc_rstream_funcs cached_funcs = {
+	.read = (nnc_read_func) cached_read,
+	.seek_abs = (nnc_seek_abs_func) cached_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) cached_seek_rel,
+	.size = (nnc_size_func) cached_size,
+	.close = (nnc_close_func) cached_close,
+	.tell = (nnc_tell_func) cached_tell,
+	.locate = (nnc_locate_func) cached_locate,
+	.advise = (nnc_advise_func) cached_advise,
+	.clone = (nnc_clone_func) cached_clone,
+};
+
+/* misses read the child without holding a lock, so only positional children can be read like this */
+static const nnc_rstream_funcs cached_at_funcs = {
+	.read = (nnc_read_func) cached_read,
+	.seek_abs = (nnc_seek_abs_func) cached_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) cached_seek_rel,
+	.size = (nnc_size_func) cached_size,
+	.close = (nnc_close_func) cached_close,
+	.tell = (nnc_tell_func) cached_tell,
+	.read_at = (nnc_read_at_func) cached_read_at,
+	.locate = (nnc_locate_func) cached_locate,
+	.advise = (nnc_advise_func) cached_advise,
+	.clone = (nnc_clone_func) cached_clone,
+};
+
+void nnc_cached_rstream_open(nnc_cached_rstream *self, nnc_rstream *child)
+{
+	self->funcs = child->funcs->read_at ? &cached_at_funcs : &cached_funcs;
+	self->child = child;
+	self->pos = 0;
+#ifdef __GNUC__
+	self->id = __atomic_fetch_add(&next_stream_id, 1, __ATOMIC_RELAXED);
+#else
+	/* id_lock is created by nnc_cache_init */
+	if(id_lock) mutex_lock(id_lock);
+	self->id = next_stream_id++;
+	if(id_lock) mutex_unlock(id_lock);
+#endif
+}
+
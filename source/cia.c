@@ -15,10 +15,11 @@
 
 nnc_result nnc_read_cia_header(nnc_rstream *rs, nnc_cia_header *cia)
 {
-	nnc_u8 header[0x2020];
+	nnc_u8 buf[0x2020];
+	const nnc_u8 *header;
 	result ret;
 
-	TRY(read_at_exact(rs, 0, header, sizeof(header)));
+	TRY(borrow_at_exact(rs, 0, buf, sizeof(buf), &header));
 	/* 0x00 */ if(LE32P(&header[0x00]) != HDRSIZE) return NNC_R_CORRUPT;
 	/* 0x04 */ cia->type = LE16P(&header[0x04]);
 	/* 0x06 */ cia->version = LE16P(&header[0x06]);
@@ -33,26 +34,26 @@ nnc_result nnc_read_cia_header(nnc_rstream *rs, nnc_cia_header *cia)
 
 void nnc_cia_open_certchain(nnc_cia_header *cia, nnc_rstream *rs, nnc_subview *sv)
 {
-	nnc_u32 offset = HDRSIZE_AL;
+	nnc_u64 offset = HDRSIZE_AL;
 	nnc_subview_open(sv, rs, offset, cia->cert_chain_size);
 }
 
 void nnc_cia_open_ticket(nnc_cia_header *cia, nnc_rstream *rs, nnc_subview *sv)
 {
-	nnc_u32 offset = HDRSIZE_AL + CALIGN(cia->cert_chain_size);
+	nnc_u64 offset = HDRSIZE_AL + CALIGN((nnc_u64) cia->cert_chain_size);
 	nnc_subview_open(sv, rs, offset, cia->ticket_size);
 }
 
 void nnc_cia_open_tmd(nnc_cia_header *cia, nnc_rstream *rs, nnc_subview *sv)
 {
-	nnc_u32 offset = HDRSIZE_AL + CALIGN(cia->cert_chain_size) + CALIGN(cia->ticket_size);
+	nnc_u64 offset = HDRSIZE_AL + CALIGN((nnc_u64) cia->cert_chain_size) + CALIGN((nnc_u64) cia->ticket_size);
 	nnc_subview_open(sv, rs, offset, cia->tmd_size);
 }
 
 nnc_result nnc_cia_open_meta(nnc_cia_header *cia, nnc_rstream *rs, nnc_subview *sv)
 {
 	if(cia->meta_size == 0) return NNC_R_NOT_FOUND;
-	nnc_u32 offset = HDRSIZE_AL + CALIGN(cia->cert_chain_size) + CALIGN(cia->ticket_size) + CALIGN(cia->tmd_size) + CALIGN(cia->content_size);
+	nnc_u64 offset = HDRSIZE_AL + CALIGN((nnc_u64) cia->cert_chain_size) + CALIGN((nnc_u64) cia->ticket_size) + CALIGN((nnc_u64) cia->tmd_size) + CALIGN(cia->content_size);
 	nnc_subview_open(sv, rs, offset, cia->meta_size);
 	return NNC_R_OK;
 }
@@ -96,17 +97,18 @@ free_chunks:
 	return ret;
 }
 
-static nnc_result open_content(nnc_cia_content_reader *reader, nnc_chunk_record *chunk, nnc_u32 offset,
+static nnc_result open_content(nnc_cia_content_reader *reader, nnc_chunk_record *chunk, nnc_u64 offset,
 	nnc_cia_content_stream *content)
 {
+	nnc_rstream *rs = trace_rs(reader->rs, "cia.content.source");
 	if(chunk->flags & NNC_CHUNKF_ENCRYPTED)
 	{
 		u16 iv[8] = { BE16(chunk->index), 0, 0, 0, 0, 0, 0, 0 };
-		nnc_subview_open(&content->u.enc.sv, reader->rs, offset, chunk->size);
-		return nnc_aes_cbc_open(&content->u.enc.crypt, NNC_RSP(&content->u.enc.sv),
+		nnc_subview_open(&content->u.enc.sv, rs, offset, chunk->size);
+		return nnc_aes_cbc_open(&content->u.enc.crypt, trace_rs(NNC_RSP(&content->u.enc.sv), "cia.content.subview"),
 			reader->key, (u8 *) iv);
 	}
-	nnc_subview_open(&content->u.dec.sv, reader->rs, offset, chunk->size);
+	nnc_subview_open(&content->u.dec.sv, rs, offset, chunk->size);
 	return NNC_R_OK;
 }
 
@@ -114,7 +116,7 @@ nnc_result nnc_cia_open_content(nnc_cia_content_reader *reader, nnc_u16 index,
 	nnc_cia_content_stream *content, nnc_chunk_record **chunk_output)
 {
 	nnc_u16 i;
-	nnc_u32 offset = HDRSIZE_AL + CALIGN(reader->cia->cert_chain_size) + CALIGN(reader->cia->ticket_size) + CALIGN(reader->cia->tmd_size);
+	nnc_u64 offset = HDRSIZE_AL + CALIGN((nnc_u64) reader->cia->cert_chain_size) + CALIGN((nnc_u64) reader->cia->ticket_size) + CALIGN((nnc_u64) reader->cia->tmd_size);
 	for(i = 0; i < reader->content_count; ++i)
 	{
 		if(!NNC_CINDEX_HAS(reader->cia->content_index, reader->chunks[i].index))
@@ -135,6 +137,16 @@ void nnc_cia_free_reader(nnc_cia_content_reader *reader)
 	free(reader->chunks);
 }
 
+static result nnc_cia_validate_wflags(u8 wflags, nnc_certchain_or_stream certchain, nnc_ticket_or_stream ticket, nnc_tmd_or_stream tmd)
+{
+#define DO_VALIDATE_FOR(ptr, opt1, opt2) if( !ptr || (wflags & (opt1 | opt2)) == 0 || (wflags & (opt1 | opt2)) == (opt1 | opt2)) return NNC_R_INVAL
+	DO_VALIDATE_FOR(certchain, NNC_CIA_WF_CERTCHAIN_BUILD, NNC_CIA_WF_CERTCHAIN_STREAM);
+	DO_VALIDATE_FOR(ticket, NNC_CIA_WF_TICKET_BUILD, NNC_CIA_WF_TICKET_STREAM);
+	DO_VALIDATE_FOR(tmd, NNC_CIA_WF_TMD_BUILD, NNC_CIA_WF_TMD_STREAM);
+#undef DO_VALIDATE_FOR
+	return NNC_R_OK;
+}
+
 nnc_result nnc_write_cia(
 	nnc_u8 wflags,
 	nnc_certchain_or_stream certchain,
@@ -147,14 +159,10 @@ nnc_result nnc_write_cia(
 	if(!ws->funcs->seek || !ws->funcs->subreadstream)
 		return NNC_R_INVAL;
 
-#define DO_VALIDATE_FOR(ptr, opt1, opt2) if( !ptr || (wflags & (opt1 | opt2)) == 0 || (wflags & (opt1 | opt2)) == (opt1 | opt2)) return NNC_R_INVAL
-	DO_VALIDATE_FOR(certchain, NNC_CIA_WF_CERTCHAIN_BUILD, NNC_CIA_WF_CERTCHAIN_STREAM);
-	DO_VALIDATE_FOR(ticket, NNC_CIA_WF_TICKET_BUILD, NNC_CIA_WF_TICKET_STREAM);
-	DO_VALIDATE_FOR(tmd, NNC_CIA_WF_TMD_BUILD, NNC_CIA_WF_TMD_STREAM);
-#undef DO_VALIDATE_FOR
-
 	result ret;
-	nnc_u32 certchain_size, ticket_size, tmd_size, hdr_off, tmd_off, off, size, chunkcount = 0, startpos, endpos;
+	TRY(nnc_cia_validate_wflags(wflags, certchain, ticket, tmd));
+	nnc_u64 certchain_size, ticket_size, tmd_size, hdr_off, tmd_off, off, size, startpos, endpos;
+	nnc_u32 chunkcount = 0;
 	nnc_chunk_record *chunk_records = NULL;
 	nnc_wstream *content_writer;
 	nnc_hasher_writer hasher = { NULL };
@@ -202,6 +210,7 @@ nnc_result nnc_write_cia(
 	else
 	{
 		TRY(nnc_copy((nnc_rstream *) tmd, ws, &tmd_size));
+		TRY(PERFORM_ALIGNMENT(tmd_size));
 		content_writer = ws;
 	}
 
@@ -308,4 +317,71 @@ out:
 	return ret;
 }
 
+nnc_result nnc_plan_cia(
+	nnc_u8 wflags,
+	nnc_certchain_or_stream certchain,
+	nnc_ticket_or_stream ticket,
+	nnc_tmd_or_stream tmd,
+	nnc_u16 amount_contents,
+	nnc_cia_writable_ncch *contents,
+	nnc_cia_plan *plan,
+	nnc_cia_content_plan *content_plans)
+{
+	result ret;
+	nnc_ncch_plan ncch_plan;
+	u64 size;
+	TRY(nnc_cia_validate_wflags(wflags, certchain, ticket, tmd));
+
+	if(wflags & NNC_CIA_WF_CERTCHAIN_BUILD)
+		return NNC_R_UNSUPPORTED;
+	plan->cert_chain_size = nnc_rs_size(certchain);
 
+	if(wflags & NNC_CIA_WF_TICKET_BUILD)
+	{
+		/* the ticket size depends on its signature and content index, so we just let it be written */
+		nnc_wcounter counter;
+		nnc_wcounter_open(&counter);
+		TRY(nnc_write_ticket((nnc_ticket *) ticket, NNC_WSP(&counter)));
+		plan->ticket_size = counter.size;
+	}
+	else
+		plan->ticket_size = nnc_rs_size(ticket);
+
+	if(wflags & NNC_CIA_WF_TMD_BUILD)
+		plan->tmd_size = nnc_calculate_tmd_size(amount_contents, NNC_SIG_NONE + NNC_SIG_RSA_2048_SHA256);
+	else
+		plan->tmd_size = nnc_rs_size(tmd);
+
+	plan->certchain_offset = HDRSIZE_AL;
+	plan->ticket_offset = plan->certchain_offset + CALIGN(plan->cert_chain_size);
+	plan->tmd_offset = plan->ticket_offset + CALIGN(plan->ticket_size);
+	plan->content_offset = plan->tmd_offset + CALIGN(plan->tmd_size);
+	plan->content_size = 0;
+
+	for(u32 i = 0; i < amount_contents; ++i)
+	{
+		switch(contents[i].type)
+		{
+		case NNC_CIA_NCCHBUILD_STREAM:
+			size = nnc_rs_size(contents[i].ncch);
+			break;
+		case NNC_CIA_NCCHBUILD_BUILD:
+			TRY(nnc_plan_ncch_from_buildable((nnc_buildable_ncch *) contents[i].ncch, &ncch_plan));
+			size = ncch_plan.size;
+			break;
+		default:
+			if(content_plans)
+				content_plans[i].offset = content_plans[i].size = 0;
+			continue;
+		}
+		if(content_plans)
+		{
+			content_plans[i].offset = plan->content_offset + plan->content_size;
+			content_plans[i].size = size;
+		}
+		plan->content_size += CALIGN(size);
+	}
+
+	plan->size = plan->content_offset + plan->content_size;
+	return NNC_R_OK;
+}
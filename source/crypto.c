@@ -1,11 +1,11 @@
 
 #include <mbedtls/version.h>
-#include <mbedtls/sha256.h>
 #include <mbedtls/sha1.h>
 #include <mbedtls/aes.h>
 #include <nnc/crypto.h>
 #include <nnc/ticket.h>
 #include <nnc/ncch.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include "./internal.h"
@@ -14,45 +14,11 @@
  * you were supposed to use *_ret, but in mbedTLS version 3+ the
  * *_ret functions had the functions renamed to have the _ret suffix removed */
 #if MBEDTLS_VERSION_MAJOR == 2
-	#define mbedtls_sha256_starts mbedtls_sha256_starts_ret
-	#define mbedtls_sha256_update mbedtls_sha256_update_ret
-	#define mbedtls_sha256_finish mbedtls_sha256_finish_ret
 	#define mbedtls_sha1_starts mbedtls_sha1_starts_ret
 	#define mbedtls_sha1_update mbedtls_sha1_update_ret
 	#define mbedtls_sha1_finish mbedtls_sha1_finish_ret
 #endif
 
-nnc_result nnc_crypto_sha256_incremental(nnc_sha256_incremental_hash *self)
-{
-	*self = malloc(sizeof(mbedtls_sha256_context));
-	if(!*self) return NNC_R_NOMEM;
-	mbedtls_sha256_init(*self);
-	mbedtls_sha256_starts(*self, 0);
-	return NNC_R_OK;
-}
-
-void nnc_crypto_sha256_feed(nnc_sha256_incremental_hash self, u8 *data, u32 length)
-{
-	mbedtls_sha256_update(self, data, length);
-}
-
-void nnc_crypto_sha256_finish(nnc_sha256_incremental_hash self, nnc_sha256_hash digest)
-{
-	mbedtls_sha256_finish(self, digest);
-	mbedtls_sha256_free(self);
-}
-
-void nnc_crypto_sha256_reset(nnc_sha256_incremental_hash self)
-{
-	mbedtls_sha256_init(self);
-	mbedtls_sha256_starts(self, 0);
-}
-
-void nnc_crypto_sha256_free(nnc_sha256_incremental_hash self)
-{
-	free(self);
-}
-
 static result hasher_writer_write(nnc_hasher_writer *self, u8 *buf, u32 size)
 {
 	u32 to_hash = self->lim ? MIN(self->lim - self->hashed, size) : size;
@@ -62,7 +28,7 @@ static result hasher_writer_write(nnc_hasher_writer *self, u8 *buf, u32 size)
 }
 
 static result hasher_writer_wclose(nnc_hasher_writer *self) { nnc_crypto_sha256_free(self->hash); return NNC_R_OK; }
-static result hasher_writer_wtell(nnc_hasher_writer *self)  { return self->child->funcs->tell(self->child); }
+static u64 hasher_writer_wtell(nnc_hasher_writer *self)  { return self->child->funcs->tell(self->child); }
 
 static const nnc_wstream_funcs hasher_writer_wfuncs = {
 	.write = (nnc_write_func)  hasher_writer_write,
@@ -70,7 +36,7 @@ static const nnc_wstream_funcs hasher_writer_wfuncs = {
 	.tell  = (nnc_wtell_func)  hasher_writer_wtell,
 };
 
-nnc_result nnc_open_hasher_writer(nnc_hasher_writer *self, nnc_wstream *child, nnc_u32 limit)
+nnc_result nnc_open_hasher_writer(nnc_hasher_writer *self, nnc_wstream *child, nnc_u64 limit)
 {
 	self->funcs  = &hasher_writer_wfuncs;
 	self->child  = child;
@@ -92,38 +58,24 @@ void nnc_hasher_writer_digest_reset(nnc_hasher_writer *self, nnc_sha256_hash dig
 }
 
 
-result nnc_crypto_sha256_part(nnc_rstream *rs, nnc_sha256_hash digest, u32 size)
-{
-	mbedtls_sha256_context ctx;
-	mbedtls_sha256_init(&ctx);
-	mbedtls_sha256_starts(&ctx, 0);
-	u8 block[BLOCK_SZ];
-	u32 read_left = size, next_read = MIN(size, BLOCK_SZ), read_ret;
-	result ret;
-	while(read_left != 0)
-	{
-		ret = NNC_RS_PCALL(rs, read, block, next_read, &read_ret);
-		if(ret != NNC_R_OK) goto out;
-		if(read_ret != next_read) { ret = NNC_R_TOO_SMALL; goto out; }
-		mbedtls_sha256_update(&ctx, block, read_ret);
-		read_left -= next_read;
-		next_read = MIN(read_left, BLOCK_SZ);
-	}
-	mbedtls_sha256_finish(&ctx, digest);
-	ret = NNC_R_OK;
-out:
-	mbedtls_sha256_free(&ctx);
-	return ret;
-}
-
-result nnc_crypto_sha1_part(nnc_rstream *rs, nnc_sha1_hash digest, u32 size)
+result nnc_crypto_sha1_part(nnc_rstream *rs, nnc_sha1_hash digest, u64 size)
 {
 	mbedtls_sha1_context ctx;
 	mbedtls_sha1_init(&ctx);
 	mbedtls_sha1_starts(&ctx);
 	u8 block[BLOCK_SZ];
-	u32 read_left = size, next_read = MIN(size, BLOCK_SZ), read_ret;
+	u64 read_left = size;
+	u32 next_read = MIN(size, BLOCK_SZ), read_ret;
 	result ret;
+	u64 pos = nnc_rs_tell(rs);
+	const u8 *data;
+	/* hash straight out of memory if possible */
+	if(nnc_rs_borrow(rs, pos, size, &data) == NNC_R_OK)
+	{
+		if((ret = nnc_rs_seek_abs(rs, pos + size)) != NNC_R_OK) goto out;
+		mbedtls_sha1_update(&ctx, data, size);
+		read_left = 0;
+	}
 	while(read_left != 0)
 	{
 		ret = NNC_RS_PCALL(rs, read, block, next_read, &read_ret);
@@ -158,52 +110,123 @@ bool nnc_crypto_hasheq(nnc_sha256_hash a, nnc_sha256_hash b)
 	return memcmp(a, b, sizeof(nnc_sha256_hash)) == 0;
 }
 
-result nnc_crypto_sha256(const u8 *buf, nnc_sha256_hash digest, u32 size)
-{
-	mbedtls_sha256_context ctx;
-	mbedtls_sha256_init(&ctx);
-	mbedtls_sha256_starts(&ctx, 0);
-	mbedtls_sha256_update(&ctx, buf, size);
-	mbedtls_sha256_finish(&ctx, digest);
-	mbedtls_sha256_free(&ctx);
-	return NNC_R_OK;
-}
+/* seeddb entries parsed per borrow from the stream */
+#define SEEDDB_BATCH 0x100
 
 nnc_result nnc_seeds_seeddb(nnc_rstream *rs, nnc_seeddb *seeddb)
 {
-	u8 buf[0x20];
+	u8 buf[SEEDDB_BATCH * 0x20];
+	const u8 *data;
 	result ret;
 	seeddb->size = 0;
+	seeddb->entries = NULL;
+	seeddb->index = NULL;
+	seeddb->index_size = 0;
 	u32 expected_size;
-	TRY(read_exact(rs, buf, 0x10));
+	u64 pos = nnc_rs_tell(rs);
+	TRY(read_at_exact(rs, pos, buf, 0x10));
 	expected_size = LE32P(&buf[0x00]);
+	pos += 0x10;
+	if(pos + (u64) expected_size * 0x20 > nnc_rs_size(rs))
+		return NNC_R_TOO_SMALL;
 	if(!(seeddb->entries = malloc(expected_size * sizeof(struct nnc_seeddb_entry))))
 		return NNC_R_NOMEM;
-	for(u32 i = 0; i < expected_size; ++i, ++seeddb->size)
+	/* straight out of the mapping if the stream is memory-mapped */
+	while(seeddb->size != expected_size)
 	{
-		TRY(read_exact(rs, buf, 0x20));
-		memcpy(seeddb->entries[i].seed, &buf[0x08], NNC_SEED_SIZE);
-		seeddb->entries[i].title_id = LE64P(&buf[0x00]);
+		u32 count = MIN(SEEDDB_BATCH, expected_size - seeddb->size);
+		TRY(borrow_at_exact(rs, pos, buf, count * 0x20, &data));
+		for(u32 i = 0; i < count; ++i, ++seeddb->size, data += 0x20)
+		{
+			memcpy(seeddb->entries[seeddb->size].seed, &data[0x08], NNC_SEED_SIZE);
+			seeddb->entries[seeddb->size].title_id = LE64P(&data[0x00]);
+		}
+		pos += count * 0x20;
 	}
+	TRY(nnc_rs_seek_abs(rs, pos));
+	/* lookups fall back to searching linearly without the index */
+	nnc_index_seeddb(seeddb);
 	return NNC_R_OK;
 }
 
 result nnc_scan_seeddb(nnc_seeddb *seeddb)
 {
+	seeddb->size = 0;
 	seeddb->entries = NULL;
+	seeddb->index = NULL;
+	seeddb->index_size = 0;
 	char path[SUP_FILE_NAME_LEN];
 	if(!find_support_file("seeddb.bin", path))
 		return NNC_R_NOT_FOUND;
+	nnc_mmap_file mf;
 	nnc_file f;
 	result ret;
+	if(nnc_mmap_file_open(&mf, path) == NNC_R_OK)
+	{
+		ret = nnc_seeds_seeddb(NNC_RSP(&mf), seeddb);
+		NNC_RS_CALL0(mf, close);
+		return ret;
+	}
 	TRY(nnc_file_open(&f, path));
 	ret = nnc_seeds_seeddb(NNC_RSP(&f), seeddb);
 	NNC_RS_CALL0(f, close);
 	return ret;
 }
 
+static u32 seed_slot(u64 tid, u32 index_size)
+{
+	/* fibonacci hashing, title IDs of one title only differ in the low bits */
+	return (tid * 0x9E3779B97F4A7C15ULL) >> 32 & (index_size - 1);
+}
+
+/* builds the title ID index, if compact is set the entries that are not the first for their title are removed */
+static result index_seeddb(nnc_seeddb *seeddb, bool compact)
+{
+	free(seeddb->index);
+	seeddb->index = NULL;
+	seeddb->index_size = 0;
+	if(seeddb->size == 0) return NNC_R_OK;
+	if(seeddb->size > 0x40000000) return NNC_R_TOO_LARGE;
+	/* at most half full so a search always ends at an empty slot */
+	u32 index_size = 2, slot, kept = 0;
+	while(index_size < seeddb->size * 2) index_size *= 2;
+	u32 *index = calloc(index_size, sizeof(u32));
+	if(!index) return NNC_R_NOMEM;
+	for(u32 i = 0; i < seeddb->size; ++i)
+	{
+		u64 tid = seeddb->entries[i].title_id;
+		/* the first seed of a title wins, as it does without the index */
+		for(slot = seed_slot(tid, index_size); index[slot]; slot = (slot + 1) & (index_size - 1))
+			if(seeddb->entries[index[slot] - 1].title_id == tid)
+				break;
+		if(index[slot]) continue;
+		if(compact) seeddb->entries[kept] = seeddb->entries[i];
+		index[slot] = (compact ? kept : i) + 1;
+		++kept;
+	}
+	if(compact) seeddb->size = kept;
+	seeddb->index = index;
+	seeddb->index_size = index_size;
+	return NNC_R_OK;
+}
+
+result nnc_index_seeddb(nnc_seeddb *seeddb)
+{
+	return index_seeddb(seeddb, false);
+}
+
 u8 *nnc_get_seed(nnc_seeddb *seeddb, u64 tid)
 {
+	if(seeddb->index)
+	{
+		for(u32 slot = seed_slot(tid, seeddb->index_size); seeddb->index[slot]; slot = (slot + 1) & (seeddb->index_size - 1))
+		{
+			struct nnc_seeddb_entry *entry = &seeddb->entries[seeddb->index[slot] - 1];
+			if(entry->title_id == tid)
+				return entry->seed;
+		}
+		return NULL;
+	}
 	for(u32 i = 0; i < seeddb->size; ++i)
 	{
 		if(seeddb->entries[i].title_id == tid)
@@ -212,9 +235,27 @@ u8 *nnc_get_seed(nnc_seeddb *seeddb, u64 tid)
 	return NULL;
 }
 
+result nnc_merge_seeddb(nnc_seeddb *dest, nnc_seeddb *src)
+{
+	if(src->size == 0 || src == dest) return NNC_R_OK;
+	if(dest->size > 0x40000000 || src->size > 0x40000000 - dest->size) return NNC_R_TOO_LARGE;
+	struct nnc_seeddb_entry *entries = realloc(dest->entries, (dest->size + src->size) * sizeof(struct nnc_seeddb_entry));
+	if(!entries) return NNC_R_NOMEM;
+	memcpy(entries + dest->size, src->entries, src->size * sizeof(struct nnc_seeddb_entry));
+	dest->entries = entries;
+	dest->size += src->size;
+
+	/* the seeds already in dest come first, so they win over the ones from src */
+	return index_seeddb(dest, true);
+}
+
 void nnc_free_seeddb(nnc_seeddb *seeddb)
 {
 	free(seeddb->entries);
+	free(seeddb->index);
+	seeddb->entries = NULL;
+	seeddb->index = NULL;
+	seeddb->size = seeddb->index_size = 0;
 }
 
 enum keyfield {
@@ -285,6 +326,267 @@ nnc_result nnc_keyset_default(nnc_keyset *ks, u8 setsel)
 	return NNC_R_OK;
 }
 
+/* key cache */
+
+/* the accelerated kernels in aes.c need their own key schedule */
+struct aes_keys {
+	mbedtls_aes_context mbed;
+	nnc_aes128_key accel;
+};
+
+enum key_sched_kind {
+	KS_CTR,     /* encryption schedule for mbedtls and the accelerated kernels */
+	KS_CBC_DEC, /* decryption schedule for mbedtls, encryption schedule for the accelerated kernels */
+	KS_CBC_ENC, /* encryption schedule for mbedtls */
+};
+
+/* crypto_ctx of the AES streams, the mbedtls context comes first so
+ * AES-CBC streams can use it as their context directly */
+struct key_sched {
+	struct aes_keys keys;
+	u8 raw[0x10];
+	u8 kind;
+	bool cached; /* false if not in the cache (anymore), the last user frees it then */
+	u32 refs;
+	struct key_sched *hnext;       /* next in the hash bucket */
+	struct key_sched *prev, *next; /* lru list of unused schedules, head is the most recently used */
+};
+
+enum normal_key_flags {
+	NK_VALID  = 0x01,
+	NK_SEEDED = 0x02,
+	NK_DSI    = 0x04,
+};
+
+struct normal_key_slot {
+	u128 kx, ky;
+	/* the seed is only used if its hash matches the one in the NCCH,
+	 * which also covers the title ID */
+	u64 title_id;
+	u8 seed[NNC_SEED_SIZE];
+	u8 seed_hash[4];
+	u8 flags;
+	u128 normal;
+};
+
+static struct nnc_key_cache {
+	nnc_mutex *lock; /* created by the first nnc_key_cache_init and never freed */
+	struct key_sched **buckets;
+	struct key_sched *head, *tail;
+	struct normal_key_slot *normal;
+	u32 nbuckets, count, max;
+	u64 hits, misses, normal_hits, normal_misses;
+	bool enabled;
+} key_cache;
+
+static u32 key_hash(const u8 *data, u32 len, u8 kind)
+{
+	/* FNV-1a */
+	u32 hash = 0x811C9DC5 ^ kind;
+	for(u32 i = 0; i < len; ++i)
+		hash = (hash ^ data[i]) * 0x01000193;
+	return hash;
+}
+
+static void key_lru_unlink(struct key_sched *ks)
+{
+	if(ks->prev) ks->prev->next = ks->next;
+	else key_cache.head = ks->next;
+	if(ks->next) ks->next->prev = ks->prev;
+	else key_cache.tail = ks->prev;
+}
+
+static void key_lru_push_front(struct key_sched *ks)
+{
+	ks->prev = NULL;
+	ks->next = key_cache.head;
+	if(key_cache.head) key_cache.head->prev = ks;
+	else key_cache.tail = ks;
+	key_cache.head = ks;
+}
+
+static struct key_sched **key_bucket_of(const u8 raw[0x10], u8 kind)
+{
+	return &key_cache.buckets[key_hash(raw, 0x10, kind) & (key_cache.nbuckets - 1)];
+}
+
+static struct key_sched *key_sched_new(const u8 raw[0x10], u8 kind)
+{
+	struct key_sched *ks = malloc(sizeof(struct key_sched));
+	if(!ks) return NULL;
+	memcpy(ks->raw, raw, 0x10);
+	ks->kind = kind;
+	ks->cached = false;
+	ks->refs = 1;
+	mbedtls_aes_init(&ks->keys.mbed);
+	if(kind == KS_CBC_DEC) mbedtls_aes_setkey_dec(&ks->keys.mbed, raw, 128);
+	else                   mbedtls_aes_setkey_enc(&ks->keys.mbed, raw, 128);
+	if(kind != KS_CBC_ENC) aes128_expand_key(&ks->keys.accel, raw);
+	return ks;
+}
+
+static void key_sched_free(struct key_sched *ks)
+{
+	mbedtls_aes_free(&ks->keys.mbed);
+	free(ks);
+}
+
+/* drops unused schedules until the cache is within its limit, the lock must be held */
+static void key_cache_evict(void)
+{
+	while(key_cache.count > key_cache.max && key_cache.tail)
+	{
+		struct key_sched *ks = key_cache.tail, **it = key_bucket_of(ks->raw, ks->kind);
+		while(*it != ks) it = &(*it)->hnext;
+		*it = ks->hnext;
+		key_lru_unlink(ks);
+		--key_cache.count;
+		key_sched_free(ks);
+	}
+}
+
+static struct key_sched *key_cache_lookup(const u8 raw[0x10], u8 kind)
+{
+	for(struct key_sched *ks = *key_bucket_of(raw, kind); ks; ks = ks->hnext)
+		if(ks->kind == kind && memcmp(ks->raw, raw, 0x10) == 0)
+		{
+			if(ks->refs++ == 0) key_lru_unlink(ks);
+			return ks;
+		}
+	return NULL;
+}
+
+/* gets a key schedule for raw, shared with other streams if the key cache is enabled */
+static struct key_sched *key_sched_get(const u8 raw[0x10], u8 kind)
+{
+	struct key_sched *ks, *existing;
+	if(!key_cache.lock) return key_sched_new(raw, kind);
+
+	mutex_lock(key_cache.lock);
+	if(!key_cache.enabled)
+	{
+		mutex_unlock(key_cache.lock);
+		return key_sched_new(raw, kind);
+	}
+	if((ks = key_cache_lookup(raw, kind)))
+	{
+		++key_cache.hits;
+		mutex_unlock(key_cache.lock);
+		return ks;
+	}
+	++key_cache.misses;
+	mutex_unlock(key_cache.lock);
+
+	/* the key is expanded without holding the lock */
+	if(!(ks = key_sched_new(raw, kind)))
+		return NULL;
+	mutex_lock(key_cache.lock);
+	/* another thread may have been faster, or the cache was freed in the meantime */
+	if(!key_cache.enabled) { mutex_unlock(key_cache.lock); return ks; }
+	if((existing = key_cache_lookup(raw, kind)))
+	{
+		mutex_unlock(key_cache.lock);
+		key_sched_free(ks);
+		return existing;
+	}
+	struct key_sched **bucket = key_bucket_of(raw, kind);
+	ks->hnext = *bucket;
+	*bucket = ks;
+	ks->cached = true;
+	++key_cache.count;
+	key_cache_evict();
+	mutex_unlock(key_cache.lock);
+	return ks;
+}
+
+static void key_sched_release(struct key_sched *ks)
+{
+	if(key_cache.lock)
+	{
+		mutex_lock(key_cache.lock);
+		if(--ks->refs != 0) ks = NULL;
+		else if(ks->cached)
+		{
+			/* unused schedules stay in the cache until they are evicted */
+			key_lru_push_front(ks);
+			key_cache_evict();
+			ks = NULL;
+		}
+		mutex_unlock(key_cache.lock);
+	}
+	if(ks) key_sched_free(ks);
+}
+
+/* releases all unused schedules, the ones still in use are freed by their last user */
+static void key_cache_clear(void)
+{
+	for(u32 i = 0; i < key_cache.nbuckets; ++i)
+	{
+		for(struct key_sched *ks = key_cache.buckets[i], *next; ks; ks = next)
+		{
+			next = ks->hnext;
+			ks->cached = false;
+			if(ks->refs == 0) key_sched_free(ks);
+		}
+	}
+	free(key_cache.buckets);
+	free(key_cache.normal);
+	key_cache.buckets = NULL;
+	key_cache.normal = NULL;
+	key_cache.head = key_cache.tail = NULL;
+	key_cache.nbuckets = key_cache.count = key_cache.max = 0;
+	key_cache.enabled = false;
+}
+
+nnc_result nnc_key_cache_init(u32 max_keys)
+{
+	if(max_keys == 0) return NNC_R_INVAL;
+	if(!key_cache.lock && !(key_cache.lock = mutex_new()))
+		return NNC_R_NOMEM;
+
+	mutex_lock(key_cache.lock);
+	key_cache_clear();
+	u32 nbuckets = 1;
+	while(nbuckets < max_keys && nbuckets < 0x80000000) nbuckets *= 2;
+	key_cache.buckets = calloc(nbuckets, sizeof(struct key_sched *));
+	key_cache.normal = calloc(nbuckets, sizeof(struct normal_key_slot));
+	if(!key_cache.buckets || !key_cache.normal)
+	{
+		key_cache_clear();
+		mutex_unlock(key_cache.lock);
+		return NNC_R_NOMEM;
+	}
+	key_cache.nbuckets = nbuckets;
+	key_cache.max = max_keys;
+	key_cache.hits = key_cache.misses = 0;
+	key_cache.normal_hits = key_cache.normal_misses = 0;
+	key_cache.enabled = true;
+	mutex_unlock(key_cache.lock);
+	return NNC_R_OK;
+}
+
+void nnc_key_cache_free(void)
+{
+	if(!key_cache.lock) return;
+	mutex_lock(key_cache.lock);
+	key_cache_clear();
+	mutex_unlock(key_cache.lock);
+}
+
+void nnc_key_cache_get_stats(nnc_key_cache_stats *stats)
+{
+	memset(stats, 0, sizeof(nnc_key_cache_stats));
+	if(!key_cache.lock) return;
+	mutex_lock(key_cache.lock);
+	stats->schedule_hits = key_cache.hits;
+	stats->schedule_misses = key_cache.misses;
+	stats->normal_key_hits = key_cache.normal_hits;
+	stats->normal_key_misses = key_cache.normal_misses;
+	stats->schedules = key_cache.count;
+	stats->capacity = key_cache.max;
+	mutex_unlock(key_cache.lock);
+}
+
 static const u128 C1_b = NNC_HEX128(0x1FF9E9AAC5FE0408,024591DC5D52768A);
 static const u128 *C1 = &C1_b;
 
@@ -338,20 +640,100 @@ nnc_result nnc_keyy_seed(nnc_ncch_header *ncch, nnc_u128 *keyy, u8 seed[NNC_SEED
 	return NNC_R_OK;
 }
 
-static result ky_from_ncch(u128 *ky, nnc_ncch_header *ncch, nnc_seeddb *seeddb)
+/* seeds hashed per call to nnc_crypto_sha256_multi */
+#define SEED_PROBE_BATCH 64
+
+u8 *nnc_probe_seed(nnc_seeddb *seeddb, nnc_ncch_header *ncch)
 {
+	u8 msgs[SEED_PROBE_BATCH][0x18];
+	const u8 *bufs[SEED_PROBE_BATCH];
+	u32 sizes[SEED_PROBE_BATCH];
+	nnc_sha256_hash digests[SEED_PROBE_BATCH];
+	nnc_u64 title_id_int = LE64(ncch->title_id);
+	for(u32 i = 0; i < SEED_PROBE_BATCH; ++i)
+	{
+		/* the same message as in nnc_keyy_seed */
+		memcpy(msgs[i] + NNC_SEED_SIZE, &title_id_int, sizeof(ncch->title_id));
+		bufs[i] = msgs[i];
+		sizes[i] = sizeof(msgs[i]);
+	}
+	for(u32 start = 0; start < seeddb->size; start += SEED_PROBE_BATCH)
+	{
+		u32 count = MIN(SEED_PROBE_BATCH, seeddb->size - start);
+		for(u32 i = 0; i < count; ++i)
+			memcpy(msgs[i], seeddb->entries[start + i].seed, NNC_SEED_SIZE);
+		nnc_crypto_sha256_multi(count, bufs, sizes, digests);
+		for(u32 i = 0; i < count; ++i)
+			if(memcmp(digests[i], ncch->seed_hash, 4) == 0)
+				return seeddb->entries[start + i].seed;
+	}
+	return NULL;
+}
+
+/* everything before the normal key identifies it */
+#define NORMAL_KEY_ID_SIZE offsetof(struct normal_key_slot, normal)
+
+static struct normal_key_slot *normal_key_slot_of(struct normal_key_slot *key)
+{
+	return &key_cache.normal[key_hash((u8 *) key, NORMAL_KEY_ID_SIZE, 0) & (key_cache.nbuckets - 1)];
+}
+
+/* hwkgen for the keyY of an NCCH, seeded with seed if it isn't NULL,
+ * remembers the normal key if the key cache is enabled */
+static result normal_key(nnc_ncch_header *ncch, u128 *output, u128 *kx, u8 *seed)
+{
+	struct normal_key_slot key, *slot = NULL;
+	/* the slots are compared with memcmp, so the padding has to be zero */
+	memset(&key, 0, sizeof(key));
+	key.kx = *kx;
+	key.ky = ncch->keyy;
+	key.flags = NK_VALID;
+	if(seed)
+	{
+		key.flags |= NK_SEEDED;
+		key.title_id = ncch->title_id;
+		memcpy(key.seed, seed, NNC_SEED_SIZE);
+		memcpy(key.seed_hash, ncch->seed_hash, sizeof(key.seed_hash));
+	}
+	if(nnc_tid_category(ncch->title_id) & NNC_TID_CAT_TWL)
+		key.flags |= NK_DSI;
+
+	if(key_cache.lock)
+	{
+		mutex_lock(key_cache.lock);
+		if(key_cache.enabled)
+		{
+			slot = normal_key_slot_of(&key);
+			if(memcmp(slot, &key, NORMAL_KEY_ID_SIZE) == 0)
+			{
+				++key_cache.normal_hits;
+				*output = slot->normal;
+				mutex_unlock(key_cache.lock);
+				return NNC_R_OK;
+			}
+			++key_cache.normal_misses;
+		}
+		mutex_unlock(key_cache.lock);
+	}
+
 	result ret;
+	u128 ky = ncch->keyy;
 	/* We need to decrypt the keyY first */
-	if(ncch->flags & NNC_NCCH_USES_SEED)
+	if(seed) TRY(nnc_keyy_seed(ncch, &ky, seed));
+	hwkgen(ncch, output, kx, &ky);
+
+	if(slot)
 	{
-		if(!seeddb) return NNC_R_SEED_NOT_FOUND;
-		u8 *seed;
-		if(!(seed = nnc_get_seed(seeddb, ncch->title_id)))
-			return NNC_R_SEED_NOT_FOUND;
-		TRY(nnc_keyy_seed(ncch, ky, seed));
+		mutex_lock(key_cache.lock);
+		/* the slot is gone if the cache was freed in the meantime */
+		if(key_cache.enabled)
+		{
+			slot = normal_key_slot_of(&key);
+			*slot = key;
+			slot->normal = *output;
+		}
+		mutex_unlock(key_cache.lock);
 	}
-	/* it's fine to use */
-	else *ky = ncch->keyy;
 	return NNC_R_OK;
 }
 
@@ -371,8 +753,7 @@ result nnc_key_menu_info(u128 *output, nnc_keyset *ks, nnc_ncch_header *ncch)
 	if(!(ks->flags & DEFAULT)) return NNC_R_KEY_NOT_FOUND;
 	/* "menu info" always uses keyslot 0x2C and the unencrypted
 	 * keyy even if NNC_NCCH_USES_SEED is set (!!!) */
-	hwkgen(ncch, output, &ks->kx_ncch0, &ncch->keyy);
-	return NNC_R_OK;
+	return normal_key(ncch, output, &ks->kx_ncch0, NULL);
 }
 
 result nnc_key_content(u128 *output, nnc_keyset *ks, nnc_seeddb *seeddb,
@@ -383,11 +764,18 @@ result nnc_key_content(u128 *output, nnc_keyset *ks, nnc_seeddb *seeddb,
 	if(ncch->flags & NNC_NCCH_FIXED_KEY)
 		return key_fixed(ncch, output), NNC_R_OK;
 
-	result ret; u128 ky; TRY(ky_from_ncch(&ky, ncch, seeddb));
+	u8 *seed = NULL;
+	if(ncch->flags & NNC_NCCH_USES_SEED)
+	{
+		if(!seeddb) return NNC_R_SEED_NOT_FOUND;
+		if(!(seed = nnc_get_seed(seeddb, ncch->title_id)))
+			return NNC_R_SEED_NOT_FOUND;
+	}
 
+	u128 *kx;
 	switch(ncch->crypt_method)
 	{
-#define CASE(val, key, dep) case val: if(!(ks->flags & (dep))) return NNC_R_KEY_NOT_FOUND; hwkgen(ncch, output, &ks->kx_ncch##key, &ky); break;
+#define CASE(val, key, dep) case val: if(!(ks->flags & (dep))) return NNC_R_KEY_NOT_FOUND; kx = &ks->kx_ncch##key; break;
 	CASE(0x00, 0, DEFAULT)
 	CASE(0x01, 1, DEFAULT)
 	CASE(0x0A, A, DEFAULT)
@@ -396,7 +784,7 @@ result nnc_key_content(u128 *output, nnc_keyset *ks, nnc_seeddb *seeddb,
 	default: return NNC_R_NOT_FOUND;
 	}
 
-	return NNC_R_OK;
+	return normal_key(ncch, output, kx, seed);
 }
 
 nnc_result nnc_fill_keypair(nnc_keypair *output, nnc_keyset *ks, nnc_seeddb *seeddb,
@@ -448,145 +836,195 @@ result nnc_get_ncch_iv(struct nnc_ncch_header *ncch, u8 for_section,
 	return NNC_R_OK;
 }
 
-struct generic_crypto_obj {
-	const void *funcs;
-	void *crypto_ctx;
-	void *child;
-	nnc_u8 last_unaligned_block[0x10];
-	/* crypto-method specific data */
-	nnc_u8 additional_data[];
-};
+/* nnc_aes_ctr */
 
-typedef void   (*crypto_decrypt_func)(struct generic_crypto_obj *self, u32 size, u8 *buf);
-typedef result (*crypto_redo_iv_func)(struct generic_crypto_obj *self, u32 pos);
+/* xors the keystream at ctr into buf and advances ctr, size should be a multiple of 0x10 except at the end */
+static void aes_ctr_crypt(nnc_aes_ctr *self, u8 ctr[0x10], u8 *buf, u32 size)
+{
+	struct aes_keys *keys = self->crypto_ctx;
+	if(aes128_ctr_xor(&keys->accel, ctr, buf, size))
+		return;
+	size_t of = 0;
+	u8 block[0x10];
+	mbedtls_aes_crypt_ctr(&keys->mbed, size, &of, ctr, block, buf, buf);
+}
 
-static result do_crypto_seek(struct generic_crypto_obj *self, u32 pos, crypto_redo_iv_func redo_iv)
+/* decrypts len bytes read from pos in the child, the counter is derived from pos */
+static void aes_ctr_decrypt_at(nnc_aes_ctr *self, u64 pos, u8 *buf, u32 len)
 {
-	u32 cpos = NNC_RS_PCALL0(self->child, tell);
-	nnc_result ret;
-	/* i doubt this will happen but it's here anyway
-	 * to save a bit of time. */
-	if(cpos == pos) return NNC_R_OK;
-	if(pos % 0x10 == 0)
-	{
-		TRY(redo_iv(self, pos));
-	}
-	else
+	u128 ctr_num = NNC_PROMOTE128(pos / 0x10);
+	nnc_u128_add(&ctr_num, &self->iv);
+	u8 ctr[0x10];
+	nnc_u128_bytes_be(&ctr_num, ctr);
+	if(pos % 0x10 != 0)
 	{
-		/* we need to do the slightly more complicated version */
-		u32 aligned = ALIGN_DOWN(pos, 0x10);
-		NNC_RS_PCALL(self->child, seek_abs, aligned);
-		TRY(redo_iv(self, aligned));
-		u32 totalRead;
-		ret = NNC_RS_PCALL(self, read, self->last_unaligned_block, 0x10, &totalRead);
-		if(ret != NNC_R_OK || totalRead != 0x10)
-			return NNC_R_TOO_SMALL;
+		/* decrypt the part of the first block from pos on */
+		u8 block[0x10] = { 0 };
+		u32 skip = pos % 0x10, n = MIN(0x10 - skip, len);
+		memcpy(block + skip, buf, n);
+		aes_ctr_crypt(self, ctr, block, 0x10);
+		memcpy(buf, block + skip, n);
+		buf += n;
+		len -= n;
 	}
-	return NNC_RS_PCALL(self->child, seek_abs, pos);
+	aes_ctr_crypt(self, ctr, buf, len);
+}
+
+/* positional reads of at least this size are split across threads */
+#define CTR_PARALLEL_MIN   0x800000
+/* smallest part a single thread decrypts */
+#define CTR_PARALLEL_SPLIT 0x200000
+#define CTR_MAX_THREADS    64
+
+struct ctr_part {
+	nnc_aes_ctr *self;
+	u64 pos;
+	u8 *buf;
+	u32 len, got;
+	result res;
+};
+
+static void ctr_part_read(void *arg, u32 index)
+{
+	struct ctr_part *part = (struct ctr_part *) arg + index;
+	u32 got = 0;
+	part->got = 0;
+	/* every thread does its own read of the ciphertext */
+	do {
+		part->res = NNC_RS_PCALL(part->self->child, read_at, part->pos + part->got, part->buf + part->got, part->len - part->got, &got);
+		/* got isn't set by a failed read */
+		if(part->res != NNC_R_OK) return;
+		part->got += got;
+	} while(got && part->got != part->len);
+	aes_ctr_decrypt_at(part->self, part->pos, part->buf, part->got);
+}
+
+/* AES-CBC reads are split the same way */
+static u32 aes_read_threads(u32 threads, u32 len)
+{
+	if(len < CTR_PARALLEL_MIN) return 1;
+	if(!threads) threads = cpu_count();
+	return MIN(MIN(threads, len / CTR_PARALLEL_SPLIT), CTR_MAX_THREADS);
 }
 
-static result do_crypto_read(struct generic_crypto_obj *self, u8 *buf, u32 max, u32 *totalRead, crypto_decrypt_func decrypt)
+static result aes_ctr_read_at_parallel(nnc_aes_ctr *self, u64 pos, u8 *buf, u32 max, u32 threads, u32 *totalRead)
 {
-	u32 offset = NNC_RS_PCALL0(self->child, tell);
-	u32 real_read = 0;
-	/* if the starting offset is not aligned we need to do a little more fuckery */
-	if(offset % 0x10 != 0)
+	struct ctr_part parts[CTR_MAX_THREADS];
+	u64 size = NNC_RS_PCALL0(self->child, size);
+	*totalRead = 0;
+	if(pos >= size) return NNC_R_OK;
+	max = MIN(max, size - pos);
+	/* parts start on a block boundary relative to pos */
+	u32 split = ALIGN(max / threads + 1, 0x10);
+	threads = (max + split - 1) / split;
+	for(u32 i = 0; i < threads; ++i)
 	{
-		/* TODO: This does not account for case if the last read was at the end */
-		u8 skip = offset & (0x10 - 1);
-		u8 need = 0x10 - skip;
-		/* for the exceptional case that need > max */
-		need = MIN(need, max);
-		memcpy(buf, self->last_unaligned_block + skip, need);
-		real_read += need;
-		buf += need;
-		max -= need;
-		/* seek to the next block so we don't read data twice */
-		NNC_RS_PCALL(self->child, seek_rel, need);
+		parts[i].self = self;
+		parts[i].pos = pos + (u64) i * split;
+		parts[i].buf = buf + i * split;
+		parts[i].len = MIN(split, max - i * split);
 	}
-
-	u32 aligned_max = ALIGN_DOWN(max, 0x10);
-
-	result ret;
-	bool full_read;
-	if(aligned_max)
+	parallel_run(threads, ctr_part_read, parts);
+	for(u32 i = 0; i < threads; ++i)
 	{
-		TRY(NNC_RS_PCALL(self->child, read, buf, aligned_max, totalRead));
-		full_read = *totalRead == aligned_max;
-		if(*totalRead % 0x10 != 0)
-		{
-			/* this could theorically be handled but i don't think it matters much */
-			return NNC_R_BAD_ALIGN;
-		}
-		decrypt(self, *totalRead, buf);
-		real_read += *totalRead;
-		buf += *totalRead;
-		max -= *totalRead;
-	} else full_read = true;
-
-	/* if we still need to read some unaligned data: */
-	if(full_read && max)
-	{
-		TRY(NNC_RS_PCALL(self->child, read, self->last_unaligned_block, 0x10, totalRead));
-		if(*totalRead != 0x10)
-			memset(self->last_unaligned_block + *totalRead, 0x00, 0x10 - *totalRead);
-		decrypt(self, 0x10, self->last_unaligned_block);
-		u8 applicable_read = MIN(*totalRead, max);
-		/* "unread" the extra bytes we read so we get the correct offset */
-		TRY(NNC_RS_PCALL(self->child, seek_abs, NNC_RS_PCALL0(self->child, tell) - (0x10 - applicable_read)));
-		memcpy(buf, self->last_unaligned_block, applicable_read);
-		real_read += applicable_read;
-	}
-	*totalRead = real_read;
+		if(parts[i].res != NNC_R_OK) return parts[i].res;
+		*totalRead += parts[i].got;
+		if(parts[i].got != parts[i].len) break;
+	}
 	return NNC_R_OK;
 }
 
-/* nnc_aes_ctr */
+static result aes_ctr_read_at(nnc_aes_ctr *self, u64 pos, u8 *buf, u32 max, u32 *totalRead)
+{
+	/* the threads need positional reads on the child, streams that would
+	 * seek a shared position to read at an offset don't implement read_at */
+	u32 threads = self->child->funcs->read_at ? aes_read_threads(self->threads, max) : 1;
+	if(threads > 1)
+		return aes_ctr_read_at_parallel(self, pos, buf, max, threads, totalRead);
+	result ret;
+	/* the ciphertext maps 1:1 to the plaintext, so read it in place,
+	 * the counter comes from pos so unaligned reads don't need anything else */
+	TRY(nnc_rs_read_at(self->child, pos, buf, max, totalRead));
+	aes_ctr_decrypt_at(self, pos, buf, *totalRead);
+	return NNC_R_OK;
+}
 
-static result redo_ctr_iv(nnc_aes_ctr *ac, u32 offset)
+static result aes_ctr_read(nnc_aes_ctr *self, u8 *buf, u32 max, u32 *totalRead)
 {
-	u128 ctr = NNC_PROMOTE128(offset / 0x10);
-	nnc_u128_add(&ctr, &ac->iv);
-	nnc_u128_bytes_be(&ctr, ac->ctr);
+	result ret;
+	TRY(aes_ctr_read_at(self, self->pos, buf, max, totalRead));
+	self->pos += *totalRead;
 	return NNC_R_OK;
 }
 
-static void aes_ctr_decrypt(nnc_aes_ctr *self, u32 size, u8 *buf)
+static result aes_ctr_seek_abs(nnc_aes_ctr *self, u64 pos)
 {
-	size_t of = 0;
-	u8 block[0x10];
-	mbedtls_aes_crypt_ctr(self->crypto_ctx, size, &of, self->ctr, block, buf, buf);
+	if(pos > NNC_RS_PCALL0(self->child, size)) return NNC_R_SEEK_RANGE;
+	self->pos = pos;
+	return NNC_R_OK;
 }
 
-static result aes_ctr_read(nnc_aes_ctr *self, u8 *buf, u32 max, u32 *totalRead)
+static result aes_ctr_seek_rel(nnc_aes_ctr *self, u64 pos)
 {
-	return do_crypto_read((struct generic_crypto_obj *) self, buf, max, totalRead, (crypto_decrypt_func) aes_ctr_decrypt);
+	return aes_ctr_seek_abs(self, self->pos + pos);
 }
 
-static result aes_ctr_seek_abs(nnc_aes_ctr *self, u32 pos)
+static u64 aes_ctr_size(nnc_aes_ctr *self)
 {
-	return do_crypto_seek((struct generic_crypto_obj *) self, pos, (crypto_redo_iv_func) redo_ctr_iv);
+	return NNC_RS_PCALL0(self->child, size);
 }
 
-static result aes_ctr_seek_rel(nnc_aes_ctr *self, u32 pos)
+static u64 aes_ctr_tell(nnc_aes_ctr *self)
 {
-	return aes_ctr_seek_abs(self, NNC_RS_PCALL0(self->child, tell) + pos);
+	return self->pos;
 }
 
-static u32 aes_ctr_size(nnc_aes_ctr *self)
+/* len is often UINT64_MAX for "up to the end", growing it must not wrap around */
+static u64 advise_len(u64 len, u64 extra)
 {
-	return NNC_RS_PCALL0(self->child, size);
+	return len > UINT64_MAX - extra ? UINT64_MAX : len + extra;
 }
 
-static u32 aes_ctr_tell(nnc_aes_ctr *self)
+static result aes_ctr_advise(nnc_aes_ctr *self, u64 pos, u64 len, int advice)
 {
-	return NNC_RS_PCALL0(self->child, tell);
+	/* whole blocks are read from the child */
+	return nnc_rs_advise(self->child, pos - pos % 0x10, advise_len(len, pos % 0x10), advice);
 }
 
 static void aes_ctr_close(nnc_aes_ctr *self)
 {
-	mbedtls_aes_free(self->crypto_ctx);
-	free(self->crypto_ctx);
+	key_sched_release(self->crypto_ctx);
+}
+
+/* clones share the key schedule, which is only read while decrypting,
+ * and own a clone of the child */
+struct aes_ctr_clone {
+	nnc_aes_ctr ctr;
+	nnc_rstream_funcs table;
+};
+
+static void aes_ctr_clone_close(nnc_aes_ctr *self)
+{
+	nnc_rs_close(self->child);
+	free(self->child);
+}
+
+static result aes_ctr_clone(nnc_aes_ctr *self, nnc_rstream **out)
+{
+	struct aes_ctr_clone *clone = malloc(sizeof(struct aes_ctr_clone));
+	if(!clone) return NNC_R_NOMEM;
+	nnc_rstream *child;
+	result ret = nnc_rs_clone(self->child, &child);
+	if(ret != NNC_R_OK) return free(clone), ret;
+	clone->ctr = *self;
+	clone->ctr.child = child;
+	clone->table = *(const nnc_rstream_funcs *) self->funcs;
+	clone->table.close = (nnc_close_func) aes_ctr_clone_close;
+	clone->table.read_at = child->funcs->read_at ? (nnc_read_at_func) aes_ctr_read_at : NULL;
+	clone->ctr.funcs = &clone->table;
+	clone->ctr.pos = 0;
+	*out = NNC_RSP(clone);
+	return NNC_R_OK;
 }
 
 static const nnc_rstream_funcs aes_ctr_funcs = {
@@ -596,74 +1034,449 @@ static const nnc_rstream_funcs aes_ctr_funcs = {
 	.size = (nnc_size_func) aes_ctr_size,
 	.close = (nnc_close_func) aes_ctr_close,
 	.tell = (nnc_tell_func) aes_ctr_tell,
+	.advise = (nnc_advise_func) aes_ctr_advise,
+	.clone = (nnc_clone_func) aes_ctr_clone,
+};
+
+/* used if the child supports positional reads */
+static const nnc_rstream_funcs aes_ctr_at_funcs = {
+	.read = (nnc_read_func) aes_ctr_read,
+	.seek_abs = (nnc_seek_abs_func) aes_ctr_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) aes_ctr_seek_rel,
+	.size = (nnc_size_func) aes_ctr_size,
+	.close = (nnc_close_func) aes_ctr_close,
+	.tell = (nnc_tell_func) aes_ctr_tell,
+	.read_at = (nnc_read_at_func) aes_ctr_read_at,
+	.advise = (nnc_advise_func) aes_ctr_advise,
+	.clone = (nnc_clone_func) aes_ctr_clone,
 };
 
 nnc_result nnc_aes_ctr_open(nnc_aes_ctr *self, nnc_rstream *child, u128 *key, u8 iv[0x10])
 {
-	self->funcs = &aes_ctr_funcs;
-	if(!(self->crypto_ctx = malloc(sizeof(mbedtls_aes_context))))
+	self->funcs = child->funcs->read_at ? &aes_ctr_at_funcs : &aes_ctr_funcs;
+	u8 buf[0x10];
+	nnc_u128_bytes_be(key, buf);
+	if(!(self->crypto_ctx = key_sched_get(buf, KS_CTR)))
 		return NNC_R_NOMEM;
 	self->iv = nnc_u128_import_be(iv);
 	self->child = child;
+	self->pos = 0;
+	self->threads = 0;
+	return NNC_R_OK;
+}
+
+void nnc_aes_ctr_set_threads(nnc_aes_ctr *self, u32 threads)
+{
+	self->threads = threads;
+}
 
+/* in write mode pos is the child position the stream started at and the counter
+ * comes from the current child position, so seeking needs no extra state */
+static result aes_ctr_write(nnc_aes_ctr *self, u8 *buf, u32 size)
+{
+	nnc_wstream *child = (nnc_wstream *) self->child;
+	u64 pos = NNC_WS_PCALL0(child, tell);
+	u8 block[BLOCK_SZ];
+	u32 next_write;
+	result ret;
+	if(pos < self->pos) return NNC_R_SEEK_RANGE;
+	pos -= self->pos;
+	while(size != 0)
+	{
+		next_write = MIN(BLOCK_SZ, size);
+		memcpy(block, buf, next_write);
+		aes_ctr_decrypt_at(self, pos, block, next_write);
+		TRY(NNC_WS_PCALL(child, write, block, next_write));
+		pos += next_write;
+		buf += next_write;
+		size -= next_write;
+	}
+	return NNC_R_OK;
+}
+
+static result aes_ctr_wclose(nnc_aes_ctr *self)
+{
+	aes_ctr_close(self);
+	return NNC_R_OK;
+}
+
+static result aes_ctr_wseek(nnc_aes_ctr *self, u64 pos)
+{
+	if(pos < self->pos) return NNC_R_SEEK_RANGE;
+	return NNC_WS_PCALL((nnc_wstream *) self->child, seek, pos);
+}
+
+static u64 aes_ctr_wtell(nnc_aes_ctr *self)
+{
+	return NNC_WS_PCALL0((nnc_wstream *) self->child, tell);
+}
+
+static const nnc_wstream_funcs aes_ctr_wfuncs = {
+	.write = (nnc_write_func) aes_ctr_write,
+	.close = (nnc_wclose_func) aes_ctr_wclose,
+	.tell  = (nnc_wtell_func) aes_ctr_wtell,
+};
+
+/* used if the child supports seeking */
+static const nnc_wstream_funcs aes_ctr_wfuncs_seekable = {
+	.write = (nnc_write_func) aes_ctr_write,
+	.close = (nnc_wclose_func) aes_ctr_wclose,
+	.seek  = (nnc_wseek_func) aes_ctr_wseek,
+	.tell  = (nnc_wtell_func) aes_ctr_wtell,
+};
+
+nnc_result nnc_aes_ctr_open_w(nnc_aes_ctr *self, nnc_wstream *child, u128 *key, u8 iv[0x10])
+{
+	self->funcs = child->funcs->seek ? &aes_ctr_wfuncs_seekable : &aes_ctr_wfuncs;
 	u8 buf[0x10];
 	nnc_u128_bytes_be(key, buf);
-	mbedtls_aes_setkey_enc(self->crypto_ctx, buf, 128);
+	if(!(self->crypto_ctx = key_sched_get(buf, KS_CTR)))
+		return NNC_R_NOMEM;
+	self->iv = nnc_u128_import_be(iv);
+	self->child = (nnc_rstream *) child;
+	self->pos = NNC_WS_PCALL0(child, tell);
+	self->threads = 0;
+	return NNC_R_OK;
+}
+
+void nnc_crypto_backend_info(nnc_crypto_backend *info)
+{
+	static const char *aes_names[] = { "mbedtls", "aes-ni", "armv8" };
+	static const char *sha256_names[] = { "mbedtls", "sha-ni", "armv8" };
+	static const char *sha256_multi_names[] = { "single", "sse2", "avx2", "avx512" };
+	info->aes = nnc_aes_impl();
+	info->sha256 = nnc_crypto_sha256_impl();
+	info->aes_name = aes_names[info->aes];
+	info->sha256_name = sha256_names[info->sha256];
+	info->sha256_multi = nnc_crypto_sha256_multi_impl();
+	info->sha256_multi_name = sha256_multi_names[info->sha256_multi];
+}
+
+/* nnc_decrypt_section_parallel */
 
-	redo_ctr_iv(self, 0);
+/* amount of data a worker reads at once, below CTR_PARALLEL_MIN so AES-CTR streams don't split it further */
+#define SECTION_CHUNK 0x100000
+
+enum section_slot_state {
+	SLOT_FREE,
+	SLOT_BUSY,
+	SLOT_DONE,
+};
+
+struct section_slot {
+	u8 *buf;
+	u32 len;
+	result res;
+	enum section_slot_state state;
+};
+
+struct section_job {
+	nnc_rstream *rs;
+	u64 size;
+	u64 nchunks;
+	u64 next;    /* next chunk a worker picks up */
+	u64 written; /* chunks handed to the write stream */
+	struct section_slot *slots;
+	u32 nslots;
+	nnc_mutex *lock;
+	nnc_cond *ready, *space;
+	bool quit;
+};
+
+static void section_worker(void *arg)
+{
+	struct section_job *job = arg;
+	mutex_lock(job->lock);
+	for(;;)
+	{
+		/* a chunk may only be read once its slot is written out */
+		while(!job->quit && job->next < job->nchunks && job->next >= job->written + job->nslots)
+			cond_wait(job->space, job->lock);
+		if(job->quit || job->next >= job->nchunks) break;
+		u64 chunk = job->next++;
+		struct section_slot *slot = &job->slots[chunk % job->nslots];
+		slot->state = SLOT_BUSY;
+		mutex_unlock(job->lock);
+		u64 pos = chunk * SECTION_CHUNK;
+		slot->len = MIN(SECTION_CHUNK, job->size - pos);
+		slot->res = read_at_exact(job->rs, pos, slot->buf, slot->len);
+		mutex_lock(job->lock);
+		slot->state = SLOT_DONE;
+		cond_broadcast(job->ready);
+	}
+	mutex_unlock(job->lock);
+}
+
+nnc_result nnc_decrypt_section_parallel(nnc_rstream *rs, nnc_wstream *ws, u32 threads)
+{
+	result ret = NNC_R_OK;
+	if(threads == 0) threads = cpu_count();
+	/* streams only implement read_at if it can be called from several threads */
+	if(!rs->funcs->read_at || threads < 2)
+	{
+		TRY(NNC_RS_PCALL(rs, seek_abs, 0));
+		return nnc_copy(rs, ws, NULL);
+	}
+
+	struct section_job job;
+	nnc_thread *workers[CTR_MAX_THREADS];
+	u32 nworkers = 0;
+	job.rs = rs;
+	job.size = NNC_RS_PCALL0(rs, size);
+	job.nchunks = (job.size + SECTION_CHUNK - 1) / SECTION_CHUNK;
+	if(job.nchunks == 0) return NNC_R_OK;
+	job.next = job.written = 0;
+	job.quit = false;
+	threads = MIN(MIN(threads, job.nchunks), CTR_MAX_THREADS);
+	/* two chunks per worker so writing out doesn't stall reading */
+	job.nslots = threads * 2;
+	job.lock = mutex_new();
+	job.ready = cond_new();
+	job.space = cond_new();
+	job.slots = calloc(job.nslots, sizeof(struct section_slot));
+	if(!job.lock || !job.ready || !job.space || !job.slots)
+		TRYLBL(NNC_R_NOMEM, out);
+	for(u32 i = 0; i < job.nslots; ++i)
+		if(!(job.slots[i].buf = malloc(SECTION_CHUNK)))
+			TRYLBL(NNC_R_NOMEM, out);
+	for(; nworkers < threads; ++nworkers)
+		if(!(workers[nworkers] = thread_create(section_worker, &job)))
+			break;
+	if(!nworkers) TRYLBL(NNC_R_OS, out);
+
+	mutex_lock(job.lock);
+	while(job.written < job.nchunks)
+	{
+		struct section_slot *slot = &job.slots[job.written % job.nslots];
+		while(slot->state != SLOT_DONE)
+			cond_wait(job.ready, job.lock);
+		mutex_unlock(job.lock);
+		/* chunks are written in order, the workers keep reading ahead meanwhile */
+		ret = slot->res;
+		if(ret == NNC_R_OK)
+			ret = NNC_WS_PCALL(ws, write, slot->buf, slot->len);
+		mutex_lock(job.lock);
+		if(ret != NNC_R_OK) break;
+		slot->state = SLOT_FREE;
+		++job.written;
+		cond_broadcast(job.space);
+	}
+	job.quit = true;
+	cond_broadcast(job.space);
+	mutex_unlock(job.lock);
+
+out:
+	for(u32 i = 0; i < nworkers; ++i)
+		thread_join(workers[i]);
+	if(job.slots)
+		for(u32 i = 0; i < job.nslots; ++i)
+			free(job.slots[i].buf);
+	free(job.slots);
+	cond_free(job.space);
+	cond_free(job.ready);
+	mutex_free(job.lock);
+	return ret;
+}
+
+/* reads up to len bytes at pos from the child, only stopping early at its end */
+static result read_child_at(nnc_rstream *child, u64 pos, u8 *buf, u32 len, u32 *totalRead)
+{
+	result ret;
+	u32 got;
+	*totalRead = 0;
+	do {
+		TRY(nnc_rs_read_at(child, pos + *totalRead, buf + *totalRead, len - *totalRead, &got));
+		*totalRead += got;
+	} while(got && *totalRead != len);
 	return NNC_R_OK;
 }
 
-static nnc_result redo_cbc_iv(nnc_aes_cbc *self, u32 offset)
+/* nnc_aes_cbc */
+
+/* decrypts whole blocks in place and sets iv to the last ciphertext block */
+static void aes_cbc_decrypt(void *crypto_ctx, u8 iv[0x10], u8 *buf, u32 len)
 {
-	if(offset == 0) memcpy(self->iv, self->init_iv, 0x10);
-	else
+	struct aes_keys *keys = crypto_ctx;
+	if(aes128_cbc_decrypt(&keys->accel, iv, buf, len))
+		return;
+	mbedtls_aes_crypt_cbc(&keys->mbed, MBEDTLS_AES_DECRYPT, len, iv, buf, buf);
+}
+
+/* decrypts a block that may be cut off by the end of the child */
+static result aes_cbc_read_block(nnc_aes_cbc *self, u64 pos, u8 iv[0x10], u8 block[0x10], u32 *totalRead)
+{
+	result ret;
+	TRY(read_child_at(self->child, pos, block, 0x10, totalRead));
+	if(*totalRead != 0x10) memset(block + *totalRead, 0x00, 0x10 - *totalRead);
+	aes_cbc_decrypt(self->crypto_ctx, iv, block, 0x10);
+	return NNC_R_OK;
+}
+
+/* reads and decrypts len bytes at pos, the caller makes sure they are inside the child */
+static result aes_cbc_read_part(nnc_aes_cbc *self, u64 pos, u8 *buf, u32 len, u32 *totalRead)
+{
+	u32 skip = pos % 0x10, got, n;
+	u8 iv[0x10], block[0x10];
+	result ret;
+	*totalRead = 0;
+	if(len == 0) return NNC_R_OK;
+	pos -= skip;
+	/* the IV of a block is the ciphertext before it, so any block can be decrypted on its own */
+	if(pos == 0) memcpy(iv, self->init_iv, 0x10);
+	else TRY(read_at_exact(self->child, pos - 0x10, iv, 0x10));
+	if(skip != 0)
 	{
-		result ret;
-		/* the new IV is the previous encrypted block */
-		TRY(NNC_RS_PCALL(self->child, seek_abs, offset - 16));
-		u32 read;
-		ret = NNC_RS_PCALL(self->child, read, self->iv, 16, &read);
-		if(ret != NNC_R_OK || read != 0x10)
-			return NNC_R_TOO_SMALL;
+		TRY(aes_cbc_read_block(self, pos, iv, block, &got));
+		n = MIN(0x10 - skip, len);
+		memcpy(buf, block + skip, n);
+		*totalRead += n;
+		buf += n;
+		len -= n;
+		pos += 0x10;
+	}
+	/* the whole blocks are read in place */
+	n = ALIGN_DOWN(len, 0x10);
+	if(n != 0)
+	{
+		TRY(read_child_at(self->child, pos, buf, n, &got));
+		if(got % 0x10 != 0) return NNC_R_BAD_ALIGN;
+		aes_cbc_decrypt(self->crypto_ctx, iv, buf, got);
+		*totalRead += got;
+		if(got != n) return NNC_R_OK;
+		buf += n;
+		len -= n;
+		pos += n;
+	}
+	if(len != 0)
+	{
+		TRY(aes_cbc_read_block(self, pos, iv, block, &got));
+		n = MIN(len, got);
+		memcpy(buf, block, n);
+		*totalRead += n;
 	}
 	return NNC_R_OK;
 }
 
-static void aes_cbc_decrypt(nnc_aes_cbc *self, u32 size, u8 *buf)
+struct cbc_part {
+	nnc_aes_cbc *self;
+	u64 pos;
+	u8 *buf;
+	u32 len, got;
+	result res;
+};
+
+static void cbc_part_read(void *arg, u32 index)
 {
-	mbedtls_aes_crypt_cbc(self->crypto_ctx, MBEDTLS_AES_DECRYPT, size, self->iv, buf, buf);
+	struct cbc_part *part = (struct cbc_part *) arg + index;
+	/* every thread reads its own ciphertext and the block before it */
+	part->res = aes_cbc_read_part(part->self, part->pos, part->buf, part->len, &part->got);
+}
+
+static result aes_cbc_read_at(nnc_aes_cbc *self, u64 pos, u8 *buf, u32 max, u32 *totalRead)
+{
+	struct cbc_part parts[CTR_MAX_THREADS];
+	u64 size = NNC_RS_PCALL0(self->child, size);
+	*totalRead = 0;
+	if(pos >= size) return NNC_R_OK;
+	max = MIN(max, size - pos);
+	/* the threads need positional reads on the child, see aes_ctr_read_at */
+	u32 threads = self->child->funcs->read_at ? aes_read_threads(self->threads, max) : 1;
+	if(threads == 1)
+		return aes_cbc_read_part(self, pos, buf, max, totalRead);
+	/* parts end on a block boundary so none of them decrypts a block twice */
+	u32 split = ALIGN(max / threads + 1, 0x10);
+	u64 end = pos;
+	threads = 0;
+	while(end != pos + max)
+	{
+		parts[threads].self = self;
+		parts[threads].pos = end;
+		parts[threads].buf = buf + (end - pos);
+		end = MIN(ALIGN_DOWN(end + split, (u64) 0x10), pos + max);
+		parts[threads].len = end - parts[threads].pos;
+		++threads;
+	}
+	parallel_run(threads, cbc_part_read, parts);
+	for(u32 i = 0; i < threads; ++i)
+	{
+		if(parts[i].res != NNC_R_OK) return parts[i].res;
+		*totalRead += parts[i].got;
+		if(parts[i].got != parts[i].len) break;
+	}
+	return NNC_R_OK;
 }
 
 static result aes_cbc_read(nnc_aes_cbc *self, u8 *buf, u32 max, u32 *totalRead)
 {
-	return do_crypto_read((struct generic_crypto_obj *) self, buf, max, totalRead, (crypto_decrypt_func) aes_cbc_decrypt);
+	result ret;
+	TRY(aes_cbc_read_at(self, self->pos, buf, max, totalRead));
+	self->pos += *totalRead;
+	return NNC_R_OK;
 }
 
-static result aes_cbc_seek_abs(nnc_aes_cbc *self, u32 pos)
+static result aes_cbc_seek_abs(nnc_aes_cbc *self, u64 pos)
 {
-	return do_crypto_seek((struct generic_crypto_obj *) self, pos, (crypto_redo_iv_func) redo_cbc_iv);
+	if(pos > NNC_RS_PCALL0(self->child, size)) return NNC_R_SEEK_RANGE;
+	self->pos = pos;
+	return NNC_R_OK;
 }
 
-static result aes_cbc_seek_rel(nnc_aes_cbc *self, u32 pos)
+static result aes_cbc_seek_rel(nnc_aes_cbc *self, u64 pos)
 {
-	return aes_cbc_seek_abs(self, NNC_RS_PCALL0(self->child, tell) + pos);
+	return aes_cbc_seek_abs(self, self->pos + pos);
 }
 
-static u32 aes_cbc_size(nnc_aes_cbc *self)
+static u64 aes_cbc_size(nnc_aes_cbc *self)
 {
 	return NNC_RS_PCALL0(self->child, size);
 }
 
-static u32 aes_cbc_tell(nnc_aes_cbc *self)
+static u64 aes_cbc_tell(nnc_aes_cbc *self)
+{
+	return self->pos;
+}
+
+static result aes_cbc_advise(nnc_aes_cbc *self, u64 pos, u64 len, int advice)
 {
-	return NNC_RS_PCALL0(self->child, tell);
+	/* the block before the range is needed as the IV */
+	u64 start = pos - pos % 0x10;
+	if(start != 0) start -= 0x10;
+	return nnc_rs_advise(self->child, start, advise_len(len, pos - start), advice);
 }
 
 static void aes_cbc_close(nnc_aes_cbc *self)
 {
-	mbedtls_aes_free(self->crypto_ctx);
-	free(self->crypto_ctx);
+	key_sched_release(self->crypto_ctx);
+}
+
+/* see struct aes_ctr_clone */
+struct aes_cbc_clone {
+	nnc_aes_cbc cbc;
+	nnc_rstream_funcs table;
+};
+
+static void aes_cbc_clone_close(nnc_aes_cbc *self)
+{
+	nnc_rs_close(self->child);
+	free(self->child);
+}
+
+static result aes_cbc_clone(nnc_aes_cbc *self, nnc_rstream **out)
+{
+	struct aes_cbc_clone *clone = malloc(sizeof(struct aes_cbc_clone));
+	if(!clone) return NNC_R_NOMEM;
+	nnc_rstream *child;
+	result ret = nnc_rs_clone(self->child, &child);
+	if(ret != NNC_R_OK) return free(clone), ret;
+	clone->cbc = *self;
+	clone->cbc.child = child;
+	clone->table = *(const nnc_rstream_funcs *) self->funcs;
+	clone->table.close = (nnc_close_func) aes_cbc_clone_close;
+	clone->table.read_at = child->funcs->read_at ? (nnc_read_at_func) aes_cbc_read_at : NULL;
+	clone->cbc.funcs = &clone->table;
+	clone->cbc.pos = 0;
+	*out = NNC_RSP(clone);
+	return NNC_R_OK;
 }
 
 static const nnc_rstream_funcs aes_cbc_funcs = {
@@ -673,27 +1486,46 @@ static const nnc_rstream_funcs aes_cbc_funcs = {
 	.size = (nnc_size_func) aes_cbc_size,
 	.close = (nnc_close_func) aes_cbc_close,
 	.tell = (nnc_tell_func) aes_cbc_tell,
+	.advise = (nnc_advise_func) aes_cbc_advise,
+	.clone = (nnc_clone_func) aes_cbc_clone,
+};
+
+/* used if the child supports positional reads */
+static const nnc_rstream_funcs aes_cbc_at_funcs = {
+	.read = (nnc_read_func) aes_cbc_read,
+	.seek_abs = (nnc_seek_abs_func) aes_cbc_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) aes_cbc_seek_rel,
+	.size = (nnc_size_func) aes_cbc_size,
+	.close = (nnc_close_func) aes_cbc_close,
+	.tell = (nnc_tell_func) aes_cbc_tell,
+	.read_at = (nnc_read_at_func) aes_cbc_read_at,
+	.advise = (nnc_advise_func) aes_cbc_advise,
+	.clone = (nnc_clone_func) aes_cbc_clone,
 };
 
 static result init_aes_cbc(nnc_aes_cbc *self, void *child, u8 key[0x10], u8 iv[0x10], bool set_deckey)
 {
-	if(!(self->crypto_ctx = malloc(sizeof(mbedtls_aes_context))))
+	if(!(self->crypto_ctx = key_sched_get(key, set_deckey ? KS_CBC_DEC : KS_CBC_ENC)))
 		return NNC_R_NOMEM;
 	memcpy(self->init_iv, iv, 0x10);
 	memcpy(self->iv, iv, 0x10);
 	self->child = child;
-
-	if(set_deckey) mbedtls_aes_setkey_dec(self->crypto_ctx, key, 128);
-	else           mbedtls_aes_setkey_enc(self->crypto_ctx, key, 128);
+	self->pos = 0;
+	self->threads = 0;
 	return NNC_R_OK;
 }
 
 nnc_result nnc_aes_cbc_open(nnc_aes_cbc *self, nnc_rstream *child, u8 key[0x10], u8 iv[0x10])
 {
-	self->funcs = &aes_cbc_funcs;
+	self->funcs = child->funcs->read_at ? &aes_cbc_at_funcs : &aes_cbc_funcs;
 	return init_aes_cbc(self, child, key, iv, true);
 }
 
+void nnc_aes_cbc_set_threads(nnc_aes_cbc *self, u32 threads)
+{
+	self->threads = threads;
+}
+
 static result aes_cbc_write(nnc_aes_cbc *self, u8 *buf, u32 size)
 {
 	if(size % 0x10 != 0) return NNC_R_BAD_ALIGN;
@@ -718,7 +1550,7 @@ static result aes_cbc_wclose(nnc_aes_cbc *self)
 	return NNC_R_OK;
 }
 
-static u32 aes_cbc_wtell(nnc_aes_cbc *self)
+static u64 aes_cbc_wtell(nnc_aes_cbc *self)
 {
 	return self->child->funcs->tell(self->child);
 }
@@ -735,6 +1567,223 @@ nnc_result nnc_aes_cbc_open_w(nnc_aes_cbc *self, nnc_wstream *child, u8 key[0x10
 	return init_aes_cbc(self, child, key, iv, false);
 }
 
+/* nnc_aes_ctr_hashing & nnc_aes_cbc_hashing */
+
+/* plaintext is hashed in tiles of this size right after decrypting them,
+ * so the hash reads it from the L1 cache instead of memory */
+#define FUSED_TILE  0x4000
+/* buffer size nnc_crypto_sha256_part uses for AES streams */
+#define FUSED_CHUNK 0x40000
+
+/* common part of both hashing streams */
+struct fused_hashing {
+	const void *funcs;
+	void *crypt;
+	nnc_sha256_incremental_hash hash;
+	u64 pos;
+};
+
+static result fused_seek_abs(struct fused_hashing *self, u64 pos)
+{
+	/* everything up to pos has to go through the hash */
+	if(pos < self->pos) return NNC_R_SEEK_RANGE;
+	u8 block[BLOCK_SZ];
+	result ret;
+	u32 got;
+	while(self->pos != pos)
+	{
+		TRY(NNC_RS_PCALL(self, read, block, MIN(pos - self->pos, BLOCK_SZ), &got));
+		if(got == 0) return NNC_R_SEEK_RANGE;
+	}
+	return NNC_R_OK;
+}
+
+static result fused_seek_rel(struct fused_hashing *self, u64 pos)
+{
+	return fused_seek_abs(self, self->pos + pos);
+}
+
+static u64 fused_tell(struct fused_hashing *self)
+{
+	return self->pos;
+}
+
+static void fused_close(struct fused_hashing *self)
+{
+	nnc_crypto_sha256_free(self->hash);
+}
+
+static void fused_digest(struct fused_hashing *self, nnc_sha256_hash digest)
+{
+	nnc_crypto_sha256_finish(self->hash, digest);
+	fused_close(self);
+}
+
+static result aes_ctr_hashing_read(nnc_aes_ctr_hashing *self, u8 *buf, u32 max, u32 *totalRead)
+{
+	result ret;
+	u32 n;
+	TRY(read_child_at(self->crypt->child, self->pos, buf, max, totalRead));
+	for(u32 off = 0; off < *totalRead; off += n)
+	{
+		n = MIN(FUSED_TILE, *totalRead - off);
+		aes_ctr_decrypt_at(self->crypt, self->pos + off, buf + off, n);
+		nnc_crypto_sha256_feed(self->hash, buf + off, n);
+	}
+	self->pos += *totalRead;
+	return NNC_R_OK;
+}
+
+static u64 aes_ctr_hashing_size(nnc_aes_ctr_hashing *self)
+{
+	return NNC_RS_PCALL0(self->crypt->child, size);
+}
+
+static const nnc_rstream_funcs aes_ctr_hashing_funcs = {
+	.read = (nnc_read_func) aes_ctr_hashing_read,
+	.seek_abs = (nnc_seek_abs_func) fused_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) fused_seek_rel,
+	.size = (nnc_size_func) aes_ctr_hashing_size,
+	.close = (nnc_close_func) fused_close,
+	.tell = (nnc_tell_func) fused_tell,
+};
+
+nnc_result nnc_aes_ctr_hashing_open(nnc_aes_ctr_hashing *self, nnc_aes_ctr *crypt)
+{
+	self->funcs = &aes_ctr_hashing_funcs;
+	self->crypt = crypt;
+	self->pos = 0;
+	return nnc_crypto_sha256_incremental(&self->hash);
+}
+
+void nnc_aes_ctr_hashing_digest(nnc_aes_ctr_hashing *self, nnc_sha256_hash digest)
+{
+	fused_digest((struct fused_hashing *) self, digest);
+}
+
+static void aes_cbc_hashing_decrypt(nnc_aes_cbc_hashing *self, u8 *buf, u32 len)
+{
+	aes_cbc_decrypt(self->crypt->crypto_ctx, self->iv, buf, len);
+}
+
+static result aes_cbc_hashing_read(nnc_aes_cbc_hashing *self, u8 *buf, u32 max, u32 *totalRead)
+{
+	nnc_rstream *child = self->crypt->child;
+	u64 size = NNC_RS_PCALL0(child, size);
+	result ret;
+	u32 got, n;
+	*totalRead = 0;
+	if(self->pos >= size) return NNC_R_OK;
+	max = MIN(max, size - self->pos);
+	/* the rest of the block the last read ended in */
+	if(self->pos % 0x10 != 0)
+	{
+		u32 skip = self->pos % 0x10;
+		n = MIN(0x10 - skip, max);
+		memcpy(buf, self->block + skip, n);
+		nnc_crypto_sha256_feed(self->hash, buf, n);
+		self->pos += n;
+		*totalRead += n;
+		buf += n;
+		max -= n;
+	}
+	u32 aligned = ALIGN_DOWN(max, 0x10);
+	TRY(read_child_at(child, self->pos, buf, aligned, &got));
+	if(got % 0x10 != 0) return NNC_R_BAD_ALIGN;
+	for(u32 off = 0; off < got; off += n)
+	{
+		n = MIN(FUSED_TILE, got - off);
+		aes_cbc_hashing_decrypt(self, buf + off, n);
+		nnc_crypto_sha256_feed(self->hash, buf + off, n);
+	}
+	self->pos += got;
+	*totalRead += got;
+	if(got == aligned && max != aligned)
+	{
+		/* the start of one more block, the next read returns the rest of it */
+		TRY(read_child_at(child, self->pos, self->block, 0x10, &got));
+		if(got != 0x10) memset(self->block + got, 0x00, 0x10 - got);
+		aes_cbc_hashing_decrypt(self, self->block, 0x10);
+		n = max - aligned;
+		memcpy(buf + aligned, self->block, n);
+		nnc_crypto_sha256_feed(self->hash, buf + aligned, n);
+		self->pos += n;
+		*totalRead += n;
+	}
+	return NNC_R_OK;
+}
+
+static u64 aes_cbc_hashing_size(nnc_aes_cbc_hashing *self)
+{
+	return NNC_RS_PCALL0(self->crypt->child, size);
+}
+
+static const nnc_rstream_funcs aes_cbc_hashing_funcs = {
+	.read = (nnc_read_func) aes_cbc_hashing_read,
+	.seek_abs = (nnc_seek_abs_func) fused_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) fused_seek_rel,
+	.size = (nnc_size_func) aes_cbc_hashing_size,
+	.close = (nnc_close_func) fused_close,
+	.tell = (nnc_tell_func) fused_tell,
+};
+
+nnc_result nnc_aes_cbc_hashing_open(nnc_aes_cbc_hashing *self, nnc_aes_cbc *crypt)
+{
+	self->funcs = &aes_cbc_hashing_funcs;
+	self->crypt = crypt;
+	self->pos = 0;
+	memcpy(self->iv, crypt->init_iv, 0x10);
+	return nnc_crypto_sha256_incremental(&self->hash);
+}
+
+void nnc_aes_cbc_hashing_digest(nnc_aes_cbc_hashing *self, nnc_sha256_hash digest)
+{
+	fused_digest((struct fused_hashing *) self, digest);
+}
+
+result nnc_crypto_sha256_fused(nnc_rstream *rs, nnc_sha256_hash digest, u64 size)
+{
+	union {
+		struct fused_hashing common;
+		nnc_aes_ctr_hashing ctr;
+		nnc_aes_cbc_hashing cbc;
+	} hs;
+	u64 pos = NNC_RS_PCALL0(rs, tell);
+	result ret;
+	/* clones have their own table and use the regular path */
+	if(rs->funcs == &aes_ctr_funcs || rs->funcs == &aes_ctr_at_funcs)
+	{
+		TRY(nnc_aes_ctr_hashing_open(&hs.ctr, (nnc_aes_ctr *) rs));
+	}
+	else if((rs->funcs == &aes_cbc_funcs || rs->funcs == &aes_cbc_at_funcs) && pos % 0x10 == 0)
+	{
+		TRY(nnc_aes_cbc_hashing_open(&hs.cbc, (nnc_aes_cbc *) rs));
+		/* the IV for a block is the ciphertext before it */
+		if(pos != 0)
+			TRYLBL(read_at_exact(((nnc_aes_cbc *) rs)->child, pos - 0x10, hs.cbc.iv, 0x10), out);
+	}
+	else return NNC_R_UNSUPPORTED;
+	hs.common.pos = pos;
+
+	u32 chunk = MIN(size, FUSED_CHUNK), got;
+	u8 *buf = malloc(chunk);
+	if(!buf) { ret = NNC_R_NOMEM; goto out; }
+	for(u64 left = size; left != 0; left -= got)
+	{
+		TRYLBL(NNC_RS_CALL(hs.common, read, buf, MIN(left, chunk), &got), out_buf);
+		if(got != MIN(left, chunk)) { ret = NNC_R_TOO_SMALL; goto out_buf; }
+	}
+	free(buf);
+	fused_digest(&hs.common, digest);
+	/* the hashing stream read the child directly, put the decrypting stream where it expects to be */
+	return NNC_RS_PCALL(rs, seek_abs, pos + size);
+out_buf:
+	free(buf);
+out:
+	fused_close(&hs.common);
+	return ret;
+}
+
 result nnc_decrypt_tkey(nnc_ticket *tik, nnc_keyset *ks, nnc_u8 decrypted[0x10])
 {
 	u128 *used_keyy;
@@ -763,6 +1812,7 @@ result nnc_decrypt_tkey(nnc_ticket *tik, nnc_keyset *ks, nnc_u8 decrypted[0x10])
 static nnc_seeddb nnc_empty_seeddb = {
 	.size    = 0,
 	.entries = NULL,
+	.index   = NULL,
 };
 static nnc_seeddb *nnc_default_seeddb = &nnc_empty_seeddb;
 
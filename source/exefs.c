@@ -16,9 +16,10 @@ result nnc_read_exefs_header(nnc_rstream *rs, nnc_exefs_file_header *headers, nn
 	result ret;
 	u8 i = 0;
 
-	u8 data[0x200];
-	u8 *cur = data;
-	TRY(read_at_exact(rs, 0x0, data, sizeof(data)));
+	u8 buf[0x200];
+	const u8 *data, *cur;
+	TRY(borrow_at_exact(rs, 0x0, buf, sizeof(buf), &data));
+	cur = data;
 	for(; i < NNC_EXEFS_MAX_FILES && cur[0] != '\0'; ++i, cur = &data[0x10 * i])
 	{
 		/* 0x00 */ memcpy(headers[i].name, cur, 8);
@@ -64,58 +65,114 @@ void nnc_exefs_subview(nnc_rstream *rs, nnc_subview *sv, nnc_exefs_file_header *
 	nnc_subview_open(sv, rs, NNC_EXEFS_HEADER_SIZE + header->offset, header->size);
 }
 
+/* files up to this size are loaded to hash them side by side, larger ones (usually .code) are streamed */
+#define EXEFS_MULTI_MAX 0x100000
+
 result nnc_write_exefs(nnc_vfs *vfs, nnc_wstream *ws)
 {
 	u8 header[0x200];
 	u8 *block;
-	unsigned i, namelen;
-	size_t cumulative_offset = 0, size;
+	unsigned i, namelen, count = vfs->root_directory.filecount, nbatch = 0;
+	size_t cumulative_offset = 0;
+	u64 size;
 	nnc_vfs_file_node *node;
 	nnc_vfs_stream source;
-	result ret;
-	nnc_sha256_hash hash;
-	u32 copied;
+	result ret = NNC_R_OK;
+	u8 *data[NNC_EXEFS_MAX_FILES] = { NULL };
+	u32 sizes[NNC_EXEFS_MAX_FILES] = { 0 };
+	nnc_sha256_hash hashes[NNC_EXEFS_MAX_FILES];
+	/* the files that were loaded */
+	const u8 *batch[NNC_EXEFS_MAX_FILES] = { NULL };
+	u32 batch_sizes[NNC_EXEFS_MAX_FILES] = { 0 };
+	unsigned batch_index[NNC_EXEFS_MAX_FILES];
+	nnc_sha256_hash batch_hashes[NNC_EXEFS_MAX_FILES];
 
 	if(vfs->totalfiles > NNC_EXEFS_MAX_FILES) return NNC_R_TOO_LARGE;
 	if(vfs->totaldirs != 1)                   return NNC_R_NOT_A_FILE;
 
 	memset(header, 0x00, sizeof(header));
 
-	for(i = 0; i < vfs->root_directory.filecount; ++i)
+	for(i = 0; i < count; ++i)
 	{
 		node = &vfs->root_directory.file_children[i];
 		namelen = strlen(node->vname);
-		if(namelen > 8) return NNC_R_TOO_LARGE;
+		if(namelen > 8) TRYLBL(NNC_R_TOO_LARGE, out);
 
-		/* we may as well use the stream here instead of nnc_vfs_node_size() since we need to hash as well */
-		TRY(nnc_vfs_open_node(node, &source));
+		TRYLBL(nnc_vfs_open_node(node, &source), out);
 		size = nnc_rs_size(&source);
-		ret = nnc_crypto_sha256_stream((nnc_rstream *) &source, hash);
+		if(size > 0xFFFFFFFF)
+			ret = NNC_R_TOO_LARGE;
+		else if(size > EXEFS_MULTI_MAX)
+			ret = nnc_crypto_sha256_stream((nnc_rstream *) &source, hashes[i]);
+		else if(size && !(data[i] = malloc(size)))
+			ret = NNC_R_NOMEM;
+		else if((ret = read_exact((nnc_rstream *) &source, data[i], size)) == NNC_R_OK)
+		{
+			batch[nbatch] = data[i];
+			batch_sizes[nbatch] = size;
+			batch_index[nbatch++] = i;
+		}
 		nnc_rs_close(&source);
 		if(ret != NNC_R_OK)
-			return ret;
+			goto out;
+		sizes[i] = size;
 
 		block = &header[0x10 * i];
 		/* 0x00 */ strncpy((char *) block, node->vname, 8); /* strncpy will pad the rest of the bytes with \0 */
 		/* 0x08 */ U32P(&block[0x08]) = LE32(cumulative_offset);
 		/* 0x0C */ U32P(&block[0x0C]) = LE32(size);
-		block = &header[0xC0 + sizeof(nnc_sha256_hash) * (NNC_EXEFS_MAX_FILES - i - 1)];
-		/* 0x00 */ memcpy(block, hash, sizeof(hash));
 		cumulative_offset += ALIGN(size, NNC_EXEFS_ALIGNMENT);
 	}
 
-	TRY(NNC_WS_PCALL(ws, write, header, sizeof(header)));
+	nnc_crypto_sha256_multi(nbatch, batch, batch_sizes, batch_hashes);
+	for(i = 0; i < nbatch; ++i)
+		memcpy(hashes[batch_index[i]], batch_hashes[i], sizeof(nnc_sha256_hash));
+	for(i = 0; i < count; ++i)
+		memcpy(&header[0xC0 + sizeof(nnc_sha256_hash) * (NNC_EXEFS_MAX_FILES - i - 1)], hashes[i], sizeof(nnc_sha256_hash));
+
+	TRYLBL(NNC_WS_PCALL(ws, write, header, sizeof(header)), out);
 
-	for(i = 0; i < vfs->root_directory.filecount; ++i)
+	for(i = 0; i < count; ++i)
 	{
-		TRY(nnc_vfs_open_node(&vfs->root_directory.file_children[i], &source));
-		ret = nnc_copy((nnc_rstream *) &source, ws, &copied);
-		nnc_rs_close(&source);
-		if(ret != NNC_R_OK)
-			return ret;
-		TRY(nnc_write_padding(ws, ALIGN(copied, NNC_EXEFS_ALIGNMENT) - copied));
+		if(sizes[i] > EXEFS_MULTI_MAX)
+		{
+			TRYLBL(nnc_vfs_open_node(&vfs->root_directory.file_children[i], &source), out);
+			ret = nnc_copy((nnc_rstream *) &source, ws, NULL);
+			nnc_rs_close(&source);
+			if(ret != NNC_R_OK)
+				goto out;
+		}
+		else TRYLBL(NNC_WS_PCALL(ws, write, data[i], sizes[i]), out);
+		TRYLBL(nnc_write_padding(ws, ALIGN(sizes[i], NNC_EXEFS_ALIGNMENT) - sizes[i]), out);
 	}
 
-	return NNC_R_OK;
+out:
+	for(i = 0; i < count; ++i)
+		free(data[i]);
+	return ret;
 }
 
+result nnc_plan_exefs(nnc_vfs *vfs, nnc_exefs_plan *plan)
+{
+	u64 cumulative_offset = 0, size;
+	nnc_vfs_file_node *node;
+
+	if(vfs->totalfiles > NNC_EXEFS_MAX_FILES) return NNC_R_TOO_LARGE;
+	if(vfs->totaldirs != 1)                   return NNC_R_NOT_A_FILE;
+
+	memset(plan->headers, 0x00, sizeof(plan->headers));
+
+	for(unsigned i = 0; i < vfs->root_directory.filecount; ++i)
+	{
+		node = &vfs->root_directory.file_children[i];
+		if(strlen(node->vname) > 8) return NNC_R_TOO_LARGE;
+		size = nnc_vfs_node_size(node);
+		strncpy(plan->headers[i].name, node->vname, 8);
+		plan->headers[i].offset = cumulative_offset;
+		plan->headers[i].size = size;
+		cumulative_offset += ALIGN(size, NNC_EXEFS_ALIGNMENT);
+	}
+
+	plan->size = NNC_EXEFS_HEADER_SIZE + cumulative_offset;
+	return NNC_R_OK;
+}
@@ -23,15 +23,22 @@ MKBSWAP(32)
 MKBSWAP(64)
 #endif
 
-result nnc_read_at_exact(nnc_rstream *rs, u32 offset, u8 *data, u32 dsize)
+result nnc_read_at_exact(nnc_rstream *rs, u64 offset, u8 *data, u32 dsize)
 {
 	result ret;
 	u32 size;
-	TRY(NNC_RS_PCALL(rs, seek_abs, offset));
-	TRY(NNC_RS_PCALL(rs, read, data, dsize, &size));
+	TRY(nnc_rs_read_at(rs, offset, data, dsize, &size));
 	return size == dsize ? NNC_R_OK : NNC_R_TOO_SMALL;
 }
 
+result nnc_borrow_at_exact(nnc_rstream *rs, u64 offset, u8 *buf, u32 dsize, const u8 **ptr)
+{
+	if(nnc_rs_borrow(rs, offset, dsize, ptr) == NNC_R_OK)
+		return NNC_R_OK;
+	*ptr = buf;
+	return read_at_exact(rs, offset, buf, dsize);
+}
+
 result nnc_read_exact(nnc_rstream *rs, u8 *data, u32 dsize)
 {
 	result ret;
@@ -89,9 +89,19 @@ nnc_u64 nnc_bswap64(nnc_u64 a);
 /* forward declaration from stream.h */
 struct nnc_rstream;
 #define read_at_exact nnc_read_at_exact
-result nnc_read_at_exact(struct nnc_rstream *rs, u32 offset, u8 *data, u32 dsize);
+result nnc_read_at_exact(struct nnc_rstream *rs, u64 offset, u8 *data, u32 dsize);
+#define borrow_at_exact nnc_borrow_at_exact
+/* points *ptr at the data in the stream if it can be borrowed, else reads it into buf */
+result nnc_borrow_at_exact(struct nnc_rstream *rs, u64 offset, u8 *buf, u32 dsize, const u8 **ptr);
+#define trace_rs nnc_trace_rs
+/* wraps rs in a traced stream if tracing of internal streams is enabled, see trace.c */
+struct nnc_rstream *nnc_trace_rs(struct nnc_rstream *rs, const char *name);
 #define read_exact nnc_read_exact
 result nnc_read_exact(struct nnc_rstream *rs, u8 *data, u32 dsize);
+#define crypto_sha256_fused nnc_crypto_sha256_fused
+/* nnc_crypto_sha256_part for a stream from nnc_aes_ctr_open or nnc_aes_cbc_open through the fused
+ * decrypt and hash streams, returns NNC_R_UNSUPPORTED for other streams; see crypto.c */
+result nnc_crypto_sha256_fused(struct nnc_rstream *rs, u8 digest[0x20], u64 size);
 #define dumpmem nnc_dumpmem
 /* for debugging */
 void nnc_dumpmem(void *mem, u32 len);
@@ -118,6 +128,60 @@ static inline void nnc_store_f32_le(nnc_u8 *addr, f32 val)
 	U32P(addr) = LE32(conv.uint);
 }
 
+/* threading primitives, see thread.c */
+typedef struct nnc_mutex nnc_mutex;
+#define mutex_new nnc_mutex_new
+nnc_mutex *nnc_mutex_new(void);
+#define mutex_lock nnc_mutex_lock
+void nnc_mutex_lock(nnc_mutex *mtx);
+#define mutex_unlock nnc_mutex_unlock
+void nnc_mutex_unlock(nnc_mutex *mtx);
+#define mutex_free nnc_mutex_free
+void nnc_mutex_free(nnc_mutex *mtx);
+typedef struct nnc_cond nnc_cond;
+#define cond_new nnc_cond_new
+nnc_cond *nnc_cond_new(void);
+#define cond_wait nnc_cond_wait
+void nnc_cond_wait(nnc_cond *cond, nnc_mutex *mtx);
+#define cond_signal nnc_cond_signal
+void nnc_cond_signal(nnc_cond *cond);
+#define cond_broadcast nnc_cond_broadcast
+void nnc_cond_broadcast(nnc_cond *cond);
+#define cond_free nnc_cond_free
+void nnc_cond_free(nnc_cond *cond);
+typedef struct nnc_thread nnc_thread;
+typedef void (*nnc_thread_func)(void *arg);
+#define thread_create nnc_thread_create
+nnc_thread *nnc_thread_create(nnc_thread_func func, void *arg);
+#define thread_join nnc_thread_join
+/* also frees the thread */
+void nnc_thread_join(nnc_thread *thread);
+#define cpu_count nnc_cpu_count
+/* amount of online processors, at least 1 */
+u32 nnc_cpu_count(void);
+typedef void (*nnc_parallel_func)(void *arg, u32 index);
+#define parallel_run nnc_parallel_run
+/* calls func(arg, i) for each i below count on a shared pool of threads and waits for all of them,
+ * the calling thread takes index 0 and any index no thread of the pool is free for */
+void nnc_parallel_run(u32 count, nnc_parallel_func func, void *arg);
+
+/* AES-128 encryption round keys for the accelerated kernels, see aes.c */
+typedef struct nnc_aes128_key {
+	u8 rk[11][0x10];
+} nnc_aes128_key;
+#define aes128_expand_key nnc_aes128_expand_key
+void nnc_aes128_expand_key(nnc_aes128_key *key, const u8 raw[0x10]);
+#define aes128_ctr_xor nnc_aes128_ctr_xor
+/* xors the keystream starting at the big-endian counter ctr into buf and advances ctr past
+ * the blocks used, a partial block at the end uses up a counter; returns false if no
+ * accelerated implementation is selected, the caller has to use the cryptographic library then */
+bool nnc_aes128_ctr_xor(const nnc_aes128_key *key, u8 ctr[0x10], u8 *buf, size_t len);
+#define aes128_cbc_decrypt nnc_aes128_cbc_decrypt
+/* decrypts len bytes of AES-CBC in place, len must be a multiple of 0x10 and key is the
+ * encryption schedule; iv is replaced with the last ciphertext block so the next call continues
+ * the chain, returns false if no accelerated implementation is selected like aes128_ctr_xor */
+bool nnc_aes128_cbc_decrypt(const nnc_aes128_key *key, u8 iv[0x10], u8 *buf, size_t len);
+
 struct dynbuf {
 	u8 *buffer;
 	u32 alloc, used;
@@ -46,20 +46,178 @@ nnc_result nnc_read_ivfc_header(nnc_rstream *rs, nnc_ivfc *ivfc, nnc_u32 expecte
 	return i == 0 || (expected_levels != 0 && ivfc->number_levels != expected_levels) ? NNC_R_CORRUPT : NNC_R_OK;
 }
 
-static result nnc_ivfc_finish_block(nnc_ivfc_writer *self)
+/* space reserved for the header and level 0 in front of the data */
+#define IVFC_RESERVED_SIZE(levels, block_size) ALIGN(0x14 + 0x18 * (levels), block_size)
+
+static u32 nnc_ivfc_level_sizes(u64 level_sizes[], u64 final_lv_size, u32 levels, u32 block_size)
 {
-	/* if there is no space left for another block, we need to allocate another block of hashes */
-	if(self->blocks_hashed == self->blocks_allocated)
+	level_sizes[levels - 1] = final_lv_size;
+	for(i32 i = levels - 2; i != -1; --i)
+	{
+		/* let ln = levels[i] and lm[i + 1]; ln contains lm_size/block_size hashes, so the size is (lm_size/block_size)*hash_size, the hash used is sha256 (0x20 bytes)
+		 * note that it itself is also aligned to the block size of the level above which in our implementation is just the same */
+		level_sizes[i] = (ALIGN(level_sizes[i + 1], block_size) / block_size) * sizeof(nnc_sha256_hash);
+	}
+	/* level 0 */
+	return (ALIGN(level_sizes[0], block_size) / block_size) * sizeof(nnc_sha256_hash);
+}
+
+/* data handed to a hashing worker at once */
+#define IVFC_BATCH_SIZE 0x40000
+#define IVFC_MAX_THREADS 32
+/* upper level blocks one thread hashes at least */
+#define IVFC_PARALLEL_MIN_BLOCKS 64
+
+struct ivfc_batch {
+	u8 *buf;
+	u32 len;                 /* always a multiple of the block size once submitted */
+	nnc_sha256_hash *hashes; /* where the digests go in block_hashes */
+	bool busy;               /* submitted and not hashed yet */
+};
+
+struct nnc_ivfc_hash_pool {
+	struct ivfc_batch *batches;
+	u32 nbatches, batch_size, block_size;
+	u32 submitted; /* batches handed to the workers, the writer fills batches[submitted % nbatches] */
+	u32 taken;     /* batches picked up by a worker */
+	u32 pending;   /* submitted batches not hashed yet */
+	nnc_mutex *lock;
+	nnc_cond *work, *done;
+	bool quit;
+	u32 nworkers;
+	nnc_thread *workers[IVFC_MAX_THREADS];
+};
+
+static void ivfc_hash_worker(void *arg)
+{
+	struct nnc_ivfc_hash_pool *pool = arg;
+	mutex_lock(pool->lock);
+	for(;;)
+	{
+		while(!pool->quit && pool->taken == pool->submitted)
+			cond_wait(pool->work, pool->lock);
+		/* pending batches are still hashed when quitting */
+		if(pool->taken == pool->submitted) break;
+		struct ivfc_batch *batch = &pool->batches[pool->taken++ % pool->nbatches];
+		mutex_unlock(pool->lock);
+		/* the batches are hashed out of order but each digest has its own slot */
+		nnc_crypto_sha256_blocks(batch->buf, pool->block_size, batch->len / pool->block_size, batch->hashes);
+		mutex_lock(pool->lock);
+		batch->busy = false;
+		--pool->pending;
+		cond_broadcast(pool->done);
+	}
+	mutex_unlock(pool->lock);
+}
+
+/* waits until all submitted batches are hashed */
+static void ivfc_pool_barrier(struct nnc_ivfc_hash_pool *pool)
+{
+	mutex_lock(pool->lock);
+	while(pool->pending)
+		cond_wait(pool->done, pool->lock);
+	mutex_unlock(pool->lock);
+}
+
+static void ivfc_pool_free(struct nnc_ivfc_hash_pool *pool)
+{
+	if(!pool) return;
+	if(pool->lock)
 	{
-		u64 real_old_size = self->blocks_allocated * sizeof(nnc_sha256_hash);
-		/* (block_size / sizeof(nnc_sha256_hash)) * sizeof(nnc_sha256_hash) = block_size */
-		u8 *new_hashes = realloc(self->block_hashes, real_old_size + self->block_size);
-		if(new_hashes == NULL) return NNC_R_NOMEM;
-		/* we need to clear the new area */
-		memset(new_hashes + real_old_size, 0x00, self->block_size);
-		self->block_hashes = (nnc_sha256_hash *) new_hashes;
-		self->blocks_allocated += self->block_size / sizeof(nnc_sha256_hash);
+		mutex_lock(pool->lock);
+		pool->quit = true;
+		cond_broadcast(pool->work);
+		mutex_unlock(pool->lock);
 	}
+	for(u32 i = 0; i < pool->nworkers; ++i)
+		thread_join(pool->workers[i]);
+	if(pool->batches)
+		for(u32 i = 0; i < pool->nbatches; ++i)
+			free(pool->batches[i].buf);
+	free(pool->batches);
+	cond_free(pool->done);
+	cond_free(pool->work);
+	mutex_free(pool->lock);
+	free(pool);
+}
+
+static struct nnc_ivfc_hash_pool *ivfc_pool_new(u32 threads, u32 block_size)
+{
+	struct nnc_ivfc_hash_pool *pool = calloc(1, sizeof(struct nnc_ivfc_hash_pool));
+	if(!pool) return NULL;
+	pool->block_size = block_size;
+	pool->batch_size = MAX(IVFC_BATCH_SIZE, block_size);
+	/* two batches per worker so the writer can fill one while the others are hashed */
+	pool->nbatches = threads * 2;
+	pool->lock = mutex_new();
+	pool->work = cond_new();
+	pool->done = cond_new();
+	pool->batches = calloc(pool->nbatches, sizeof(struct ivfc_batch));
+	if(!pool->lock || !pool->work || !pool->done || !pool->batches)
+		goto fail;
+	for(u32 i = 0; i < pool->nbatches; ++i)
+		if(!(pool->batches[i].buf = malloc(pool->batch_size)))
+			goto fail;
+	for(; pool->nworkers < threads; ++pool->nworkers)
+		if(!(pool->workers[pool->nworkers] = thread_create(ivfc_hash_worker, pool)))
+			break;
+	if(pool->nworkers) return pool;
+fail:
+	ivfc_pool_free(pool);
+	return NULL;
+}
+
+/* makes sure block_hashes can hold `count' hashes */
+static result nnc_ivfc_reserve_hashes(nnc_ivfc_writer *self, u32 count)
+{
+	if(count <= self->blocks_allocated)
+		return NNC_R_OK;
+	/* the workers write to block_hashes directly */
+	if(self->pool) ivfc_pool_barrier(self->pool);
+	/* (block_size / sizeof(nnc_sha256_hash)) * sizeof(nnc_sha256_hash) = block_size */
+	u32 per_block = self->block_size / sizeof(nnc_sha256_hash);
+	u32 new_count = ALIGN(MAX(count, self->blocks_allocated * 2), per_block);
+	u64 real_old_size = self->blocks_allocated * sizeof(nnc_sha256_hash);
+	u64 real_new_size = (u64) new_count * sizeof(nnc_sha256_hash);
+	u8 *new_hashes = realloc(self->block_hashes, real_new_size);
+	if(new_hashes == NULL) return NNC_R_NOMEM;
+	/* we need to clear the new area */
+	memset(new_hashes + real_old_size, 0x00, real_new_size - real_old_size);
+	self->block_hashes = (nnc_sha256_hash *) new_hashes;
+	self->blocks_allocated = new_count;
+	return NNC_R_OK;
+}
+
+/* hands the batch the writer filled to the workers */
+static result nnc_ivfc_submit_batch(nnc_ivfc_writer *self)
+{
+	struct nnc_ivfc_hash_pool *pool = self->pool;
+	struct ivfc_batch *batch = &pool->batches[pool->submitted % pool->nbatches];
+	u32 nblocks = batch->len / self->block_size;
+	result ret;
+	TRY(nnc_ivfc_reserve_hashes(self, self->blocks_hashed + nblocks));
+	batch->hashes = &self->block_hashes[self->blocks_hashed];
+	self->blocks_hashed += nblocks;
+
+	mutex_lock(pool->lock);
+	batch->busy = true;
+	++pool->pending;
+	++pool->submitted;
+	cond_signal(pool->work);
+	/* the next batch may still be hashed */
+	batch = &pool->batches[pool->submitted % pool->nbatches];
+	while(batch->busy)
+		cond_wait(pool->done, pool->lock);
+	mutex_unlock(pool->lock);
+	batch->len = 0;
+	return NNC_R_OK;
+}
+
+static result nnc_ivfc_finish_block(nnc_ivfc_writer *self)
+{
+	result ret;
+	/* if there is no space left for another block, we need to allocate another block of hashes */
+	TRY(nnc_ivfc_reserve_hashes(self, self->blocks_hashed + 1));
 
 	nnc_crypto_sha256_finish(self->current_hash, self->block_hashes[self->blocks_hashed++]);
 	/* when we've extracted the digest we need to prepare it for
@@ -75,7 +233,23 @@ static result nnc_ivfc_wwrite(nnc_ivfc_writer *self, u8 *buf, u32 size)
 	result ret;
 
 	/* TODO: Check if the new write will fit in the master hash */
-	/* TODO: Optimize this routine, most time in romfs writing is spent here */
+
+	if(self->pool)
+	{
+		/* the workers hash, we only copy the data into batches */
+		struct nnc_ivfc_hash_pool *pool = self->pool;
+		while(sizeleft)
+		{
+			struct ivfc_batch *batch = &pool->batches[pool->submitted % pool->nbatches];
+			u32 will_copy = MIN(sizeleft, pool->batch_size - batch->len);
+			memcpy(batch->buf + batch->len, buf + bufptr, will_copy);
+			batch->len += will_copy;
+			bufptr     += will_copy;
+			sizeleft   -= will_copy;
+			if(batch->len == pool->batch_size)
+				TRY(nnc_ivfc_submit_batch(self));
+		}
+	}
 
 	/* if we have some incremental buffer left */
 	if(self->current_hashed_size)
@@ -94,13 +268,11 @@ static result nnc_ivfc_wwrite(nnc_ivfc_writer *self, u8 *buf, u32 size)
 	{
 		/* we can only write chunks of self->block_size (which is power of 2 aligned) fast */
 		u32 will_hash_blocks = ALIGN_DOWN(sizeleft, self->block_size) / self->block_size;
-		for(u32 i = 0; i < will_hash_blocks; ++i)
-		{
-			nnc_crypto_sha256_feed(self->current_hash, buf + bufptr, self->block_size);
-			TRY(nnc_ivfc_finish_block(self));
-			bufptr   += self->block_size;
-			sizeleft -= self->block_size;
-		}
+		TRY(nnc_ivfc_reserve_hashes(self, self->blocks_hashed + will_hash_blocks));
+		nnc_crypto_sha256_blocks(buf + bufptr, self->block_size, will_hash_blocks, &self->block_hashes[self->blocks_hashed]);
+		self->blocks_hashed += will_hash_blocks;
+		bufptr   += will_hash_blocks * self->block_size;
+		sizeleft -= will_hash_blocks * self->block_size;
 	}
 
 	/* and the last bit we need to write to the incremental buffer hash */
@@ -120,6 +292,20 @@ static result nnc_ivfc_wwrite(nnc_ivfc_writer *self, u8 *buf, u32 size)
 	return ret;
 }
 
+struct ivfc_level_job {
+	u8 *data;
+	nnc_sha256_hash *hashes;
+	u32 nhashes, block_size, parts;
+};
+
+static void ivfc_hash_level_part(void *arg, u32 index)
+{
+	struct ivfc_level_job *job = arg;
+	u32 start = (u64) job->nhashes * index / job->parts;
+	u32 end = (u64) job->nhashes * (index + 1) / job->parts;
+	nnc_crypto_sha256_blocks(job->data + (u64) job->block_size * start, job->block_size, end - start, &job->hashes[start]);
+}
+
 static result nnc_ivfc_fill_hashbuffer(nnc_ivfc_writer *self, nnc_sha256_hash **output, u8 *data_to_hash, u64 datalen)
 {
 	/* the data must be aligned by the hash size */
@@ -130,14 +316,11 @@ static result nnc_ivfc_fill_hashbuffer(nnc_ivfc_writer *self, nnc_sha256_hash **
 	nnc_sha256_hash *hashes = malloc(my_length);
 	if(!hashes) return NNC_R_NOMEM;
 
-	/* we need to hash each block of the data */
+	/* we need to hash each block of the data, split over the threads if there are enough */
 	u32 nhashes = (ALIGN(datalen, self->block_size) / self->block_size);
-	for(u32 i = 0; i < nhashes; ++i)
-	{
-		nnc_crypto_sha256_feed(self->current_hash, data_to_hash + self->block_size * i, self->block_size);
-		nnc_crypto_sha256_finish(self->current_hash, hashes[i]);
-		nnc_crypto_sha256_reset(self->current_hash);
-	}
+	struct ivfc_level_job job = { data_to_hash, hashes, nhashes, self->block_size, 1 };
+	job.parts = MAX(MIN(self->threads, nhashes / IVFC_PARALLEL_MIN_BLOCKS), 1);
+	parallel_run(job.parts, ivfc_hash_level_part, &job);
 
 	/* the other (unused) hashes must be zero-initialized afterwards */
 	memset(&hashes[nhashes], 0x00, my_length - nhashes * sizeof(nnc_sha256_hash));
@@ -157,18 +340,19 @@ static result nnc_ivfc_wclose(nnc_ivfc_writer *self)
 	u64 pad_bytes = ALIGN(self->final_lv_size, self->block_size) - self->final_lv_size;
 	/* We may still need to finish the last hash if it wasn't complete yet, let's just do that right now quickly by padding */
 	TRYLBL(nnc_write_padding(NNC_WSP(self), pad_bytes), out);
+	if(self->pool)
+	{
+		/* the padding made the last batch a multiple of the block size */
+		if(self->pool->batches[self->pool->submitted % self->pool->nbatches].len)
+			TRYLBL(nnc_ivfc_submit_batch(self), out);
+		/* stopping the workers waits for the hashes */
+		ivfc_pool_free(self->pool);
+		self->pool = NULL;
+	}
 
 	/* now we'll calculate all sizes of each level */
 	u64 level_sizes[NNC_IVFC_MAX_LEVELS];
-
-	level_sizes[self->levels - 1] = self->final_lv_size;
-	for(i32 i = self->levels - 2; i != -1; --i)
-	{
-		/* let ln = levels[i] and lm[i + 1]; ln contains lm_size/block_size hashes, so the size is (lm_size/block_size)*hash_size, the hash used is sha256 (0x20 bytes)
-		 * note that it itself is also aligned to the block size of the level above which in our implementation is just the same */
-		level_sizes[i] = (ALIGN(level_sizes[i + 1], self->block_size) / self->block_size) * sizeof(nnc_sha256_hash);
-	}
-	u32 l0_size = (ALIGN(level_sizes[0], self->block_size) / self->block_size) * sizeof(nnc_sha256_hash);
+	u32 l0_size = nnc_ivfc_level_sizes(level_sizes, self->final_lv_size, self->levels, self->block_size);
 
 	/* we've padded enough so we can write the hashes now! */
 	/* first comes level 1, are hashes of level 2, which are hashes of level 3, which are ...
@@ -189,7 +373,7 @@ static result nnc_ivfc_wclose(nnc_ivfc_writer *self)
 		TRYLBL(NNC_WS_PCALL(self->child, write, (u8 *) hash_buffers[i], aligned_size), out);
 	}
 
-	u32 return_pos = NNC_WS_PCALL0(self->child, tell);
+	u64 return_pos = NNC_WS_PCALL0(self->child, tell);
 	/* Now we can write the header and level 0, after we seek and seek back to the end */
 	TRYLBL(NNC_WS_PCALL(self->child, seek, self->header_pos), out);
 
@@ -233,6 +417,8 @@ static result nnc_ivfc_wclose(nnc_ivfc_writer *self)
 
 out:
 	/* And finally we can free up our own resources */
+	ivfc_pool_free(self->pool);
+	self->pool = NULL;
 	nnc_crypto_sha256_free(self->current_hash);
 	free(master_hashes);
 	for(u32 i = 0; i < NNC_IVFC_MAX_LEVELS - 1; ++i)
@@ -240,7 +426,7 @@ out:
 	return ret;
 }
 
-static u32 nnc_ivfc_wtell(nnc_ivfc_writer *self)
+static u64 nnc_ivfc_wtell(nnc_ivfc_writer *self)
 {
 	return self->child->funcs->tell(self->child);
 }
@@ -260,12 +446,14 @@ nnc_result nnc_open_ivfc_writer(nnc_ivfc_writer *self, nnc_wstream *child, nnc_u
 	self->block_size    = block_size;
 	self->final_lv_size = 0;
 	self->header_pos    = child->funcs->tell(child);
+	self->threads       = 1;
+	self->pool          = NULL;
 
 	if(!child->funcs->seek || block_size == 0 || block_size & (block_size - 1) || levels > NNC_IVFC_MAX_LEVELS)
 		return NNC_R_INVAL;
 
 	/* Write IVFC header dummy + l0 which is filled on close */
-	nnc_result res = nnc_write_padding(child, ALIGN(0x14 + 0x18 * levels, block_size));
+	nnc_result res = nnc_write_padding(child, IVFC_RESERVED_SIZE(levels, block_size));
 	if(res != NNC_R_OK) return res;
 
 	self->current_hashed_size = 0;
@@ -282,11 +470,58 @@ nnc_result nnc_open_ivfc_writer(nnc_ivfc_writer *self, nnc_wstream *child, nnc_u
 		return res;
 	}
 
+	nnc_ivfc_set_threads(self, 0);
 	return NNC_R_OK;
 }
 
+void nnc_ivfc_set_threads(nnc_ivfc_writer *self, nnc_u32 threads)
+{
+	if(threads == 0) threads = cpu_count();
+	threads = MIN(threads, IVFC_MAX_THREADS);
+	ivfc_pool_free(self->pool);
+	self->pool = threads > 1 ? ivfc_pool_new(threads, self->block_size) : NULL;
+	self->threads = self->pool ? self->pool->nworkers : 1;
+}
+
 void nnc_ivfc_abort_write(nnc_ivfc_writer *self)
 {
+	ivfc_pool_free(self->pool);
+	self->pool = NULL;
 	nnc_crypto_sha256_free(self->current_hash);
 }
 
+nnc_result nnc_plan_ivfc(nnc_ivfc_plan *plan, nnc_u64 data_size, nnc_u32 levels, nnc_u32 id, nnc_u32 block_size)
+{
+	if(block_size == 0 || block_size & (block_size - 1) || levels < 2 || levels > NNC_IVFC_MAX_LEVELS)
+		return NNC_R_INVAL;
+
+	/* the writer pads the data to the block size before it hashes the last block */
+	u64 level_sizes[NNC_IVFC_MAX_LEVELS];
+	plan->header.l0_size = nnc_ivfc_level_sizes(level_sizes, ALIGN(data_size, block_size), levels, block_size);
+	plan->header.id = id;
+	plan->header.number_levels = levels;
+
+	u64 logical_offset = 0;
+	u32 block_size_log2 = nnc_log2(block_size);
+	for(u32 i = 0; i < levels; ++i)
+	{
+		plan->header.level[i].logical_offset = logical_offset;
+		plan->header.level[i].size = level_sizes[i];
+		plan->header.level[i].block_size_log2 = block_size_log2;
+		logical_offset += ALIGN(level_sizes[i], block_size);
+	}
+
+	/* the data comes right after the header, the other levels follow it in order */
+	u64 pos = IVFC_RESERVED_SIZE(levels, block_size);
+	plan->level_offset[levels - 1] = pos;
+	pos += level_sizes[levels - 1];
+	for(u32 i = 0; i < levels - 1; ++i)
+	{
+		plan->level_offset[i] = pos;
+		pos += ALIGN(level_sizes[i], block_size);
+	}
+	for(u32 i = levels; i < NNC_IVFC_MAX_LEVELS; ++i)
+		plan->level_offset[i] = 0;
+	plan->size = pos;
+	return NNC_R_OK;
+}
@@ -64,20 +64,23 @@ result nnc_read_ncch_header(rstream *rs, nnc_ncch_header *ncch)
 #define SUBVIEW_R(mode, offset, size) \
 	nnc_subview_open(&section->u. mode .sv, rs, offset, size)
 #define SUBVIEW(mode, offset, size) \
-	SUBVIEW_R(mode, NNC_MU_TO_BYTE(offset), NNC_MU_TO_BYTE(size))
+	SUBVIEW_R(mode, MU_TO_BYTE64(offset), MU_TO_BYTE64(size))
+/* media unit fields are 32-bit, but in bytes they can exceed 4 GiB */
+#define MU_TO_BYTE64(a) NNC_MU_TO_BYTE((u64) (a))
 
 result nnc_ncch_section_romfs(nnc_ncch_header *ncch, nnc_rstream *rs,
 	nnc_keypair *kp, nnc_ncch_section_stream *section)
 {
 	if(ncch->flags & NNC_NCCH_NO_ROMFS || ncch->romfs_size == 0)
 		return NNC_R_NOT_FOUND;
+	rs = trace_rs(rs, "ncch.romfs.source");
 	if(ncch->flags & NNC_NCCH_NO_CRYPTO)
 		return SUBVIEW(dec, ncch->romfs_offset, ncch->romfs_size), NNC_R_OK;
 
 	u8 iv[0x10]; result ret;
 	TRY(nnc_get_ncch_iv(ncch, NNC_SECTION_ROMFS, iv));
 	SUBVIEW(enc, ncch->romfs_offset, ncch->romfs_size);
-	return nnc_aes_ctr_open(&section->u.enc.crypt, NNC_RSP(&section->u.enc.sv),
+	return nnc_aes_ctr_open(&section->u.enc.crypt, trace_rs(NNC_RSP(&section->u.enc.sv), "ncch.romfs.subview"),
 		&kp->secondary, iv);
 }
 
@@ -146,7 +149,7 @@ static result efs_strm_read(nnc_ncch_exefs_stream *self, u8 *buf, u32 max, u32 *
 	return NNC_R_OK;
 }
 
-static result efs_strm_seek_abs(nnc_ncch_exefs_stream *self, u32 pos)
+static result efs_strm_seek_abs(nnc_ncch_exefs_stream *self, u64 pos)
 {
 	if(pos > self->size) return NNC_R_SEEK_RANGE;
 	/* find the correct bucket */
@@ -166,12 +169,12 @@ static result efs_strm_seek_abs(nnc_ncch_exefs_stream *self, u32 pos)
 	return NNC_R_SEEK_RANGE;
 }
 
-static result efs_strm_seek_rel(nnc_ncch_exefs_stream *self, u32 pos)
+static result efs_strm_seek_rel(nnc_ncch_exefs_stream *self, u64 pos)
 {
 	return efs_strm_seek_abs(self, self->pos + pos);
 }
 
-static u32 efs_strm_size(nnc_ncch_exefs_stream *self)
+static u64 efs_strm_size(nnc_ncch_exefs_stream *self)
 {
 	return self->size;
 }
@@ -182,7 +185,56 @@ static void efs_strm_close(nnc_ncch_exefs_stream *self)
 		NNC_RS_CALL0(self->substreams[i].stream, close);
 }
 
-static u32 efs_strm_tell(nnc_ncch_exefs_stream *self) { return self->pos; }
+static u64 efs_strm_tell(nnc_ncch_exefs_stream *self) { return self->pos; }
+
+static result efs_strm_advise(nnc_ncch_exefs_stream *self, u64 pos, u64 len, int advice)
+{
+	u64 end = pos + MIN(len, self->size - MIN(pos, self->size));
+	/* pass the hint to every substream that overlaps the range */
+	for(u8 i = 0; i < self->streamcount; ++i)
+	{
+		nnc_ncch_exefs_substream *sstream = &self->substreams[i];
+		u64 sstart = MAX(pos, sstream->offset), send = MIN(end, (u64) sstream->offset + sstream->size);
+		if(sstart < send)
+			nnc_rs_advise(&sstream->stream, sstart - sstream->offset, send - sstart, advice);
+	}
+	return NNC_R_OK;
+}
+
+static result efs_strm_clone(nnc_ncch_exefs_stream *self, nnc_rstream **out)
+{
+	nnc_ncch_exefs_stream *clone = malloc(sizeof(nnc_ncch_exefs_stream));
+	if(!clone) return NNC_R_NOMEM;
+	clone->funcs = self->funcs;
+	clone->streamcount = 0;
+	result ret = NNC_R_OK;
+	/* every part becomes a raw subview that owns a clone of the original part */
+	for(u8 i = 0; i < self->streamcount; ++i)
+	{
+		nnc_ncch_exefs_substream *sstream = &clone->substreams[i];
+		nnc_rstream *part;
+		if((ret = nnc_rs_clone(&self->substreams[i].stream, &part)) != NNC_R_OK)
+			break;
+		nnc_subview_open(&sstream->stream.raw, part, 0, self->substreams[i].size);
+		nnc_subview_delete_on_close(&sstream->stream.raw);
+		sstream->offset = self->substreams[i].offset;
+		sstream->size = self->substreams[i].size;
+		sstream->readoff = 0;
+		++clone->streamcount;
+	}
+	if(ret != NNC_R_OK)
+	{
+		efs_strm_close(clone);
+		free(clone);
+		return ret;
+	}
+	clone->filecount = self->filecount;
+	clone->size = self->size;
+	clone->pos = 0;
+	clone->curstream = 0;
+	*out = NNC_RSP(clone);
+	return NNC_R_OK;
+}
 
 static const nnc_rstream_funcs efs_strm_funcs = {
 	.read = (nnc_read_func) efs_strm_read,
@@ -191,6 +243,8 @@ static const nnc_rstream_funcs efs_strm_funcs = {
 	.size = (nnc_size_func) efs_strm_size,
 	.close = (nnc_close_func) efs_strm_close,
 	.tell = (nnc_tell_func) efs_strm_tell,
+	.advise = (nnc_advise_func) efs_strm_advise,
+	.clone = (nnc_clone_func) efs_strm_clone,
 };
 
 nnc_result nnc_ncch_exefs_full_stream(nnc_ncch_exefs_stream *self, nnc_ncch_header *ncch, nnc_rstream *rs, nnc_keypair *kp)
@@ -224,7 +278,7 @@ nnc_result nnc_ncch_exefs_full_stream(nnc_ncch_exefs_stream *self, nnc_ncch_head
 			self->substreams[sindex].size = nsiz;
 			self->substreams[sindex].readoff = 0;
 			/* open a substream in the raw exefs */
-			nnc_subview_open(&self->substreams[sindex].stream.raw, rs, NNC_MU_TO_BYTE(ncch->exefs_offset) + mpos, nsiz);
+			nnc_subview_open(&self->substreams[sindex].stream.raw, rs, MU_TO_BYTE64(ncch->exefs_offset) + mpos, nsiz);
 			mpos += nsiz;
 			++sindex;
 			++self->streamcount;
@@ -244,14 +298,14 @@ nnc_result nnc_ncch_exefs_full_stream(nnc_ncch_exefs_stream *self, nnc_ncch_head
 		mpos += headers[i].size;
 	}
 	/* Add the last section */
-	tpos = NNC_MU_TO_BYTE(ncch->exefs_size);
+	tpos = MU_TO_BYTE64(ncch->exefs_size);
 	if(mpos < tpos)
 	{
 		nsiz = tpos - mpos;
 		self->substreams[sindex].offset = mpos;
 		self->substreams[sindex].size = nsiz;
 		self->substreams[sindex].readoff = 0;
-		nnc_subview_open(&self->substreams[sindex].stream.raw, rs, NNC_MU_TO_BYTE(ncch->exefs_offset) + mpos, nsiz);
+		nnc_subview_open(&self->substreams[sindex].stream.raw, rs, MU_TO_BYTE64(ncch->exefs_offset) + mpos, nsiz);
 		++self->streamcount;
 		mpos += nsiz;
 	}
@@ -268,13 +322,20 @@ out:
 	return ret;
 }
 
+/* these belong to the "info menu" group and use the primary key,
+ * the rest belongs to the "content" group and uses the secondary key */
+static bool exefs_file_is_menu_info(nnc_exefs_file_header *header)
+{
+	return strcmp(header->name, "icon") == 0 || strcmp(header->name, "banner") == 0;
+}
+
 nnc_result nnc_ncch_exefs_subview(nnc_ncch_header *ncch, nnc_rstream *rs,
 	nnc_keypair *kp, nnc_ncch_section_stream *section, nnc_exefs_file_header *header)
 {
 	if(ncch->exefs_size == 0) return NNC_R_NOT_FOUND;
 	if(ncch->flags & NNC_NCCH_NO_CRYPTO)
 		return SUBVIEW_R(dec,
-			NNC_MU_TO_BYTE(ncch->exefs_offset) + NNC_EXEFS_HEADER_SIZE + header->offset,
+			MU_TO_BYTE64(ncch->exefs_offset) + NNC_EXEFS_HEADER_SIZE + header->offset,
 			header->size), NNC_R_OK;
 
 	nnc_u128 *key; u8 iv[0x10]; result ret;
@@ -286,15 +347,10 @@ nnc_result nnc_ncch_exefs_subview(nnc_ncch_header *ncch, nnc_rstream *rs,
 	nnc_u128_add(&ctr, &addition);
 	nnc_u128_bytes_be(&ctr, iv);
 
-	/* these belong to the "info menu" group */
-	if(strcmp(header->name, "icon") == 0 || strcmp(header->name, "banner") == 0)
-		key = &kp->primary;
-	/* the rest belongs to the "content" group */
-	else
-		key = &kp->secondary;
+	key = exefs_file_is_menu_info(header) ? &kp->primary : &kp->secondary;
 
 	SUBVIEW_R(enc,
-		NNC_MU_TO_BYTE(ncch->exefs_offset) + NNC_EXEFS_HEADER_SIZE + header->offset,
+		MU_TO_BYTE64(ncch->exefs_offset) + NNC_EXEFS_HEADER_SIZE + header->offset,
 		header->size);
 	return nnc_aes_ctr_open(&section->u.enc.crypt, NNC_RSP(&section->u.enc.sv), key, iv);
 }
@@ -303,8 +359,8 @@ nnc_result nnc_ncch_section_plain(nnc_ncch_header *ncch, nnc_rstream *rs,
 	nnc_subview *section)
 {
 	if(ncch->plain_size == 0) return NNC_R_NOT_FOUND;
-	nnc_subview_open(section, rs, NNC_MU_TO_BYTE(ncch->plain_offset),
-		NNC_MU_TO_BYTE(ncch->plain_size));
+	nnc_subview_open(section, rs, MU_TO_BYTE64(ncch->plain_offset),
+		MU_TO_BYTE64(ncch->plain_size));
 	return 0;
 }
 
@@ -312,8 +368,8 @@ nnc_result nnc_ncch_section_logo(nnc_ncch_header *ncch, nnc_rstream *rs,
 	nnc_subview *section)
 {
 	if(ncch->logo_size == 0) return NNC_R_NOT_FOUND;
-	nnc_subview_open(section, rs, NNC_MU_TO_BYTE(ncch->logo_offset),
-		NNC_MU_TO_BYTE(ncch->logo_size));
+	nnc_subview_open(section, rs, MU_TO_BYTE64(ncch->logo_offset),
+		MU_TO_BYTE64(ncch->logo_size));
 	return 0;
 }
 
@@ -327,6 +383,143 @@ void nnc_condense_ncch(nnc_condensed_ncch_header *cnd, nnc_ncch_header *hdr)
 	strncpy(cnd->maker_code, hdr->maker_code, sizeof(hdr->maker_code));
 }
 
+/* encrypts an ExeFS while it is written, the file ranges are only known once the
+ * header went through; padding uses the primary key like the header */
+struct efs_crypt_writer {
+	const nnc_wstream_funcs *funcs;
+	nnc_wstream *child;
+	nnc_aes_ctr primary, secondary;
+	nnc_exefs_file_header headers[NNC_EXEFS_MAX_FILES];
+	u8 header[NNC_EXEFS_HEADER_SIZE];
+	u8 filecount;
+	u64 pos;
+};
+
+/* returns where the region at pos ends and selects the key it uses */
+static u64 efs_crypt_region(struct efs_crypt_writer *self, nnc_aes_ctr **crypt)
+{
+	u64 end = UINT64_MAX, start;
+	*crypt = &self->primary;
+	if(self->pos < NNC_EXEFS_HEADER_SIZE)
+		return NNC_EXEFS_HEADER_SIZE;
+	for(u8 i = 0; i < self->filecount; ++i)
+	{
+		start = NNC_EXEFS_HEADER_SIZE + self->headers[i].offset;
+		if(self->pos < start)
+			end = MIN(end, start);
+		else if(self->pos < start + self->headers[i].size)
+		{
+			end = MIN(end, start + self->headers[i].size);
+			if(!exefs_file_is_menu_info(&self->headers[i]))
+				*crypt = &self->secondary;
+		}
+	}
+	return end;
+}
+
+static result efs_crypt_write(struct efs_crypt_writer *self, u8 *buf, u32 size)
+{
+	nnc_aes_ctr *crypt;
+	nnc_memory header;
+	result ret;
+	u32 next_write;
+	while(size != 0)
+	{
+		next_write = MIN(size, efs_crypt_region(self, &crypt) - self->pos);
+		if(self->pos < NNC_EXEFS_HEADER_SIZE)
+			memcpy(&self->header[self->pos], buf, next_write);
+		TRY(NNC_WS_PCALL(crypt, write, buf, next_write));
+		self->pos += next_write;
+		buf += next_write;
+		size -= next_write;
+		/* the header is complete, now the files are known */
+		if(self->pos == NNC_EXEFS_HEADER_SIZE && next_write != 0)
+		{
+			nnc_mem_open(&header, self->header, NNC_EXEFS_HEADER_SIZE);
+			TRY(nnc_read_exefs_header(NNC_RSP(&header), self->headers, &self->filecount));
+		}
+	}
+	return NNC_R_OK;
+}
+
+static result efs_crypt_close(struct efs_crypt_writer *self)
+{
+	NNC_WS_CALL0(self->primary, close);
+	NNC_WS_CALL0(self->secondary, close);
+	return NNC_R_OK;
+}
+
+static u64 efs_crypt_tell(struct efs_crypt_writer *self)
+{
+	return NNC_WS_PCALL0(self->child, tell);
+}
+
+static const nnc_wstream_funcs efs_crypt_funcs = {
+	.write = (nnc_write_func) efs_crypt_write,
+	.close = (nnc_wclose_func) efs_crypt_close,
+	.tell  = (nnc_wtell_func) efs_crypt_tell,
+};
+
+static result efs_crypt_open(struct efs_crypt_writer *self, nnc_ncch_header *ncch, nnc_keypair *kp, nnc_wstream *child)
+{
+	result ret;
+	u8 iv[0x10];
+	TRY(nnc_get_ncch_iv(ncch, NNC_SECTION_EXEFS, iv));
+	TRY(nnc_aes_ctr_open_w(&self->primary, child, &kp->primary, iv));
+	if((ret = nnc_aes_ctr_open_w(&self->secondary, child, &kp->secondary, iv)) != NNC_R_OK)
+	{
+		NNC_WS_CALL0(self->primary, close);
+		return ret;
+	}
+	self->funcs = &efs_crypt_funcs;
+	self->child = child;
+	self->filecount = 0;
+	self->pos = 0;
+	return NNC_R_OK;
+}
+
+/* the exheader and RomFS are encrypted with a single key */
+static result open_section_writer(nnc_ncch_header *ncch, u8 section, nnc_u128 *key,
+	nnc_aes_ctr *crypt, nnc_wstream *ws, nnc_wstream **out)
+{
+	result ret;
+	u8 iv[0x10];
+	/* unencrypted sections are written straight to ws */
+	if(!ncch) return *out = ws, NNC_R_OK;
+	TRY(nnc_get_ncch_iv(ncch, section, iv));
+	TRY(nnc_aes_ctr_open_w(crypt, ws, key, iv));
+	*out = NNC_WSP(crypt);
+	return NNC_R_OK;
+}
+
+static void close_section_writer(nnc_wstream *out, nnc_wstream *ws)
+{
+	if(out != ws) NNC_WS_PCALL0(out, close);
+}
+
+static result ncch_seed_hash(nnc_seeddb *seeddb, nnc_ncch_header *ncch)
+{
+	u8 buf[NNC_SEED_SIZE + sizeof(u64)], *seed;
+	nnc_sha256_hash hash;
+	if(!seeddb || !(seed = nnc_get_seed(seeddb, ncch->title_id)))
+		return NNC_R_SEED_NOT_FOUND;
+	memcpy(buf, seed, NNC_SEED_SIZE);
+	U64P(&buf[NNC_SEED_SIZE]) = LE64(ncch->title_id);
+	nnc_crypto_sha256(buf, hash, sizeof(buf));
+	memcpy(ncch->seed_hash, hash, sizeof(ncch->seed_hash));
+	return NNC_R_OK;
+}
+
+static result nnc_ncch_validate_wflags(u8 wflags, nnc_exheader_or_stream exheader, nnc_vfs_or_stream exefs, nnc_vfs_or_stream romfs)
+{
+#define DO_VALIDATE_FOR(ptr, opt1, opt2) if( (!ptr && (wflags & (opt1 | opt2))) || (ptr && !(wflags & (opt1 | opt2))) || (wflags & (opt1 | opt2)) == (opt1 | opt2)) return NNC_R_INVAL
+	DO_VALIDATE_FOR(exheader, NNC_NCCH_WF_EXHEADER_BUILD, NNC_NCCH_WF_EXHEADER_STREAM);
+	DO_VALIDATE_FOR(romfs, NNC_NCCH_WF_ROMFS_VFS, NNC_NCCH_WF_ROMFS_STREAM);
+	DO_VALIDATE_FOR(exefs, NNC_NCCH_WF_EXEFS_VFS, NNC_NCCH_WF_EXEFS_STREAM);
+#undef DO_VALIDATE_FOR
+	return NNC_R_OK;
+}
+
 nnc_result nnc_write_ncch(
 	nnc_condensed_ncch_header *ncch_header,
 	nnc_u8 wflags,
@@ -336,22 +529,52 @@ nnc_result nnc_write_ncch(
 	nnc_vfs_or_stream exefs,
 	nnc_vfs_or_stream romfs,
 	nnc_wstream *ws)
+{
+	return nnc_write_ncch_encrypted(ncch_header, NULL, wflags, exheader, logo, plain, exefs, romfs, ws);
+}
+
+nnc_result nnc_write_ncch_encrypted(
+	nnc_condensed_ncch_header *ncch_header,
+	nnc_ncch_encryption *crypto,
+	nnc_u8 wflags,
+	nnc_exheader_or_stream exheader,
+	nnc_rstream *logo,
+	nnc_rstream *plain,
+	nnc_vfs_or_stream exefs,
+	nnc_vfs_or_stream romfs,
+	nnc_wstream *ws)
 {
 	result ret;
-	u32 header_off, end_off, logo_off = 0, plain_off = 0, exefs_off = 0, romfs_off = 0, logo_size = 0, plain_size = 0, exefs_size = 0, romfs_size = 0;
+	u64 header_off, end_off, logo_off = 0, plain_off = 0, exefs_off = 0, romfs_off = 0, logo_size = 0, plain_size = 0, exefs_size = 0, romfs_size = 0;
 	nnc_sha256_hash exheader_hash, logo_hash, exefs_super_hash, romfs_super_hash;
 	nnc_hasher_writer hwrite;
 	nnc_header_saver hsaver;
+	nnc_ncch_header keyhdr, *crypt_hdr = NULL;
+	nnc_keypair kp;
+	nnc_aes_ctr crypt;
+	struct efs_crypt_writer efs_crypt;
+	nnc_wstream *out;
 	u8 header[0x200], exheader_in_use = 0;
 
 	if(!ws->funcs->seek)
 		return NNC_R_INVAL;
+	TRY(nnc_ncch_validate_wflags(wflags, exheader, exefs, romfs));
 
-#define DO_VALIDATE_FOR(ptr, opt1, opt2) if( (!ptr && (wflags & (opt1 | opt2))) || (ptr && !(wflags & (opt1 | opt2))) || (wflags & (opt1 | opt2)) == (opt1 | opt2)) return NNC_R_INVAL
-	DO_VALIDATE_FOR(exheader, NNC_NCCH_WF_EXHEADER_BUILD, NNC_NCCH_WF_EXHEADER_STREAM);
-	DO_VALIDATE_FOR(romfs, NNC_NCCH_WF_ROMFS_VFS, NNC_NCCH_WF_ROMFS_STREAM);
-	DO_VALIDATE_FOR(exefs, NNC_NCCH_WF_EXEFS_VFS, NNC_NCCH_WF_EXEFS_STREAM);
-#undef DO_VALIDATE_FOR
+	if(crypto)
+	{
+		/* the keys and counters only depend on these fields */
+		memset(&keyhdr, 0x00, sizeof(keyhdr));
+		keyhdr.keyy = crypto->keyy;
+		keyhdr.partition_id = ncch_header->partition_id;
+		keyhdr.title_id = ncch_header->title_id;
+		keyhdr.version = 2;
+		keyhdr.crypt_method = crypto->crypt_method;
+		keyhdr.flags = crypto->flags & (NNC_NCCH_FIXED_KEY | NNC_NCCH_USES_SEED);
+		if(keyhdr.flags & NNC_NCCH_USES_SEED)
+			TRY(ncch_seed_hash(crypto->seeddb, &keyhdr));
+		TRY(nnc_fill_keypair(&kp, crypto->ks, crypto->seeddb, &keyhdr));
+		crypt_hdr = &keyhdr;
+	}
 
 	memset(&exheader_hash, 0x00, sizeof(exheader_hash));
 	memset(&logo_hash, 0x00, sizeof(logo_hash));
@@ -371,9 +594,13 @@ nnc_result nnc_write_ncch(
 		{
 			if(NNC_RS_PCALL0((nnc_rstream *) exheader, size) != EXHEADER_FULL_SIZE)
 				return NNC_R_INVAL;
-			TRY(nnc_open_hasher_writer(&hwrite, ws, EXHEADER_NCCH_SIZE));
-			ret = nnc_copy((nnc_rstream *) exheader, NNC_WSP(&hwrite), NULL);
-			nnc_hasher_writer_digest(&hwrite, exheader_hash);
+			TRY(open_section_writer(crypt_hdr, NNC_SECTION_EXHEADER, &kp.primary, &crypt, ws, &out));
+			if((ret = nnc_open_hasher_writer(&hwrite, out, EXHEADER_NCCH_SIZE)) == NNC_R_OK)
+			{
+				ret = nnc_copy((nnc_rstream *) exheader, NNC_WSP(&hwrite), NULL);
+				nnc_hasher_writer_digest(&hwrite, exheader_hash);
+			}
+			close_section_writer(out, ws);
 			if(ret != NNC_R_OK) return ret;
 		}
 		exheader_in_use = 1;
@@ -402,55 +629,73 @@ nnc_result nnc_write_ncch(
 	if(exefs)
 	{
 		exefs_off = NNC_WS_PCALL0(ws, tell);
+		out = ws;
+		if(crypt_hdr)
+		{
+			TRY(efs_crypt_open(&efs_crypt, crypt_hdr, &kp, ws));
+			out = NNC_WSP(&efs_crypt);
+		}
 		if(wflags & NNC_NCCH_WF_EXEFS_VFS)
 		{
-			TRY(nnc_open_header_saver(&hsaver, ws, NNC_MEDIA_UNIT));
-			ret = nnc_write_exefs((nnc_vfs *) exefs, NNC_WSP(&hsaver));
-			exefs_size = NNC_WS_PCALL0(ws, tell) - exefs_off;
-			if(exefs_size >= NNC_MEDIA_UNIT)
-				nnc_crypto_sha256_buffer(hsaver.buffer, NNC_MEDIA_UNIT, exefs_super_hash);
-			NNC_WS_CALL0(hsaver, close);
-			if(ret == NNC_R_OK && exefs_size < NNC_MEDIA_UNIT)
-				ret = NNC_R_INVAL; /* shouldn't happen afaik */
-			if(ret != NNC_R_OK) return ret;
+			if((ret = nnc_open_header_saver(&hsaver, out, NNC_MEDIA_UNIT)) == NNC_R_OK)
+			{
+				ret = nnc_write_exefs((nnc_vfs *) exefs, NNC_WSP(&hsaver));
+				exefs_size = NNC_WS_PCALL0(ws, tell) - exefs_off;
+				if(exefs_size >= NNC_MEDIA_UNIT)
+					nnc_crypto_sha256_buffer(hsaver.buffer, NNC_MEDIA_UNIT, exefs_super_hash);
+				NNC_WS_CALL0(hsaver, close);
+				if(ret == NNC_R_OK && exefs_size < NNC_MEDIA_UNIT)
+					ret = NNC_R_INVAL; /* shouldn't happen afaik */
+			}
 		}
 		else
 		{
 			if((exefs_size = NNC_RS_PCALL0((nnc_rstream *) exefs, size)) < NNC_MEDIA_UNIT)
-				return NNC_R_INVAL; /* a valid ExeFS has at least NNC_MEDIA_UNIT bytes */
-			TRY(nnc_open_hasher_writer(&hwrite, ws, NNC_MEDIA_UNIT));
-			ret = nnc_copy((nnc_rstream *) exefs, NNC_WSP(&hwrite), NULL);
-			nnc_hasher_writer_digest(&hwrite, exefs_super_hash);
-			if(ret != NNC_R_OK) return ret;
+				ret = NNC_R_INVAL; /* a valid ExeFS has at least NNC_MEDIA_UNIT bytes */
+			else if((ret = nnc_open_hasher_writer(&hwrite, out, NNC_MEDIA_UNIT)) == NNC_R_OK)
+			{
+				ret = nnc_copy((nnc_rstream *) exefs, NNC_WSP(&hwrite), NULL);
+				nnc_hasher_writer_digest(&hwrite, exefs_super_hash);
+			}
 		}
-		TRY(nnc_write_padding(ws, ALIGN(exefs_size, NNC_MEDIA_UNIT) - exefs_size));
+		/* the padding is part of the section, so it is encrypted as well */
+		if(ret == NNC_R_OK)
+			ret = nnc_write_padding(out, ALIGN(exefs_size, NNC_MEDIA_UNIT) - exefs_size);
+		close_section_writer(out, ws);
+		if(ret != NNC_R_OK) return ret;
 	}
 
 	if(romfs)
 	{
 		romfs_off = NNC_WS_PCALL0(ws, tell);
+		TRY(open_section_writer(crypt_hdr, NNC_SECTION_ROMFS, &kp.secondary, &crypt, ws, &out));
 		if(wflags & NNC_NCCH_WF_ROMFS_VFS)
 		{
-			TRY(nnc_open_header_saver(&hsaver, ws, NNC_MEDIA_UNIT));
-			ret = nnc_write_romfs((nnc_vfs *) romfs, NNC_WSP(&hsaver));
-			romfs_size = NNC_WS_PCALL0(ws, tell) - romfs_off;
-			if(romfs_size >= NNC_MEDIA_UNIT)
-				nnc_crypto_sha256_buffer(hsaver.buffer, NNC_MEDIA_UNIT, romfs_super_hash);
-			NNC_WS_CALL0(hsaver, close);
-			if(ret == NNC_R_OK && romfs_size < NNC_MEDIA_UNIT)
-				ret = NNC_R_INVAL; /* shouldn't happen afaik */
-			if(ret != NNC_R_OK) return ret;
+			if((ret = nnc_open_header_saver(&hsaver, out, NNC_MEDIA_UNIT)) == NNC_R_OK)
+			{
+				ret = nnc_write_romfs((nnc_vfs *) romfs, NNC_WSP(&hsaver));
+				romfs_size = NNC_WS_PCALL0(ws, tell) - romfs_off;
+				if(romfs_size >= NNC_MEDIA_UNIT)
+					nnc_crypto_sha256_buffer(hsaver.buffer, NNC_MEDIA_UNIT, romfs_super_hash);
+				NNC_WS_CALL0(hsaver, close);
+				if(ret == NNC_R_OK && romfs_size < NNC_MEDIA_UNIT)
+					ret = NNC_R_INVAL; /* shouldn't happen afaik */
+			}
 		}
 		else
 		{
 			if((romfs_size = NNC_RS_PCALL0((nnc_rstream *) romfs, size)) < NNC_MEDIA_UNIT)
-				return NNC_R_INVAL; /* a valid RomFS has at least NNC_MEDIA_UNIT bytes */
-			TRY(nnc_open_hasher_writer(&hwrite, ws, NNC_MEDIA_UNIT));
-			ret = nnc_copy((nnc_rstream *) romfs, NNC_WSP(&hwrite), NULL);
-			nnc_hasher_writer_digest(&hwrite, romfs_super_hash);
-			if(ret != NNC_R_OK) return ret;
+				ret = NNC_R_INVAL; /* a valid RomFS has at least NNC_MEDIA_UNIT bytes */
+			else if((ret = nnc_open_hasher_writer(&hwrite, out, NNC_MEDIA_UNIT)) == NNC_R_OK)
+			{
+				ret = nnc_copy((nnc_rstream *) romfs, NNC_WSP(&hwrite), NULL);
+				nnc_hasher_writer_digest(&hwrite, romfs_super_hash);
+			}
 		}
-		TRY(nnc_write_padding(ws, ALIGN(romfs_size, NNC_MEDIA_UNIT) - romfs_size));
+		if(ret == NNC_R_OK)
+			ret = nnc_write_padding(out, ALIGN(romfs_size, NNC_MEDIA_UNIT) - romfs_size);
+		close_section_writer(out, ws);
+		if(ret != NNC_R_OK) return ret;
 		if(romfs_size == 0) romfs_off = 0;
 	}
 
@@ -474,12 +719,14 @@ nnc_result nnc_write_ncch(
 	strncpy(product_code, ncch_header->product_code, sizeof(product_code));
 
 	/* 0x000 */ memset(&header[0x000], 0x00, 0x100);
+	/* 0x000 */ if(crypt_hdr) nnc_u128_bytes_be(&crypt_hdr->keyy, &header[0x000]); /* keyY */
 	/* 0x100 */ memcpy(&header[0x100], "NCCH", 4);
 	/* 0x104 */ U32P(&header[0x104]) = LE32(romfs_off + romfs_size); /* content size */
 	/* 0x108 */ U64P(&header[0x108]) = LE64(ncch_header->partition_id);
 	/* 0x110 */ memcpy(&header[0x110], ncch_header->maker_code, 2);
 	/* 0x112 */ U16P(&header[0x112]) = LE16(2);
-	/* 0x114 */ memset(&header[0x114], 0x00, 4); /* seed hash, crypto not supported yet */
+	/* 0x114 */ memset(&header[0x114], 0x00, 4); /* seed hash */
+	/* 0x114 */ if(crypt_hdr) memcpy(&header[0x114], crypt_hdr->seed_hash, 4);
 	/* 0x118 */ U64P(&header[0x118]) = LE64(ncch_header->title_id);
 	/* 0x120 */ memset(&header[0x120], 0x00, 0x10); /* reserved */
 	/* 0x130 */ memcpy(&header[0x130], logo_hash, 0x20); /* logo region hash */
@@ -490,11 +737,11 @@ nnc_result nnc_write_ncch(
 	/* 0x188 */ header[0x188] = 0; /* ncchflags[0] */
 	/* 0x189 */ header[0x189] = 0; /* ncchflags[1] */
 	/* 0x18A */ header[0x18A] = 0; /* ncchflags[2] */
-	/* 0x18B */ header[0x18B] = NNC_CRYPT_INITIAL; /* crypto method, unsupported for now */
+	/* 0x18B */ header[0x18B] = crypt_hdr ? crypt_hdr->crypt_method : NNC_CRYPT_INITIAL; /* crypto method */
 	/* 0x18C */ header[0x18C] = ncch_header->platform;
 	/* 0x18D */ header[0x18D] = ncch_header->type;
 	/* 0x18E */ header[0x18E] = 0; /* content unit size; 0x200*2^0=0x200 (=NNC_MEDIA_UNIT) */
-	/* 0x18F */ header[0x18F] = NNC_NCCH_NO_CRYPTO; /* flags */
+	/* 0x18F */ header[0x18F] = crypt_hdr ? crypt_hdr->flags : NNC_NCCH_NO_CRYPTO; /* flags */
 	/* 0x18F */ if(!romfs_size) header[0x18F] |= NNC_NCCH_NO_ROMFS;
 	/* 0x190 */ U32P(&header[0x190]) = LE32(plain_off);
 	/* 0x194 */ U32P(&header[0x194]) = LE32(plain_size);
@@ -517,3 +764,68 @@ nnc_result nnc_write_ncch(
 	return NNC_R_OK;
 }
 
+nnc_result nnc_plan_ncch(
+	nnc_u8 wflags,
+	nnc_exheader_or_stream exheader,
+	nnc_rstream *logo,
+	nnc_rstream *plain,
+	nnc_vfs_or_stream exefs,
+	nnc_vfs_or_stream romfs,
+	nnc_ncch_plan *plan)
+{
+	result ret;
+	u64 pos = EXHEADER_OFFSET, size;
+	TRY(nnc_ncch_validate_wflags(wflags, exheader, exefs, romfs));
+	memset(plan, 0x00, sizeof(*plan));
+
+	if(exheader)
+	{
+		if(wflags & NNC_NCCH_WF_EXHEADER_BUILD)
+			return NNC_R_UNSUPPORTED;
+		if(nnc_rs_size(exheader) != EXHEADER_FULL_SIZE)
+			return NNC_R_INVAL;
+		plan->exheader.offset = pos;
+		plan->exheader.size = EXHEADER_FULL_SIZE;
+		pos += EXHEADER_FULL_SIZE;
+	}
+
+	/* like the writer, empty sections get no offset */
+#define PLAN_SECTION(sect, sz) \
+	if((plan->sect.size = (sz)) != 0) \
+	{ \
+		plan->sect.offset = pos; \
+		pos += ALIGN(plan->sect.size, NNC_MEDIA_UNIT); \
+	}
+	if(logo)  PLAN_SECTION(logo, nnc_rs_size(logo));
+	if(plain) PLAN_SECTION(plain, nnc_rs_size(plain));
+
+	if(exefs)
+	{
+		if(wflags & NNC_NCCH_WF_EXEFS_VFS)
+		{
+			TRY(nnc_plan_exefs((nnc_vfs *) exefs, &plan->exefs_layout));
+			size = plan->exefs_layout.size;
+		}
+		else size = nnc_rs_size(exefs);
+		if(size < NNC_MEDIA_UNIT)
+			return NNC_R_INVAL;
+		PLAN_SECTION(exefs, size);
+	}
+
+	if(romfs)
+	{
+		if(wflags & NNC_NCCH_WF_ROMFS_VFS)
+		{
+			TRY(nnc_plan_romfs((nnc_vfs *) romfs, &plan->romfs_layout));
+			size = plan->romfs_layout.size;
+		}
+		else size = nnc_rs_size(romfs);
+		if(size < NNC_MEDIA_UNIT)
+			return NNC_R_INVAL;
+		PLAN_SECTION(romfs, size);
+	}
+#undef PLAN_SECTION
+
+	plan->size = pos;
+	return NNC_R_OK;
+}
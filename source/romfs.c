@@ -318,11 +318,22 @@ nnc_romfs_iterator nnc_romfs_mkit(nnc_romfs_ctx *ctx, const nnc_romfs_info *dir)
 result nnc_romfs_open_subview(nnc_romfs_ctx *ctx, nnc_subview *sv, nnc_romfs_info *info)
 {
 	if(info->type != NNC_ROMFS_FILE) return NNC_R_NOT_A_FILE;
-	nnc_subview_open(sv, ctx->rs, ctx->header.data_offset + info->u.f.offset,
+	nnc_subview_open(sv, trace_rs(ctx->rs, "romfs.file.source"), ctx->header.data_offset + info->u.f.offset,
 		info->u.f.size);
+	/* files are almost always read front to back */
+	nnc_rs_advise(sv, 0, info->u.f.size, NNC_ADVISE_SEQUENTIAL);
 	return NNC_R_OK;
 }
 
+result nnc_romfs_copy_file(nnc_romfs_ctx *ctx, nnc_romfs_info *info, nnc_wstream *ws)
+{
+	nnc_subview sv;
+	result ret;
+	TRY(nnc_romfs_open_subview(ctx, &sv, info));
+	/* reads ahead asynchronously for larger files */
+	return nnc_copy(NNC_RSP(&sv), ws, NULL);
+}
+
 static result nnc_romfs_to_vfs_iterate(nnc_romfs_ctx *ctx, nnc_romfs_info *info, nnc_vfs_directory_node *dir)
 {
 	nnc_romfs_iterator it = nnc_romfs_mkit(ctx, info);
@@ -371,6 +382,25 @@ result nnc_init_romfs(nnc_rstream *rs, nnc_romfs_ctx *ctx)
 
 	TRY(nnc_cbuf_init(&ctx->cbuf, 0));
 
+	/* the tables can be used in-place if the stream is backed by memory
+	 * and the hash tables are suitably aligned */
+	const u8 *file_hash_tab, *file_meta_data, *dir_hash_tab, *dir_meta_data;
+	if(nnc_rs_borrow(rs, ctx->header.file_hash.offset, ctx->header.file_hash.length, &file_hash_tab) == NNC_R_OK
+		&& nnc_rs_borrow(rs, ctx->header.file_meta.offset, ctx->header.file_meta.length, &file_meta_data) == NNC_R_OK
+		&& nnc_rs_borrow(rs, ctx->header.dir_hash.offset, ctx->header.dir_hash.length, &dir_hash_tab) == NNC_R_OK
+		&& nnc_rs_borrow(rs, ctx->header.dir_meta.offset, ctx->header.dir_meta.length, &dir_meta_data) == NNC_R_OK
+		&& (uintptr_t) file_hash_tab % sizeof(u32) == 0 && (uintptr_t) dir_hash_tab % sizeof(u32) == 0)
+	{
+		ctx->file_hash_tab = (u32 *) file_hash_tab;
+		ctx->file_meta_data = (u8 *) file_meta_data;
+		ctx->dir_hash_tab = (u32 *) dir_hash_tab;
+		ctx->dir_meta_data = (u8 *) dir_meta_data;
+		ctx->borrowed = true;
+		ctx->rs = rs;
+		return NNC_R_OK;
+	}
+	ctx->borrowed = false;
+
 	ret = NNC_R_NOMEM;
 	if(!(ctx->file_hash_tab = malloc(ctx->header.file_hash.length)))
 		goto fail;
@@ -400,10 +430,13 @@ fail:
 
 void nnc_free_romfs(nnc_romfs_ctx *ctx)
 {
-	free(ctx->file_meta_data);
-	free(ctx->file_hash_tab);
-	free(ctx->dir_meta_data);
-	free(ctx->dir_hash_tab);
+	if(!ctx->borrowed)
+	{
+		free(ctx->file_meta_data);
+		free(ctx->file_hash_tab);
+		free(ctx->dir_meta_data);
+		free(ctx->dir_hash_tab);
+	}
 	nnc_cbuf_free(&ctx->cbuf);
 }
 
@@ -577,7 +610,7 @@ static result nnc_romfs_write_meta(struct romfs_writer_ctx *ctx, nnc_vfs_directo
 
 static result nnc_romfs_write_file_data(nnc_wstream *ws, nnc_vfs_directory_node *dir)
 {
-	u32 copied, padding;
+	u64 copied, padding;
 	nnc_vfs_stream stream;
 	result ret;
 
@@ -659,7 +692,7 @@ result nnc_write_romfs(nnc_vfs *vfs, nnc_wstream *ws)
 	TRYLBL(NNC_WS_CALL(writer, write, (u8 *) ctx.file_meta.buffer, ctx.file_meta.used), out);
 
 	/* and now the long-awaited files, which we first need to put at an aligned offset obviously */
-	u32 now_off = NNC_WS_CALL0(writer, tell);
+	u64 now_off = NNC_WS_CALL0(writer, tell);
 	TRYLBL(nnc_write_padding(NNC_WSP(&writer), ALIGN(now_off, 0x10) - now_off), out);
 	TRYLBL(nnc_romfs_write_file_data(NNC_WSP(&writer), &vfs->root_directory), out);
 
@@ -679,3 +712,55 @@ out:
 
 	return ret;
 }
+
+/* length of the metadata entry the writer creates for a name */
+static u32 nnc_romfs_plan_meta_length(const char *vname, u32 base)
+{
+	size_t len = nnc_utf8_to_utf16(NULL, 0, (const u8 *) vname, strlen(vname));
+	return base + ALIGN(len * 2, 4);
+}
+
+static void nnc_romfs_plan_directory(nnc_vfs_directory_node *dir, u32 *dir_meta_size, u32 *file_meta_size, u64 *data_size)
+{
+	/* same order as nnc_romfs_write_meta and nnc_romfs_write_file_data */
+	for(unsigned i = 0; i < dir->filecount; ++i)
+	{
+		*file_meta_size += nnc_romfs_plan_meta_length(dir->file_children[i].vname, FILE_OFF_NAME);
+		*data_size = ALIGN(*data_size + nnc_vfs_node_size(&dir->file_children[i]), 16);
+	}
+	for(unsigned i = 0; i < dir->dircount; ++i)
+	{
+		*dir_meta_size += nnc_romfs_plan_meta_length(dir->directory_children[i].vname, DIR_OFF_NAME);
+		nnc_romfs_plan_directory(&dir->directory_children[i], dir_meta_size, file_meta_size, data_size);
+	}
+}
+
+result nnc_plan_romfs(nnc_vfs *vfs, nnc_romfs_plan *plan)
+{
+	u32 dir_hashtab_size = nnc_romfs_table_length(vfs->totaldirs) * sizeof(u32);
+	u32 file_hashtab_size = nnc_romfs_table_length(vfs->totalfiles) * sizeof(u32);
+	/* the root directory has an empty name */
+	u32 dir_meta_size = DIR_OFF_NAME, file_meta_size = 0;
+	u64 data_size = 0;
+	nnc_romfs_plan_directory(&vfs->root_directory, &dir_meta_size, &file_meta_size, &data_size);
+
+	u64 tables_end = 0x28 + dir_hashtab_size + dir_meta_size + file_hashtab_size + file_meta_size;
+	u64 l3_size = ALIGN(tables_end, 0x10) + data_size;
+
+	result ret;
+	TRY(nnc_plan_ivfc(&plan->ivfc, l3_size, NNC_IVFC_LEVELS_ROMFS, NNC_IVFC_ID_ROMFS, NNC_IVFC_BLOCKSIZE_ROMFS));
+
+	u64 l3_offset = plan->ivfc.level_offset[NNC_IVFC_LEVELS_ROMFS - 1];
+	plan->header.dir_hash.offset  = l3_offset + 0x28;
+	plan->header.dir_hash.length  = dir_hashtab_size;
+	plan->header.dir_meta.offset  = plan->header.dir_hash.offset + dir_hashtab_size;
+	plan->header.dir_meta.length  = dir_meta_size;
+	plan->header.file_hash.offset = plan->header.dir_meta.offset + dir_meta_size;
+	plan->header.file_hash.length = file_hashtab_size;
+	plan->header.file_meta.offset = plan->header.file_hash.offset + file_hashtab_size;
+	plan->header.file_meta.length = file_meta_size;
+	plan->header.data_offset      = l3_offset + ALIGN(tables_end, 0x10);
+	plan->data_size = data_size;
+	plan->size = plan->ivfc.size;
+	return NNC_R_OK;
+}
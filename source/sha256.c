@@ -0,0 +1,527 @@
+/* SHA-256 with hardware acceleration, this implements all of the
+ *  nnc_crypto_sha256_* functions. The SHA-NI and ARMv8 kernels only do the
+ *  compression function, the buffering and padding are done here. Without
+ *  either of them the hashing is done by the cryptographic library */
+
+#include <mbedtls/version.h>
+#include <mbedtls/sha256.h>
+#include <nnc/crypto.h>
+#include <stdlib.h>
+#include <string.h>
+#include "./internal.h"
+
+/* see crypto.c */
+#if MBEDTLS_VERSION_MAJOR == 2
+	#define mbedtls_sha256_starts mbedtls_sha256_starts_ret
+	#define mbedtls_sha256_update mbedtls_sha256_update_ret
+	#define mbedtls_sha256_finish mbedtls_sha256_finish_ret
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#define SHA_HAVE_SHANI 1
+	#include <immintrin.h>
+	#include <cpuid.h>
+	#define SHANI_TARGET __attribute__((target("sha,sse4.1")))
+#endif
+
+/* like in aes.c the ARMv8 kernel is only built if the compiler may assume the extension */
+#if defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+	#define SHA_HAVE_ARMV8 1
+	#include <arm_neon.h>
+#endif
+
+#if SHA_HAVE_SHANI || SHA_HAVE_ARMV8
+static const u32 sha256_k[64] = {
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+#endif
+
+#if SHA_HAVE_SHANI
+
+static SHANI_TARGET void shani_compress(u32 state[8], const u8 *data, size_t blocks)
+{
+	const __m128i bswap_mask = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+	__m128i abef, cdgh, tmp, msg, w[4];
+
+	/* the instructions want the state as ABEF and CDGH */
+	tmp  = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[0]), 0xB1);
+	cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) &state[4]), 0x1B);
+	abef = _mm_alignr_epi8(tmp, cdgh, 8);
+	cdgh = _mm_blend_epi16(cdgh, tmp, 0xF0);
+
+	for(; blocks; --blocks, data += 0x40)
+	{
+		__m128i abef_save = abef, cdgh_save = cdgh;
+		for(int j = 0; j < 16; ++j)
+		{
+			/* w[j % 4] holds message words 4j up to 4j+3 */
+			if(j < 4)
+				w[j] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (data + j * 0x10)), bswap_mask);
+			else
+			{
+				tmp = _mm_add_epi32(_mm_sha256msg1_epu32(w[j % 4], w[(j - 3) % 4]), _mm_alignr_epi8(w[(j - 1) % 4], w[(j - 2) % 4], 4));
+				w[j % 4] = _mm_sha256msg2_epu32(tmp, w[(j - 1) % 4]);
+			}
+			msg  = _mm_add_epi32(w[j % 4], _mm_loadu_si128((const __m128i *) &sha256_k[j * 4]));
+			cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+			abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0E));
+		}
+		abef = _mm_add_epi32(abef, abef_save);
+		cdgh = _mm_add_epi32(cdgh, cdgh_save);
+	}
+
+	tmp  = _mm_shuffle_epi32(abef, 0x1B);
+	cdgh = _mm_shuffle_epi32(cdgh, 0xB1);
+	_mm_storeu_si128((__m128i *) &state[0], _mm_blend_epi16(tmp, cdgh, 0xF0));
+	_mm_storeu_si128((__m128i *) &state[4], _mm_alignr_epi8(cdgh, tmp, 8));
+}
+
+static bool shani_supported(void)
+{
+	unsigned a, b, c, d;
+	/* SHA is reported in leaf 7, the shuffles we need are SSSE3 and SSE4.1 */
+	if(!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSSE3) || !(c & bit_SSE4_1))
+		return false;
+	if(__get_cpuid_max(0, NULL) < 7)
+		return false;
+	__cpuid_count(7, 0, a, b, c, d);
+	return (b >> 29) & 1;
+}
+
+#endif
+
+#if SHA_HAVE_ARMV8
+
+static void armv8_compress(u32 state[8], const u8 *data, size_t blocks)
+{
+	uint32x4_t abcd = vld1q_u32(&state[0]), efgh = vld1q_u32(&state[4]);
+	uint32x4_t w[4], wk, prev;
+
+	for(; blocks; --blocks, data += 0x40)
+	{
+		uint32x4_t abcd_save = abcd, efgh_save = efgh;
+		for(int j = 0; j < 16; ++j)
+		{
+			if(j < 4)
+				w[j] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + j * 0x10)));
+			else
+				w[j % 4] = vsha256su1q_u32(vsha256su0q_u32(w[j % 4], w[(j - 3) % 4]), w[(j - 2) % 4], w[(j - 1) % 4]);
+			wk   = vaddq_u32(w[j % 4], vld1q_u32(&sha256_k[j * 4]));
+			prev = abcd;
+			abcd = vsha256hq_u32(abcd, efgh, wk);
+			efgh = vsha256h2q_u32(efgh, prev, wk);
+		}
+		abcd = vaddq_u32(abcd, abcd_save);
+		efgh = vaddq_u32(efgh, efgh_save);
+	}
+
+	vst1q_u32(&state[0], abcd);
+	vst1q_u32(&state[4], efgh);
+}
+
+#endif
+
+typedef void (*sha256_compress_func)(u32 state[8], const u8 *data, size_t blocks);
+
+struct sha256_ctx {
+	sha256_compress_func compress; /* NULL if the cryptographic library is used */
+	union {
+		mbedtls_sha256_context mbed;
+		struct {
+			u32 state[8];
+			u64 total;
+			u32 buflen;
+			u8 buf[0x40];
+		} hw;
+	} u;
+};
+
+static bool sha256_impl_available(enum nnc_sha256_impl impl)
+{
+	switch(impl)
+	{
+	case NNC_SHA256_IMPL_GENERIC:
+		return true;
+#if SHA_HAVE_SHANI
+	case NNC_SHA256_IMPL_SHANI:
+		return shani_supported();
+#endif
+#if SHA_HAVE_ARMV8
+	case NNC_SHA256_IMPL_ARMV8:
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+/* -1 until the first use, racing threads all store the same value */
+static volatile int sha256_impl = -1;
+
+enum nnc_sha256_impl nnc_crypto_sha256_impl(void)
+{
+	if(sha256_impl == -1)
+	{
+		if(sha256_impl_available(NNC_SHA256_IMPL_SHANI))      sha256_impl = NNC_SHA256_IMPL_SHANI;
+		else if(sha256_impl_available(NNC_SHA256_IMPL_ARMV8)) sha256_impl = NNC_SHA256_IMPL_ARMV8;
+		else                                                  sha256_impl = NNC_SHA256_IMPL_GENERIC;
+	}
+	return (enum nnc_sha256_impl) sha256_impl;
+}
+
+nnc_result nnc_crypto_sha256_set_impl(enum nnc_sha256_impl impl)
+{
+	if(!sha256_impl_available(impl))
+		return NNC_R_UNSUPPORTED;
+	sha256_impl = impl;
+	return NNC_R_OK;
+}
+
+static const u32 sha256_initial_state[8] = {
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+static void sha256_init(struct sha256_ctx *ctx)
+{
+	switch(nnc_crypto_sha256_impl())
+	{
+#if SHA_HAVE_SHANI
+	case NNC_SHA256_IMPL_SHANI:
+		ctx->compress = shani_compress;
+		break;
+#endif
+#if SHA_HAVE_ARMV8
+	case NNC_SHA256_IMPL_ARMV8:
+		ctx->compress = armv8_compress;
+		break;
+#endif
+	default:
+		ctx->compress = NULL;
+		mbedtls_sha256_init(&ctx->u.mbed);
+		mbedtls_sha256_starts(&ctx->u.mbed, 0);
+		return;
+	}
+	memcpy(ctx->u.hw.state, sha256_initial_state, sizeof(sha256_initial_state));
+	ctx->u.hw.total = 0;
+	ctx->u.hw.buflen = 0;
+}
+
+static void sha256_update(struct sha256_ctx *ctx, const u8 *data, size_t len)
+{
+	if(!ctx->compress)
+	{
+		mbedtls_sha256_update(&ctx->u.mbed, data, len);
+		return;
+	}
+	ctx->u.hw.total += len;
+	if(ctx->u.hw.buflen)
+	{
+		size_t n = MIN(0x40 - ctx->u.hw.buflen, len);
+		memcpy(ctx->u.hw.buf + ctx->u.hw.buflen, data, n);
+		ctx->u.hw.buflen += n;
+		data += n;
+		len -= n;
+		if(ctx->u.hw.buflen != 0x40) return;
+		ctx->compress(ctx->u.hw.state, ctx->u.hw.buf, 1);
+		ctx->u.hw.buflen = 0;
+	}
+	if(len >= 0x40)
+	{
+		ctx->compress(ctx->u.hw.state, data, len / 0x40);
+		data += ALIGN_DOWN(len, 0x40);
+		len %= 0x40;
+	}
+	memcpy(ctx->u.hw.buf, data, len);
+	ctx->u.hw.buflen = len;
+}
+
+static void sha256_finish(struct sha256_ctx *ctx, nnc_sha256_hash digest)
+{
+	if(!ctx->compress)
+	{
+		mbedtls_sha256_finish(&ctx->u.mbed, digest);
+		mbedtls_sha256_free(&ctx->u.mbed);
+		return;
+	}
+	u8 *buf = ctx->u.hw.buf;
+	u32 len = ctx->u.hw.buflen;
+	buf[len++] = 0x80;
+	if(len > 0x38)
+	{
+		memset(buf + len, 0x00, 0x40 - len);
+		ctx->compress(ctx->u.hw.state, buf, 1);
+		len = 0;
+	}
+	memset(buf + len, 0x00, 0x38 - len);
+	U64P(&buf[0x38]) = BE64(ctx->u.hw.total * 8);
+	ctx->compress(ctx->u.hw.state, buf, 1);
+	for(int i = 0; i < 8; ++i)
+		U32P(&digest[i * 4]) = BE32(ctx->u.hw.state[i]);
+}
+
+static void sha256_free(struct sha256_ctx *ctx)
+{
+	if(!ctx->compress)
+		mbedtls_sha256_free(&ctx->u.mbed);
+}
+
+nnc_result nnc_crypto_sha256_incremental(nnc_sha256_incremental_hash *self)
+{
+	struct sha256_ctx *ctx = malloc(sizeof(struct sha256_ctx));
+	if(!(*self = ctx)) return NNC_R_NOMEM;
+	sha256_init(ctx);
+	return NNC_R_OK;
+}
+
+void nnc_crypto_sha256_feed(nnc_sha256_incremental_hash self, u8 *data, u32 length)
+{
+	sha256_update(self, data, length);
+}
+
+void nnc_crypto_sha256_finish(nnc_sha256_incremental_hash self, nnc_sha256_hash digest)
+{
+	sha256_finish(self, digest);
+}
+
+void nnc_crypto_sha256_reset(nnc_sha256_incremental_hash self)
+{
+	sha256_init(self);
+}
+
+void nnc_crypto_sha256_free(nnc_sha256_incremental_hash self)
+{
+	free(self);
+}
+
+result nnc_crypto_sha256_part(nnc_rstream *rs, nnc_sha256_hash digest, u64 size)
+{
+	struct sha256_ctx ctx;
+	sha256_init(&ctx);
+	u8 block[BLOCK_SZ];
+	u64 read_left = size;
+	u32 next_read = MIN(size, BLOCK_SZ), read_ret;
+	result ret;
+	u64 pos = nnc_rs_tell(rs);
+	const u8 *data;
+	/* decrypt and hash in one pass for AES streams */
+	if((ret = crypto_sha256_fused(rs, digest, size)) != NNC_R_UNSUPPORTED)
+		goto out;
+	/* hash straight out of memory if possible */
+	if(nnc_rs_borrow(rs, pos, size, &data) == NNC_R_OK)
+	{
+		if((ret = nnc_rs_seek_abs(rs, pos + size)) != NNC_R_OK) goto out;
+		sha256_update(&ctx, data, size);
+		read_left = 0;
+	}
+	while(read_left != 0)
+	{
+		ret = NNC_RS_PCALL(rs, read, block, next_read, &read_ret);
+		if(ret != NNC_R_OK) goto out;
+		if(read_ret != next_read) { ret = NNC_R_TOO_SMALL; goto out; }
+		sha256_update(&ctx, block, read_ret);
+		read_left -= next_read;
+		next_read = MIN(read_left, BLOCK_SZ);
+	}
+	sha256_finish(&ctx, digest);
+	return NNC_R_OK;
+out:
+	sha256_free(&ctx);
+	return ret;
+}
+
+result nnc_crypto_sha256(const u8 *buf, nnc_sha256_hash digest, u32 size)
+{
+	struct sha256_ctx ctx;
+	sha256_init(&ctx);
+	sha256_update(&ctx, buf, size);
+	sha256_finish(&ctx, digest);
+	return NNC_R_OK;
+}
+
+/* multi-buffer hashing: the same round of up to 16 messages at once, one per vector lane */
+
+#define SHA256_MAX_LANES 16
+
+/* compresses one block of each lane, state holds word j of lane i at [j * lanes + i]
+ * and inactive lanes (active[i] = 0) keep their state */
+typedef void (*sha256_lanes_func)(u32 *state, const u8 *const *blocks, const u32 *active);
+
+#if SHA_HAVE_SHANI
+
+#define LANE_ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/* the kernel is written once with GCC vector extensions and compiled for each vector width */
+#define DEFINE_SHA256_LANES(name, lanes, attr)                                                   \
+	typedef u32 name##_vec __attribute__((vector_size((lanes) * 4)));                            \
+	static attr void name(u32 *state, const u8 *const *blocks, const u32 *active)                \
+	{                                                                                            \
+		name##_vec w[16], s[8], mask, a, b, c, d, e, f, g, h, t1, t2;                            \
+		u32 words[16][lanes];                                                                    \
+		for(int i = 0; i < (lanes); ++i)                                                         \
+			for(int t = 0; t < 16; ++t)                                                          \
+			{                                                                                    \
+				u32 word;                                                                        \
+				memcpy(&word, blocks[i] + t * 4, sizeof(word));                                  \
+				words[t][i] = __builtin_bswap32(word);                                           \
+			}                                                                                    \
+		memcpy(w, words, sizeof(w));                                                             \
+		memcpy(s, state, sizeof(s));                                                             \
+		memcpy(&mask, active, sizeof(mask));                                                     \
+		a = s[0]; b = s[1]; c = s[2]; d = s[3]; e = s[4]; f = s[5]; g = s[6]; h = s[7];          \
+		for(int t = 0; t < 64; ++t)                                                              \
+		{                                                                                        \
+			if(t >= 16)                                                                          \
+			{                                                                                    \
+				name##_vec w2 = w[(t - 2) & 15], w15 = w[(t - 15) & 15];                         \
+				w[t & 15] += (LANE_ROR(w2, 17) ^ LANE_ROR(w2, 19) ^ (w2 >> 10)) + w[(t - 7) & 15] \
+					+ (LANE_ROR(w15, 7) ^ LANE_ROR(w15, 18) ^ (w15 >> 3));                       \
+			}                                                                                    \
+			t1 = h + (LANE_ROR(e, 6) ^ LANE_ROR(e, 11) ^ LANE_ROR(e, 25)) + ((e & f) ^ (~e & g))  \
+				+ sha256_k[t] + w[t & 15];                                                      \
+			t2 = (LANE_ROR(a, 2) ^ LANE_ROR(a, 13) ^ LANE_ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c)); \
+			h = g; g = f; f = e; e = d + t1;                                                     \
+			d = c; c = b; b = a; a = t1 + t2;                                                    \
+		}                                                                                        \
+		/* inactive lanes add nothing */                                                         \
+		s[0] += a & mask; s[1] += b & mask; s[2] += c & mask; s[3] += d & mask;                  \
+		s[4] += e & mask; s[5] += f & mask; s[6] += g & mask; s[7] += h & mask;                  \
+		memcpy(state, s, sizeof(s));                                                             \
+	}
+
+/* SSE2 is part of x86-64, the others are checked for before use */
+DEFINE_SHA256_LANES(sha256_lanes_sse2, 4, __attribute__((target("sse2"))))
+DEFINE_SHA256_LANES(sha256_lanes_avx2, 8, __attribute__((target("avx2"))))
+DEFINE_SHA256_LANES(sha256_lanes_avx512, 16, __attribute__((target("avx512f"))))
+
+#endif
+
+static bool sha256_multi_impl_available(enum nnc_sha256_multi_impl impl)
+{
+	switch(impl)
+	{
+	case NNC_SHA256_MULTI_SINGLE:
+		return true;
+#if SHA_HAVE_SHANI
+	/* __builtin_cpu_supports also checks that the OS saves the vector registers */
+	case NNC_SHA256_MULTI_SSE2:
+		return __builtin_cpu_supports("sse2");
+	case NNC_SHA256_MULTI_AVX2:
+		return __builtin_cpu_supports("avx2");
+	case NNC_SHA256_MULTI_AVX512:
+		return __builtin_cpu_supports("avx512f");
+#endif
+	default:
+		return false;
+	}
+}
+
+static volatile int sha256_multi_impl = -1;
+
+enum nnc_sha256_multi_impl nnc_crypto_sha256_multi_impl(void)
+{
+	if(sha256_multi_impl == -1)
+	{
+		/* 16 lanes beat the SHA extensions, narrower vectors only beat the generic implementation */
+		if(sha256_multi_impl_available(NNC_SHA256_MULTI_AVX512))                  sha256_multi_impl = NNC_SHA256_MULTI_AVX512;
+		else if(nnc_crypto_sha256_impl() != NNC_SHA256_IMPL_GENERIC)              sha256_multi_impl = NNC_SHA256_MULTI_SINGLE;
+		else if(sha256_multi_impl_available(NNC_SHA256_MULTI_AVX2))               sha256_multi_impl = NNC_SHA256_MULTI_AVX2;
+		else if(sha256_multi_impl_available(NNC_SHA256_MULTI_SSE2))               sha256_multi_impl = NNC_SHA256_MULTI_SSE2;
+		else                                                                      sha256_multi_impl = NNC_SHA256_MULTI_SINGLE;
+	}
+	return (enum nnc_sha256_multi_impl) sha256_multi_impl;
+}
+
+nnc_result nnc_crypto_sha256_multi_set_impl(enum nnc_sha256_multi_impl impl)
+{
+	if(!sha256_multi_impl_available(impl))
+		return NNC_R_UNSUPPORTED;
+	sha256_multi_impl = impl;
+	return NNC_R_OK;
+}
+
+/* hashes `count' (at most `lanes') messages */
+static void sha256_multi_group(sha256_lanes_func kernel, u32 lanes, u32 count,
+	const u8 *const bufs[], const u32 sizes[], nnc_sha256_hash digests[])
+{
+	u32 state[8 * SHA256_MAX_LANES], active[SHA256_MAX_LANES];
+	u32 full_blocks[SHA256_MAX_LANES], total_blocks[SHA256_MAX_LANES], max_blocks = 0;
+	const u8 *blocks[SHA256_MAX_LANES];
+	/* the padded end of each message, up to two blocks */
+	u8 tail[SHA256_MAX_LANES][0x80];
+
+	for(u32 i = 0; i < lanes; ++i)
+	{
+		for(u32 j = 0; j < 8; ++j)
+			state[j * lanes + i] = sha256_initial_state[j];
+		/* unused lanes have no blocks */
+		full_blocks[i] = total_blocks[i] = 0;
+		if(i >= count) continue;
+		u32 rest = sizes[i] % 0x40, tail_size = rest < 0x38 ? 0x40 : 0x80;
+		full_blocks[i] = sizes[i] / 0x40;
+		total_blocks[i] = full_blocks[i] + tail_size / 0x40;
+		memcpy(tail[i], bufs[i] + sizes[i] - rest, rest);
+		tail[i][rest] = 0x80;
+		memset(tail[i] + rest + 1, 0x00, tail_size - rest - 9);
+		U64P(&tail[i][tail_size - 8]) = BE64((u64) sizes[i] * 8);
+		max_blocks = MAX(max_blocks, total_blocks[i]);
+	}
+
+	for(u32 b = 0; b < max_blocks; ++b)
+	{
+		for(u32 i = 0; i < lanes; ++i)
+		{
+			active[i] = b < total_blocks[i] ? 0xFFFFFFFF : 0;
+			if(b < full_blocks[i])       blocks[i] = bufs[i] + (u64) b * 0x40;
+			else if(b < total_blocks[i]) blocks[i] = tail[i] + (b - full_blocks[i]) * 0x40;
+			else                         blocks[i] = tail[i];
+		}
+		kernel(state, blocks, active);
+	}
+
+	for(u32 i = 0; i < count; ++i)
+		for(u32 j = 0; j < 8; ++j)
+			U32P(&digests[i][j * 4]) = BE32(state[j * lanes + i]);
+}
+
+void nnc_crypto_sha256_multi(u32 count, const u8 *const bufs[], const u32 sizes[], nnc_sha256_hash digests[])
+{
+	sha256_lanes_func kernel;
+	u32 lanes;
+	switch(nnc_crypto_sha256_multi_impl())
+	{
+#if SHA_HAVE_SHANI
+	case NNC_SHA256_MULTI_SSE2:   kernel = sha256_lanes_sse2;   lanes = 4;  break;
+	case NNC_SHA256_MULTI_AVX2:   kernel = sha256_lanes_avx2;   lanes = 8;  break;
+	case NNC_SHA256_MULTI_AVX512: kernel = sha256_lanes_avx512; lanes = 16; break;
+#endif
+	default:
+		for(u32 i = 0; i < count; ++i)
+			nnc_crypto_sha256(bufs[i], digests[i], sizes[i]);
+		return;
+	}
+	for(u32 i = 0; i < count; i += lanes)
+		sha256_multi_group(kernel, lanes, MIN(lanes, count - i), bufs + i, sizes + i, digests + i);
+}
+
+void nnc_crypto_sha256_blocks(const u8 *data, u32 block_size, u32 count, nnc_sha256_hash digests[])
+{
+	const u8 *bufs[SHA256_MAX_LANES];
+	u32 sizes[SHA256_MAX_LANES];
+	for(u32 i = 0; i < count; i += SHA256_MAX_LANES)
+	{
+		u32 n = MIN(SHA256_MAX_LANES, count - i);
+		for(u32 j = 0; j < n; ++j)
+		{
+			bufs[j] = data + (u64) (i + j) * block_size;
+			sizes[j] = block_size;
+		}
+		nnc_crypto_sha256_multi(n, bufs, sizes, digests + i);
+	}
+}
@@ -8,38 +8,51 @@
 #include "./internal.h"
 
 #if NNC_PLATFORM_UNIX
+	#include <sys/stat.h>
 	#include <unistd.h>
+	#include <fcntl.h>
+	#include <errno.h>
+#endif
+#if NNC_PLATFORM_UNIX && defined(__linux__)
+	#include <sys/sendfile.h>
+	#include <sys/syscall.h>
 #endif
 
 #include <nnc/crypto.h>
 #include <nnc/stream.h>
+#include <nnc/aio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
-#define FILE_SIZE_NULL ((u32) -1)
+#define FILE_SIZE_NULL ((u64) -1)
 
 enum nnc_file_flags {
 	NNC_FILE_KEEP_ALIVE = 1,
 };
 
-static result nnc_seek_file_abs(FILE *file, u32 pos, u32 *npos)
+static result nnc_seek_file_abs(FILE *file, u64 pos, u64 *npos)
 {
 	int res;
-	if(pos <= INT32_MAX || sizeof(long) > 4)
+	if(pos <= INT32_MAX || (sizeof(long) > 4 && pos <= LONG_MAX))
 		res = fseek(file, pos, SEEK_SET);
 #if NNC_PLATFORM_WINDOWS
 	else
 		res = _fseeki64(file, pos, SEEK_SET);
 #elif NNC_PLATFORM_UNIX
-	else /* This should be fine, be sure to test */
-		res = lseek64(fileno(file), pos, SEEK_SET);
+	else
+		res = fseeko64(file, pos, SEEK_SET);
 #else
 	else
 	{
-		/* ugly hack */
+		/* ugly hack, seek in steps of at most INT32_MAX */
 		res = fseek(file, INT32_MAX, SEEK_SET);
-		if(res == 0)
-			res = fseek(file, pos - INT32_MAX, SEEK_CUR);
+		for(u64 left = pos - INT32_MAX; res == 0 && left; )
+		{
+			long step = MIN(left, INT32_MAX);
+			res = fseek(file, step, SEEK_CUR);
+			left -= step;
+		}
 	}
 #endif
 	if(res == 0 && npos)
@@ -47,39 +60,253 @@ static result nnc_seek_file_abs(FILE *file, u32 pos, u32 *npos)
 	return res == 0 ? NNC_R_OK : NNC_R_SEEK_RANGE;
 }
 
+/* read-ahead buffer used by nnc_file and nnc_buffered_rstream */
+
+#define RA_MIN_AHEAD 0x1000
+
+struct nnc_readahead {
+	nnc_mutex *lock; /* positional reads may come from multiple threads */
+	u64 start;    /* stream offset of buf[0] */
+	u64 last_end; /* end of the previous read, to detect sequential access */
+	u32 len;      /* amount of valid data in buf */
+	u32 window;   /* size of buf */
+	u32 ahead;    /* amount to read on the next refill */
+	bool unlocked_fill; /* fill can be called from several threads at once */
+	u8 *buf;
+	u8 *spare; /* refills go here outside the lock and are then swapped with buf, NULL while in use */
+};
+
+typedef result (*ra_fill_func)(void *udata, u64 pos, u8 *buf, u32 max, u32 *totalRead);
+
+/* unlocked_fill says if the fill function is a real positional read, anything
+ * else is called with the lock held so it can move a shared position */
+static struct nnc_readahead *ra_alloc(u32 window, bool unlocked_fill)
+{
+	struct nnc_readahead *ra = malloc(sizeof(struct nnc_readahead) + (unlocked_fill ? 2 : 1) * (size_t) window);
+	if(!ra) return NULL;
+	if(!(ra->lock = mutex_new()))
+		return free(ra), NULL;
+	ra->start = ra->last_end = 0;
+	ra->len = 0;
+	ra->window = window;
+	ra->ahead = MIN(RA_MIN_AHEAD, window);
+	ra->unlocked_fill = unlocked_fill;
+	ra->buf = (u8 *) (ra + 1);
+	ra->spare = unlocked_fill ? ra->buf + window : NULL;
+	return ra;
+}
+
+static void ra_free(struct nnc_readahead *ra)
+{
+	if(!ra) return;
+	mutex_free(ra->lock);
+	free(ra);
+}
+
+/* calls fill without the lock if it allows that, the lock is held again on return */
+static result ra_fill(struct nnc_readahead *ra, u64 pos, u8 *buf, u32 max, u32 *totalRead,
+	ra_fill_func fill, void *udata)
+{
+	if(!ra->unlocked_fill) return fill(udata, pos, buf, max, totalRead);
+	mutex_unlock(ra->lock);
+	result ret = fill(udata, pos, buf, max, totalRead);
+	mutex_lock(ra->lock);
+	return ret;
+}
+
+static result ra_read(struct nnc_readahead *ra, u64 pos, u8 *buf, u32 max, u32 *totalRead,
+	ra_fill_func fill, void *udata)
+{
+	u32 total = 0, got;
+	result ret = NNC_R_OK;
+	mutex_lock(ra->lock);
+	/* grow the read-ahead while reads continue where the last one ended */
+	bool sequential = pos == ra->last_end;
+	while(total != max)
+	{
+		if(pos >= ra->start && pos - ra->start < ra->len)
+		{
+			u32 n = MIN(max - total, ra->len - (pos - ra->start));
+			memcpy(buf + total, ra->buf + (pos - ra->start), n);
+			total += n;
+			pos += n;
+			continue;
+		}
+		/* large reads gain nothing from an extra copy, neither do reads while
+		 * another thread is refilling as the buffer will hold its data */
+		if(max - total >= ra->window || (ra->unlocked_fill && !ra->spare))
+		{
+			if((ret = ra_fill(ra, pos, buf + total, max - total, &got, fill, udata)) != NNC_R_OK)
+				break;
+			total += got;
+			pos += got;
+			break;
+		}
+		ra->ahead = sequential ? MIN(ra->ahead * 2, ra->window) : MIN(RA_MIN_AHEAD, ra->window);
+		u8 *fresh = ra->buf;
+		if(ra->unlocked_fill)
+		{
+			fresh = ra->spare;
+			ra->spare = NULL;
+		}
+		else ra->len = 0;
+		ret = ra_fill(ra, pos, fresh, MAX(ra->ahead, max - total), &got, fill, udata);
+		if(ra->unlocked_fill)
+		{
+			/* the buffer other threads copy from is only swapped with the lock held */
+			ra->spare = ret == NNC_R_OK ? ra->buf : fresh;
+			if(ret == NNC_R_OK) ra->buf = fresh;
+		}
+		if(ret != NNC_R_OK) break;
+		ra->start = pos;
+		ra->len = got;
+		/* end of stream */
+		if(got == 0) break;
+	}
+	if(ret == NNC_R_OK)
+	{
+		ra->last_end = pos;
+		*totalRead = total;
+	}
+	mutex_unlock(ra->lock);
+	return ret;
+}
+
 static result file_read(nnc_file *self, u8 *buf, u32 max, u32 *totalRead)
 {
 	u32 total = fread(buf, 1, max, self->f);
 	if(totalRead) *totalRead = total;
+	self->off += total;
 	if(total != max)
 		return ferror(self->f) ? NNC_R_FAIL_READ : NNC_R_OK;
-	self->off += total;
 	return NNC_R_OK;
 }
 
-static result file_seek_abs(nnc_file *self, u32 pos)
+static result file_seek_abs(nnc_file *self, u64 pos)
 {
-	if(self->size == 0 && pos == 0) return NNC_R_OK;
-	if(pos >= self->size) return NNC_R_SEEK_RANGE;
+	if(pos > self->size) return NNC_R_SEEK_RANGE;
 	return nnc_seek_file_abs(self->f, pos, &self->off);
 }
 
-static result file_seek_rel(nnc_file *self, u32 pos)
+static result file_seek_rel(nnc_file *self, u64 pos)
 {
-	u32 npos = self->off + pos;
-	if(npos >= self->size) return NNC_R_SEEK_RANGE;
+	u64 npos = self->off + pos;
+	if(npos > self->size) return NNC_R_SEEK_RANGE;
 	return nnc_seek_file_abs(self->f, npos, &self->off);
 }
 
-static u32 file_size(nnc_file *self) { return self->size; }
-static u32 file_tell(nnc_file *self) { return self->off; }
+static u64 file_size(nnc_file *self) { return self->size; }
+static u64 file_tell(nnc_file *self) { return self->off; }
 
 static void file_close(nnc_file *self)
 {
 	if(!(self->flags & NNC_FILE_KEEP_ALIVE))
 		fclose(self->f);
+	ra_free(self->ra);
+	self->ra = NULL;
+}
+
+static result file_read_at(nnc_file *self, u64 pos, u8 *buf, u32 max, u32 *totalRead)
+{
+	u32 total = 0;
+	if(pos < self->size)
+		max = MIN(max, self->size - pos);
+	else max = 0;
+#if NNC_PLATFORM_UNIX
+	int fd = fileno(self->f);
+	while(total != max)
+	{
+		ssize_t got = pread(fd, buf + total, max - total, (off_t) (pos + total));
+		if(got < 0) return NNC_R_FAIL_READ;
+		if(got == 0) break;
+		total += got;
+	}
+#else
+	/* only used by buffered files on these platforms, which don't care about the FILE position */
+	if(max)
+	{
+		result ret;
+		TRY(nnc_seek_file_abs(self->f, pos, NULL));
+		total = fread(buf, 1, max, self->f);
+		if(total != max && ferror(self->f)) return NNC_R_FAIL_READ;
+	}
+#endif
+	*totalRead = total;
+	return NNC_R_OK;
+}
+
+#if NNC_PLATFORM_UNIX
+static result file_locate(nnc_file *self, u64 pos, u64 len, int *fd, u64 *fd_pos)
+{
+	if(pos > self->size || len > self->size - pos) return NNC_R_SEEK_RANGE;
+	*fd = fileno(self->f);
+	*fd_pos = pos;
+	return NNC_R_OK;
+}
+	#define FILE_READ_AT ((nnc_read_at_func) file_read_at)
+	#define FILE_LOCATE ((nnc_locate_func) file_locate)
+	#define FILE_PREAD true
+#else
+	/* no positional read primitive for a FILE, the generic seek+read fallback is used */
+	#define FILE_READ_AT NULL
+	#define FILE_LOCATE NULL
+	#define FILE_PREAD false
+#endif
+
+#ifdef POSIX_FADV_NORMAL
+static result file_advise(nnc_file *self, u64 pos, u64 len, int advice)
+{
+	static const int fadv[] = {
+		[NNC_ADVISE_NORMAL]     = POSIX_FADV_NORMAL,
+		[NNC_ADVISE_SEQUENTIAL] = POSIX_FADV_SEQUENTIAL,
+		[NNC_ADVISE_RANDOM]     = POSIX_FADV_RANDOM,
+		[NNC_ADVISE_WILLNEED]   = POSIX_FADV_WILLNEED,
+		[NNC_ADVISE_DONTNEED]   = POSIX_FADV_DONTNEED,
+	};
+	if(advice < 0 || advice > NNC_ADVISE_DONTNEED) return NNC_R_INVAL;
+	if(pos >= self->size || !len) return NNC_R_OK;
+	len = MIN(len, self->size - pos);
+	return posix_fadvise(fileno(self->f), pos, len, fadv[advice]) == 0 ? NNC_R_OK : NNC_R_UNSUPPORTED;
+}
+	#define FILE_ADVISE ((nnc_advise_func) file_advise)
+#else
+	#define FILE_ADVISE NULL
+#endif
+
+static result file_buffered_read_at(nnc_file *self, u64 pos, u8 *buf, u32 max, u32 *totalRead)
+{
+	return ra_read(self->ra, pos, buf, max, totalRead, (ra_fill_func) file_read_at, self);
+}
+
+static result file_buffered_read(nnc_file *self, u8 *buf, u32 max, u32 *totalRead)
+{
+	result ret;
+	TRY(file_buffered_read_at(self, self->off, buf, max, totalRead));
+	self->off += *totalRead;
+	return NNC_R_OK;
+}
+
+/* the FILE position is not used by buffered reads */
+static result file_buffered_seek_abs(nnc_file *self, u64 pos)
+{
+	if(pos > self->size) return NNC_R_SEEK_RANGE;
+	self->off = pos;
+	return NNC_R_OK;
 }
 
+static result file_buffered_seek_rel(nnc_file *self, u64 pos)
+{
+	return file_buffered_seek_abs(self, self->off + pos);
+}
+
+#if NNC_PLATFORM_UNIX
+static result file_clone(nnc_file *self, nnc_rstream **out);
+	#define FILE_CLONE ((nnc_clone_func) file_clone)
+#else
+	/* buffered reads seek the shared FILE, so clones read through the original instead */
+	#define FILE_CLONE NULL
+#endif
+
 static const nnc_rstream_funcs file_funcs = {
 	.read = (nnc_read_func) file_read,
 	.seek_abs = (nnc_seek_abs_func) file_seek_abs,
@@ -87,21 +314,56 @@ static const nnc_rstream_funcs file_funcs = {
 	.size = (nnc_size_func) file_size,
 	.close = (nnc_close_func) file_close,
 	.tell = (nnc_tell_func) file_tell,
+	.read_at = FILE_READ_AT,
+	.locate = FILE_LOCATE,
+	.advise = FILE_ADVISE,
+	.clone = FILE_CLONE,
 };
 
-static u32 get_file_size(FILE *file, u32 seekback)
+static const nnc_rstream_funcs buffered_file_funcs = {
+	.read = (nnc_read_func) file_buffered_read,
+	.seek_abs = (nnc_seek_abs_func) file_buffered_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) file_buffered_seek_rel,
+	.size = (nnc_size_func) file_size,
+	.close = (nnc_close_func) file_close,
+	.tell = (nnc_tell_func) file_tell,
+	.read_at = (nnc_read_at_func) file_buffered_read_at,
+	.locate = FILE_LOCATE,
+	.advise = FILE_ADVISE,
+	.clone = FILE_CLONE,
+};
+
+#if NNC_PLATFORM_UNIX
+/* buffered reads use pread, so clones share the FILE but not its position */
+static result file_clone(nnc_file *self, nnc_rstream **out)
+{
+	nnc_file *clone = malloc(sizeof(nnc_file));
+	if(!clone) return NNC_R_NOMEM;
+	*clone = *self;
+	clone->flags |= NNC_FILE_KEEP_ALIVE;
+	clone->off = 0;
+	/* unbuffered reads would move the shared FILE position */
+	if(!(clone->ra = ra_alloc(self->ra ? self->ra->window : NNC_BUFFERED_DEFAULT_WINDOW, true)))
+		return free(clone), NNC_R_NOMEM;
+	clone->funcs = &buffered_file_funcs;
+	*out = NNC_RSP(clone);
+	return NNC_R_OK;
+}
+#endif
+
+static u64 get_file_size(FILE *file, u64 seekback)
 {
-	fseek(file, 0, SEEK_END);
-	u32 size
+	if(fseek(file, 0, SEEK_END) != 0)
+		return FILE_SIZE_NULL;
 #if NNC_PLATFORM_WINDOWS
-		= _ftelli64(file);
+	i64 size = _ftelli64(file);
 #elif NNC_PLATFORM_UNIX
-		= ftello64(file);
+	i64 size = ftello64(file);
 #else
-		= ftell(file); /* dangerous call */
+	i64 size = ftell(file); /* dangerous call */
 #endif
 	nnc_seek_file_abs(file, seekback, NULL);
-	return size;
+	return size < 0 ? FILE_SIZE_NULL : (u64) size;
 }
 
 result nnc_file_open(nnc_file *self, const char *name)
@@ -109,10 +371,62 @@ result nnc_file_open(nnc_file *self, const char *name)
 	self->f = fopen(name, "rb");
 	self->flags = 0;
 	self->off = 0;
+	self->ra = NULL;
 	if(!self->f) return NNC_R_FAIL_OPEN;
 	self->size = get_file_size(self->f, 0);
+	if(self->size == FILE_SIZE_NULL)
+		return fclose(self->f), NNC_R_FAIL_OPEN;
+	self->funcs = &file_funcs;
+	/* unbuffered reads still work if this fails */
+	nnc_file_set_window(self, NNC_BUFFERED_DEFAULT_WINDOW);
+	return NNC_R_OK;
+}
+
+result nnc_file_set_window(nnc_file *self, u32 window)
+{
+	result ret;
+	ra_free(self->ra);
+	self->ra = NULL;
 	self->funcs = &file_funcs;
-	return self->size == FILE_SIZE_NULL ? NNC_R_FAIL_OPEN : NNC_R_OK;
+	/* unbuffered reads use the FILE position */
+	TRY(nnc_seek_file_abs(self->f, self->off, NULL));
+	if(window == 0) return NNC_R_OK;
+	/* file_read_at seeks the FILE where there is no pread */
+	if(!(self->ra = ra_alloc(window, FILE_PREAD)))
+		return NNC_R_NOMEM;
+	self->funcs = &buffered_file_funcs;
+	return NNC_R_OK;
+}
+
+static result write_zeros(nnc_wstream *self, u64 count)
+{
+	u8 buffer[4096];
+	/* if count < sizeof(buffer) it makes no sense to completely fill it with 0s */
+	memset(buffer, 0x00, MIN(count, sizeof(buffer)));
+
+	u64 left = count;
+	u32 to_do;
+	result ret;
+
+	while(left)
+	{
+		to_do = MIN(left, sizeof(buffer));
+		TRY(self->funcs->write(self, buffer, to_do));
+		left -= to_do;
+	}
+
+	return NNC_R_OK;
+}
+
+/* skips shorter than this are written as zeros, which is cheaper than finding
+ *  out how much of the range is already in the file */
+#define SKIP_ZEROS_MAX 0x10000
+
+/* amount of the next count bytes at pos that are already in a file of the given size */
+static u64 skip_overlap(u64 pos, u64 count, u64 file_size)
+{
+	if(file_size == FILE_SIZE_NULL) return count;
+	return pos < file_size ? MIN(count, file_size - pos) : 0;
 }
 
 static nnc_result wfile_write(nnc_wfile *self, nnc_u8 *buf, nnc_u32 size)
@@ -122,42 +436,100 @@ static nnc_result wfile_write(nnc_wfile *self, nnc_u8 *buf, nnc_u32 size)
 	return res;
 }
 
+/* writes the last byte of a skipped range at the end of the file so the file has the right size */
+static result wfile_extend(nnc_wfile *self)
+{
+	if(!self->end) return NNC_R_OK;
+	u64 size = get_file_size(self->f, self->off);
+	if(size == FILE_SIZE_NULL) return NNC_R_FAIL_WRITE;
+	if(self->end <= size) return NNC_R_OK;
+	result ret;
+	TRY(nnc_seek_file_abs(self->f, self->end - 1, NULL));
+	if(fputc(0, self->f) == EOF) return NNC_R_FAIL_WRITE;
+	return nnc_seek_file_abs(self->f, self->off, NULL);
+}
+
 static result wfile_close(nnc_wfile *self)
 {
-	return fclose(self->f) == 0 ? NNC_R_OK : NNC_R_FAIL_WRITE;
+	result ret = wfile_extend(self);
+	if(fclose(self->f) != 0 && ret == NNC_R_OK)
+		ret = NNC_R_FAIL_WRITE;
+	return ret;
 }
 
-static nnc_result wfile_seek(nnc_wfile *self, nnc_u32 pos)
+/* zeros past the end of the file are left to the file system */
+static result wfile_skip(nnc_wfile *self, u64 count)
+{
+	if(count < SKIP_ZEROS_MAX)
+		return write_zeros(NNC_WSP(self), count);
+	result ret;
+	u64 dirty = skip_overlap(self->off, count, get_file_size(self->f, self->off));
+	TRY(write_zeros(NNC_WSP(self), dirty));
+	TRY(nnc_seek_file_abs(self->f, self->off + count - dirty, &self->off));
+	self->end = MAX(self->end, self->off);
+	return NNC_R_OK;
+}
+
+static nnc_result wfile_seek(nnc_wfile *self, nnc_u64 pos)
 {
 	return nnc_seek_file_abs(self->f, pos, &self->off);
 }
 
-static nnc_u32 wfile_tell(nnc_wfile *self)
+static nnc_u64 wfile_tell(nnc_wfile *self)
 { return self->off; }
 
-static nnc_result wfile_subreadstream(nnc_wfile *self, nnc_subview *out, nnc_u32 start, nnc_u32 len)
+/* opens a readback stream on a file that is being written to */
+static result file_subreadstream(FILE *f, u64 seekback, nnc_subview *out, u64 start, u64 len)
 {
 	nnc_file *substream = malloc(sizeof(nnc_file));
 	if(!substream) return NNC_R_NOMEM;
 	substream->funcs = &file_funcs;
 	substream->flags = NNC_FILE_KEEP_ALIVE;
-	substream->f = self->f;
-	substream->size = get_file_size(self->f, self->off);
-	if(start + len > substream->size)
-		return NNC_R_SEEK_RANGE;
+	substream->f = f;
+	/* the file is still being written, so this must not be buffered */
+	substream->ra = NULL;
+	/* positional reads bypass the stdio buffer */
+	if(fflush(f) != 0)
+		return free(substream), NNC_R_FAIL_WRITE;
+	substream->off = seekback;
+	substream->size = get_file_size(f, seekback);
 	if(substream->size == FILE_SIZE_NULL)
-		return NNC_R_FAIL_OPEN;
+		return free(substream), NNC_R_FAIL_OPEN;
+	if(start + len > substream->size)
+		return free(substream), NNC_R_SEEK_RANGE;
 	nnc_subview_open(out, NNC_RSP(substream), start, len);
 	nnc_subview_delete_on_close(out);
 	return NNC_R_OK;
 }
 
+static nnc_result wfile_subreadstream(nnc_wfile *self, nnc_subview *out, nnc_u64 start, nnc_u64 len)
+{
+	result ret;
+	TRY(wfile_extend(self));
+	return file_subreadstream(self->f, self->off, out, start, len);
+}
+
+#if NNC_PLATFORM_UNIX
+static result wfile_locate(nnc_wfile *self, int *fd, u64 *fd_pos)
+{
+	if(fflush(self->f) != 0) return NNC_R_FAIL_WRITE;
+	*fd = fileno(self->f);
+	*fd_pos = self->off;
+	return NNC_R_OK;
+}
+	#define WFILE_LOCATE ((nnc_wlocate_func) wfile_locate)
+#else
+	#define WFILE_LOCATE NULL
+#endif
+
 static const nnc_wstream_funcs wfile_funcs = {
 	.write = (nnc_write_func) wfile_write,
 	.close = (nnc_wclose_func) wfile_close,
 	.seek = (nnc_wseek_func) wfile_seek,
 	.tell = (nnc_wtell_func) wfile_tell,
 	.subreadstream = (nnc_wsubreadstream_func) wfile_subreadstream,
+	.locate = WFILE_LOCATE,
+	.skip = (nnc_wskip_func) wfile_skip,
 };
 
 result nnc_wfile_open(nnc_wfile *self, const char *name)
@@ -166,6 +538,179 @@ result nnc_wfile_open(nnc_wfile *self, const char *name)
 	if(!self->f) return NNC_R_FAIL_OPEN;
 	self->funcs = &wfile_funcs;
 	self->off = 0;
+	self->end = 0;
+	return NNC_R_OK;
+}
+
+#define FPOS_UNKNOWN ((u64) -1)
+
+static result bwfile_put(nnc_buffered_wfile *self, u64 pos, u8 *buf, u32 size)
+{
+	result ret;
+	if(self->fpos != pos)
+		TRY(nnc_seek_file_abs(self->f, pos, &self->fpos));
+	if(fwrite(buf, 1, size, self->f) != size)
+	{
+		self->fpos = FPOS_UNKNOWN;
+		return NNC_R_FAIL_WRITE;
+	}
+	self->fpos += size;
+	return NNC_R_OK;
+}
+
+static result bwfile_flush(nnc_buffered_wfile *self)
+{
+	if(!self->buf_len) return NNC_R_OK;
+	result ret;
+	TRY(bwfile_put(self, self->buf_start, self->buf, self->buf_len));
+	self->buf_len = 0;
+	return NNC_R_OK;
+}
+
+static result bwfile_write(nnc_buffered_wfile *self, u8 *buf, u32 size)
+{
+	result ret;
+	/* data is only buffered if it is contiguous with what is already buffered */
+	if(self->buf_len && (self->pos < self->buf_start || self->pos > self->buf_start + self->buf_len))
+		TRY(bwfile_flush(self));
+	while(size)
+	{
+		if(!self->buf_len)
+		{
+			/* whole aligned chunks go straight to the file, anything before the next
+			 * boundary is buffered first so the direct writes stay aligned */
+			if(self->pos % self->buf_size == 0 && size >= self->buf_size)
+			{
+				u32 direct = size - size % self->buf_size;
+				TRY(bwfile_put(self, self->pos, buf, direct));
+				self->pos += direct;
+				buf += direct;
+				size -= direct;
+				continue;
+			}
+			self->buf_start = self->pos;
+		}
+		u32 off = self->pos - self->buf_start;
+		/* the buffer ends at the next multiple of its size so flushes stay aligned */
+		u32 cap = self->buf_size - self->buf_start % self->buf_size;
+		u32 n = MIN(size, cap - off);
+		memcpy(self->buf + off, buf, n);
+		self->buf_len = MAX(self->buf_len, off + n);
+		self->pos += n;
+		buf += n;
+		size -= n;
+		if(self->buf_len == cap)
+			TRY(bwfile_flush(self));
+	}
+	return NNC_R_OK;
+}
+
+/* the buffer is flushed lazily by the next write that is not contiguous with it */
+static result bwfile_seek(nnc_buffered_wfile *self, u64 pos)
+{
+	self->pos = pos;
+	return NNC_R_OK;
+}
+
+static u64 bwfile_tell(nnc_buffered_wfile *self)
+{ return self->pos; }
+
+static u64 bwfile_file_size(nnc_buffered_wfile *self)
+{
+	/* this moves the FILE position */
+	self->fpos = FPOS_UNKNOWN;
+	return get_file_size(self->f, 0);
+}
+
+static result bwfile_skip(nnc_buffered_wfile *self, u64 count)
+{
+	if(count < SKIP_ZEROS_MAX)
+		return write_zeros(NNC_WSP(self), count);
+	result ret;
+	u64 size = bwfile_file_size(self);
+	if(size != FILE_SIZE_NULL && self->buf_len)
+		size = MAX(size, self->buf_start + self->buf_len);
+	u64 dirty = skip_overlap(self->pos, count, size);
+	TRY(write_zeros(NNC_WSP(self), dirty));
+	self->pos += count - dirty;
+	self->end = MAX(self->end, self->pos);
+	return NNC_R_OK;
+}
+
+/* flushes the buffer and gives the file the right size if a skipped range is at the end */
+static result bwfile_flush_extend(nnc_buffered_wfile *self)
+{
+	result ret;
+	TRY(bwfile_flush(self));
+	if(!self->end) return NNC_R_OK;
+	u64 size = bwfile_file_size(self);
+	if(size == FILE_SIZE_NULL) return NNC_R_FAIL_WRITE;
+	if(self->end <= size) return NNC_R_OK;
+	u8 zero = 0;
+	return bwfile_put(self, self->end - 1, &zero, 1);
+}
+
+static result bwfile_close(nnc_buffered_wfile *self)
+{
+	result ret = bwfile_flush_extend(self);
+	free(self->buf);
+	self->buf = NULL;
+	if(fclose(self->f) != 0 && ret == NNC_R_OK)
+		ret = NNC_R_FAIL_WRITE;
+	return ret;
+}
+
+static result bwfile_subreadstream(nnc_buffered_wfile *self, nnc_subview *out, u64 start, u64 len)
+{
+	result ret;
+	TRY(bwfile_flush_extend(self));
+	/* the FILE position is moved by this */
+	self->fpos = FPOS_UNKNOWN;
+	return file_subreadstream(self->f, 0, out, start, len);
+}
+
+#if NNC_PLATFORM_UNIX
+static result bwfile_locate(nnc_buffered_wfile *self, int *fd, u64 *fd_pos)
+{
+	result ret;
+	TRY(bwfile_flush(self));
+	/* the descriptor may be written to directly */
+	self->fpos = FPOS_UNKNOWN;
+	*fd = fileno(self->f);
+	*fd_pos = self->pos;
+	return NNC_R_OK;
+}
+	#define BWFILE_LOCATE ((nnc_wlocate_func) bwfile_locate)
+#else
+	#define BWFILE_LOCATE NULL
+#endif
+
+static const nnc_wstream_funcs bwfile_funcs = {
+	.write = (nnc_write_func) bwfile_write,
+	.close = (nnc_wclose_func) bwfile_close,
+	.seek = (nnc_wseek_func) bwfile_seek,
+	.tell = (nnc_wtell_func) bwfile_tell,
+	.subreadstream = (nnc_wsubreadstream_func) bwfile_subreadstream,
+	.locate = BWFILE_LOCATE,
+	.skip = (nnc_wskip_func) bwfile_skip,
+};
+
+result nnc_buffered_wfile_open(nnc_buffered_wfile *self, const char *name, u32 buf_size)
+{
+	if(!buf_size) buf_size = NNC_BUFFERED_WFILE_DEFAULT_SIZE;
+	if(!(self->buf = malloc(buf_size)))
+		return NNC_R_NOMEM;
+	if(!(self->f = fopen(name, "wb+")))
+		return free(self->buf), NNC_R_FAIL_OPEN;
+	/* all writes are already large, the stdio buffer would only add a copy */
+	setvbuf(self->f, NULL, _IONBF, 0);
+	self->funcs = &bwfile_funcs;
+	self->buf_size = buf_size;
+	self->buf_start = 0;
+	self->buf_len = 0;
+	self->pos = 0;
+	self->fpos = 0;
+	self->end = 0;
 	return NNC_R_OK;
 }
 
@@ -182,8 +727,8 @@ static result hdrsaver_write(nnc_header_saver *self, nnc_u8 *buf, nnc_u32 size)
 }
 
 static result hdrsaver_close(nnc_header_saver *self) { free(self->buffer); return NNC_R_OK; }
-static nnc_result hdrsaver_seek(nnc_header_saver *self, nnc_u32 pos) { self->pos = pos; return self->child->funcs->seek(self->child, pos); }
-static nnc_u32 hdrsaver_tell(nnc_header_saver *self) { return self->child->funcs->tell(self->child); }
+static nnc_result hdrsaver_seek(nnc_header_saver *self, nnc_u64 pos) { self->pos = pos; return self->child->funcs->seek(self->child, pos); }
+static nnc_u64 hdrsaver_tell(nnc_header_saver *self) { return self->child->funcs->tell(self->child); }
 
 
 static const nnc_wstream_funcs hdrsaver_funcs_seekable = {
@@ -199,170 +744,690 @@ static const nnc_wstream_funcs hdrsaver_funcs = {
 	.tell  = (nnc_wtell_func)  hdrsaver_tell,
 };
 
-nnc_result nnc_open_header_saver(nnc_header_saver *self, nnc_wstream *child, nnc_u32 count)
+nnc_result nnc_open_header_saver(nnc_header_saver *self, nnc_wstream *child, nnc_u32 count)
+{
+	self->funcs = child->funcs->seek ? &hdrsaver_funcs_seekable : &hdrsaver_funcs;
+	self->child = child;
+	self->count = count;
+	self->start = NNC_WS_PCALL0(child, tell);
+	self->pos   = self->start;
+
+	self->buffer = malloc(count);
+	return self->buffer ? NNC_R_OK : NNC_R_NOMEM;
+}
+
+static result mem_read(nnc_memory *self, u8 *buf, u32 max, u32 *totalRead)
+{
+	*totalRead = MIN(max, self->size - self->pos);
+	memcpy(buf, ((u8 *) self->un.ptr_const) + self->pos, *totalRead);
+	self->pos += *totalRead;
+	return NNC_R_OK;
+}
+
+static result mem_read_at(nnc_memory *self, u64 pos, u8 *buf, u32 max, u32 *totalRead)
+{
+	*totalRead = pos < self->size ? MIN(max, self->size - pos) : 0;
+	memcpy(buf, ((u8 *) self->un.ptr_const) + pos, *totalRead);
+	return NNC_R_OK;
+}
+
+static result mem_borrow(nnc_memory *self, u64 pos, u64 len, const u8 **ptr)
+{
+	if(pos > self->size || len > self->size - pos) return NNC_R_SEEK_RANGE;
+	*ptr = ((const u8 *) self->un.ptr_const) + pos;
+	return NNC_R_OK;
+}
+
+static result mem_seek_abs(nnc_memory *self, u64 pos)
+{
+	if(pos > self->size) return NNC_R_SEEK_RANGE;
+	self->pos = pos;
+	return NNC_R_OK;
+}
+
+static result mem_seek_rel(nnc_memory *self, u64 pos)
+{
+	u64 npos = self->pos + pos;
+	if(npos > self->size) return NNC_R_SEEK_RANGE;
+	self->pos = npos;
+	return NNC_R_OK;
+}
+
+static u64 mem_size(nnc_memory *self)
+{
+	return self->size;
+}
+
+static void mem_close(nnc_memory *self)
+{
+	/* nothing to do ... */
+	(void) self;
+}
+
+static void mem_own_close(nnc_memory *self)
+{
+	free(self->un.ptr);
+}
+
+static u64 mem_tell(nnc_memory *self)
+{
+	return self->pos;
+}
+
+/* the clone never owns the buffer */
+static result mem_clone(nnc_memory *self, nnc_rstream **out)
+{
+	nnc_memory *clone = malloc(sizeof(nnc_memory));
+	if(!clone) return NNC_R_NOMEM;
+	nnc_mem_open(clone, self->un.ptr_const, self->size);
+	*out = NNC_RSP(clone);
+	return NNC_R_OK;
+}
+
+static const nnc_rstream_funcs mem_funcs = {
+	.read = (nnc_read_func) mem_read,
+	.seek_abs = (nnc_seek_abs_func) mem_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) mem_seek_rel,
+	.size = (nnc_size_func) mem_size,
+	.close = (nnc_close_func) mem_close,
+	.tell = (nnc_tell_func) mem_tell,
+	.read_at = (nnc_read_at_func) mem_read_at,
+	.borrow = (nnc_borrow_func) mem_borrow,
+	.clone = (nnc_clone_func) mem_clone,
+};
+
+static const nnc_rstream_funcs mem_own_funcs = {
+	.read = (nnc_read_func) mem_read,
+	.seek_abs = (nnc_seek_abs_func) mem_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) mem_seek_rel,
+	.size = (nnc_size_func) mem_size,
+	.close = (nnc_close_func) mem_own_close,
+	.tell = (nnc_tell_func) mem_tell,
+	.read_at = (nnc_read_at_func) mem_read_at,
+	.borrow = (nnc_borrow_func) mem_borrow,
+	.clone = (nnc_clone_func) mem_clone,
+};
+
+void nnc_mem_open(nnc_memory *self, const void *ptr, u64 size)
+{
+	self->funcs = &mem_funcs;
+	self->size = size;
+	self->un.ptr_const = ptr;
+	self->pos = 0;
+}
+
+void nnc_mem_own_open(nnc_memory *self, void *ptr, u64 size)
+{
+	self->funcs = &mem_own_funcs;
+	self->size = size;
+	self->un.ptr = ptr;
+	self->pos = 0;
+}
+
+/* nnc_wmemory */
+
+static result wmem_reserve(nnc_wmemory *self, u64 end)
+{
+	if(end <= self->capacity) return NNC_R_OK;
+	u64 ncap = MAX(self->capacity * 2, 0x1000);
+	while(ncap < end)
+	{
+		if(ncap > UINT64_MAX / 2) return NNC_R_NOMEM;
+		ncap *= 2;
+	}
+	if(ncap != (size_t) ncap) return NNC_R_NOMEM;
+	u8 *nbuf = realloc(self->buf, ncap);
+	if(!nbuf) return NNC_R_NOMEM;
+	self->buf = nbuf;
+	self->capacity = ncap;
+	return NNC_R_OK;
+}
+
+/* makes room for count bytes at the position, zeroing the gap if it is past the end */
+static result wmem_prepare(nnc_wmemory *self, u64 count)
+{
+	result ret;
+	TRY(wmem_reserve(self, self->pos + count));
+	if(self->pos > self->size)
+		memset(self->buf + self->size, 0x00, self->pos - self->size);
+	return NNC_R_OK;
+}
+
+static result wmem_write(nnc_wmemory *self, u8 *buf, u32 size)
+{
+	result ret;
+	TRY(wmem_prepare(self, size));
+	memcpy(self->buf + self->pos, buf, size);
+	self->pos += size;
+	self->size = MAX(self->size, self->pos);
+	return NNC_R_OK;
+}
+
+static result wmem_skip(nnc_wmemory *self, u64 count)
+{
+	result ret;
+	TRY(wmem_prepare(self, count));
+	memset(self->buf + self->pos, 0x00, count);
+	self->pos += count;
+	self->size = MAX(self->size, self->pos);
+	return NNC_R_OK;
+}
+
+static result wmem_seek(nnc_wmemory *self, u64 pos)
+{
+	self->pos = pos;
+	return NNC_R_OK;
+}
+
+static u64 wmem_tell(nnc_wmemory *self)
+{ return self->pos; }
+
+static result wmem_close(nnc_wmemory *self)
+{
+	free(self->buf);
+	self->buf = NULL;
+	self->size = self->capacity = self->pos = 0;
+	return NNC_R_OK;
+}
+
+static result wmem_subreadstream(nnc_wmemory *self, nnc_subview *out, u64 start, u64 len)
+{
+	if(start > self->size || len > self->size - start)
+		return NNC_R_SEEK_RANGE;
+	nnc_memory *mem = malloc(sizeof(nnc_memory));
+	if(!mem) return NNC_R_NOMEM;
+	nnc_mem_open(mem, self->buf, self->size);
+	nnc_subview_open(out, NNC_RSP(mem), start, len);
+	nnc_subview_delete_on_close(out);
+	return NNC_R_OK;
+}
+
+static const nnc_wstream_funcs wmem_funcs = {
+	.write = (nnc_write_func) wmem_write,
+	.close = (nnc_wclose_func) wmem_close,
+	.seek = (nnc_wseek_func) wmem_seek,
+	.tell = (nnc_wtell_func) wmem_tell,
+	.subreadstream = (nnc_wsubreadstream_func) wmem_subreadstream,
+	.skip = (nnc_wskip_func) wmem_skip,
+};
+
+result nnc_wmemory_open(nnc_wmemory *self, u64 capacity)
+{
+	self->funcs = &wmem_funcs;
+	self->buf = NULL;
+	self->size = self->capacity = self->pos = 0;
+	if(capacity == 0) return NNC_R_OK;
+	if(capacity != (size_t) capacity || !(self->buf = malloc(capacity)))
+		return NNC_R_NOMEM;
+	self->capacity = capacity;
+	return NNC_R_OK;
+}
+
+void nnc_wmemory_to_rstream(nnc_wmemory *self, nnc_memory *out)
+{
+	nnc_mem_own_open(out, self->buf, self->size);
+	self->buf = NULL;
+	self->size = self->capacity = self->pos = 0;
+}
+
+/* nnc_wcounter */
+
+static result wcounter_skip(nnc_wcounter *self, u64 count)
+{
+	self->pos += count;
+	self->size = MAX(self->size, self->pos);
+	return NNC_R_OK;
+}
+
+static result wcounter_write(nnc_wcounter *self, u8 *buf, u32 size)
+{
+	(void) buf;
+	return wcounter_skip(self, size);
+}
+
+static result wcounter_seek(nnc_wcounter *self, u64 pos)
+{
+	self->pos = pos;
+	return NNC_R_OK;
+}
+
+static u64 wcounter_tell(nnc_wcounter *self)
+{ return self->pos; }
+
+static result wcounter_close(nnc_wcounter *self)
+{
+	(void) self;
+	return NNC_R_OK;
+}
+
+static const nnc_wstream_funcs wcounter_funcs = {
+	.write = (nnc_write_func) wcounter_write,
+	.close = (nnc_wclose_func) wcounter_close,
+	.seek = (nnc_wseek_func) wcounter_seek,
+	.tell = (nnc_wtell_func) wcounter_tell,
+	.skip = (nnc_wskip_func) wcounter_skip,
+};
+
+void nnc_wcounter_open(nnc_wcounter *self)
+{
+	self->funcs = &wcounter_funcs;
+	self->size = self->pos = 0;
+}
+
+enum nnc_subview_flags {
+	NNC_SUBVIEW_DELETE_ON_CLOSE = 1,
+};
+
+static result subview_read_at(nnc_subview *self, u64 pos, u8 *buf, u32 max, u32 *totalRead)
+{
+	if(pos >= self->size)
+	{
+		*totalRead = 0;
+		return NNC_R_OK;
+	}
+	max = MIN(max, self->size - pos);
+	/* only seeks the child if it has no positional read, subview_funcs has no read_at then */
+	return nnc_rs_read_at(self->child, self->off + pos, buf, max, totalRead);
+}
+
+static result subview_read(nnc_subview *self, u8 *buf, u32 max, u32 *totalRead)
+{
+	result ret = subview_read_at(self, self->pos, buf, max, totalRead);
+	if(ret == NNC_R_OK) self->pos += *totalRead;
+	return ret;
+}
+
+static result subview_borrow(nnc_subview *self, u64 pos, u64 len, const u8 **ptr)
+{
+	if(pos > self->size || len > self->size - pos) return NNC_R_SEEK_RANGE;
+	return nnc_rs_borrow(self->child, self->off + pos, len, ptr);
+}
+
+static result subview_advise(nnc_subview *self, u64 pos, u64 len, int advice)
+{
+	if(pos >= self->size) return NNC_R_OK;
+	return nnc_rs_advise(self->child, self->off + pos, MIN(len, self->size - pos), advice);
+}
+
+static result subview_locate(nnc_subview *self, u64 pos, u64 len, int *fd, u64 *fd_pos)
+{
+	if(pos > self->size || len > self->size - pos) return NNC_R_SEEK_RANGE;
+	return nnc_rs_locate(self->child, self->off + pos, len, fd, fd_pos);
+}
+
+static result subview_seek_abs(nnc_subview *self, u64 pos)
+{
+	if(pos > self->size) return NNC_R_SEEK_RANGE;
+	self->pos = pos;
+	return NNC_R_OK;
+}
+
+static result subview_seek_rel(nnc_subview *self, u64 pos)
+{
+	u64 npos = self->pos + pos;
+	if(npos > self->size) return NNC_R_SEEK_RANGE;
+	self->pos = npos;
+	return NNC_R_OK;
+}
+
+static u64 subview_size(nnc_subview *self)
+{
+	return self->size;
+}
+
+static void subview_close(nnc_subview *self)
+{
+	if(self->flags & NNC_SUBVIEW_DELETE_ON_CLOSE)
+	{
+		NNC_RS_PCALL0(self->child, close);
+		free(self->child);
+	}
+}
+
+static nnc_u64 subview_tell(nnc_subview *self)
+{
+	return self->pos;
+}
+
+static result subview_clone(nnc_subview *self, nnc_rstream **out)
+{
+	nnc_subview *clone = malloc(sizeof(nnc_subview));
+	if(!clone) return NNC_R_NOMEM;
+	nnc_rstream *child;
+	result ret = nnc_rs_clone(self->child, &child);
+	if(ret != NNC_R_OK) return free(clone), ret;
+	nnc_subview_open(clone, child, self->off, self->size);
+	nnc_subview_delete_on_close(clone);
+	*out = NNC_RSP(clone);
+	return NNC_R_OK;
+}
+
+static const nnc_rstream_funcs subview_funcs = {
+	.read = (nnc_read_func) subview_read,
+	.seek_abs = (nnc_seek_abs_func) subview_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) subview_seek_rel,
+	.size = (nnc_size_func) subview_size,
+	.close = (nnc_close_func) subview_close,
+	.tell = (nnc_tell_func) subview_tell,
+	.borrow = (nnc_borrow_func) subview_borrow,
+	.locate = (nnc_locate_func) subview_locate,
+	.advise = (nnc_advise_func) subview_advise,
+	.clone = (nnc_clone_func) subview_clone,
+};
+
+static const nnc_rstream_funcs subview_at_funcs = {
+	.read = (nnc_read_func) subview_read,
+	.seek_abs = (nnc_seek_abs_func) subview_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) subview_seek_rel,
+	.size = (nnc_size_func) subview_size,
+	.close = (nnc_close_func) subview_close,
+	.tell = (nnc_tell_func) subview_tell,
+	.read_at = (nnc_read_at_func) subview_read_at,
+	.borrow = (nnc_borrow_func) subview_borrow,
+	.locate = (nnc_locate_func) subview_locate,
+	.advise = (nnc_advise_func) subview_advise,
+	.clone = (nnc_clone_func) subview_clone,
+};
+
+void nnc_subview_open(nnc_subview *self, nnc_rstream *child, nnc_u64 off, nnc_u64 len)
+{
+	self->funcs = child->funcs->read_at ? &subview_at_funcs : &subview_funcs;
+	self->flags = 0;
+	self->child = child;
+	self->size = len;
+	self->off = off;
+	self->pos = 0;
+}
+
+void nnc_subview_delete_on_close(nnc_subview *self)
+{
+	self->flags |= NNC_SUBVIEW_DELETE_ON_CLOSE;
+}
+
+/* nnc_buffered_rstream */
+
+static result buffered_fill(nnc_buffered_rstream *self, u64 pos, u8 *buf, u32 max, u32 *totalRead)
 {
-	self->funcs = child->funcs->seek ? &hdrsaver_funcs_seekable : &hdrsaver_funcs;
-	self->child = child;
-	self->count = count;
-	self->start = NNC_WS_PCALL0(child, tell);
-	self->pos   = self->start;
+	return nnc_rs_read_at(self->child, pos, buf, max, totalRead);
+}
 
-	self->buffer = malloc(count);
-	return self->buffer ? NNC_R_OK : NNC_R_NOMEM;
+static result buffered_read_at(nnc_buffered_rstream *self, u64 pos, u8 *buf, u32 max, u32 *totalRead)
+{
+	return ra_read(self->ra, pos, buf, max, totalRead, (ra_fill_func) buffered_fill, self);
 }
 
-static result mem_read(nnc_memory *self, u8 *buf, u32 max, u32 *totalRead)
+static result buffered_read(nnc_buffered_rstream *self, u8 *buf, u32 max, u32 *totalRead)
 {
-	*totalRead = MIN(max, self->size);
-	memcpy(buf, ((u8 *) self->un.ptr_const) + self->pos, *totalRead);
+	result ret;
+	TRY(buffered_read_at(self, self->pos, buf, max, totalRead));
 	self->pos += *totalRead;
 	return NNC_R_OK;
 }
 
-static result mem_seek_abs(nnc_memory *self, u32 pos)
+static result buffered_borrow(nnc_buffered_rstream *self, u64 pos, u64 len, const u8 **ptr)
 {
-	if(pos >= self->size) return NNC_R_SEEK_RANGE;
-	self->pos = pos;
-	return NNC_R_OK;
+	return nnc_rs_borrow(self->child, pos, len, ptr);
 }
 
-static result mem_seek_rel(nnc_memory *self, u32 pos)
+static result buffered_locate(nnc_buffered_rstream *self, u64 pos, u64 len, int *fd, u64 *fd_pos)
 {
-	u32 npos = self->pos + pos;
-	if(npos >= self->size) return NNC_R_SEEK_RANGE;
-	self->pos = npos;
-	return NNC_R_OK;
+	return nnc_rs_locate(self->child, pos, len, fd, fd_pos);
 }
 
-static u32 mem_size(nnc_memory *self)
+static result buffered_advise(nnc_buffered_rstream *self, u64 pos, u64 len, int advice)
 {
-	return self->size;
+	return nnc_rs_advise(self->child, pos, len, advice);
 }
 
-static void mem_close(nnc_memory *self)
+static result buffered_seek_abs(nnc_buffered_rstream *self, u64 pos)
 {
-	/* nothing to do ... */
-	(void) self;
+	if(pos > NNC_RS_PCALL0(self->child, size)) return NNC_R_SEEK_RANGE;
+	self->pos = pos;
+	return NNC_R_OK;
 }
 
-static void mem_own_close(nnc_memory *self)
+static result buffered_seek_rel(nnc_buffered_rstream *self, u64 pos)
 {
-	free(self->un.ptr);
+	return buffered_seek_abs(self, self->pos + pos);
 }
 
-static u32 mem_tell(nnc_memory *self)
+static u64 buffered_size(nnc_buffered_rstream *self) { return NNC_RS_PCALL0(self->child, size); }
+static u64 buffered_tell(nnc_buffered_rstream *self) { return self->pos; }
+
+static void buffered_close(nnc_buffered_rstream *self)
 {
-	return self->pos;
+	ra_free(self->ra);
+	self->ra = NULL;
 }
 
-static const nnc_rstream_funcs mem_funcs = {
-	.read = (nnc_read_func) mem_read,
-	.seek_abs = (nnc_seek_abs_func) mem_seek_abs,
-	.seek_rel = (nnc_seek_rel_func) mem_seek_rel,
-	.size = (nnc_size_func) mem_size,
-	.close = (nnc_close_func) mem_close,
-	.tell = (nnc_tell_func) mem_tell,
+/* a clone has its own buffer and owns a clone of the child */
+struct buffered_clone {
+	nnc_buffered_rstream buffered;
+	nnc_rstream_funcs table;
 };
 
-static const nnc_rstream_funcs mem_own_funcs = {
-	.read = (nnc_read_func) mem_read,
-	.seek_abs = (nnc_seek_abs_func) mem_seek_abs,
-	.seek_rel = (nnc_seek_rel_func) mem_seek_rel,
-	.size = (nnc_size_func) mem_size,
-	.close = (nnc_close_func) mem_own_close,
-	.tell = (nnc_tell_func) mem_tell,
-};
+static void buffered_clone_close(nnc_buffered_rstream *self)
+{
+	buffered_close(self);
+	nnc_rs_close(self->child);
+	free(self->child);
+}
 
-void nnc_mem_open(nnc_memory *self, const void *ptr, u32 size)
+static result buffered_clone(nnc_buffered_rstream *self, nnc_rstream **out)
 {
-	self->funcs = &mem_funcs;
-	self->size = size;
-	self->un.ptr_const = ptr;
-	self->pos = 0;
+	struct buffered_clone *clone = malloc(sizeof(struct buffered_clone));
+	if(!clone) return NNC_R_NOMEM;
+	nnc_rstream *child;
+	result ret = nnc_rs_clone(self->child, &child);
+	if(ret != NNC_R_OK) return free(clone), ret;
+	if((ret = nnc_buffered_rstream_open(&clone->buffered, child, self->ra->window)) != NNC_R_OK)
+	{
+		nnc_rs_close(child);
+		free(child);
+		free(clone);
+		return ret;
+	}
+	clone->table = *clone->buffered.funcs;
+	clone->table.close = (nnc_close_func) buffered_clone_close;
+	clone->buffered.funcs = &clone->table;
+	*out = NNC_RSP(clone);
+	return NNC_R_OK;
 }
 
-void nnc_mem_own_open(nnc_memory *self, void *ptr, u32 size)
+static const nnc_rstream_funcs buffered_funcs = {
+	.read = (nnc_read_func) buffered_read,
+	.seek_abs = (nnc_seek_abs_func) buffered_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) buffered_seek_rel,
+	.size = (nnc_size_func) buffered_size,
+	.close = (nnc_close_func) buffered_close,
+	.tell = (nnc_tell_func) buffered_tell,
+	.read_at = (nnc_read_at_func) buffered_read_at,
+	.borrow = (nnc_borrow_func) buffered_borrow,
+	.locate = (nnc_locate_func) buffered_locate,
+	.advise = (nnc_advise_func) buffered_advise,
+	.clone = (nnc_clone_func) buffered_clone,
+};
+
+nnc_result nnc_buffered_rstream_open(nnc_buffered_rstream *self, nnc_rstream *child, nnc_u32 window)
 {
-	self->funcs = &mem_own_funcs;
-	self->size = size;
-	self->un.ptr = ptr;
+	/* nnc_rs_read_at falls back to seeking the child if it has no read_at */
+	if(!(self->ra = ra_alloc(window ? window : NNC_BUFFERED_DEFAULT_WINDOW, child->funcs->read_at != NULL)))
+		return NNC_R_NOMEM;
+	self->funcs = &buffered_funcs;
+	self->child = child;
 	self->pos = 0;
+	return NNC_R_OK;
 }
 
-enum nnc_subview_flags {
-	NNC_SUBVIEW_DELETE_ON_CLOSE = 1,
-};
+/* nnc_mmap_file */
 
-static result subview_read(nnc_subview *self, u8 *buf, u32 max, u32 *totalRead)
+#if NNC_PLATFORM_UNIX
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#define MMAP_API 1
+#elif NNC_PLATFORM_WINDOWS
+	#include <windows.h>
+	#define MMAP_API 1
+#endif
+
+#if MMAP_API
+
+static result mmap_read(nnc_mmap_file *self, u8 *buf, u32 max, u32 *totalRead)
 {
-	u32 sizeleft = self->size - self->pos;
-	max = MIN(max, sizeleft);
-	result ret;
-	/* seek to correct offset in child */
-	TRY(NNC_RS_PCALL(self->child, seek_abs, self->off + self->pos));
-	ret = NNC_RS_PCALL(self->child, read, buf, max, totalRead);
+	*totalRead = MIN(max, self->size - self->pos);
+	memcpy(buf, self->ptr + self->pos, *totalRead);
 	self->pos += *totalRead;
-	return ret;
+	return NNC_R_OK;
 }
 
-static result subview_seek_abs(nnc_subview *self, u32 pos)
+static result mmap_read_at(nnc_mmap_file *self, u64 pos, u8 *buf, u32 max, u32 *totalRead)
 {
-	if(pos >= self->size) return NNC_R_SEEK_RANGE;
-	self->pos = pos;
+	*totalRead = pos < self->size ? MIN(max, self->size - pos) : 0;
+	memcpy(buf, self->ptr + pos, *totalRead);
 	return NNC_R_OK;
 }
 
-static result subview_seek_rel(nnc_subview *self, u32 pos)
+static result mmap_borrow(nnc_mmap_file *self, u64 pos, u64 len, const u8 **ptr)
 {
-	u32 npos = self->pos + pos;
-	if(npos >= self->size) return NNC_R_SEEK_RANGE;
-	self->pos = npos;
+	if(pos > self->size || len > self->size - pos) return NNC_R_SEEK_RANGE;
+	*ptr = self->ptr + pos;
 	return NNC_R_OK;
 }
 
-static u32 subview_size(nnc_subview *self)
+static result mmap_seek_abs(nnc_mmap_file *self, u64 pos)
 {
-	return self->size;
+	if(pos > self->size) return NNC_R_SEEK_RANGE;
+	self->pos = pos;
+	return NNC_R_OK;
 }
 
-static void subview_close(nnc_subview *self)
+static result mmap_seek_rel(nnc_mmap_file *self, u64 pos)
 {
-	if(self->flags & NNC_SUBVIEW_DELETE_ON_CLOSE)
-	{
-		NNC_RS_PCALL0(self->child, close);
-		free(self->child);
-	}
+	return mmap_seek_abs(self, self->pos + pos);
 }
 
-static nnc_u32 subview_tell(nnc_subview *self)
+#if NNC_PLATFORM_UNIX
+static result mmap_advise(nnc_mmap_file *self, u64 pos, u64 len, int advice)
+{
+	static const int madv[] = {
+		[NNC_ADVISE_NORMAL]     = MADV_NORMAL,
+		[NNC_ADVISE_SEQUENTIAL] = MADV_SEQUENTIAL,
+		[NNC_ADVISE_RANDOM]     = MADV_RANDOM,
+		[NNC_ADVISE_WILLNEED]   = MADV_WILLNEED,
+		[NNC_ADVISE_DONTNEED]   = MADV_DONTNEED,
+	};
+	if(advice < 0 || advice > NNC_ADVISE_DONTNEED) return NNC_R_INVAL;
+	if(pos >= self->size || !len) return NNC_R_OK;
+	len = MIN(len, self->size - pos);
+	/* madvise wants a page aligned address */
+	u64 page = sysconf(_SC_PAGESIZE), start = pos - pos % page;
+	return madvise((void *) (self->ptr + start), len + (pos - start), madv[advice]) == 0
+		? NNC_R_OK : NNC_R_UNSUPPORTED;
+}
+	#define MMAP_ADVISE ((nnc_advise_func) mmap_advise)
+#else
+	#define MMAP_ADVISE NULL
+#endif
+
+static u64 mmap_size(nnc_mmap_file *self) { return self->size; }
+static u64 mmap_tell(nnc_mmap_file *self) { return self->pos; }
+
+/* the clone is a plain memory stream over the mapping, which stays owned by self */
+static result mmap_clone(nnc_mmap_file *self, nnc_rstream **out)
 {
-	return self->pos;
+	nnc_memory *clone = malloc(sizeof(nnc_memory));
+	if(!clone) return NNC_R_NOMEM;
+	nnc_mem_open(clone, self->ptr, self->size);
+	*out = NNC_RSP(clone);
+	return NNC_R_OK;
 }
 
-static const nnc_rstream_funcs subview_funcs = {
-	.read = (nnc_read_func) subview_read,
-	.seek_abs = (nnc_seek_abs_func) subview_seek_abs,
-	.seek_rel = (nnc_seek_rel_func) subview_seek_rel,
-	.size = (nnc_size_func) subview_size,
-	.close = (nnc_close_func) subview_close,
-	.tell = (nnc_tell_func) subview_tell,
+static void mmap_close(nnc_mmap_file *self)
+{
+	/* empty files are not mapped */
+	if(!self->ptr) return;
+#if NNC_PLATFORM_UNIX
+	munmap((void *) self->ptr, self->size);
+#else
+	UnmapViewOfFile(self->ptr);
+#endif
+	self->ptr = NULL;
+}
+
+static const nnc_rstream_funcs mmap_funcs = {
+	.read = (nnc_read_func) mmap_read,
+	.seek_abs = (nnc_seek_abs_func) mmap_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) mmap_seek_rel,
+	.size = (nnc_size_func) mmap_size,
+	.close = (nnc_close_func) mmap_close,
+	.tell = (nnc_tell_func) mmap_tell,
+	.read_at = (nnc_read_at_func) mmap_read_at,
+	.borrow = (nnc_borrow_func) mmap_borrow,
+	.advise = MMAP_ADVISE,
+	.clone = (nnc_clone_func) mmap_clone,
 };
 
-void nnc_subview_open(nnc_subview *self, nnc_rstream *child, nnc_u32 off, nnc_u32 len)
+nnc_result nnc_mmap_file_open(nnc_mmap_file *self, const char *name)
 {
-	self->funcs = &subview_funcs;
-	self->flags = 0;
-	self->child = child;
-	self->size = len;
-	self->off = off;
+	self->ptr = NULL;
 	self->pos = 0;
+#if NNC_PLATFORM_UNIX
+	int fd = open(name, O_RDONLY);
+	if(fd < 0) return NNC_R_FAIL_OPEN;
+	struct stat st;
+	if(fstat(fd, &st) != 0)
+		return close(fd), NNC_R_FAIL_OPEN;
+	if((u64) st.st_size > SIZE_MAX)
+		return close(fd), NNC_R_TOO_LARGE;
+	self->size = st.st_size;
+	if(self->size)
+	{
+		void *ptr = mmap(NULL, self->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		/* the mapping keeps the file referenced */
+		close(fd);
+		if(ptr == MAP_FAILED) return NNC_R_FAIL_OPEN;
+		/* most consumers hash or extract front-to-back */
+		madvise(ptr, self->size, MADV_SEQUENTIAL);
+		self->ptr = ptr;
+	}
+	else close(fd);
+#else
+	HANDLE file = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(file == INVALID_HANDLE_VALUE) return NNC_R_FAIL_OPEN;
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file, &size))
+		return CloseHandle(file), NNC_R_FAIL_OPEN;
+	if((u64) size.QuadPart > SIZE_MAX)
+		return CloseHandle(file), NNC_R_TOO_LARGE;
+	self->size = size.QuadPart;
+	if(self->size)
+	{
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		CloseHandle(file);
+		if(!mapping) return NNC_R_FAIL_OPEN;
+		/* the view keeps the mapping referenced */
+		self->ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping);
+		if(!self->ptr) return NNC_R_FAIL_OPEN;
+	}
+	else CloseHandle(file);
+#endif
+	self->funcs = &mmap_funcs;
+	return NNC_R_OK;
 }
 
-void nnc_subview_delete_on_close(nnc_subview *self)
+#else
+
+nnc_result nnc_mmap_file_open(nnc_mmap_file *self, const char *name)
 {
-	self->flags |= NNC_SUBVIEW_DELETE_ON_CLOSE;
+	(void) self;
+	(void) name;
+	return NNC_R_UNSUPPORTED;
 }
 
+#endif
+
 /* ... vfs code ... */
 
 #define DEFAULT_FILE_CHILDREN_ALLOC 8
@@ -761,10 +1826,14 @@ nnc_vfs_directory_node *nnc_vfs_directory_by_name(nnc_vfs_directory_node *root_d
 }
 
 static result vfs_stream_read(nnc_vfs_stream *self, u8 *buf, u32 max, u32 *totalRead) { return self->substream->funcs->read(self->substream, buf, max, totalRead); }
-static result vfs_stream_seek_abs(nnc_vfs_stream *self, u32 pos) { return self->substream->funcs->seek_abs(self->substream, pos); }
-static result vfs_stream_seek_rel(nnc_vfs_stream *self, u32 pos) { return self->substream->funcs->seek_rel(self->substream, pos); }
-static u32 vfs_stream_size(nnc_vfs_stream *self) { return self->substream->funcs->size(self->substream); }
-static u32 vfs_stream_tell(nnc_vfs_stream *self) { return self->substream->funcs->tell(self->substream); }
+static result vfs_stream_seek_abs(nnc_vfs_stream *self, u64 pos) { return self->substream->funcs->seek_abs(self->substream, pos); }
+static result vfs_stream_seek_rel(nnc_vfs_stream *self, u64 pos) { return self->substream->funcs->seek_rel(self->substream, pos); }
+static u64 vfs_stream_size(nnc_vfs_stream *self) { return self->substream->funcs->size(self->substream); }
+static u64 vfs_stream_tell(nnc_vfs_stream *self) { return self->substream->funcs->tell(self->substream); }
+static result vfs_stream_read_at(nnc_vfs_stream *self, u64 pos, u8 *buf, u32 max, u32 *totalRead) { return self->substream->funcs->read_at(self->substream, pos, buf, max, totalRead); }
+static result vfs_stream_borrow(nnc_vfs_stream *self, u64 pos, u64 len, const u8 **ptr) { return nnc_rs_borrow(self->substream, pos, len, ptr); }
+static result vfs_stream_locate(nnc_vfs_stream *self, u64 pos, u64 len, int *fd, u64 *fd_pos) { return nnc_rs_locate(self->substream, pos, len, fd, fd_pos); }
+static result vfs_stream_advise(nnc_vfs_stream *self, u64 pos, u64 len, int advice) { return nnc_rs_advise(self->substream, pos, len, advice); }
 static void vfs_stream_close(nnc_vfs_stream *self)
 {
 	if(self->flags & NNC_VFS_STREAM_RECURSIVE_CLOSE)
@@ -773,6 +1842,18 @@ static void vfs_stream_close(nnc_vfs_stream *self)
 		free(self->substream);
 }
 
+static result vfs_stream_clone(nnc_vfs_stream *self, nnc_rstream **out)
+{
+	nnc_vfs_stream *clone = malloc(sizeof(nnc_vfs_stream));
+	if(!clone) return NNC_R_NOMEM;
+	nnc_rstream *substream;
+	result ret = nnc_rs_clone(self->substream, &substream);
+	if(ret != NNC_R_OK) return free(clone), ret;
+	nnc_vfs_open_stream(clone, substream, NNC_VFS_STREAM_FULL_CLOSE);
+	*out = NNC_RSP(clone);
+	return NNC_R_OK;
+}
+
 static const nnc_rstream_funcs vfs_stream_funcs = {
 	.read = (nnc_read_func) vfs_stream_read,
 	.seek_abs = (nnc_seek_abs_func) vfs_stream_seek_abs,
@@ -780,11 +1861,30 @@ static const nnc_rstream_funcs vfs_stream_funcs = {
 	.size = (nnc_size_func) vfs_stream_size,
 	.close = (nnc_close_func) vfs_stream_close,
 	.tell = (nnc_tell_func) vfs_stream_tell,
+	.borrow = (nnc_borrow_func) vfs_stream_borrow,
+	.locate = (nnc_locate_func) vfs_stream_locate,
+	.advise = (nnc_advise_func) vfs_stream_advise,
+	.clone = (nnc_clone_func) vfs_stream_clone,
+};
+
+/* used if the substream supports positional reads */
+static const nnc_rstream_funcs vfs_stream_at_funcs = {
+	.read = (nnc_read_func) vfs_stream_read,
+	.seek_abs = (nnc_seek_abs_func) vfs_stream_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) vfs_stream_seek_rel,
+	.size = (nnc_size_func) vfs_stream_size,
+	.close = (nnc_close_func) vfs_stream_close,
+	.tell = (nnc_tell_func) vfs_stream_tell,
+	.read_at = (nnc_read_at_func) vfs_stream_read_at,
+	.borrow = (nnc_borrow_func) vfs_stream_borrow,
+	.locate = (nnc_locate_func) vfs_stream_locate,
+	.advise = (nnc_advise_func) vfs_stream_advise,
+	.clone = (nnc_clone_func) vfs_stream_clone,
 };
 
 void nnc_vfs_open_stream(nnc_vfs_stream *self, nnc_rstream *substream, int flags)
 {
-	self->funcs = &vfs_stream_funcs;
+	self->funcs = substream->funcs->read_at ? &vfs_stream_at_funcs : &vfs_stream_funcs;
 	self->substream = substream;
 	self->flags = flags;
 }
@@ -816,9 +1916,9 @@ static nnc_result nnc_filegen_make_reader(nnc_vfs_generator_data udata, nnc_vfs_
 	nnc_file *reader = malloc(sizeof(nnc_file));
 	if(!reader) return NNC_R_NOMEM;
 	nnc_result res = nnc_file_open(reader, data->path);
-	if(res != NNC_R_OK) free(reader);
+	if(res != NNC_R_OK) return free(reader), res;
 	nnc_vfs_open_stream(out, (nnc_rstream *) reader, NNC_VFS_STREAM_FULL_CLOSE);
-	return res;
+	return NNC_R_OK;
 }
 
 static nnc_u64 nnc_filegen_node_size(nnc_vfs_generator_data udata)
@@ -931,14 +2031,180 @@ const nnc_vfs_reader_generator nnc__internal_vfs_generator_reader_copy = {
 
 //
 
-nnc_result nnc_copy(nnc_rstream *from, nnc_wstream *to, u32 *copied)
+#define COPY_DEPTH 4
+/* starting the thread pool of nnc_aio only pays off for large copies */
+#define COPY_THREADS_MIN 0x1000000
+
+/* on the heap, a read that could not be waited for may still write to it */
+struct copy_async_ctx {
+	nnc_aio_request reqs[COPY_DEPTH];
+	bool finished[COPY_DEPTH];
+	u8 buffers[COPY_DEPTH * BLOCK_SZ];
+};
+
+/* keeps COPY_DEPTH reads in flight while writing out the blocks in order */
+static result copy_async(nnc_aio *aio, nnc_wstream *to, u64 size, struct copy_async_ctx *ctx)
+{
+	nnc_aio_request *req;
+	u64 nblocks = size / BLOCK_SZ + (size % BLOCK_SZ != 0), submitted = 0, written = 0;
+	result ret = NNC_R_OK;
+
+	for(; submitted < nblocks && submitted < COPY_DEPTH; ++submitted)
+	{
+		req = &ctx->reqs[submitted];
+		req->offset = submitted * BLOCK_SZ;
+		req->buf = ctx->buffers + submitted * BLOCK_SZ;
+		req->len = MIN(size - req->offset, BLOCK_SZ);
+		req->udata = &ctx->finished[submitted];
+		ctx->finished[submitted] = false;
+		if((ret = nnc_aio_submit(aio, req)) != NNC_R_OK) goto out;
+	}
+	for(; written != nblocks; ++written)
+	{
+		u32 slot = written % COPY_DEPTH;
+		while(!ctx->finished[slot])
+		{
+			if((ret = nnc_aio_complete(aio, &req)) != NNC_R_OK) goto out;
+			*(bool *) req->udata = true;
+		}
+		req = &ctx->reqs[slot];
+		if((ret = req->res) != NNC_R_OK) goto out;
+		if(req->read != req->len) { ret = NNC_R_TOO_SMALL; goto out; }
+		if((ret = NNC_WS_PCALL(to, write, req->buf, req->len)) != NNC_R_OK) goto out;
+		ctx->finished[slot] = false;
+		/* reuse the slot for the next block, this is the slot that would be used anyway */
+		if(submitted != nblocks)
+		{
+			req->offset = submitted * BLOCK_SZ;
+			req->len = MIN(size - req->offset, BLOCK_SZ);
+			if((ret = nnc_aio_submit(aio, req)) != NNC_R_OK) goto out;
+			++submitted;
+		}
+	}
+out:
+	/* the other reads are still in flight if this stopped early */
+	while(nnc_aio_pending(aio) && nnc_aio_complete(aio, &req) == NNC_R_OK)
+		;
+	return ret;
+}
+
+#if NNC_PLATFORM_UNIX && defined(__linux__)
+/* copies from one file descriptor to another in the kernel, *done is set to the
+ * amount copied before the kernel refused to copy more */
+static result copy_kernel(int in_fd, u64 in_pos, int out_fd, u64 out_pos, u64 size, u64 *done)
+{
+	/* copying within a file could overlap */
+	struct stat in_st, out_st;
+	*done = 0;
+	if(fstat(in_fd, &in_st) != 0 || fstat(out_fd, &out_st) != 0
+		|| (in_st.st_dev == out_st.st_dev && in_st.st_ino == out_st.st_ino))
+		return NNC_R_UNSUPPORTED;
+
+	bool use_sendfile = false;
+#ifndef SYS_copy_file_range
+	use_sendfile = true;
+#endif
+	if(use_sendfile && lseek(out_fd, out_pos, SEEK_SET) < 0)
+		return NNC_R_UNSUPPORTED;
+	while(*done != size)
+	{
+		size_t chunk = MIN(size - *done, 0x40000000);
+		ssize_t n = -1;
+		if(!use_sendfile)
+		{
+#ifdef SYS_copy_file_range
+			loff_t ioff = in_pos + *done, ooff = out_pos + *done;
+			n = syscall(SYS_copy_file_range, in_fd, &ioff, out_fd, &ooff, chunk, 0);
+#endif
+			if(n < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP))
+			{
+				/* sendfile writes at the file position */
+				if(lseek(out_fd, out_pos + *done, SEEK_SET) < 0)
+					return NNC_R_UNSUPPORTED;
+				use_sendfile = true;
+				continue;
+			}
+		}
+		else
+		{
+			off_t ioff = in_pos + *done;
+			n = sendfile(out_fd, in_fd, &ioff, chunk);
+			if(n < 0 && (errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+				return NNC_R_UNSUPPORTED;
+		}
+		if(n < 0)
+		{
+			if(errno == EINTR || errno == EAGAIN) continue;
+			return NNC_R_FAIL_WRITE;
+		}
+		if(n == 0) return NNC_R_TOO_SMALL;
+		*done += n;
+	}
+	return NNC_R_OK;
+}
+#endif
+
+nnc_result nnc_copy(nnc_rstream *from, nnc_wstream *to, u64 *copied)
 {
 	u8 block[BLOCK_SZ];
-	u32 left = NNC_RS_PCALL0(from, size), next, actual;
+	u64 left = NNC_RS_PCALL0(from, size), done = 0;
+	u32 next, actual;
 	result ret;
-	TRY(NNC_RS_PCALL(from, seek_abs, 0));
 
-	if(copied) *copied = left;
+	/* only a hint, it doesn't matter if it fails */
+	nnc_rs_advise(from, 0, left, NNC_ADVISE_SEQUENTIAL);
+
+#if NNC_PLATFORM_UNIX && defined(__linux__)
+	int in_fd, out_fd;
+	u64 in_pos, out_pos, start;
+	if(left && to->funcs->locate && to->funcs->seek
+		&& nnc_rs_locate(from, 0, left, &in_fd, &in_pos) == NNC_R_OK)
+	{
+		start = NNC_WS_PCALL0(to, tell);
+		TRY(NNC_WS_PCALL(to, locate, &out_fd, &out_pos));
+		ret = copy_kernel(in_fd, in_pos, out_fd, out_pos, left, &done);
+		/* the stream has to be moved past the data in any case */
+		result seek_ret = NNC_WS_PCALL(to, seek, start + done);
+		if(ret == NNC_R_OK) ret = seek_ret;
+		if(ret == NNC_R_OK)
+		{
+			if(copied) *copied = left;
+			return NNC_RS_PCALL(from, seek_abs, left);
+		}
+		if(ret != NNC_R_UNSUPPORTED) return ret;
+		TRY(seek_ret);
+		/* the rest is copied the slow way */
+		left -= done;
+	}
+#endif
+
+	/* for larger streams, overlap reading with writing */
+	if(done == 0 && left > COPY_DEPTH * BLOCK_SZ)
+	{
+		nnc_aio *aio;
+		struct copy_async_ctx *ctx = malloc(sizeof(struct copy_async_ctx));
+		int flags = left >= COPY_THREADS_MIN ? NNC_AIO_DEFAULT : NNC_AIO_NO_THREADS;
+		if(ctx && nnc_aio_open(&aio, from, COPY_DEPTH, flags) == NNC_R_OK)
+		{
+			if(nnc_aio_get_backend(aio) != NNC_AIO_SYNC)
+			{
+				ret = copy_async(aio, to, left, ctx);
+				/* waits for the reads still in flight, nothing writes to ctx after this */
+				nnc_aio_close(aio);
+				free(ctx);
+				if(ret != NNC_R_OK) return ret;
+				if(copied) *copied = left;
+				/* leave the position where a sequential copy would */
+				return NNC_RS_PCALL(from, seek_abs, left);
+			}
+			nnc_aio_close(aio);
+		}
+		free(ctx);
+	}
+
+	TRY(NNC_RS_PCALL(from, seek_abs, done));
+
+	if(copied) *copied = done + left;
 	while(left != 0)
 	{
 		next = MIN(left, BLOCK_SZ);
@@ -951,23 +2217,103 @@ nnc_result nnc_copy(nnc_rstream *from, nnc_wstream *to, u32 *copied)
 	return NNC_R_OK;
 }
 
-nnc_result nnc_write_padding(nnc_wstream *self, nnc_u32 count)
+nnc_result nnc_write_padding(nnc_wstream *self, nnc_u64 count)
 {
-	u8 buffer[4096];
-	/* if count < sizeof(buffer) it makes no sense to completely fill it with 0s */
-	memset(buffer, 0x00, MIN(count, sizeof(buffer)));
+	if(count && self->funcs->skip)
+		return self->funcs->skip(self, count);
+	return write_zeros(self, count);
+}
 
-	nnc_u32 left = count, to_do;
-	nnc_result ret;
+/* 32-bit compatibility adapters */
 
-	while(left)
+static result compat_read(nnc_compat_rstream *self, u8 *buf, u32 max, u32 *totalRead)
+{
+	return self->child->funcs->read((nnc_rstream *) self->child, buf, max, totalRead);
+}
+
+static result compat_seek_abs(nnc_compat_rstream *self, u64 pos)
+{
+	if(pos > UINT32_MAX) return NNC_R_SEEK_RANGE;
+	return self->child->funcs->seek_abs((nnc_rstream *) self->child, pos);
+}
+
+static result compat_seek_rel(nnc_compat_rstream *self, u64 pos)
+{
+	if(pos > UINT32_MAX) return NNC_R_SEEK_RANGE;
+	return self->child->funcs->seek_rel((nnc_rstream *) self->child, pos);
+}
+
+static u64 compat_size(nnc_compat_rstream *self) { return self->child->funcs->size((nnc_rstream *) self->child); }
+static u64 compat_tell(nnc_compat_rstream *self) { return self->child->funcs->tell((nnc_rstream *) self->child); }
+static void compat_close(nnc_compat_rstream *self) { self->child->funcs->close((nnc_rstream *) self->child); }
+
+static const nnc_rstream_funcs compat_funcs = {
+	.read = (nnc_read_func) compat_read,
+	.seek_abs = (nnc_seek_abs_func) compat_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) compat_seek_rel,
+	.size = (nnc_size_func) compat_size,
+	.close = (nnc_close_func) compat_close,
+	.tell = (nnc_tell_func) compat_tell,
+};
+
+void nnc_compat_rstream_open(nnc_compat_rstream *self, nnc_rstream32 *child)
+{
+	self->funcs = &compat_funcs;
+	self->child = child;
+}
+
+static result compat_write(nnc_compat_wstream *self, u8 *buf, u32 size)
+{
+	return self->child->funcs->write((nnc_wstream *) self->child, buf, size);
+}
+
+static result compat_wclose(nnc_compat_wstream *self) { return self->child->funcs->close((nnc_wstream *) self->child); }
+static u64 compat_wtell(nnc_compat_wstream *self) { return self->child->funcs->tell((nnc_wstream *) self->child); }
+
+static result compat_wseek(nnc_compat_wstream *self, u64 pos)
+{
+	if(pos > UINT32_MAX) return NNC_R_SEEK_RANGE;
+	return self->child->funcs->seek((nnc_wstream *) self->child, pos);
+}
+
+static result compat_wsubreadstream(nnc_compat_wstream *self, nnc_subview *out, u64 start, u64 amount)
+{
+	if(start > UINT32_MAX || amount > UINT32_MAX - start) return NNC_R_SEEK_RANGE;
+	return self->child->funcs->subreadstream((nnc_wstream *) self->child, out, start, amount);
+}
+
+/* indexed by (has seek) | (has subreadstream) << 1 */
+static const nnc_wstream_funcs compat_wfuncs[4] = {
 	{
-		to_do = MIN(left, sizeof(buffer));
-		TRY(self->funcs->write(self, buffer, to_do));
-		left -= to_do;
-	}
+		.write = (nnc_write_func)  compat_write,
+		.close = (nnc_wclose_func) compat_wclose,
+		.tell  = (nnc_wtell_func)  compat_wtell,
+	},
+	{
+		.write = (nnc_write_func)  compat_write,
+		.close = (nnc_wclose_func) compat_wclose,
+		.seek  = (nnc_wseek_func)  compat_wseek,
+		.tell  = (nnc_wtell_func)  compat_wtell,
+	},
+	{
+		.write = (nnc_write_func)  compat_write,
+		.close = (nnc_wclose_func) compat_wclose,
+		.tell  = (nnc_wtell_func)  compat_wtell,
+		.subreadstream = (nnc_wsubreadstream_func) compat_wsubreadstream,
+	},
+	{
+		.write = (nnc_write_func)  compat_write,
+		.close = (nnc_wclose_func) compat_wclose,
+		.seek  = (nnc_wseek_func)  compat_wseek,
+		.tell  = (nnc_wtell_func)  compat_wtell,
+		.subreadstream = (nnc_wsubreadstream_func) compat_wsubreadstream,
+	},
+};
 
-	return NNC_R_OK;
+void nnc_compat_wstream_open(nnc_compat_wstream *self, nnc_wstream32 *child)
+{
+	self->funcs = &compat_wfuncs[(child->funcs->seek ? 1 : 0) | (child->funcs->subreadstream ? 2 : 0)];
+	self->child = child;
 }
 
 /* wrapper funcs */
@@ -983,29 +2329,73 @@ nnc_result nnc_rs_read_(nnc_rstream *rs, nnc_u8 *buf, nnc_u32 max, nnc_u32 *tota
 	return NNC_R_OK;
 }
 
-nnc_result nnc_rs_read_at_(nnc_rstream *rs, nnc_u32 pos, nnc_u8 *buf, nnc_u32 max, nnc_u32 *totalRead)
+nnc_result nnc_rs_read_at_(nnc_rstream *rs, nnc_u64 pos, nnc_u8 *buf, nnc_u32 max, nnc_u32 *totalRead)
 {
-	nnc_result res = nnc_rs_seek_abs(rs, pos);
+	if(!rs->funcs) return NNC_R_NOT_OPEN;
+	if(!rs->funcs->read_at)
+	{
+		nnc_result res = nnc_rs_seek_abs(rs, pos);
+		if(res != NNC_R_OK) return res;
+		return nnc_rs_read(rs, buf, max, totalRead);
+	}
+	u32 nread;
+	nnc_result res = rs->funcs->read_at(rs, pos, buf, max, &nread);
 	if(res != NNC_R_OK) return res;
-	return nnc_rs_read(rs, buf, max, totalRead);
+	if(totalRead) *totalRead = nread;
+	else if(/* !totalRead && */ nread != max) return NNC_R_TOO_SMALL;
+	return NNC_R_OK;
+}
+
+nnc_result nnc_rs_borrow_(nnc_rstream *rs, nnc_u64 pos, nnc_u64 len, const nnc_u8 **ptr)
+{
+	if(!rs->funcs) return NNC_R_NOT_OPEN;
+	if(!rs->funcs->borrow) return NNC_R_UNSUPPORTED;
+	return rs->funcs->borrow(rs, pos, len, ptr);
+}
+
+nnc_result nnc_rs_locate_(nnc_rstream *rs, nnc_u64 pos, nnc_u64 len, int *fd, nnc_u64 *fd_pos)
+{
+	if(!rs->funcs) return NNC_R_NOT_OPEN;
+	if(!rs->funcs->locate) return NNC_R_UNSUPPORTED;
+	return rs->funcs->locate(rs, pos, len, fd, fd_pos);
+}
+
+nnc_result nnc_rs_advise_(nnc_rstream *rs, nnc_u64 pos, nnc_u64 len, int advice)
+{
+	if(!rs->funcs) return NNC_R_NOT_OPEN;
+	if(!rs->funcs->advise) return NNC_R_UNSUPPORTED;
+	return rs->funcs->advise(rs, pos, len, advice);
+}
+
+nnc_result nnc_rs_clone_(nnc_rstream *rs, nnc_rstream **out)
+{
+	if(!rs->funcs) return NNC_R_NOT_OPEN;
+	if(rs->funcs->clone) return rs->funcs->clone(rs, out);
+	if(!rs->funcs->read_at) return NNC_R_UNSUPPORTED;
+	/* a subview reads through the positional reads of rs, leaving its position alone */
+	nnc_subview *view = malloc(sizeof(nnc_subview));
+	if(!view) return NNC_R_NOMEM;
+	nnc_subview_open(view, rs, 0, nnc_rs_size(rs));
+	*out = NNC_RSP(view);
+	return NNC_R_OK;
 }
 
-nnc_result nnc_rs_seek_abs_(nnc_rstream *rs, nnc_u32 pos)
+nnc_result nnc_rs_seek_abs_(nnc_rstream *rs, nnc_u64 pos)
 {
 	if(!rs->funcs) return NNC_R_NOT_OPEN;
 	if(nnc_rs_tell(rs) == pos) return NNC_R_OK;
 	return rs->funcs->seek_abs(rs, pos);
 }
 
-nnc_result nnc_rs_seek_rel_(nnc_rstream *rs, nnc_u32 pos)
+nnc_result nnc_rs_seek_rel_(nnc_rstream *rs, nnc_u64 pos)
 {
 	if(!rs->funcs) return NNC_R_NOT_OPEN;
 	if(pos == 0) return NNC_R_OK;
 	return rs->funcs->seek_rel(rs, pos);
 }
 
-nnc_u32 nnc_rs_size_(nnc_rstream *rs) { return rs->funcs ? rs->funcs->size(rs) : 0; }
-nnc_u32 nnc_rs_tell_(nnc_rstream *rs) { return rs->funcs ? rs->funcs->tell(rs) : 0; }
+nnc_u64 nnc_rs_size_(nnc_rstream *rs) { return rs->funcs ? rs->funcs->size(rs) : 0; }
+nnc_u64 nnc_rs_tell_(nnc_rstream *rs) { return rs->funcs ? rs->funcs->tell(rs) : 0; }
 
 void nnc_rs_close_(nnc_rstream *rs)
 {
@@ -0,0 +1,332 @@
+/* pthreads and sysconf(), this has to come before any system header so
+ *  NNC_PLATFORM_* from internal.h can't be used yet */
+#if !defined(_WIN32)
+	#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "./internal.h"
+#include <stdlib.h>
+
+#if NNC_PLATFORM_WINDOWS
+	#include <windows.h>
+#else
+	#include <pthread.h>
+#endif
+#if NNC_PLATFORM_UNIX
+	#include <unistd.h>
+#endif
+
+struct nnc_mutex {
+#if NNC_PLATFORM_WINDOWS
+	CRITICAL_SECTION cs;
+#else
+	pthread_mutex_t mtx;
+#endif
+};
+
+struct nnc_cond {
+#if NNC_PLATFORM_WINDOWS
+	CONDITION_VARIABLE cv;
+#else
+	pthread_cond_t cv;
+#endif
+};
+
+struct nnc_thread {
+#if NNC_PLATFORM_WINDOWS
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+	nnc_thread_func func;
+	void *arg;
+};
+
+nnc_mutex *nnc_mutex_new(void)
+{
+	nnc_mutex *mtx = malloc(sizeof(nnc_mutex));
+	if(!mtx) return NULL;
+#if NNC_PLATFORM_WINDOWS
+	InitializeCriticalSection(&mtx->cs);
+#else
+	if(pthread_mutex_init(&mtx->mtx, NULL) != 0)
+		return free(mtx), NULL;
+#endif
+	return mtx;
+}
+
+void nnc_mutex_lock(nnc_mutex *mtx)
+{
+#if NNC_PLATFORM_WINDOWS
+	EnterCriticalSection(&mtx->cs);
+#else
+	pthread_mutex_lock(&mtx->mtx);
+#endif
+}
+
+void nnc_mutex_unlock(nnc_mutex *mtx)
+{
+#if NNC_PLATFORM_WINDOWS
+	LeaveCriticalSection(&mtx->cs);
+#else
+	pthread_mutex_unlock(&mtx->mtx);
+#endif
+}
+
+void nnc_mutex_free(nnc_mutex *mtx)
+{
+	if(!mtx) return;
+#if NNC_PLATFORM_WINDOWS
+	DeleteCriticalSection(&mtx->cs);
+#else
+	pthread_mutex_destroy(&mtx->mtx);
+#endif
+	free(mtx);
+}
+
+nnc_cond *nnc_cond_new(void)
+{
+	nnc_cond *cond = malloc(sizeof(nnc_cond));
+	if(!cond) return NULL;
+#if NNC_PLATFORM_WINDOWS
+	InitializeConditionVariable(&cond->cv);
+#else
+	if(pthread_cond_init(&cond->cv, NULL) != 0)
+		return free(cond), NULL;
+#endif
+	return cond;
+}
+
+void nnc_cond_wait(nnc_cond *cond, nnc_mutex *mtx)
+{
+#if NNC_PLATFORM_WINDOWS
+	SleepConditionVariableCS(&cond->cv, &mtx->cs, INFINITE);
+#else
+	pthread_cond_wait(&cond->cv, &mtx->mtx);
+#endif
+}
+
+void nnc_cond_signal(nnc_cond *cond)
+{
+#if NNC_PLATFORM_WINDOWS
+	WakeConditionVariable(&cond->cv);
+#else
+	pthread_cond_signal(&cond->cv);
+#endif
+}
+
+void nnc_cond_broadcast(nnc_cond *cond)
+{
+#if NNC_PLATFORM_WINDOWS
+	WakeAllConditionVariable(&cond->cv);
+#else
+	pthread_cond_broadcast(&cond->cv);
+#endif
+}
+
+void nnc_cond_free(nnc_cond *cond)
+{
+	if(!cond) return;
+#if NNC_PLATFORM_WINDOWS
+	/* nothing to do ... */
+#else
+	pthread_cond_destroy(&cond->cv);
+#endif
+	free(cond);
+}
+
+#if NNC_PLATFORM_WINDOWS
+static DWORD WINAPI thread_entry(LPVOID arg)
+#else
+static void *thread_entry(void *arg)
+#endif
+{
+	nnc_thread *thread = arg;
+	thread->func(thread->arg);
+	return 0;
+}
+
+nnc_thread *nnc_thread_create(nnc_thread_func func, void *arg)
+{
+	nnc_thread *thread = malloc(sizeof(nnc_thread));
+	if(!thread) return NULL;
+	thread->func = func;
+	thread->arg = arg;
+#if NNC_PLATFORM_WINDOWS
+	if(!(thread->handle = CreateThread(NULL, 0, thread_entry, thread, 0, NULL)))
+		return free(thread), NULL;
+#else
+	if(pthread_create(&thread->handle, NULL, thread_entry, thread) != 0)
+		return free(thread), NULL;
+#endif
+	return thread;
+}
+
+void nnc_thread_join(nnc_thread *thread)
+{
+#if NNC_PLATFORM_WINDOWS
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+#else
+	pthread_join(thread->handle, NULL);
+#endif
+	free(thread);
+}
+
+u32 nnc_cpu_count(void)
+{
+#if NNC_PLATFORM_WINDOWS
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return si.dwNumberOfProcessors ? si.dwNumberOfProcessors : 1;
+#elif NNC_PLATFORM_UNIX && defined(_SC_NPROCESSORS_ONLN)
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (u32) n : 1;
+#else
+	return 1;
+#endif
+}
+
+/* nnc_parallel_run hands its indices to a pool of threads that is started on the first
+ *  call and grows up to POOL_MAX threads, which then wait for work until the process exits.
+ *  The pool lock is initialized statically so the first calls can race */
+#define POOL_MAX 64
+
+struct pool_job {
+	nnc_parallel_func func;
+	void *arg;
+	u32 count;
+	u32 next; /* next index to hand out */
+	u32 done; /* amount of indices that finished */
+	struct pool_job *link;
+};
+
+#if NNC_PLATFORM_WINDOWS
+static SRWLOCK pool_lock = SRWLOCK_INIT;
+static CONDITION_VARIABLE pool_work = CONDITION_VARIABLE_INIT;
+static CONDITION_VARIABLE pool_done = CONDITION_VARIABLE_INIT;
+#else
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+#endif
+/* jobs with indices left to hand out, oldest first */
+static struct pool_job *pool_jobs;
+static nnc_thread *pool_threads[POOL_MAX];
+static u32 pool_size;
+
+static void pool_enter(void)
+{
+#if NNC_PLATFORM_WINDOWS
+	AcquireSRWLockExclusive(&pool_lock);
+#else
+	pthread_mutex_lock(&pool_lock);
+#endif
+}
+
+static void pool_leave(void)
+{
+#if NNC_PLATFORM_WINDOWS
+	ReleaseSRWLockExclusive(&pool_lock);
+#else
+	pthread_mutex_unlock(&pool_lock);
+#endif
+}
+
+#if NNC_PLATFORM_WINDOWS
+static void pool_wait(CONDITION_VARIABLE *cv)
+{
+	SleepConditionVariableSRW(cv, &pool_lock, INFINITE, 0);
+}
+
+static void pool_wake(CONDITION_VARIABLE *cv)
+{
+	WakeAllConditionVariable(cv);
+}
+#else
+static void pool_wait(pthread_cond_t *cv)
+{
+	pthread_cond_wait(cv, &pool_lock);
+}
+
+static void pool_wake(pthread_cond_t *cv)
+{
+	pthread_cond_broadcast(cv);
+}
+#endif
+
+/* takes the next index of job and unlinks it once all are handed out, the lock must be held */
+static bool pool_take(struct pool_job *job, u32 *index)
+{
+	if(job->next == job->count) return false;
+	*index = job->next++;
+	if(job->next == job->count)
+	{
+		struct pool_job **it = &pool_jobs;
+		while(*it != job) it = &(*it)->link;
+		*it = job->link;
+	}
+	return true;
+}
+
+/* the lock must be held, job may be gone once this wakes its caller */
+static void pool_finish(struct pool_job *job)
+{
+	if(++job->done == job->count)
+		pool_wake(&pool_done);
+}
+
+static void pool_worker(void *arg)
+{
+	struct pool_job *job;
+	u32 index;
+	(void) arg;
+	pool_enter();
+	for(;;)
+	{
+		while(!pool_jobs)
+			pool_wait(&pool_work);
+		/* jobs in the list always have an index left */
+		job = pool_jobs;
+		if(!pool_take(job, &index)) continue;
+		pool_leave();
+		job->func(job->arg, index);
+		pool_enter();
+		pool_finish(job);
+	}
+}
+
+void nnc_parallel_run(u32 count, nnc_parallel_func func, void *arg)
+{
+	struct pool_job job = { func, arg, count, 1, 0, NULL };
+	struct pool_job **tail;
+	u32 index;
+	if(count == 0) return;
+	if(count > 1)
+	{
+		pool_enter();
+		while(pool_size < MIN(count - 1, POOL_MAX) && (pool_threads[pool_size] = thread_create(pool_worker, NULL)))
+			++pool_size;
+		for(tail = &pool_jobs; *tail; tail = &(*tail)->link)
+			;
+		*tail = &job;
+		pool_wake(&pool_work);
+		pool_leave();
+	}
+	/* this thread helps with the indices no worker took yet, so the job finishes
+	 * even if all workers are busy or none could be started */
+	func(arg, 0);
+	if(count == 1) return;
+	pool_enter();
+	pool_finish(&job);
+	while(pool_take(&job, &index))
+	{
+		pool_leave();
+		func(arg, index);
+		pool_enter();
+		pool_finish(&job);
+	}
+	while(job.done != job.count)
+		pool_wait(&pool_done);
+	pool_leave();
+}
@@ -109,19 +109,36 @@ bool nnc_verify_tmd_chunk_records(rstream *rs, nnc_tmd_header *tmd, nnc_cinfo_re
 {
 	u32 pos = get_crec_pos(tmd);
 	if(!pos) return false;
-	TRYB(NNC_RS_PCALL(rs, seek_abs, pos));
-	u32 to_hash = tmd->content_count;
-	for(u32 i = 0; records[i].count != 0 && to_hash != 0; ++i)
+	/* the groups of chunk records follow each other, so we can read them
+	 * all at once and hash the groups side by side */
+	u32 sizes[NNC_CINFO_MAX_SIZE];
+	u32 to_hash = tmd->content_count, total_size = 0, i;
+	for(i = 0; i < NNC_CINFO_MAX_SIZE && records[i].count != 0 && to_hash != 0; ++i)
 	{
 		to_hash -= records[i].count;
 		/* sizeof(chunk_record) = 0x30 */
-		u32 hash_size = records[i].count * 0x30;
-		nnc_sha256_hash digest;
-		TRYB(nnc_crypto_sha256_part(rs, digest, hash_size));
-		if(memcmp(digest, records[i].hash, sizeof(digest)) != 0)
-			return false;
+		sizes[i] = records[i].count * 0x30;
+		total_size += sizes[i];
+	}
+	if(to_hash != 0) return false;
+	if(i == 0) return true;
+
+	u8 *data = malloc(total_size);
+	if(!data) return false;
+	const u8 *bufs[NNC_CINFO_MAX_SIZE];
+	nnc_sha256_hash digests[NNC_CINFO_MAX_SIZE];
+	bool ok = read_at_exact(rs, pos, data, total_size) == NNC_R_OK;
+	if(ok)
+	{
+		bufs[0] = data;
+		for(u32 j = 1; j < i; ++j)
+			bufs[j] = bufs[j - 1] + sizes[j - 1];
+		nnc_crypto_sha256_multi(i, bufs, sizes, digests);
+		for(u32 j = 0; j < i && ok; ++j)
+			ok = memcmp(digests[j], records[j].hash, sizeof(nnc_sha256_hash)) == 0;
 	}
-	return to_hash == 0;
+	free(data);
+	return ok;
 }
 
 result nnc_read_tmd_chunk_records(rstream *rs, nnc_tmd_header *tmd, nnc_chunk_record *records)
@@ -0,0 +1,363 @@
+/* clock_gettime(), same check as NNC_PLATFORM_UNIX in internal.h which
+ *  can't be used as this has to come before any system header */
+#if defined(__unix__) || defined(__linux__) || defined(__APPLE__)
+	#define _POSIX_C_SOURCE 200112L
+#endif
+
+#include <nnc/trace.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "./internal.h"
+
+#if NNC_PLATFORM_WINDOWS
+	#include <windows.h>
+#endif
+
+#ifdef __GNUC__
+	#define STAT_ADD(field, n) __atomic_fetch_add(&(field), (n), __ATOMIC_RELAXED)
+	#define EXCHANGE(var, val) __atomic_exchange_n(&(var), (val), __ATOMIC_RELAXED)
+#else
+	/* statistics may be slightly off when used from multiple threads */
+	#define STAT_ADD(field, n) ((field) += (n))
+	static u64 exchange_u64(u64 *var, u64 val) { u64 old = *var; *var = val; return old; }
+	#define EXCHANGE(var, val) exchange_u64(&(var), (val))
+#endif
+
+static u64 now_ns(void)
+{
+#if NNC_PLATFORM_UNIX
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#elif NNC_PLATFORM_WINDOWS
+	LARGE_INTEGER count, freq;
+	QueryPerformanceCounter(&count);
+	QueryPerformanceFrequency(&freq);
+	return (u64) (count.QuadPart / freq.QuadPart) * 1000000000
+		+ (u64) (count.QuadPart % freq.QuadPart) * 1000000000 / freq.QuadPart;
+#else
+	return (u64) clock() * (1000000000 / CLOCKS_PER_SEC);
+#endif
+}
+
+static void record_seek(nnc_trace_stats *stats, u64 distance)
+{
+	u32 bucket = 0;
+	while(distance && bucket != NNC_TRACE_SEEK_BUCKETS - 1)
+	{
+		distance >>= 1;
+		++bucket;
+	}
+	STAT_ADD(stats->seeks, 1);
+	STAT_ADD(stats->seek_hist[bucket], 1);
+}
+
+static u64 distance(u64 a, u64 b) { return a > b ? a - b : b - a; }
+
+/* nnc_traced_rstream */
+
+static result traced_read(nnc_traced_rstream *self, u8 *buf, u32 max, u32 *totalRead)
+{
+	u64 start = now_ns();
+	result ret = NNC_RS_PCALL(self->child, read, buf, max, totalRead);
+	STAT_ADD(self->stats.read_ns, now_ns() - start);
+	STAT_ADD(self->stats.reads, 1);
+	if(ret == NNC_R_OK) STAT_ADD(self->stats.bytes_read, *totalRead);
+	return ret;
+}
+
+static result traced_read_at(nnc_traced_rstream *self, u64 pos, u8 *buf, u32 max, u32 *totalRead)
+{
+	u64 start = now_ns();
+	result ret = NNC_RS_PCALL(self->child, read_at, pos, buf, max, totalRead);
+	STAT_ADD(self->stats.read_ns, now_ns() - start);
+	STAT_ADD(self->stats.reads, 1);
+	STAT_ADD(self->stats.read_ats, 1);
+	if(ret != NNC_R_OK) return ret;
+	STAT_ADD(self->stats.bytes_read, *totalRead);
+	u64 last = EXCHANGE(self->last_end, pos + *totalRead);
+	if(last != pos) record_seek(&self->stats, distance(last, pos));
+	return NNC_R_OK;
+}
+
+static result traced_seek_abs(nnc_traced_rstream *self, u64 pos)
+{
+	u64 from = NNC_RS_PCALL0(self->child, tell), start = now_ns();
+	result ret = NNC_RS_PCALL(self->child, seek_abs, pos);
+	STAT_ADD(self->stats.seek_ns, now_ns() - start);
+	record_seek(&self->stats, distance(from, pos));
+	return ret;
+}
+
+static result traced_seek_rel(nnc_traced_rstream *self, u64 pos)
+{
+	u64 start = now_ns();
+	result ret = NNC_RS_PCALL(self->child, seek_rel, pos);
+	STAT_ADD(self->stats.seek_ns, now_ns() - start);
+	record_seek(&self->stats, pos);
+	return ret;
+}
+
+static result traced_borrow(nnc_traced_rstream *self, u64 pos, u64 len, const u8 **ptr)
+{
+	result ret = NNC_RS_PCALL(self->child, borrow, pos, len, ptr);
+	if(ret == NNC_R_OK)
+	{
+		STAT_ADD(self->stats.borrows, 1);
+		STAT_ADD(self->stats.bytes_borrowed, len);
+	}
+	return ret;
+}
+
+static result traced_locate(nnc_traced_rstream *self, u64 pos, u64 len, int *fd, u64 *fd_pos)
+{
+	result ret = NNC_RS_PCALL(self->child, locate, pos, len, fd, fd_pos);
+	if(ret == NNC_R_OK)
+	{
+		STAT_ADD(self->stats.locates, 1);
+		STAT_ADD(self->stats.bytes_located, len);
+	}
+	return ret;
+}
+
+static result traced_advise(nnc_traced_rstream *self, u64 pos, u64 len, int advice)
+{
+	return NNC_RS_PCALL(self->child, advise, pos, len, advice);
+}
+
+static u64 traced_size(nnc_traced_rstream *self) { return NNC_RS_PCALL0(self->child, size); }
+static u64 traced_tell(nnc_traced_rstream *self) { return NNC_RS_PCALL0(self->child, tell); }
+static void traced_close(nnc_traced_rstream *self) { NNC_RS_PCALL0(self->child, close); }
+
+/* a clone traces a clone of the child and adds its statistics to the stream it was made from when closed */
+struct traced_clone {
+	nnc_traced_rstream traced;
+	nnc_traced_rstream *parent;
+};
+
+static void traced_clone_close(struct traced_clone *self)
+{
+	/* nnc_trace_stats consists of only nnc_u64 fields */
+	u64 *from = (u64 *) &self->traced.stats, *to = (u64 *) &self->parent->stats;
+	for(size_t i = 0; i < sizeof(nnc_trace_stats) / sizeof(u64); ++i)
+		STAT_ADD(to[i], from[i]);
+	nnc_rs_close(self->traced.child);
+	free(self->traced.child);
+}
+
+static result traced_clone(nnc_traced_rstream *self, nnc_rstream **out)
+{
+	struct traced_clone *clone = malloc(sizeof(struct traced_clone));
+	if(!clone) return NNC_R_NOMEM;
+	nnc_rstream *child;
+	result ret = nnc_rs_clone(self->child, &child);
+	if(ret != NNC_R_OK) return free(clone), ret;
+	nnc_traced_rstream_open(&clone->traced, child, self->name);
+	clone->traced.table.close = (nnc_close_func) traced_clone_close;
+	clone->parent = self;
+	*out = NNC_RSP(clone);
+	return NNC_R_OK;
+}
+
+/* the optional functions follow what the child implements */
+static void traced_set_table(nnc_traced_rstream *self)
+{
+	const nnc_rstream_funcs *cf = self->child->funcs;
+	self->table.read = (nnc_read_func) traced_read;
+	self->table.seek_abs = (nnc_seek_abs_func) traced_seek_abs;
+	self->table.seek_rel = (nnc_seek_rel_func) traced_seek_rel;
+	self->table.size = (nnc_size_func) traced_size;
+	self->table.close = (nnc_close_func) traced_close;
+	self->table.tell = (nnc_tell_func) traced_tell;
+	self->table.read_at = cf->read_at ? (nnc_read_at_func) traced_read_at : NULL;
+	self->table.borrow = cf->borrow ? (nnc_borrow_func) traced_borrow : NULL;
+	self->table.locate = cf->locate ? (nnc_locate_func) traced_locate : NULL;
+	self->table.advise = cf->advise ? (nnc_advise_func) traced_advise : NULL;
+	self->table.clone = (nnc_clone_func) traced_clone;
+	self->funcs = &self->table;
+}
+
+void nnc_traced_rstream_open(nnc_traced_rstream *self, nnc_rstream *child, const char *name)
+{
+	memset(&self->stats, 0, sizeof(self->stats));
+	self->child = child;
+	self->name = name;
+	self->last_end = 0;
+	traced_set_table(self);
+}
+
+/* nnc_traced_wstream */
+
+static result traced_write(nnc_traced_wstream *self, u8 *buf, u32 size)
+{
+	u64 start = now_ns();
+	result ret = NNC_WS_PCALL(self->child, write, buf, size);
+	STAT_ADD(self->stats.write_ns, now_ns() - start);
+	STAT_ADD(self->stats.writes, 1);
+	if(ret == NNC_R_OK) STAT_ADD(self->stats.bytes_written, size);
+	return ret;
+}
+
+static result traced_wseek(nnc_traced_wstream *self, u64 pos)
+{
+	u64 from = NNC_WS_PCALL0(self->child, tell), start = now_ns();
+	result ret = NNC_WS_PCALL(self->child, seek, pos);
+	STAT_ADD(self->stats.seek_ns, now_ns() - start);
+	record_seek(&self->stats, distance(from, pos));
+	return ret;
+}
+
+static result traced_skip(nnc_traced_wstream *self, u64 count)
+{
+	u64 start = now_ns();
+	result ret = NNC_WS_PCALL(self->child, skip, count);
+	STAT_ADD(self->stats.write_ns, now_ns() - start);
+	STAT_ADD(self->stats.skips, 1);
+	if(ret == NNC_R_OK) STAT_ADD(self->stats.bytes_skipped, count);
+	return ret;
+}
+
+static result traced_subreadstream(nnc_traced_wstream *self, nnc_subview *out, u64 start, u64 len)
+{
+	return NNC_WS_PCALL(self->child, subreadstream, out, start, len);
+}
+
+static result traced_wlocate(nnc_traced_wstream *self, int *fd, u64 *fd_pos)
+{
+	result ret = NNC_WS_PCALL(self->child, locate, fd, fd_pos);
+	if(ret == NNC_R_OK) STAT_ADD(self->stats.locates, 1);
+	return ret;
+}
+
+static u64 traced_wtell(nnc_traced_wstream *self) { return NNC_WS_PCALL0(self->child, tell); }
+static result traced_wclose(nnc_traced_wstream *self) { return NNC_WS_PCALL0(self->child, close); }
+
+void nnc_traced_wstream_open(nnc_traced_wstream *self, nnc_wstream *child, const char *name)
+{
+	const nnc_wstream_funcs *cf = child->funcs;
+	memset(&self->stats, 0, sizeof(self->stats));
+	self->child = child;
+	self->name = name;
+	self->table.write = (nnc_write_func) traced_write;
+	self->table.close = (nnc_wclose_func) traced_wclose;
+	self->table.seek = cf->seek ? (nnc_wseek_func) traced_wseek : NULL;
+	self->table.tell = (nnc_wtell_func) traced_wtell;
+	self->table.subreadstream = cf->subreadstream ? (nnc_wsubreadstream_func) traced_subreadstream : NULL;
+	self->table.locate = cf->locate ? (nnc_wlocate_func) traced_wlocate : NULL;
+	self->table.skip = cf->skip ? (nnc_wskip_func) traced_skip : NULL;
+	self->funcs = &self->table;
+}
+
+/* JSON output */
+
+static void dump_string(FILE *out, const char *str)
+{
+	fputc('"', out);
+	for(; *str; ++str)
+	{
+		if(*str == '"' || *str == '\\') fprintf(out, "\\%c", *str);
+		else if((u8) *str < 0x20) fprintf(out, "\\u%04x", (u8) *str);
+		else fputc(*str, out);
+	}
+	fputc('"', out);
+}
+
+void nnc_trace_dump_json(FILE *out, const char *name, const nnc_trace_stats *stats)
+{
+	fputs("{\"name\":", out);
+	dump_string(out, name);
+#define FIELD(f) fprintf(out, ",\"" #f "\":%llu", (unsigned long long) stats->f)
+	FIELD(reads); FIELD(read_ats); FIELD(bytes_read); FIELD(read_ns);
+	FIELD(borrows); FIELD(bytes_borrowed);
+	FIELD(locates); FIELD(bytes_located);
+	FIELD(writes); FIELD(bytes_written); FIELD(write_ns);
+	FIELD(skips); FIELD(bytes_skipped);
+	FIELD(seeks); FIELD(seek_ns);
+#undef FIELD
+	/* trailing empty buckets are left out */
+	int used = NNC_TRACE_SEEK_BUCKETS;
+	while(used && !stats->seek_hist[used - 1]) --used;
+	fputs(",\"seek_hist\":[", out);
+	for(int i = 0; i < used; ++i)
+		fprintf(out, i ? ",%llu" : "%llu", (unsigned long long) stats->seek_hist[i]);
+	fputs("]}", out);
+}
+
+/* tracing of internal streams */
+
+static struct trace_session {
+	nnc_mutex *lock;
+	nnc_traced_rstream **streams;
+	u32 count, alloc;
+	bool enabled;
+} session;
+
+nnc_result nnc_trace_internal_start(void)
+{
+	if(session.enabled) return NNC_R_OK;
+	if(!(session.lock = mutex_new()))
+		return NNC_R_NOMEM;
+	session.streams = NULL;
+	session.count = session.alloc = 0;
+	session.enabled = true;
+	return NNC_R_OK;
+}
+
+void nnc_trace_internal_stop(void)
+{
+	if(!session.enabled) return;
+	for(u32 i = 0; i < session.count; ++i)
+		free(session.streams[i]);
+	free(session.streams);
+	mutex_free(session.lock);
+	memset(&session, 0, sizeof(session));
+}
+
+void nnc_trace_internal_dump_json(FILE *out)
+{
+	fputc('[', out);
+	if(session.enabled)
+	{
+		mutex_lock(session.lock);
+		for(u32 i = 0; i < session.count; ++i)
+		{
+			if(i) fputc(',', out);
+			nnc_trace_dump_json(out, session.streams[i]->name, &session.streams[i]->stats);
+		}
+		mutex_unlock(session.lock);
+	}
+	fputs("]\n", out);
+}
+
+struct nnc_rstream *nnc_trace_rs(struct nnc_rstream *rs, const char *name)
+{
+	if(!session.enabled) return rs;
+	nnc_traced_rstream *traced = NULL;
+	mutex_lock(session.lock);
+	/* streams opened on the same data share their statistics */
+	for(u32 i = 0; i < session.count; ++i)
+		if(session.streams[i]->child == rs && strcmp(session.streams[i]->name, name) == 0)
+		{
+			/* the caller may have opened another stream of a different kind at the same
+			 * address since, such as a subview with or without read_at */
+			traced = session.streams[i];
+			traced_set_table(traced);
+			goto out;
+		}
+	if(session.count == session.alloc)
+	{
+		u32 nalloc = session.alloc ? session.alloc * 2 : 16;
+		nnc_traced_rstream **nstreams = realloc(session.streams, nalloc * sizeof(nnc_traced_rstream *));
+		if(!nstreams) goto out;
+		session.streams = nstreams;
+		session.alloc = nalloc;
+	}
+	/* tracing is best-effort, the stream is used as-is if this fails */
+	if(!(traced = malloc(sizeof(nnc_traced_rstream)))) goto out;
+	nnc_traced_rstream_open(traced, rs, name);
+	session.streams[session.count++] = traced;
+out:
+	mutex_unlock(session.lock);
+	return traced ? NNC_RSP(traced) : rs;
+}
@@ -0,0 +1,356 @@
+#define _POSIX_C_SOURCE 200112L
+#include <nnc/crypto.h>
+#include <nnc/ivfc.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+void die(const char *fmt, ...);
+
+#define BENCH_RUNS 3
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void print_speed(const char *name, size_t size, double secs)
+{
+	printf("  %-10s %9.1f MiB/s\n", name, size / secs / (1024 * 1024));
+}
+
+static void bench_aes_ctr(nnc_u8 *data, size_t size)
+{
+	static const struct { enum nnc_aes_impl impl; const char *name; } impls[] = {
+		{ NNC_AES_IMPL_GENERIC, "mbedtls" },
+		{ NNC_AES_IMPL_AESNI,   "aes-ni"  },
+		{ NNC_AES_IMPL_ARMV8,   "armv8"   },
+	};
+	enum nnc_aes_impl def = nnc_aes_impl();
+	nnc_u8 *out = malloc(size), *ref = malloc(size);
+	nnc_u8 iv[0x10] = { 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 };
+	nnc_u128 key = NNC_PROMOTE128(0x0123456789ABCDEFULL);
+	if(!out || !ref) die("out of memory");
+
+	printf("aes-ctr, %zu MiB (default: %s)\n", size >> 20, impls[def].name);
+	for(unsigned i = 0; i < sizeof(impls) / sizeof(impls[0]); ++i)
+	{
+		if(nnc_aes_set_impl(impls[i].impl) != NNC_R_OK)
+		{
+			printf("  %-10s unavailable\n", impls[i].name);
+			continue;
+		}
+		double best = 0;
+		for(int run = 0; run < BENCH_RUNS; ++run)
+		{
+			nnc_memory mem;
+			nnc_aes_ctr ctr;
+			nnc_u32 read;
+			nnc_mem_open(&mem, data, size);
+			if(nnc_aes_ctr_open(&ctr, NNC_RSP(&mem), &key, iv) != NNC_R_OK)
+				die("failed opening aes-ctr stream");
+			double start = now();
+			nnc_result res = nnc_rs_read_at(&ctr, 0, out, size, &read);
+			double secs = now() - start;
+			nnc_rs_close(&ctr);
+			if(res != NNC_R_OK || read != size) die("failed decrypting: %s", nnc_strerror(res));
+			if(run == 0 || secs < best) best = secs;
+		}
+		print_speed(impls[i].name, size, best);
+		/* the generic implementation always runs first */
+		if(i == 0) memcpy(ref, out, size);
+		else if(memcmp(ref, out, size) != 0) die("%s output differs from mbedtls", impls[i].name);
+	}
+	nnc_aes_set_impl(def);
+	free(out);
+	free(ref);
+}
+
+static void bench_aes_cbc(nnc_u8 *data, size_t size)
+{
+	static const struct { enum nnc_aes_impl impl; const char *name; } impls[] = {
+		{ NNC_AES_IMPL_GENERIC, "mbedtls" },
+		{ NNC_AES_IMPL_AESNI,   "aes-ni"  },
+		{ NNC_AES_IMPL_ARMV8,   "armv8"   },
+	};
+	enum nnc_aes_impl def = nnc_aes_impl();
+	nnc_u8 *out = malloc(size), *ref = malloc(size);
+	nnc_u8 iv[0x10] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F };
+	nnc_u8 key[0x10] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF };
+	if(!out || !ref) die("out of memory");
+
+	printf("aes-cbc decryption, %zu MiB (default: %s)\n", size >> 20, impls[def].name);
+	for(unsigned i = 0; i < sizeof(impls) / sizeof(impls[0]); ++i)
+	{
+		if(nnc_aes_set_impl(impls[i].impl) != NNC_R_OK)
+		{
+			printf("  %-10s unavailable\n", impls[i].name);
+			continue;
+		}
+		double best = 0;
+		for(int run = 0; run < BENCH_RUNS; ++run)
+		{
+			nnc_memory mem;
+			nnc_aes_cbc cbc;
+			nnc_u32 read;
+			nnc_mem_open(&mem, data, size);
+			if(nnc_aes_cbc_open(&cbc, NNC_RSP(&mem), key, iv) != NNC_R_OK)
+				die("failed opening aes-cbc stream");
+			double start = now();
+			nnc_result res = nnc_rs_read_at(&cbc, 0, out, size, &read);
+			double secs = now() - start;
+			nnc_rs_close(&cbc);
+			if(res != NNC_R_OK || read != size) die("failed decrypting: %s", nnc_strerror(res));
+			if(run == 0 || secs < best) best = secs;
+		}
+		print_speed(impls[i].name, size, best);
+		if(i == 0) memcpy(ref, out, size);
+		else if(memcmp(ref, out, size) != 0) die("%s output differs from mbedtls", impls[i].name);
+	}
+	nnc_aes_set_impl(def);
+	free(out);
+	free(ref);
+}
+
+static void bench_sha256(nnc_u8 *data, size_t size)
+{
+	static const struct { enum nnc_sha256_impl impl; const char *name; } impls[] = {
+		{ NNC_SHA256_IMPL_GENERIC, "mbedtls" },
+		{ NNC_SHA256_IMPL_SHANI,   "sha-ni"  },
+		{ NNC_SHA256_IMPL_ARMV8,   "armv8"   },
+	};
+	enum nnc_sha256_impl def = nnc_crypto_sha256_impl();
+	nnc_sha256_hash digest, ref;
+
+	printf("sha256, %zu MiB (default: %s)\n", size >> 20, impls[def].name);
+	for(unsigned i = 0; i < sizeof(impls) / sizeof(impls[0]); ++i)
+	{
+		if(nnc_crypto_sha256_set_impl(impls[i].impl) != NNC_R_OK)
+		{
+			printf("  %-10s unavailable\n", impls[i].name);
+			continue;
+		}
+		double best = 0;
+		for(int run = 0; run < BENCH_RUNS; ++run)
+		{
+			double start = now();
+			nnc_crypto_sha256(data, digest, size);
+			double secs = now() - start;
+			if(run == 0 || secs < best) best = secs;
+		}
+		print_speed(impls[i].name, size, best);
+		if(i == 0) memcpy(ref, digest, sizeof(ref));
+		else if(!nnc_crypto_hasheq(ref, digest)) die("%s digest differs from mbedtls", impls[i].name);
+	}
+	nnc_crypto_sha256_set_impl(def);
+}
+
+static void bench_sha256_multi(nnc_u8 *data, size_t size)
+{
+	static const struct { enum nnc_sha256_multi_impl impl; const char *name; } impls[] = {
+		{ NNC_SHA256_MULTI_SINGLE, "single" },
+		{ NNC_SHA256_MULTI_SSE2,   "sse2"   },
+		{ NNC_SHA256_MULTI_AVX2,   "avx2"   },
+		{ NNC_SHA256_MULTI_AVX512, "avx512" },
+	};
+	enum nnc_sha256_multi_impl def = nnc_crypto_sha256_multi_impl();
+	nnc_u32 count = size / 0x1000;
+	nnc_sha256_hash *digests = malloc(count * sizeof(nnc_sha256_hash)), *ref = malloc(count * sizeof(nnc_sha256_hash));
+	if(!digests || !ref) die("out of memory");
+
+	printf("sha256 multi-buffer, %u 4 KiB blocks (default: %s)\n", count, impls[def].name);
+	for(unsigned i = 0; i < sizeof(impls) / sizeof(impls[0]); ++i)
+	{
+		if(nnc_crypto_sha256_multi_set_impl(impls[i].impl) != NNC_R_OK)
+		{
+			printf("  %-10s unavailable\n", impls[i].name);
+			continue;
+		}
+		double best = 0;
+		for(int run = 0; run < BENCH_RUNS; ++run)
+		{
+			double start = now();
+			nnc_crypto_sha256_blocks(data, 0x1000, count, digests);
+			double secs = now() - start;
+			if(run == 0 || secs < best) best = secs;
+		}
+		print_speed(impls[i].name, (size_t) count * 0x1000, best);
+		/* single always runs first */
+		if(i == 0) memcpy(ref, digests, count * sizeof(nnc_sha256_hash));
+		else if(memcmp(ref, digests, count * sizeof(nnc_sha256_hash)) != 0) die("%s digests differ from single", impls[i].name);
+	}
+	nnc_crypto_sha256_multi_set_impl(def);
+	free(digests);
+	free(ref);
+}
+
+static void bench_fused(nnc_u8 *data, size_t size)
+{
+	nnc_u8 iv[0x10] = { 0 };
+	nnc_u128 key = NNC_PROMOTE128(0x0123456789ABCDEFULL);
+	nnc_u8 *out = malloc(size);
+	nnc_sha256_hash digest, ref;
+	if(!out) die("out of memory");
+
+	printf("aes-ctr decrypt + sha256, %zu MiB\n", size >> 20);
+	for(int fused = 0; fused < 2; ++fused)
+	{
+		double best = 0;
+		for(int run = 0; run < BENCH_RUNS; ++run)
+		{
+			nnc_memory mem;
+			nnc_aes_ctr ctr;
+			nnc_u32 read;
+			nnc_result res;
+			nnc_mem_open(&mem, data, size);
+			if(nnc_aes_ctr_open(&ctr, NNC_RSP(&mem), &key, iv) != NNC_R_OK)
+				die("failed opening aes-ctr stream");
+			/* one thread so only the passes over memory differ */
+			nnc_aes_ctr_set_threads(&ctr, 1);
+			double start = now();
+			if(fused) res = nnc_crypto_sha256_part(NNC_RSP(&ctr), digest, size);
+			else if((res = nnc_rs_read_at(&ctr, 0, out, size, &read)) == NNC_R_OK)
+				nnc_crypto_sha256(out, digest, read);
+			double secs = now() - start;
+			nnc_rs_close(&ctr);
+			if(res != NNC_R_OK) die("failed decrypting: %s", nnc_strerror(res));
+			if(run == 0 || secs < best) best = secs;
+		}
+		print_speed(fused ? "fused" : "two-pass", size, best);
+		if(!fused) memcpy(ref, digest, sizeof(ref));
+		else if(!nnc_crypto_hasheq(ref, digest)) die("fused digest differs");
+	}
+	free(out);
+}
+
+static void bench_key_cache(nnc_u8 *data, size_t size)
+{
+	nnc_u128 keys[2] = { NNC_PROMOTE128(0x0123456789ABCDEFULL), NNC_PROMOTE128(0xFEDCBA9876543210ULL) };
+	nnc_u8 iv[0x10] = { 0 };
+	const int opens = 200000;
+
+	/* like the sections of an NCCH, which use two keys */
+	printf("aes-ctr open + close, %d streams with 2 keys\n", opens);
+	for(int cached = 0; cached < 2; ++cached)
+	{
+		if(cached && nnc_key_cache_init(64) != NNC_R_OK)
+			die("failed enabling the key cache");
+		double best = 0;
+		for(int run = 0; run < BENCH_RUNS; ++run)
+		{
+			nnc_memory mem;
+			nnc_aes_ctr ctr;
+			nnc_mem_open(&mem, data, size);
+			double start = now();
+			for(int i = 0; i < opens; ++i)
+			{
+				if(nnc_aes_ctr_open(&ctr, NNC_RSP(&mem), &keys[i % 2], iv) != NNC_R_OK)
+					die("failed opening aes-ctr stream");
+				nnc_rs_close(&ctr);
+			}
+			double secs = now() - start;
+			if(run == 0 || secs < best) best = secs;
+		}
+		printf("  %-10s %9.0f opens/s\n", cached ? "cached" : "uncached", opens / best);
+	}
+	nnc_key_cache_free();
+}
+
+static void bench_section_parallel(nnc_u8 *data, size_t size)
+{
+	static const nnc_u32 threads[] = { 1, 2, 4, 0 };
+	nnc_u8 iv[0x10] = { 0 };
+	nnc_u128 key = NNC_PROMOTE128(0x0123456789ABCDEFULL);
+
+	printf("nnc_decrypt_section_parallel, %zu MiB\n", size >> 20);
+	for(unsigned i = 0; i < sizeof(threads) / sizeof(threads[0]); ++i)
+	{
+		double best = 0;
+		for(int run = 0; run < BENCH_RUNS; ++run)
+		{
+			nnc_memory mem;
+			nnc_aes_ctr ctr;
+			nnc_wcounter out;
+			nnc_mem_open(&mem, data, size);
+			if(nnc_aes_ctr_open(&ctr, NNC_RSP(&mem), &key, iv) != NNC_R_OK)
+				die("failed opening aes-ctr stream");
+			nnc_wcounter_open(&out);
+			double start = now();
+			nnc_result res = nnc_decrypt_section_parallel(NNC_RSP(&ctr), NNC_WSP(&out), threads[i]);
+			double secs = now() - start;
+			nnc_rs_close(&ctr);
+			if(res != NNC_R_OK || out.size != size) die("failed decrypting: %s", nnc_strerror(res));
+			if(run == 0 || secs < best) best = secs;
+		}
+		char name[32];
+		if(threads[i]) snprintf(name, sizeof(name), "%u thread%s", threads[i], threads[i] == 1 ? "" : "s");
+		else strcpy(name, "all cpus");
+		print_speed(name, size, best);
+	}
+}
+
+static void bench_ivfc(nnc_u8 *data, size_t size)
+{
+	static const nnc_u32 threads[] = { 1, 2, 4, 0 };
+
+	printf("ivfc writer, %zu MiB\n", size >> 20);
+	for(unsigned i = 0; i < sizeof(threads) / sizeof(threads[0]); ++i)
+	{
+		double best = 0;
+		for(int run = 0; run < BENCH_RUNS; ++run)
+		{
+			nnc_ivfc_writer writer;
+			nnc_wcounter out;
+			nnc_wcounter_open(&out);
+			if(nnc_open_ivfc_writer(&writer, NNC_WSP(&out), NNC_IVFC_LEVELS_ROMFS, NNC_IVFC_ID_ROMFS, NNC_IVFC_BLOCKSIZE_ROMFS) != NNC_R_OK)
+				die("failed opening ivfc writer");
+			nnc_ivfc_set_threads(&writer, threads[i]);
+			double start = now();
+			/* in pieces like a RomFS, the writer copies them into its batches */
+			nnc_result res = NNC_R_OK;
+			for(size_t pos = 0; pos < size && res == NNC_R_OK; pos += 0x10000)
+				res = NNC_WS_CALL(writer, write, data + pos, size - pos < 0x10000 ? size - pos : 0x10000);
+			if(res == NNC_R_OK) res = NNC_WS_CALL0(writer, close);
+			else nnc_ivfc_abort_write(&writer);
+			double secs = now() - start;
+			if(res != NNC_R_OK) die("failed writing ivfc: %s", nnc_strerror(res));
+			if(run == 0 || secs < best) best = secs;
+		}
+		char name[32];
+		if(threads[i]) snprintf(name, sizeof(name), "%u thread%s", threads[i], threads[i] == 1 ? "" : "s");
+		else strcpy(name, "all cpus");
+		print_speed(name, size, best);
+	}
+}
+
+int bench_main(int argc, char *argv[])
+{
+	if(argc > 2) die("usage: %s [size-in-MiB]", argv[0]);
+	size_t size = (argc == 2 ? strtoul(argv[1], NULL, 10) : 64) << 20;
+	if(size == 0 || size > 0xF0000000) die("invalid size");
+
+	nnc_u8 *data = malloc(size);
+	if(!data) die("out of memory");
+	srand(0);
+	for(size_t i = 0; i < size; ++i)
+		data[i] = rand();
+
+	nnc_crypto_backend backend;
+	nnc_crypto_backend_info(&backend);
+	printf("backend: aes %s, sha256 %s, sha256 multi-buffer %s\n", backend.aes_name, backend.sha256_name, backend.sha256_multi_name);
+
+	bench_aes_ctr(data, size);
+	bench_aes_cbc(data, size);
+	bench_sha256(data, size);
+	bench_sha256_multi(data, size);
+	bench_fused(data, size);
+	bench_key_cache(data, size);
+	bench_section_parallel(data, size);
+	bench_ivfc(data, size);
+
+	free(data);
+	return 0;
+}
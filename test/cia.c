@@ -14,17 +14,26 @@
 void die(const char *fmt, ...);
 
 
-static void extract(nnc_rstream *rs, const char *to, const char *type, nnc_sha256_hash hash)
+static void extract(nnc_rstream *rs, const char *to, const char *type, nnc_sha256_hash hash, nnc_aes_cbc *crypt)
 {
 	nnc_u32 len = NNC_RS_PCALL0(rs, size), rlen;
+	nnc_aes_cbc_hashing hashing;
 	printf("Saving %s (0x%X) to %s... ", type, len, to);
 	nnc_u8 *buf = malloc(len);
+	/* encrypted contents are hashed while decrypting them */
+	if(hash && crypt)
+	{
+		if(nnc_aes_cbc_hashing_open(&hashing, crypt) != NNC_R_OK)
+			die("failed opening hashing stream for %s", to);
+		rs = NNC_RSP(&hashing);
+	}
 	if(NNC_RS_PCALL(rs, read, buf, len, &rlen) != NNC_R_OK || len != rlen)
 		die("read failure for %s", to);
 	if(hash)
 	{
 		nnc_sha256_hash digest;
-		nnc_crypto_sha256(buf, digest, len);
+		if(crypt) nnc_aes_cbc_hashing_digest(&hashing, digest);
+		else nnc_crypto_sha256(buf, digest, len);
 		if(nnc_crypto_hasheq(digest, hash))
 			printf("hash match... ");
 		else
@@ -86,19 +95,19 @@ int cia_main(int argc, char *argv[])
 
 	snprintf(pathbuf, sizeof(pathbuf), "%s/certchain", output);
 	nnc_cia_open_certchain(&header, NNC_RSP(&f), &sv);
-	extract(NNC_RSP(&sv), pathbuf, "certificate chain", NULL);
+	extract(NNC_RSP(&sv), pathbuf, "certificate chain", NULL, NULL);
 
 	snprintf(pathbuf, sizeof(pathbuf), "%s/tik", output);
 	nnc_cia_open_ticket(&header, NNC_RSP(&f), &sv);
-	extract(NNC_RSP(&sv), pathbuf, "ticket", NULL);
+	extract(NNC_RSP(&sv), pathbuf, "ticket", NULL, NULL);
 
 	snprintf(pathbuf, sizeof(pathbuf), "%s/tmd", output);
 	nnc_cia_open_tmd(&header, NNC_RSP(&f), &sv);
-	extract(NNC_RSP(&sv), pathbuf, "TMD", NULL);
+	extract(NNC_RSP(&sv), pathbuf, "TMD", NULL, NULL);
 
 	snprintf(pathbuf, sizeof(pathbuf), "%s/meta", output);
 	if(nnc_cia_open_meta(&header, NNC_RSP(&f), &sv) == NNC_R_OK)
-		extract(NNC_RSP(&sv), pathbuf, "CIA meta section", NULL);
+		extract(NNC_RSP(&sv), pathbuf, "CIA meta section", NULL, NULL);
 	else fprintf(stderr, "WARN: no meta in CIA.\n");
 
 	nnc_cia_content_reader reader;
@@ -118,7 +127,7 @@ int cia_main(int argc, char *argv[])
 		snprintf(pathbuf, sizeof(pathbuf), "%s/%08" PRIX32, output, chunk->id);
 		static char type[] = "NCCH content index XXXX";
 		snprintf(type + 13, 5, "%04X", chunk->index);
-		extract(NNC_RSP(&ncch), pathbuf, type, chunk->hash);
+		extract(NNC_RSP(&ncch), pathbuf, type, chunk->hash, chunk->flags & NNC_CHUNKF_ENCRYPTED ? &ncch.u.enc.crypt : NULL);
 
 		/* this section is here to test CBC seeking */
 		NNC_RS_CALL(ncch, seek_abs, 0);
@@ -159,7 +168,7 @@ int rewrite_cia_main(int argc, char *argv[])
 	nnc_subview certchain, ticket, tmd;
 	nnc_tmd_header tmdhdr;
 	nnc_cia_header hdr;
-	nnc_wfile ocia;
+	nnc_buffered_wfile ocia;
 	nnc_file cia;
 	nnc_result res;
 	nnc_u32 i, j = 0;
@@ -170,7 +179,7 @@ int rewrite_cia_main(int argc, char *argv[])
 	nnc_cia_open_ticket(&hdr, NNC_RSP(&cia), &ticket);
 	nnc_cia_open_tmd(&hdr, NNC_RSP(&cia), &tmd);
 	MUST(nnc_read_tmd_header(NNC_RSP(&tmd), &tmdhdr), "parse tmd header");
-	MUST(nnc_wfile_open(&ocia, output), "open output");
+	MUST(nnc_buffered_wfile_open(&ocia, output, 0), "open output");
 	MUST(nnc_cia_make_reader(&hdr, NNC_RSP(&cia), nnc_get_default_keyset(), &reader), "make content reader");
 	streams = malloc(sizeof(*streams) * reader.content_count);
 	ncchs = malloc(sizeof(*ncchs) * reader.content_count);
@@ -0,0 +1,509 @@
+#include <nnc/crypto.h>
+#include <nnc/stream.h>
+#include <nnc/ncch.h>
+#include <mbedtls/aes.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+void die(const char *fmt, ...);
+
+#define CHECK(expr) do { if(!(expr)) die("%s:%d: check failed: %s", __FILE__, __LINE__, #expr); } while(0)
+
+#define DATA_SIZE 0x100000
+
+static void test_sha256_impls(const nnc_u8 *data)
+{
+	/* FIPS 180-2 examples */
+	static const struct { const char *msg; const char *digest; } vectors[] = {
+		{ "abc", "\xba\x78\x16\xbf\x8f\x01\xcf\xea\x41\x41\x40\xde\x5d\xae\x22\x23\xb0\x03\x61\xa3\x96\x17\x7a\x9c\xb4\x10\xff\x61\xf2\x00\x15\xad" },
+		{ "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+			"\x24\x8d\x6a\x61\xd2\x06\x38\xb8\xe5\xc0\x26\x93\x0c\x3e\x60\x39\xa3\x3c\xe4\x59\x64\xff\x21\x67\xf6\xec\xed\xd4\x19\xdb\x06\xc1" },
+	};
+	enum nnc_sha256_impl def = nnc_crypto_sha256_impl();
+	nnc_sha256_hash want, got;
+	unsigned seed = 1, impls = 0;
+	for(int impl = NNC_SHA256_IMPL_GENERIC; impl <= NNC_SHA256_IMPL_ARMV8; ++impl)
+	{
+		if(nnc_crypto_sha256_set_impl(impl) != NNC_R_OK) continue;
+		++impls;
+		for(unsigned i = 0; i < sizeof(vectors) / sizeof(vectors[0]); ++i)
+		{
+			CHECK(nnc_crypto_sha256((const nnc_u8 *) vectors[i].msg, got, strlen(vectors[i].msg)) == NNC_R_OK);
+			CHECK(memcmp(got, vectors[i].digest, sizeof(got)) == 0);
+		}
+		/* every length around the padding boundaries, then some longer ones */
+		for(nnc_u32 len = 0; len < 2000; len += len < 300 ? 1 : 97)
+		{
+			nnc_sha256_incremental_hash hash;
+			nnc_memory mem;
+			CHECK(nnc_crypto_sha256_set_impl(NNC_SHA256_IMPL_GENERIC) == NNC_R_OK);
+			CHECK(nnc_crypto_sha256(data + len, want, len) == NNC_R_OK);
+			CHECK(nnc_crypto_sha256_set_impl(impl) == NNC_R_OK);
+
+			CHECK(nnc_crypto_sha256(data + len, got, len) == NNC_R_OK);
+			CHECK(memcmp(got, want, sizeof(got)) == 0);
+
+			/* fed in odd pieces */
+			CHECK(nnc_crypto_sha256_incremental(&hash) == NNC_R_OK);
+			for(nnc_u32 off = 0, n; off != len; off += n)
+			{
+				seed = seed * 1103515245 + 12345;
+				n = (seed >> 16) % 130;
+				if(n > len - off) n = len - off;
+				nnc_crypto_sha256_feed(hash, (nnc_u8 *) data + len + off, n);
+			}
+			nnc_crypto_sha256_finish(hash, got);
+			nnc_crypto_sha256_free(hash);
+			CHECK(memcmp(got, want, sizeof(got)) == 0);
+
+			nnc_mem_open(&mem, data + len, len);
+			CHECK(nnc_crypto_sha256_stream(NNC_RSP(&mem), got) == NNC_R_OK);
+			CHECK(memcmp(got, want, sizeof(got)) == 0);
+		}
+	}
+	CHECK(nnc_crypto_sha256_set_impl(def) == NNC_R_OK);
+	printf("sha-256 implementations: ok (%u)\n", impls);
+}
+
+static void test_sha256_multi(const nnc_u8 *data)
+{
+	enum nnc_sha256_multi_impl def = nnc_crypto_sha256_multi_impl();
+	const nnc_u8 *bufs[40];
+	nnc_sha256_hash want[40], got[40];
+	nnc_u32 sizes[40];
+	unsigned seed = 2, impls = 0;
+	for(int impl = NNC_SHA256_MULTI_SINGLE; impl <= NNC_SHA256_MULTI_AVX512; ++impl)
+	{
+		if(nnc_crypto_sha256_multi_set_impl(impl) != NNC_R_OK) continue;
+		++impls;
+		for(int round = 0; round < 500; ++round)
+		{
+			seed = seed * 1103515245 + 12345;
+			/* counts that don't fill the lanes, equal sizes and mixed ones */
+			nnc_u32 count = 1 + (seed >> 16) % 40;
+			for(nnc_u32 i = 0; i < count; ++i)
+			{
+				seed = seed * 1103515245 + 12345;
+				sizes[i] = round % 3 == 0 ? 0x18 : round % 3 == 1 ? (seed >> 8) % 300 : (seed >> 8) % 5000;
+				bufs[i] = data + (seed >> 4) % 1000;
+				CHECK(nnc_crypto_sha256(bufs[i], want[i], sizes[i]) == NNC_R_OK);
+			}
+			nnc_crypto_sha256_multi(count, bufs, sizes, got);
+			CHECK(memcmp(got, want, count * sizeof(nnc_sha256_hash)) == 0);
+		}
+		/* consecutive IVFC sized blocks */
+		nnc_crypto_sha256_blocks(data, 0x1000, 37, got);
+		for(nnc_u32 i = 0; i < 37; ++i)
+		{
+			CHECK(nnc_crypto_sha256(data + i * 0x1000, want[0], 0x1000) == NNC_R_OK);
+			CHECK(memcmp(got[i], want[0], sizeof(nnc_sha256_hash)) == 0);
+		}
+	}
+	CHECK(nnc_crypto_sha256_multi_set_impl(def) == NNC_R_OK);
+	printf("multi-buffer sha-256: ok (%u)\n", impls);
+}
+
+#define FUSED_SIZE 300000
+
+/* reads and forward seeks through a hashing stream, the digest is of everything up to end */
+static void check_hashing_stream(nnc_rstream *hs, const nnc_u8 *plain, nnc_u32 end, unsigned *seed)
+{
+	nnc_u8 *buf = malloc(FUSED_SIZE);
+	nnc_u32 pos = 0, got;
+	if(!buf) die("out of memory");
+	while(pos != end)
+	{
+		*seed = *seed * 1103515245 + 12345;
+		nnc_u32 n = (*seed >> 16) % 3 == 0 ? (*seed >> 8) % 37 : (*seed >> 8) % 70000;
+		if(n > end - pos) n = end - pos;
+		if((*seed >> 4) % 4 == 0)
+			CHECK(nnc_rs_seek_rel(hs, n) == NNC_R_OK);
+		else
+		{
+			CHECK(nnc_rs_read(hs, buf, n, &got) == NNC_R_OK && got == n);
+			CHECK(memcmp(buf, plain + pos, n) == 0);
+		}
+		pos += n;
+		CHECK(nnc_rs_tell(hs) == pos);
+	}
+	free(buf);
+}
+
+static void check_fused(nnc_rstream *rs, const nnc_u8 *plain, unsigned seed)
+{
+	nnc_sha256_hash want, got;
+	nnc_u8 after[40];
+	nnc_u32 read;
+	for(int i = 0; i < 200; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		nnc_u32 pos = (seed >> 4) % FUSED_SIZE, len;
+		/* some block aligned starts */
+		if(i < 20) pos &= ~0xF;
+		seed = seed * 1103515245 + 12345;
+		len = (seed >> 4) % (FUSED_SIZE - pos + 1);
+		CHECK(nnc_crypto_sha256(plain + pos, want, len) == NNC_R_OK);
+		CHECK(nnc_rs_seek_abs(rs, pos) == NNC_R_OK);
+		CHECK(nnc_crypto_sha256_part(rs, got, len) == NNC_R_OK);
+		CHECK(memcmp(got, want, sizeof(got)) == 0);
+		/* the stream is left right after the hashed data */
+		CHECK(nnc_rs_tell(rs) == pos + len);
+		nnc_u32 n = FUSED_SIZE - pos - len < sizeof(after) ? FUSED_SIZE - pos - len : sizeof(after);
+		CHECK(nnc_rs_read(rs, after, n, &read) == NNC_R_OK && read == n);
+		CHECK(memcmp(after, plain + pos + len, n) == 0);
+	}
+}
+
+static void test_fused_hashing(const nnc_u8 *data)
+{
+	nnc_u128 ctr_key = NNC_PROMOTE128(0x1234);
+	nnc_u8 key[0x10] = { 9, 8, 7 }, iv[0x10] = { 1, 2, 3 };
+	nnc_u8 *plain = malloc(FUSED_SIZE);
+	nnc_aes_ctr_hashing ctr_hash;
+	nnc_aes_cbc_hashing cbc_hash;
+	nnc_sha256_hash want, got;
+	nnc_u32 read_size;
+	unsigned seed = 3;
+	nnc_aes_ctr ctr;
+	nnc_aes_cbc cbc;
+	nnc_memory mem;
+	if(!plain) die("out of memory");
+
+	nnc_mem_open(&mem, data, FUSED_SIZE);
+	CHECK(nnc_aes_ctr_open(&ctr, NNC_RSP(&mem), &ctr_key, iv) == NNC_R_OK);
+	CHECK(nnc_rs_read_at(&ctr, 0, plain, FUSED_SIZE, &read_size) == NNC_R_OK && read_size == FUSED_SIZE);
+	check_fused(NNC_RSP(&ctr), plain, 1);
+	for(int i = 0; i < 50; ++i)
+	{
+		nnc_u32 end = i == 0 ? FUSED_SIZE : (seed = seed * 1103515245 + 12345) % FUSED_SIZE;
+		CHECK(nnc_aes_ctr_hashing_open(&ctr_hash, &ctr) == NNC_R_OK);
+		check_hashing_stream(NNC_RSP(&ctr_hash), plain, end, &seed);
+		nnc_aes_ctr_hashing_digest(&ctr_hash, got);
+		CHECK(nnc_crypto_sha256(plain, want, end) == NNC_R_OK);
+		CHECK(memcmp(got, want, sizeof(got)) == 0);
+	}
+	NNC_RS_CALL0(ctr, close);
+
+	CHECK(nnc_aes_cbc_open(&cbc, NNC_RSP(&mem), key, iv) == NNC_R_OK);
+	CHECK(nnc_rs_read_at(&cbc, 0, plain, FUSED_SIZE, &read_size) == NNC_R_OK && read_size == FUSED_SIZE);
+	check_fused(NNC_RSP(&cbc), plain, 2);
+	for(int i = 0; i < 50; ++i)
+	{
+		nnc_u32 end = i == 0 ? FUSED_SIZE : (seed = seed * 1103515245 + 12345) % FUSED_SIZE;
+		CHECK(nnc_aes_cbc_hashing_open(&cbc_hash, &cbc) == NNC_R_OK);
+		check_hashing_stream(NNC_RSP(&cbc_hash), plain, end, &seed);
+		nnc_aes_cbc_hashing_digest(&cbc_hash, got);
+		CHECK(nnc_crypto_sha256(plain, want, end) == NNC_R_OK);
+		CHECK(memcmp(got, want, sizeof(got)) == 0);
+	}
+	NNC_RS_CALL0(cbc, close);
+	free(plain);
+	puts("fused decryption and hashing: ok");
+}
+
+static void decrypt_ctr(const nnc_u8 *data, nnc_u64 key_low, nnc_u8 *out)
+{
+	nnc_u128 key = NNC_PROMOTE128(key_low);
+	nnc_u8 iv[0x10] = { 5 };
+	nnc_memory mem;
+	nnc_aes_ctr ctr;
+	nnc_u32 got;
+	nnc_mem_open(&mem, data, 0x1000);
+	CHECK(nnc_aes_ctr_open(&ctr, NNC_RSP(&mem), &key, iv) == NNC_R_OK);
+	CHECK(NNC_RS_CALL(ctr, read, out, 0x1000, &got) == NNC_R_OK && got == 0x1000);
+	NNC_RS_CALL0(ctr, close);
+}
+
+static void seeded_header(nnc_ncch_header *header, const struct nnc_seeddb_entry *seed)
+{
+	nnc_u8 buf[NNC_SEED_SIZE + 8];
+	nnc_sha256_hash hash;
+	memset(header, 0, sizeof(*header));
+	header->keyy = (nnc_u128) NNC_PROMOTE128(0xABCD);
+	header->title_id = seed->title_id;
+	header->flags = NNC_NCCH_USES_SEED;
+	/* the seed is checked against a hash of it and the little endian title ID */
+	memcpy(buf, seed->seed, NNC_SEED_SIZE);
+	for(int i = 0; i < 8; ++i)
+		buf[NNC_SEED_SIZE + i] = seed->title_id >> (i * 8);
+	CHECK(nnc_crypto_sha256(buf, hash, sizeof(buf)) == NNC_R_OK);
+	memcpy(header->seed_hash, hash, sizeof(header->seed_hash));
+}
+
+static void test_key_cache(const nnc_u8 *data)
+{
+	struct nnc_seeddb_entry seed = { .title_id = 0x0004000000100000ULL };
+	nnc_seeddb seeddb = { .size = 1, .entries = &seed };
+	nnc_u8 want[8][0x1000], got[0x1000];
+	nnc_keyset ks = NNC_KEYSET_INIT;
+	nnc_key_cache_stats st;
+	nnc_ncch_header header;
+	nnc_u128 uncached, key;
+	nnc_u8 iv[0x10] = { 5 };
+	nnc_aes_ctr held;
+	nnc_memory mem;
+	nnc_u32 read;
+	ks.flags = 0x02;
+	ks.kx_ncch0 = (nnc_u128) NNC_PROMOTE128(0x1111);
+	memset(seed.seed, 0x42, NNC_SEED_SIZE);
+	seeded_header(&header, &seed);
+	for(int i = 0; i < 8; ++i)
+		decrypt_ctr(data, i + 1, want[i]);
+	CHECK(nnc_key_content(&uncached, &ks, &seeddb, &header) == NNC_R_OK);
+
+	CHECK(nnc_key_cache_init(0) == NNC_R_INVAL);
+	CHECK(nnc_key_cache_init(4) == NNC_R_OK);
+	nnc_key_cache_get_stats(&st);
+	CHECK(st.schedule_hits == 0 && st.schedule_misses == 0 && st.schedules == 0 && st.capacity == 4);
+
+	/* the second stream with the same key shares the schedule */
+	decrypt_ctr(data, 1, got);
+	CHECK(memcmp(got, want[0], sizeof(got)) == 0);
+	decrypt_ctr(data, 1, got);
+	CHECK(memcmp(got, want[0], sizeof(got)) == 0);
+	nnc_key_cache_get_stats(&st);
+	CHECK(st.schedule_misses == 1 && st.schedule_hits == 1 && st.schedules == 1);
+
+	/* only the most recently used unused schedules are kept */
+	for(int i = 0; i < 8; ++i)
+	{
+		decrypt_ctr(data, i + 1, got);
+		CHECK(memcmp(got, want[i], sizeof(got)) == 0);
+	}
+	nnc_key_cache_get_stats(&st);
+	CHECK(st.schedule_misses == 8 && st.schedule_hits == 2 && st.schedules == 4);
+	decrypt_ctr(data, 8, got);
+	decrypt_ctr(data, 1, got);
+	nnc_key_cache_get_stats(&st);
+	CHECK(st.schedule_misses == 9 && st.schedule_hits == 3);
+
+	CHECK(nnc_key_content(&key, &ks, &seeddb, &header) == NNC_R_OK);
+	CHECK(nnc_key_content(&key, &ks, &seeddb, &header) == NNC_R_OK);
+	CHECK(memcmp(&key, &uncached, sizeof(key)) == 0);
+	nnc_key_cache_get_stats(&st);
+	CHECK(st.normal_key_misses == 1 && st.normal_key_hits == 1);
+	/* a seed that doesn't match its hash must not come from the cache */
+	header.seed_hash[0] ^= 1;
+	CHECK(nnc_key_content(&key, &ks, &seeddb, &header) == NNC_R_CORRUPT);
+	header.seed_hash[0] ^= 1;
+
+	/* streams keep their schedule when the cache goes away */
+	key = (nnc_u128) NNC_PROMOTE128(3);
+	nnc_mem_open(&mem, data, 0x1000);
+	CHECK(nnc_aes_ctr_open(&held, NNC_RSP(&mem), &key, iv) == NNC_R_OK);
+	nnc_key_cache_free();
+	CHECK(NNC_RS_CALL(held, read, got, sizeof(got), &read) == NNC_R_OK && read == sizeof(got));
+	CHECK(memcmp(got, want[2], sizeof(got)) == 0);
+	NNC_RS_CALL0(held, close);
+	decrypt_ctr(data, 4, got);
+	CHECK(memcmp(got, want[3], sizeof(got)) == 0);
+	puts("key cache: ok");
+}
+
+#define SEEDS 8000
+
+static void put_le(nnc_u8 *p, nnc_u64 val, int size)
+{
+	for(int i = 0; i < size; ++i)
+		p[i] = val >> (i * 8);
+}
+
+/* the seed of the first entry with the title ID, made from its index */
+static int find_seed(const nnc_u64 *tids, nnc_u32 count, nnc_u64 tid, nnc_u8 *seed)
+{
+	for(nnc_u32 i = 0; i < count; ++i)
+		if(tids[i] == tid)
+		{
+			memset(seed, 0, NNC_SEED_SIZE);
+			put_le(seed, i, 4);
+			return 1;
+		}
+	return 0;
+}
+
+static void check_seeds(nnc_seeddb *db, const nnc_u64 *tids, nnc_u32 count, unsigned seed)
+{
+	nnc_u8 want[NNC_SEED_SIZE];
+	for(nnc_u32 i = 0; i < count + 1000; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		nnc_u64 tid = i < count ? tids[i] : 0x0004000000000000ULL | seed;
+		nnc_u8 *got = nnc_get_seed(db, tid);
+		if(find_seed(tids, count, tid, want))
+			CHECK(got && memcmp(got, want, NNC_SEED_SIZE) == 0);
+		else
+			CHECK(!got);
+	}
+}
+
+static void test_seeddb(void)
+{
+	static nnc_rstream_funcs no_borrow_funcs;
+	nnc_u8 *image = calloc(0x10 + 0x20 * SEEDS, 1);
+	nnc_u64 *tids = malloc(SEEDS * sizeof(nnc_u64));
+	nnc_seeddb parsed, copied, merged = { 0 };
+	unsigned seed = 4;
+	nnc_memory mem;
+	if(!image || !tids) die("out of memory");
+	/* some title IDs appear twice, the first one counts */
+	put_le(image, SEEDS, 4);
+	for(nnc_u32 i = 0; i < SEEDS; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		tids[i] = i > 10 && seed % 50 == 0 ? tids[(seed >> 8) % i] : 0x0004000000000000ULL | ((nnc_u64) seed << 8);
+		put_le(image + 0x10 + 0x20 * i, tids[i], 8);
+		put_le(image + 0x10 + 0x20 * i + 8, i, 4);
+	}
+
+	nnc_mem_open(&mem, image, 0x10 + 0x20 * SEEDS);
+	CHECK(nnc_seeds_seeddb(NNC_RSP(&mem), &parsed) == NNC_R_OK && parsed.size == SEEDS && parsed.index);
+	CHECK(nnc_rs_tell(&mem) == 0x10 + 0x20 * SEEDS);
+	check_seeds(&parsed, tids, SEEDS, 1);
+	/* the same without borrowing */
+	nnc_mem_open(&mem, image, 0x10 + 0x20 * SEEDS);
+	no_borrow_funcs = *mem.funcs;
+	no_borrow_funcs.borrow = NULL;
+	mem.funcs = &no_borrow_funcs;
+	CHECK(nnc_seeds_seeddb(NNC_RSP(&mem), &copied) == NNC_R_OK && copied.size == SEEDS);
+	check_seeds(&copied, tids, SEEDS, 2);
+	/* linear search without the index */
+	free(copied.index);
+	copied.index = NULL;
+	copied.index_size = 0;
+	check_seeds(&copied, tids, 2000, 3);
+	CHECK(nnc_index_seeddb(&copied) == NNC_R_OK && copied.index);
+	check_seeds(&copied, tids, SEEDS, 4);
+	nnc_free_seeddb(&copied);
+
+	/* duplicates within and across sources keep the first seed */
+	struct nnc_seeddb_entry first[3] = { { { 1 }, 5 }, { { 2 }, 6 }, { { 3 }, 5 } };
+	struct nnc_seeddb_entry second[3] = { { { 9 }, 6 }, { { 8 }, 7 }, { { 7 }, 7 } };
+	nnc_seeddb first_db = { 3, first, NULL, 0 }, second_db = { 3, second, NULL, 0 };
+	CHECK(nnc_merge_seeddb(&merged, &first_db) == NNC_R_OK && merged.size == 2);
+	CHECK(nnc_get_seed(&merged, 5)[0] == 1);
+	CHECK(nnc_merge_seeddb(&merged, &second_db) == NNC_R_OK && merged.size == 3);
+	CHECK(nnc_get_seed(&merged, 6)[0] == 2 && nnc_get_seed(&merged, 7)[0] == 8);
+	CHECK(nnc_merge_seeddb(&merged, &parsed) == NNC_R_OK && nnc_get_seed(&merged, 5)[0] == 1);
+	CHECK(merged.index != NULL);
+	check_seeds(&merged, tids, SEEDS, 5);
+	CHECK(nnc_merge_seeddb(&merged, &merged) == NNC_R_OK && nnc_get_seed(&merged, 7)[0] == 8);
+	nnc_free_seeddb(&merged);
+	nnc_free_seeddb(&parsed);
+	free(image);
+	free(tids);
+	puts("seeddb: ok");
+}
+
+#define AES_SIZE 100003
+
+/* random reads, seeks and positional reads, compared with the reference plaintext */
+static void check_aes_reads(nnc_rstream *rs, const nnc_u8 *plain, nnc_u32 size, unsigned seed)
+{
+	nnc_u8 *buf = malloc(5000);
+	nnc_u32 pos = 0, got;
+	if(!buf) die("out of memory");
+	for(int i = 0; i < 5000; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		nnc_u32 len = (seed >> 16) % 2 ? (seed >> 4) % 40 : (seed >> 4) % 5000;
+		if((seed >> 8) % 3 == 0)
+		{
+			seed = seed * 1103515245 + 12345;
+			pos = (seed >> 4) % (size + 1);
+			CHECK(nnc_rs_seek_abs(rs, pos) == NNC_R_OK);
+		}
+		nnc_u32 want = pos + len > size ? size - pos : len;
+		CHECK(nnc_rs_read(rs, buf, len, &got) == NNC_R_OK && got == want);
+		CHECK(memcmp(buf, plain + pos, got) == 0);
+		pos += got;
+		CHECK(nnc_rs_tell(rs) == pos);
+
+		seed = seed * 1103515245 + 12345;
+		nnc_u32 at = (seed >> 4) % size;
+		want = at + len > size ? size - at : len;
+		CHECK(nnc_rs_read_at(rs, at, buf, len, &got) == NNC_R_OK && got == want);
+		CHECK(memcmp(buf, plain + at, got) == 0);
+	}
+	/* small sequential reads up to the unaligned end */
+	CHECK(nnc_rs_seek_abs(rs, 0) == NNC_R_OK);
+	for(pos = 0; pos != size; pos += got)
+	{
+		seed = seed * 1103515245 + 12345;
+		CHECK(nnc_rs_read(rs, buf, 7 + (seed >> 8) % 30, &got) == NNC_R_OK && got);
+		CHECK(memcmp(buf, plain + pos, got) == 0);
+	}
+	CHECK(nnc_rs_read(rs, buf, 16, &got) == NNC_R_OK && got == 0);
+	free(buf);
+}
+
+static void test_aes_impls(const nnc_u8 *data)
+{
+	/* counters 16 blocks before the low half and the whole counter wrap around */
+	static const nnc_u8 ivs[][0x10] = {
+		{ 0, 4, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 },
+		{ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 },
+	};
+	nnc_u128 ctr_key = NNC_PROMOTE128(0x1122334455667788ULL);
+	nnc_u8 key[0x10], iv[0x10], stream[0x10];
+	nnc_u8 *plain = malloc(AES_SIZE);
+	enum nnc_aes_impl def = nnc_aes_impl();
+	mbedtls_aes_context aes;
+	unsigned impls = 0;
+	nnc_aes_ctr ctr;
+	nnc_aes_cbc cbc;
+	nnc_memory mem;
+	size_t off;
+	if(!plain) die("out of memory");
+	nnc_u128_bytes_be(&ctr_key, key);
+	mbedtls_aes_init(&aes);
+	for(int impl = NNC_AES_IMPL_GENERIC; impl <= NNC_AES_IMPL_ARMV8; ++impl)
+	{
+		if(nnc_aes_set_impl(impl) != NNC_R_OK) continue;
+		++impls;
+		for(unsigned i = 0; i < sizeof(ivs) / sizeof(ivs[0]); ++i)
+		{
+			off = 0;
+			memcpy(iv, ivs[i], sizeof(iv));
+			CHECK(mbedtls_aes_setkey_enc(&aes, key, 128) == 0);
+			CHECK(mbedtls_aes_crypt_ctr(&aes, AES_SIZE, &off, iv, stream, data, plain) == 0);
+			nnc_mem_open(&mem, data, AES_SIZE);
+			CHECK(nnc_aes_ctr_open(&ctr, NNC_RSP(&mem), &ctr_key, (nnc_u8 *) ivs[i]) == NNC_R_OK);
+			check_aes_reads(NNC_RSP(&ctr), plain, AES_SIZE, impl * 2 + i);
+			NNC_RS_CALL0(ctr, close);
+		}
+
+		/* cbc needs whole blocks */
+		memcpy(iv, ivs[0], sizeof(iv));
+		CHECK(mbedtls_aes_setkey_dec(&aes, key, 128) == 0);
+		CHECK(mbedtls_aes_crypt_cbc(&aes, MBEDTLS_AES_DECRYPT, AES_SIZE & ~0xF, iv, data, plain) == 0);
+		nnc_mem_open(&mem, data, AES_SIZE & ~0xF);
+		CHECK(nnc_aes_cbc_open(&cbc, NNC_RSP(&mem), key, (nnc_u8 *) ivs[0]) == NNC_R_OK);
+		check_aes_reads(NNC_RSP(&cbc), plain, AES_SIZE & ~0xF, impl + 7);
+		NNC_RS_CALL0(cbc, close);
+	}
+	mbedtls_aes_free(&aes);
+	CHECK(nnc_aes_set_impl(def) == NNC_R_OK);
+	free(plain);
+	printf("aes implementations: ok (%u)\n", impls);
+}
+
+int crypto_main(int argc, char *argv[])
+{
+	if(argc != 1) die("usage: %s", argv[0]);
+	nnc_u8 *data = malloc(DATA_SIZE);
+	if(!data) die("out of memory");
+	srand(0);
+	for(size_t i = 0; i < DATA_SIZE; ++i)
+		data[i] = rand();
+
+	test_sha256_impls(data);
+	test_sha256_multi(data);
+	test_fused_hashing(data);
+	test_key_cache(data);
+	test_seeddb();
+	test_aes_impls(data);
+
+	free(data);
+	return 0;
+}
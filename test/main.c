@@ -1,4 +1,5 @@
 
+#include <nnc/trace.h>
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
@@ -6,7 +7,7 @@
 
 #define BUILD_OPTS "build exefs | build romfs"
 
-#define DIE_USAGE() die("usage: [ extract-exefs | exheader-info | extract-romfs | romfs-info | ncch-info | tmd-info | smdh-info | test-u128 | tik-info | cia-unpack | " BUILD_OPTS " ]")
+#define DIE_USAGE() die("usage: [ extract-exefs | exheader-info | extract-romfs | romfs-info | ncch-info | tmd-info | smdh-info | test-u128 | test-streams | test-writers | test-crypto | bench | tik-info | cia-unpack | " BUILD_OPTS " ]")
 #define DIE_BUILD_USAGE() die("usage: [ " BUILD_OPTS " ]")
 
 static const char *opt = "nnc-test";
@@ -39,6 +40,10 @@ int smdh_main(int argc, char *argv[]); /* smdh.c */
 int u128_main(int argc, char *argv[]); /* u128.c */
 int tik_main(int argc, char *argv[]); /* tik.c */
 int cia_main(int argc, char *argv[]); /* cia.c */
+int bench_main(int argc, char *argv[]); /* bench.c */
+int streams_main(int argc, char *argv[]); /* streams.c */
+int writers_main(int argc, char *argv[]); /* writers.c */
+int crypto_main(int argc, char *argv[]); /* crypto.c */
 
 int build_exefs_main(int argc, char *argv[]); /* exefs.c */
 int bromfs_main(int argc, char *argv[]); /* romfs.c */
@@ -56,9 +61,18 @@ static int build_main(int argc, char *argv[])
 	DIE_BUILD_USAGE();
 }
 
+static void dump_trace(void)
+{
+	nnc_trace_internal_dump_json(stderr);
+	nnc_trace_internal_stop();
+}
+
 int main(int argc, char *argv[])
 {
 	if(argc < 2) DIE_USAGE();
+	/* set NNC_TRACE to get statistics of the streams opened by the library on stderr */
+	if(getenv("NNC_TRACE") && nnc_trace_internal_start() == NNC_R_OK)
+		atexit(dump_trace);
 	const char *cmd = argv[1];
 	argv[1] = argv[0];
 	--argc;
@@ -71,10 +85,14 @@ int main(int argc, char *argv[])
 	CASE("tmd-info", tmd_info_main);
 	CASE("smdh-info", smdh_main);
 	CASE("test-u128", u128_main);
+	CASE("test-streams", streams_main);
+	CASE("test-writers", writers_main);
+	CASE("test-crypto", crypto_main);
 	CASE("tik-info", tik_main);
 	CASE("cia-unpack", cia_main);
 	CASE("rewrite-cia", rewrite_cia_main);
 	CASE("build", build_main);
+	CASE("bench", bench_main);
 #undef CASE
 	DIE_USAGE();
 }
@@ -30,8 +30,8 @@ int romfs_main(int argc, char *argv[])
 	if(argc != 2) die("usage: %s <file>", argv[0]);
 	const char *romfs_file = argv[1];
 
-	nnc_file f;
-	if(nnc_file_open(&f, romfs_file) != NNC_R_OK)
+	nnc_mmap_file f;
+	if(nnc_mmap_file_open(&f, romfs_file) != NNC_R_OK)
 		die("f->open() failed");
 
 	nnc_romfs_ctx ctx;
@@ -88,31 +88,13 @@ static void extract_dir(nnc_romfs_ctx *ctx, nnc_romfs_info *info, const char *pa
 		else
 		{
 			puts(pathbuf + baselen);
-			FILE *out = fopen(pathbuf, "w");
+			nnc_wfile out;
+			if(nnc_wfile_open(&out, pathbuf) != NNC_R_OK)
+				die("failed to open '%s'", pathbuf);
 			/* empty files just need to be touched */
-			if(ent.u.f.size)
-			{
-				/* slurping the file is a bit inefficient for large
-				 * files but it's fine for this test */
-				nnc_u8 *cbuf = malloc(ent.u.f.size);
-				nnc_subview sv;
-				if(nnc_romfs_open_subview(ctx, &sv, &ent) != NNC_R_OK)
-					goto file_fail;
-				nnc_u32 r;
-				if(NNC_RS_CALL(sv, read, cbuf, ent.u.f.size, &r) != NNC_R_OK)
-					goto file_fail;
-				if(r != ent.u.f.size) goto file_fail;
-				if(fwrite(cbuf, ent.u.f.size, 1, out) != 1)
-					goto file_fail;
-out:
-				fclose(out);
-				free(cbuf);
-				continue;
-file_fail:
+			if(ent.u.f.size && nnc_romfs_copy_file(ctx, &ent, NNC_WSP(&out)) != NNC_R_OK)
 				fprintf(stderr, "fail: ");
-				goto out;
-			}
-			fclose(out);
+			NNC_WS_CALL0(out, close);
 		}
 	}
 }
@@ -148,7 +130,7 @@ int bromfs_main(int argc, char *argv[])
 	const char *input_dir = argv[1];
 	const char *output = argv[2];
 
-	nnc_wfile wf;
+	nnc_buffered_wfile wf;
 	nnc_vfs vfs;
 
 	nnc_result res;
@@ -165,7 +147,7 @@ int bromfs_main(int argc, char *argv[])
 		return 1;
 	}
 
-	if((res = nnc_wfile_open(&wf, output)) != NNC_R_OK)
+	if((res = nnc_buffered_wfile_open(&wf, output, 0)) != NNC_R_OK)
 	{
 		nnc_vfs_free(&vfs);
 		fprintf(stderr, "failed to open output file '%s': %s\n", output, nnc_strerror(res));
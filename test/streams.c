@@ -0,0 +1,866 @@
+#define _POSIX_C_SOURCE 200112L
+#include <nnc/crypto.h>
+#include <nnc/stream.h>
+#include <nnc/cache.h>
+#include <nnc/aio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+
+void die(const char *fmt, ...);
+
+#define CHECK(expr) do { if(!(expr)) die("%s:%d: check failed: %s", __FILE__, __LINE__, #expr); } while(0)
+
+/* large enough for nnc_copy to use threads */
+#define DATA_SIZE 0x1400000
+#define TEMP_NAME "nnc-test-streams.tmp"
+
+static void write_temp(const char *name, const nnc_u8 *data, size_t size)
+{
+	FILE *f = fopen(name, "wb");
+	CHECK(f && fwrite(data, 1, size, f) == size && fclose(f) == 0);
+}
+
+/* memory stream whose reads fail from fail_at onwards */
+typedef struct failing_rstream {
+	const nnc_rstream_funcs *funcs;
+	nnc_memory mem;
+	nnc_u64 fail_at;
+} failing_rstream;
+
+static nnc_result failing_read_at(failing_rstream *self, nnc_u64 pos, nnc_u8 *buf, nnc_u32 max, nnc_u32 *totalRead)
+{
+	if(pos + max > self->fail_at) return NNC_R_FAIL_READ;
+	return nnc_rs_read_at(&self->mem, pos, buf, max, totalRead);
+}
+
+static nnc_result failing_read(failing_rstream *self, nnc_u8 *buf, nnc_u32 max, nnc_u32 *totalRead)
+{
+	nnc_result res = failing_read_at(self, nnc_rs_tell(&self->mem), buf, max, totalRead);
+	if(res == NNC_R_OK) res = nnc_rs_seek_rel(&self->mem, *totalRead);
+	return res;
+}
+
+static nnc_result failing_seek_abs(failing_rstream *self, nnc_u64 pos) { return nnc_rs_seek_abs(&self->mem, pos); }
+static nnc_result failing_seek_rel(failing_rstream *self, nnc_u64 pos) { return nnc_rs_seek_rel(&self->mem, pos); }
+static nnc_u64 failing_size(failing_rstream *self) { return nnc_rs_size(&self->mem); }
+static nnc_u64 failing_tell(failing_rstream *self) { return nnc_rs_tell(&self->mem); }
+static void failing_close(failing_rstream *self) { (void) self; }
+
+static const nnc_rstream_funcs failing_funcs = {
+	.read = (nnc_read_func) failing_read,
+	.seek_abs = (nnc_seek_abs_func) failing_seek_abs,
+	.seek_rel = (nnc_seek_rel_func) failing_seek_rel,
+	.size = (nnc_size_func) failing_size,
+	.close = (nnc_close_func) failing_close,
+	.tell = (nnc_tell_func) failing_tell,
+	.read_at = (nnc_read_at_func) failing_read_at,
+};
+
+/* memory stream that can only be read from its position, like a user stream */
+static nnc_rstream_funcs seek_only_funcs;
+static nnc_read_func mem_read;
+
+/* gives other threads the chance to move the position mid-read, even on one processor */
+static nnc_result seek_only_read(nnc_rstream *self, nnc_u8 *buf, nnc_u32 max, nnc_u32 *totalRead)
+{
+	nnc_u32 total = 0, got;
+	nnc_result res = NNC_R_OK;
+	while(total != max && res == NNC_R_OK)
+	{
+		res = mem_read(self, buf + total, max - total < 0x1000 ? max - total : 0x1000, &got);
+		if(res == NNC_R_OK && got == 0) break;
+		total += got;
+		sched_yield();
+	}
+	*totalRead = total;
+	return res;
+}
+
+static void seek_only_open(nnc_memory *self, const void *ptr, nnc_u64 size)
+{
+	nnc_mem_open(self, ptr, size);
+	seek_only_funcs = *self->funcs;
+	mem_read = seek_only_funcs.read;
+	seek_only_funcs.read = seek_only_read;
+	seek_only_funcs.read_at = NULL;
+	seek_only_funcs.borrow = NULL;
+	seek_only_funcs.clone = NULL;
+	self->funcs = &seek_only_funcs;
+}
+
+/* memory stream that counts its positional reads */
+static nnc_rstream_funcs counting_funcs;
+static nnc_read_at_func mem_read_at;
+static unsigned child_reads;
+
+static nnc_result counting_read_at(nnc_rstream *self, nnc_u64 pos, nnc_u8 *buf, nnc_u32 max, nnc_u32 *totalRead)
+{
+	++child_reads;
+	return mem_read_at(self, pos, buf, max, totalRead);
+}
+
+static void counting_open(nnc_memory *self, const void *ptr, nnc_u64 size)
+{
+	nnc_mem_open(self, ptr, size);
+	counting_funcs = *self->funcs;
+	mem_read_at = counting_funcs.read_at;
+	counting_funcs.read_at = counting_read_at;
+	self->funcs = &counting_funcs;
+	child_reads = 0;
+}
+
+/* memory stream that records the last hint passed to it */
+static nnc_rstream_funcs advised_funcs;
+static nnc_u64 advised_pos, advised_len;
+static int advised_advice;
+
+static nnc_result advised_advise(nnc_rstream *self, nnc_u64 pos, nnc_u64 len, int advice)
+{
+	(void) self;
+	advised_pos = pos;
+	advised_len = len;
+	advised_advice = advice;
+	return NNC_R_OK;
+}
+
+static void advised_open(nnc_memory *self, const void *ptr, nnc_u64 size)
+{
+	nnc_mem_open(self, ptr, size);
+	advised_funcs = *self->funcs;
+	advised_funcs.advise = advised_advise;
+	self->funcs = &advised_funcs;
+	advised_pos = advised_len = 0;
+	advised_advice = -1;
+}
+
+static void test_copy_failing(const nnc_u8 *data)
+{
+	static const nnc_u64 sizes[] = { 0x100000, DATA_SIZE };
+	/* a few rounds as reads left in flight don't always crash */
+	for(unsigned round = 0; round < 4 * sizeof(sizes) / sizeof(sizes[0]); ++round)
+	{
+		nnc_u64 size = sizes[round % (sizeof(sizes) / sizeof(sizes[0]))];
+		/* fail in the first block, in the middle and in the last block */
+		nnc_u64 fail_points[] = { 0x100, size / 2 + 0x123, size - 1 };
+		for(unsigned i = 0; i < sizeof(fail_points) / sizeof(fail_points[0]); ++i)
+		{
+			failing_rstream rs = { .funcs = &failing_funcs, .fail_at = fail_points[i] };
+			nnc_wcounter out;
+			nnc_mem_open(&rs.mem, data, size);
+			nnc_wcounter_open(&out);
+			CHECK(nnc_copy(NNC_RSP(&rs), NNC_WSP(&out), NULL) == NNC_R_FAIL_READ);
+			CHECK(out.size <= fail_points[i]);
+		}
+	}
+	puts("copy from a failing stream: ok");
+}
+
+static void test_copy_seek_only(const nnc_u8 *data)
+{
+	nnc_memory base;
+	nnc_subview sv;
+	nnc_wmemory out;
+	nnc_aio *aio;
+	seek_only_open(&base, data, DATA_SIZE);
+	nnc_subview_open(&sv, NNC_RSP(&base), 0x123, DATA_SIZE - 0x123);
+	/* the subview can't read positionally without the child seeking */
+	CHECK(sv.funcs->read_at == NULL);
+	CHECK(nnc_aio_open(&aio, NNC_RSP(&sv), 4, NNC_AIO_DEFAULT) == NNC_R_OK);
+	CHECK(nnc_aio_get_backend(aio) == NNC_AIO_SYNC);
+	nnc_aio_close(aio);
+
+	CHECK(nnc_wmemory_open(&out, 0) == NNC_R_OK);
+	CHECK(nnc_copy(NNC_RSP(&sv), NNC_WSP(&out), NULL) == NNC_R_OK);
+	CHECK(out.size == DATA_SIZE - 0x123 && memcmp(out.buf, data + 0x123, out.size) == 0);
+	NNC_WS_CALL0(out, close);
+	puts("copy from a subview over a seek-only stream: ok");
+}
+
+/* decrypts the whole stream with one read_at */
+static void read_crypt(nnc_rstream *rs, nnc_u8 *out, nnc_u32 size)
+{
+	nnc_u32 got;
+	CHECK(nnc_rs_read_at(rs, 0, out, size, &got) == NNC_R_OK);
+	CHECK(got == size);
+}
+
+static void test_ctr_threads(const nnc_u8 *data)
+{
+	nnc_u8 *ref = malloc(DATA_SIZE), *out = malloc(DATA_SIZE);
+	nnc_u8 iv[0x10] = { 0x00, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 };
+	nnc_u128 key = NNC_PROMOTE128(0x0123456789ABCDEFULL);
+	nnc_memory mem, base;
+	nnc_subview sv;
+	nnc_aes_ctr ctr;
+	if(!ref || !out) die("out of memory");
+
+	nnc_mem_open(&mem, data, DATA_SIZE);
+	CHECK(nnc_aes_ctr_open(&ctr, NNC_RSP(&mem), &key, iv) == NNC_R_OK);
+	nnc_aes_ctr_set_threads(&ctr, 1);
+	read_crypt(NNC_RSP(&ctr), ref, DATA_SIZE);
+	nnc_aes_ctr_set_threads(&ctr, 4);
+	read_crypt(NNC_RSP(&ctr), out, DATA_SIZE);
+	CHECK(memcmp(ref, out, DATA_SIZE) == 0);
+	nnc_rs_close(&ctr);
+
+	/* the threads must not share the position of the seek-only stream */
+	seek_only_open(&base, data, DATA_SIZE);
+	nnc_subview_open(&sv, NNC_RSP(&base), 0, DATA_SIZE);
+	CHECK(nnc_aes_ctr_open(&ctr, NNC_RSP(&sv), &key, iv) == NNC_R_OK);
+	nnc_aes_ctr_set_threads(&ctr, 4);
+	memset(out, 0, DATA_SIZE);
+	read_crypt(NNC_RSP(&ctr), out, DATA_SIZE);
+	CHECK(memcmp(ref, out, DATA_SIZE) == 0);
+	nnc_rs_close(&ctr);
+
+	/* a failed read in one of the threads must not decrypt past its part */
+	failing_rstream fr = { .funcs = &failing_funcs, .fail_at = DATA_SIZE / 2 + 0x123 };
+	nnc_u32 got;
+	nnc_mem_open(&fr.mem, data, DATA_SIZE);
+	CHECK(nnc_aes_ctr_open(&ctr, NNC_RSP(&fr), &key, iv) == NNC_R_OK);
+	nnc_aes_ctr_set_threads(&ctr, 4);
+	for(int i = 0; i < 8; ++i)
+		CHECK(nnc_rs_read_at(&ctr, 0, out, DATA_SIZE, &got) == NNC_R_FAIL_READ);
+	nnc_rs_close(&ctr);
+
+	free(ref);
+	free(out);
+	puts("threaded aes-ctr reads: ok");
+}
+
+static void test_cbc_threads(const nnc_u8 *data)
+{
+	nnc_u8 *ref = malloc(DATA_SIZE), *out = malloc(DATA_SIZE);
+	nnc_u8 iv[0x10] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F };
+	nnc_u8 key[0x10] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF };
+	nnc_memory mem, base;
+	nnc_wmemory wm;
+	nnc_subview sv;
+	nnc_aes_cbc cbc;
+	if(!ref || !out) die("out of memory");
+
+	nnc_mem_open(&mem, data, DATA_SIZE);
+	CHECK(nnc_aes_cbc_open(&cbc, NNC_RSP(&mem), key, iv) == NNC_R_OK);
+	nnc_aes_cbc_set_threads(&cbc, 1);
+	read_crypt(NNC_RSP(&cbc), ref, DATA_SIZE);
+	nnc_aes_cbc_set_threads(&cbc, 4);
+	read_crypt(NNC_RSP(&cbc), out, DATA_SIZE);
+	CHECK(memcmp(ref, out, DATA_SIZE) == 0);
+	nnc_rs_close(&cbc);
+
+	/* like a CIA content in a stream without positional reads */
+	seek_only_open(&base, data, DATA_SIZE);
+	nnc_subview_open(&sv, NNC_RSP(&base), 0, DATA_SIZE);
+	CHECK(nnc_aes_cbc_open(&cbc, NNC_RSP(&sv), key, iv) == NNC_R_OK);
+	nnc_aes_cbc_set_threads(&cbc, 4);
+	memset(out, 0, DATA_SIZE);
+	read_crypt(NNC_RSP(&cbc), out, DATA_SIZE);
+	CHECK(memcmp(ref, out, DATA_SIZE) == 0);
+	CHECK(nnc_wmemory_open(&wm, 0) == NNC_R_OK);
+	CHECK(nnc_decrypt_section_parallel(NNC_RSP(&cbc), NNC_WSP(&wm), 4) == NNC_R_OK);
+	CHECK(wm.size == DATA_SIZE && memcmp(ref, wm.buf, DATA_SIZE) == 0);
+	NNC_WS_CALL0(wm, close);
+	nnc_rs_close(&cbc);
+
+	failing_rstream fr = { .funcs = &failing_funcs, .fail_at = DATA_SIZE / 2 + 0x123 };
+	nnc_u32 got;
+	nnc_mem_open(&fr.mem, data, DATA_SIZE);
+	CHECK(nnc_aes_cbc_open(&cbc, NNC_RSP(&fr), key, iv) == NNC_R_OK);
+	nnc_aes_cbc_set_threads(&cbc, 4);
+	for(int i = 0; i < 8; ++i)
+		CHECK(nnc_rs_read_at(&cbc, 0, out, DATA_SIZE, &got) == NNC_R_FAIL_READ);
+	nnc_rs_close(&cbc);
+
+	free(ref);
+	free(out);
+	puts("threaded aes-cbc reads: ok");
+}
+
+struct buffered_reader {
+	nnc_rstream *rs;
+	const nnc_u8 *data;
+	unsigned seed;
+	int bad;
+};
+
+static void *buffered_reader(void *arg)
+{
+	struct buffered_reader *r = arg;
+	nnc_u8 *buf = malloc(0x40000);
+	nnc_u32 got;
+	nnc_u64 pos = 0;
+	if(!buf) die("out of memory");
+	for(int i = 0; i < 2000 && !r->bad; ++i)
+	{
+		r->seed = r->seed * 1103515245 + 12345;
+		/* mostly small sequential reads so the read-ahead grows, some random and some larger than the window */
+		nnc_u32 len = r->seed % 16 == 0 ? 0x30000 + r->seed % 0x10000 : (r->seed >> 8) % 0x800;
+		if(r->seed % 8 == 1 || pos + len > DATA_SIZE) pos = (r->seed >> 4) % (DATA_SIZE - 0x40000);
+		if(nnc_rs_read_at(r->rs, pos, buf, len, &got) != NNC_R_OK || got != len || memcmp(buf, r->data + pos, len) != 0)
+			r->bad = 1;
+		pos += len;
+	}
+	free(buf);
+	return NULL;
+}
+
+static void read_from_threads(nnc_rstream *rs, const nnc_u8 *data)
+{
+	struct buffered_reader readers[4];
+	pthread_t threads[4];
+	for(int i = 0; i < 4; ++i)
+	{
+		readers[i] = (struct buffered_reader) { rs, data, i + 1, 0 };
+		CHECK(pthread_create(&threads[i], NULL, buffered_reader, &readers[i]) == 0);
+	}
+	for(int i = 0; i < 4; ++i)
+	{
+		pthread_join(threads[i], NULL);
+		CHECK(!readers[i].bad);
+	}
+}
+
+static void test_buffered_threads(const nnc_u8 *data)
+{
+	nnc_buffered_rstream brs;
+	nnc_memory mem;
+	nnc_file f;
+	write_temp(TEMP_NAME, data, DATA_SIZE);
+
+	/* file streams are buffered by default */
+	CHECK(nnc_file_open(&f, TEMP_NAME) == NNC_R_OK);
+	read_from_threads(NNC_RSP(&f), data);
+	NNC_RS_CALL0(f, close);
+	remove(TEMP_NAME);
+
+	nnc_mem_open(&mem, data, DATA_SIZE);
+	CHECK(nnc_buffered_rstream_open(&brs, NNC_RSP(&mem), 0) == NNC_R_OK);
+	read_from_threads(NNC_RSP(&brs), data);
+	NNC_RS_CALL0(brs, close);
+
+	/* the child is read with its position, so refills stay serialized */
+	seek_only_open(&mem, data, DATA_SIZE);
+	CHECK(nnc_buffered_rstream_open(&brs, NNC_RSP(&mem), 0) == NNC_R_OK);
+	read_from_threads(NNC_RSP(&brs), data);
+	NNC_RS_CALL0(brs, close);
+	puts("buffered reads from several threads: ok");
+}
+
+static void test_mmap_borrow(const nnc_u8 *data)
+{
+	nnc_sha256_hash want, got_hash;
+	nnc_mmap_file mf;
+	nnc_memory mem;
+	nnc_subview sv;
+	const nnc_u8 *ptr;
+	nnc_u8 buf[0x100];
+	nnc_u32 got;
+	write_temp(TEMP_NAME, data, 0x100000);
+	CHECK(nnc_mmap_file_open(&mf, TEMP_NAME) == NNC_R_OK);
+	CHECK(nnc_rs_size(&mf) == 0x100000);
+	CHECK(nnc_rs_seek_abs(&mf, 0x1234) == NNC_R_OK);
+	CHECK(nnc_rs_read(&mf, buf, sizeof(buf), &got) == NNC_R_OK && got == sizeof(buf));
+	CHECK(memcmp(buf, data + 0x1234, sizeof(buf)) == 0 && nnc_rs_tell(&mf) == 0x1234 + sizeof(buf));
+	CHECK(nnc_rs_read_at(&mf, 0xFFFF0, buf, sizeof(buf), &got) == NNC_R_OK && got == 0x10);
+	CHECK(memcmp(buf, data + 0xFFFF0, 0x10) == 0);
+	/* borrowing doesn't move the position */
+	CHECK(nnc_rs_borrow(&mf, 0x8000, 0x1000, &ptr) == NNC_R_OK && memcmp(ptr, data + 0x8000, 0x1000) == 0);
+	CHECK(nnc_rs_tell(&mf) == 0x1234 + sizeof(buf));
+	CHECK(nnc_rs_borrow(&mf, 0xFFFFF, 2, &ptr) == NNC_R_SEEK_RANGE);
+	/* hashing goes through the borrowed pages */
+	CHECK(nnc_rs_seek_abs(&mf, 0x10) == NNC_R_OK);
+	CHECK(nnc_crypto_sha256_part(NNC_RSP(&mf), got_hash, 0x80000) == NNC_R_OK);
+	nnc_crypto_sha256(data + 0x10, want, 0x80000);
+	CHECK(nnc_crypto_hasheq(want, got_hash));
+	NNC_RS_CALL0(mf, close);
+	remove(TEMP_NAME);
+
+	/* memory and subviews hand out pointers into the original buffer */
+	nnc_mem_open(&mem, data, DATA_SIZE);
+	CHECK(nnc_rs_borrow(&mem, 0x100, 0x10, &ptr) == NNC_R_OK && ptr == data + 0x100);
+	nnc_subview_open(&sv, NNC_RSP(&mem), 0x1000, 0x2000);
+	CHECK(nnc_rs_borrow(&sv, 0x10, 0x20, &ptr) == NNC_R_OK && ptr == data + 0x1010);
+	CHECK(nnc_rs_borrow(&sv, 0x1FF0, 0x20, &ptr) == NNC_R_SEEK_RANGE);
+	seek_only_open(&mem, data, DATA_SIZE);
+	CHECK(nnc_rs_borrow(&mem, 0, 0x10, &ptr) == NNC_R_UNSUPPORTED);
+	puts("mmap and borrow: ok");
+}
+
+static void test_cache(const nnc_u8 *data)
+{
+	nnc_cached_rstream cs;
+	nnc_cache_stats st;
+	nnc_memory mem;
+	nnc_u8 buf[0x2000];
+	nnc_u32 got;
+	/* 2 blocks in each of the shards */
+	CHECK(nnc_cache_init(32 * 0x1000, 0x1000) == NNC_R_OK);
+	counting_open(&mem, data, 0x100000);
+	nnc_cached_rstream_open(&cs, NNC_RSP(&mem));
+	CHECK(nnc_rs_read_at(&cs, 0x800, buf, 0x1000, &got) == NNC_R_OK && got == 0x1000);
+	CHECK(memcmp(buf, data + 0x800, 0x1000) == 0);
+	nnc_cache_get_stats(&st);
+	CHECK(st.misses == 2 && st.hits == 0 && child_reads == 2 && st.block_size == 0x1000 && st.capacity == 32);
+	/* both blocks are served without reading the child */
+	CHECK(nnc_rs_read_at(&cs, 0, buf, 0x2000, &got) == NNC_R_OK && got == 0x2000);
+	CHECK(memcmp(buf, data, 0x2000) == 0);
+	nnc_cache_get_stats(&st);
+	CHECK(st.misses == 2 && st.hits == 2 && child_reads == 2);
+
+	nnc_cache_reset_stats();
+	for(nnc_u32 i = 0; i < 64; ++i)
+	{
+		CHECK(nnc_rs_read_at(&cs, i * 0x1000 + 0x10, buf, 0x10, &got) == NNC_R_OK && got == 0x10);
+		CHECK(memcmp(buf, data + i * 0x1000 + 0x10, 0x10) == 0);
+	}
+	nnc_cache_get_stats(&st);
+	CHECK(st.hits + st.misses == 64 && st.misses >= 62 && st.blocks <= st.capacity);
+	CHECK(st.evictions == 2 + st.misses - st.blocks && st.evictions >= 32);
+	/* the last block is shorter */
+	CHECK(nnc_rs_read_at(&cs, 0xFFFF8, buf, 0x10, &got) == NNC_R_OK && got == 8);
+	NNC_RS_CALL0(cs, close);
+
+	/* a new stream over the same child doesn't see the old blocks */
+	nnc_cache_reset_stats();
+	nnc_cached_rstream_open(&cs, NNC_RSP(&mem));
+	CHECK(nnc_rs_read_at(&cs, 63 * 0x1000, buf, 0x10, &got) == NNC_R_OK);
+	nnc_cache_get_stats(&st);
+	CHECK(st.misses == 1 && st.hits == 0);
+
+	/* without the cache reads go to the child */
+	nnc_cache_free();
+	nnc_cache_get_stats(&st);
+	CHECK(st.capacity == 0 && st.blocks == 0);
+	child_reads = 0;
+	CHECK(nnc_rs_read_at(&cs, 0x10, buf, 0x10, &got) == NNC_R_OK && memcmp(buf, data + 0x10, 0x10) == 0);
+	CHECK(child_reads == 1);
+	NNC_RS_CALL0(cs, close);
+	puts("block cache: ok");
+}
+
+/* reads a whole file, returns its size */
+static size_t read_temp(const char *name, nnc_u8 *buf, size_t max)
+{
+	FILE *f = fopen(name, "rb");
+	CHECK(f);
+	size_t size = fread(buf, 1, max, f);
+	fclose(f);
+	return size;
+}
+
+static void test_buffered_wfile(const nnc_u8 *data)
+{
+	nnc_u8 *model = calloc(1, 0x400000), *back = malloc(0x400000);
+	if(!model || !back) die("out of memory");
+	for(unsigned round = 0; round < 20; ++round)
+	{
+		nnc_buffered_wfile bw;
+		nnc_u64 pos = 0, end = 0;
+		unsigned seed = round + 1;
+		memset(model, 0, 0x400000);
+		/* odd buffer sizes so writes cross boundaries at all offsets */
+		CHECK(nnc_buffered_wfile_open(&bw, TEMP_NAME, round % 2 ? 0x1000 + round * 0x123 : 0) == NNC_R_OK);
+		for(int op = 0; op < 300; ++op)
+		{
+			seed = seed * 1103515245 + 12345;
+			unsigned kind = (seed >> 16) % 10;
+			if(kind < 7)
+			{
+				/* mostly small writes, some spanning several buffers */
+				nnc_u32 len = kind == 0 ? (seed >> 4) % 0x30000 : (seed >> 4) % 0x300;
+				nnc_u64 from = (seed >> 8) % (DATA_SIZE - 0x30000);
+				if(pos + len > 0x400000) len = 0;
+				CHECK(NNC_WS_CALL(bw, write, (nnc_u8 *) data + from, len) == NNC_R_OK);
+				memcpy(model + pos, data + from, len);
+				pos += len;
+			}
+			else if(kind < 9)
+			{
+				/* go back to patch a header, or to the end */
+				pos = kind == 7 ? (seed >> 4) % (end + 1) : end;
+				CHECK(NNC_WS_CALL(bw, seek, pos) == NNC_R_OK);
+			}
+			else
+			{
+				nnc_subview sv;
+				nnc_u32 got;
+				CHECK(NNC_WS_CALL(bw, subreadstream, &sv, 0, end) == NNC_R_OK);
+				CHECK(NNC_RS_CALL(sv, read, back, end, &got) == NNC_R_OK && got == end);
+				CHECK(memcmp(back, model, end) == 0);
+				NNC_RS_CALL0(sv, close);
+			}
+			end = pos > end ? pos : end;
+			CHECK(NNC_WS_CALL0(bw, tell) == pos);
+		}
+		CHECK(NNC_WS_CALL0(bw, close) == NNC_R_OK);
+		CHECK(read_temp(TEMP_NAME, back, 0x400000) == end && memcmp(back, model, end) == 0);
+	}
+	remove(TEMP_NAME);
+	free(model);
+	free(back);
+	puts("buffered file writes: ok");
+}
+
+/* copies a subview of the file after a prefix, the copy must land at the write position */
+static void copy_file_into(nnc_wstream *ws, nnc_rstream *rs, nnc_u64 size)
+{
+	nnc_u64 copied;
+	CHECK(NNC_WS_PCALL(ws, write, (nnc_u8 *) "head", 4) == NNC_R_OK);
+	CHECK(nnc_copy(rs, ws, &copied) == NNC_R_OK && copied == size);
+	CHECK(nnc_rs_tell(rs) == size);
+	CHECK(NNC_WS_PCALL(ws, write, (nnc_u8 *) "tail", 4) == NNC_R_OK);
+	CHECK(NNC_WS_PCALL0(ws, tell) == size + 8);
+	NNC_WS_PCALL0(ws, close);
+}
+
+static void check_copied(const nnc_u8 *data, nnc_u64 size, nnc_u8 *back)
+{
+	CHECK(read_temp(TEMP_NAME ".out", back, size + 9) == size + 8);
+	CHECK(memcmp(back, "head", 4) == 0 && memcmp(back + 4, data, size) == 0
+		&& memcmp(back + 4 + size, "tail", 4) == 0);
+}
+
+static void test_copy_files(const nnc_u8 *data)
+{
+	const nnc_u64 offset = 0x1234, size = DATA_SIZE / 2 + 0x777;
+	nnc_u8 *back = malloc(DATA_SIZE);
+	nnc_buffered_wfile bw;
+	nnc_subview sv, rb;
+	nnc_wfile out;
+	nnc_file in;
+	if(!back) die("out of memory");
+	write_temp(TEMP_NAME, data, DATA_SIZE);
+	CHECK(nnc_file_open(&in, TEMP_NAME) == NNC_R_OK);
+
+	nnc_subview_open(&sv, NNC_RSP(&in), offset, size);
+	CHECK(nnc_wfile_open(&out, TEMP_NAME ".out") == NNC_R_OK);
+	copy_file_into(NNC_WSP(&out), NNC_RSP(&sv), size);
+	check_copied(data + offset, size, back);
+
+	nnc_subview_open(&sv, NNC_RSP(&in), offset, size);
+	CHECK(nnc_buffered_wfile_open(&bw, TEMP_NAME ".out", 0x1000) == NNC_R_OK);
+	copy_file_into(NNC_WSP(&bw), NNC_RSP(&sv), size);
+	check_copied(data + offset, size, back);
+
+	/* copying what was just written back into the same file */
+	CHECK(nnc_wfile_open(&out, TEMP_NAME ".out") == NNC_R_OK);
+	CHECK(NNC_WS_CALL(out, write, (nnc_u8 *) data, 0x80000) == NNC_R_OK);
+	CHECK(NNC_WS_CALL(out, subreadstream, &rb, 0, 0x80000) == NNC_R_OK);
+	CHECK(nnc_copy(NNC_RSP(&rb), NNC_WSP(&out), NULL) == NNC_R_OK);
+	NNC_RS_CALL0(rb, close);
+	NNC_WS_CALL0(out, close);
+	CHECK(read_temp(TEMP_NAME ".out", back, 0x100001) == 0x100000);
+	CHECK(memcmp(back, data, 0x80000) == 0 && memcmp(back + 0x80000, data, 0x80000) == 0);
+
+	NNC_RS_CALL0(in, close);
+	remove(TEMP_NAME ".out");
+	remove(TEMP_NAME);
+	free(back);
+	puts("copy between files: ok");
+}
+
+/* pads after some data, over data written earlier and at the very end */
+static nnc_u64 write_padded(nnc_wstream *ws, const nnc_u8 *data, nnc_u8 *model, nnc_u64 pad)
+{
+	memset(model, 0, 0x30000 + 2 * pad);
+	CHECK(NNC_WS_PCALL(ws, write, (nnc_u8 *) data, 0x10000) == NNC_R_OK);
+	memcpy(model, data, 0x10000);
+	CHECK(nnc_write_padding(ws, pad) == NNC_R_OK);
+	CHECK(NNC_WS_PCALL(ws, write, (nnc_u8 *) data, 0x10000) == NNC_R_OK);
+	memcpy(model + 0x10000 + pad, data, 0x10000);
+	CHECK(NNC_WS_PCALL(ws, seek, 0x123) == NNC_R_OK);
+	CHECK(nnc_write_padding(ws, 0x10000) == NNC_R_OK);
+	memset(model + 0x123, 0, 0x10000);
+	CHECK(NNC_WS_PCALL(ws, seek, 0x20000 + pad) == NNC_R_OK);
+	CHECK(nnc_write_padding(ws, pad) == NNC_R_OK);
+	CHECK(NNC_WS_PCALL0(ws, tell) == 0x20000 + 2 * pad);
+	return 0x20000 + 2 * pad;
+}
+
+static void test_padding(const nnc_u8 *data)
+{
+	/* short paddings are written, long ones skipped over */
+	static const nnc_u64 pads[] = { 0x10, 0x1234, 0x10000, 0x123457 };
+	nnc_u8 *model = malloc(0x300000), *back = malloc(0x300000);
+	if(!model || !back) die("out of memory");
+	for(unsigned i = 0; i < sizeof(pads) / sizeof(pads[0]); ++i)
+	{
+		nnc_buffered_wfile bw;
+		nnc_wmemory wm;
+		nnc_wfile wf;
+		nnc_u64 size;
+
+		CHECK(nnc_wfile_open(&wf, TEMP_NAME) == NNC_R_OK);
+		size = write_padded(NNC_WSP(&wf), data, model, pads[i]);
+		NNC_WS_CALL0(wf, close);
+		CHECK(read_temp(TEMP_NAME, back, 0x300000) == size && memcmp(back, model, size) == 0);
+
+		CHECK(nnc_buffered_wfile_open(&bw, TEMP_NAME, 0x1000) == NNC_R_OK);
+		size = write_padded(NNC_WSP(&bw), data, model, pads[i]);
+		NNC_WS_CALL0(bw, close);
+		CHECK(read_temp(TEMP_NAME, back, 0x300000) == size && memcmp(back, model, size) == 0);
+
+		CHECK(nnc_wmemory_open(&wm, 0) == NNC_R_OK);
+		size = write_padded(NNC_WSP(&wm), data, model, pads[i]);
+		CHECK(wm.size == size && memcmp(wm.buf, model, size) == 0);
+		NNC_WS_CALL0(wm, close);
+	}
+	remove(TEMP_NAME);
+	free(model);
+	free(back);
+	puts("padding: ok");
+}
+
+static void test_wmemory(const nnc_u8 *data)
+{
+	nnc_u8 *model = calloc(1, 0x200000), *back = malloc(0x200000);
+	nnc_u64 pos = 0, end = 0;
+	unsigned seed = 1;
+	nnc_wmemory wm;
+	nnc_subview sv;
+	nnc_memory mem;
+	nnc_u32 got;
+	if(!model || !back) die("out of memory");
+	/* a tiny initial capacity so it has to grow a few times */
+	CHECK(nnc_wmemory_open(&wm, 3) == NNC_R_OK);
+	for(int op = 0; op < 500; ++op)
+	{
+		seed = seed * 1103515245 + 12345;
+		unsigned kind = (seed >> 16) % 8;
+		if(kind < 5)
+		{
+			nnc_u32 len = (seed >> 4) % (kind == 0 ? 0x20000 : 0x200);
+			if(pos + len > 0x200000) len = 0;
+			CHECK(NNC_WS_CALL(wm, write, (nnc_u8 *) data + op, len) == NNC_R_OK);
+			memcpy(model + pos, data + op, len);
+			pos += len;
+		}
+		else if(kind < 7)
+		{
+			/* past the end leaves a gap that reads back as zeros */
+			pos = (seed >> 4) % (end + 0x1000);
+			if(pos + 0x20000 > 0x200000) pos = end;
+			CHECK(NNC_WS_CALL(wm, seek, pos) == NNC_R_OK);
+		}
+		else
+		{
+			nnc_u64 start = (seed >> 4) % (end + 1);
+			CHECK(NNC_WS_CALL(wm, subreadstream, &sv, start, end - start) == NNC_R_OK);
+			CHECK(NNC_RS_CALL(sv, read, back, 0x200000, &got) == NNC_R_OK && got == end - start);
+			CHECK(memcmp(back, model + start, got) == 0);
+			NNC_RS_CALL0(sv, close);
+			CHECK(NNC_WS_CALL(wm, subreadstream, &sv, start, end - start + 1) == NNC_R_SEEK_RANGE);
+		}
+		if(kind < 5) end = pos > end ? pos : end;
+		CHECK(wm.size == end && wm.size <= wm.capacity);
+		CHECK(NNC_WS_CALL0(wm, tell) == pos);
+	}
+	CHECK(memcmp(wm.buf, model, end) == 0);
+
+	nnc_wmemory_to_rstream(&wm, &mem);
+	CHECK(wm.size == 0 && wm.buf == NULL && NNC_WS_CALL0(wm, tell) == 0);
+	CHECK(nnc_rs_size(&mem) == end);
+	CHECK(NNC_RS_CALL(mem, read, back, 0x200000, &got) == NNC_R_OK && got == end);
+	CHECK(memcmp(back, model, end) == 0);
+	NNC_RS_CALL0(mem, close);
+	/* still usable after handing the data over */
+	CHECK(NNC_WS_CALL(wm, write, (nnc_u8 *) data, 0x100) == NNC_R_OK);
+	CHECK(wm.size == 0x100 && memcmp(wm.buf, data, 0x100) == 0);
+	NNC_WS_CALL0(wm, close);
+	free(model);
+	free(back);
+	puts("memory write stream: ok");
+}
+
+#define CHECK_ADVISED(rs, pos, len, advice, exp_pos, exp_len) \
+	do { \
+		advised_advice = -1; \
+		CHECK(nnc_rs_advise(rs, pos, len, advice) == NNC_R_OK); \
+		CHECK(advised_advice == (advice) && advised_pos == (exp_pos) && advised_len == (exp_len)); \
+	} while(0)
+
+static void test_advise(const nnc_u8 *data)
+{
+	nnc_u8 key[0x10] = { 0 }, iv[0x10] = { 0 };
+	nnc_u128 ctr_key = NNC_PROMOTE128(1);
+	nnc_memory mem, plain;
+	nnc_subview sv;
+	nnc_aes_ctr ctr;
+	nnc_aes_cbc cbc;
+	advised_open(&mem, data, 0x10000);
+
+	/* subviews shift the range and clamp it to the view */
+	nnc_subview_open(&sv, NNC_RSP(&mem), 0x1000, 0x2000);
+	CHECK_ADVISED(&sv, 0x10, 0x100, NNC_ADVISE_WILLNEED, 0x1010, 0x100);
+	CHECK_ADVISED(&sv, 0x1f00, UINT64_MAX, NNC_ADVISE_SEQUENTIAL, 0x2f00, 0x100);
+	advised_advice = -1;
+	CHECK(nnc_rs_advise(&sv, 0x2000, 0x10, NNC_ADVISE_WILLNEED) == NNC_R_OK && advised_advice == -1);
+
+	/* ctr reads whole blocks */
+	CHECK(nnc_aes_ctr_open(&ctr, NNC_RSP(&sv), &ctr_key, iv) == NNC_R_OK);
+	CHECK_ADVISED(&ctr, 0x25, 0x10, NNC_ADVISE_RANDOM, 0x1020, 0x15);
+	CHECK_ADVISED(&ctr, 0x20, 0x10, NNC_ADVISE_DONTNEED, 0x1020, 0x10);
+	CHECK_ADVISED(&ctr, 0x25, UINT64_MAX, NNC_ADVISE_WILLNEED, 0x1020, 0x1fe0);
+	NNC_RS_CALL0(ctr, close);
+
+	/* cbc also needs the block before as the iv */
+	CHECK(nnc_aes_cbc_open(&cbc, NNC_RSP(&mem), key, iv) == NNC_R_OK);
+	CHECK_ADVISED(&cbc, 0x25, 0x10, NNC_ADVISE_WILLNEED, 0x10, 0x25);
+	CHECK_ADVISED(&cbc, 0x5, 0x10, NNC_ADVISE_WILLNEED, 0, 0x15);
+	CHECK_ADVISED(&cbc, 0x25, UINT64_MAX - 3, NNC_ADVISE_NORMAL, 0x10, UINT64_MAX);
+	NNC_RS_CALL0(cbc, close);
+
+	nnc_mem_open(&plain, data, 0x10);
+	CHECK(nnc_rs_advise(&plain, 0, 0x10, NNC_ADVISE_WILLNEED) == NNC_R_UNSUPPORTED);
+	puts("access pattern hints: ok");
+}
+
+#undef CHECK_ADVISED
+
+#define CLONE_SIZE 0x200000
+
+struct clone_reader {
+	nnc_rstream *rs;
+	const nnc_u8 *want;
+	nnc_u32 chunk;
+	int bad;
+};
+
+/* reads its own clone front to back with the stream position, twice */
+static void *clone_reader(void *arg)
+{
+	struct clone_reader *r = arg;
+	nnc_u8 *buf = malloc(CLONE_SIZE);
+	nnc_rstream *clone;
+	nnc_u32 got;
+	if(!buf) die("out of memory");
+	if(nnc_rs_clone(r->rs, &clone) != NNC_R_OK)
+		return r->bad = 1, free(buf), NULL;
+	for(int pass = 0; pass < 2 && !r->bad; ++pass)
+	{
+		nnc_u64 done = 0;
+		if(nnc_rs_seek_abs(clone, 0) != NNC_R_OK) r->bad = 1;
+		while(!r->bad && done != CLONE_SIZE)
+		{
+			nnc_u32 len = CLONE_SIZE - done < r->chunk ? CLONE_SIZE - done : r->chunk;
+			if(nnc_rs_read(clone, buf + done, len, &got) != NNC_R_OK || !got)
+				r->bad = 1;
+			done += got;
+		}
+		if(!r->bad && memcmp(buf, r->want, CLONE_SIZE) != 0) r->bad = 1;
+	}
+	nnc_rs_close(clone);
+	free(clone);
+	free(buf);
+	return NULL;
+}
+
+static void check_clones(nnc_rstream *rs)
+{
+	static const nnc_u32 chunks[] = { 0x10000, 4103, 16, 777 };
+	struct clone_reader readers[4];
+	pthread_t threads[4];
+	nnc_u8 *want = malloc(CLONE_SIZE), a[0x20], b[0x20];
+	nnc_rstream *clone;
+	nnc_u32 got;
+	if(!want) die("out of memory");
+	read_crypt(rs, want, CLONE_SIZE);
+
+	/* neither position moves the other */
+	CHECK(nnc_rs_seek_abs(rs, 0x123) == NNC_R_OK);
+	CHECK(nnc_rs_clone(rs, &clone) == NNC_R_OK);
+	CHECK(nnc_rs_tell(clone) == 0 && nnc_rs_size(clone) == nnc_rs_size(rs));
+	CHECK(nnc_rs_read(rs, a, 0x11, &got) == NNC_R_OK && got == 0x11);
+	CHECK(nnc_rs_read(clone, b, 0x20, &got) == NNC_R_OK && got == 0x20);
+	CHECK(memcmp(a, want + 0x123, 0x11) == 0 && memcmp(b, want, 0x20) == 0);
+	CHECK(nnc_rs_read(rs, a, 0x20, &got) == NNC_R_OK && got == 0x20 && memcmp(a, want + 0x134, 0x20) == 0);
+	CHECK(nnc_rs_tell(rs) == 0x154 && nnc_rs_tell(clone) == 0x20);
+	nnc_rs_close(clone);
+	free(clone);
+
+	for(int i = 0; i < 4; ++i)
+	{
+		readers[i] = (struct clone_reader) { rs, want, chunks[i], 0 };
+		CHECK(pthread_create(&threads[i], NULL, clone_reader, &readers[i]) == 0);
+	}
+	for(int i = 0; i < 4; ++i)
+	{
+		pthread_join(threads[i], NULL);
+		CHECK(!readers[i].bad);
+	}
+	/* the original is still where it was left */
+	CHECK(nnc_rs_tell(rs) == 0x154);
+	free(want);
+}
+
+static void test_clones(const nnc_u8 *data)
+{
+	nnc_u8 key[0x10] = { 1 }, iv[0x10] = { 2 };
+	nnc_u128 ctr_key = NNC_PROMOTE128(3);
+	nnc_buffered_rstream brs;
+	nnc_mmap_file mm;
+	nnc_memory mem;
+	nnc_subview sv;
+	nnc_aes_ctr ctr;
+	nnc_aes_cbc cbc;
+	nnc_file f;
+	write_temp(TEMP_NAME, data, CLONE_SIZE + 0x1000);
+
+	CHECK(nnc_file_open(&f, TEMP_NAME) == NNC_R_OK);
+	check_clones(NNC_RSP(&f));
+	nnc_subview_open(&sv, NNC_RSP(&f), 0x3, CLONE_SIZE);
+	check_clones(NNC_RSP(&sv));
+	CHECK(nnc_buffered_rstream_open(&brs, NNC_RSP(&sv), 0) == NNC_R_OK);
+	check_clones(NNC_RSP(&brs));
+	NNC_RS_CALL0(brs, close);
+	CHECK(nnc_aes_ctr_open(&ctr, NNC_RSP(&f), &ctr_key, iv) == NNC_R_OK);
+	check_clones(NNC_RSP(&ctr));
+	NNC_RS_CALL0(ctr, close);
+	CHECK(nnc_aes_cbc_open(&cbc, NNC_RSP(&f), key, iv) == NNC_R_OK);
+	check_clones(NNC_RSP(&cbc));
+	NNC_RS_CALL0(cbc, close);
+	NNC_RS_CALL0(f, close);
+
+	CHECK(nnc_mmap_file_open(&mm, TEMP_NAME) == NNC_R_OK);
+	check_clones(NNC_RSP(&mm));
+	NNC_RS_CALL0(mm, close);
+	remove(TEMP_NAME);
+
+	nnc_mem_open(&mem, data, CLONE_SIZE);
+	check_clones(NNC_RSP(&mem));
+	/* nothing to read from without a shared position */
+	seek_only_open(&mem, data, CLONE_SIZE);
+	nnc_rstream *clone;
+	CHECK(nnc_rs_clone(&mem, &clone) == NNC_R_UNSUPPORTED);
+	puts("stream clones: ok");
+}
+
+int streams_main(int argc, char *argv[])
+{
+	if(argc != 1) die("usage: %s", argv[0]);
+	nnc_u8 *data = malloc(DATA_SIZE);
+	if(!data) die("out of memory");
+	srand(0);
+	for(size_t i = 0; i < DATA_SIZE; ++i)
+		data[i] = rand();
+
+	test_mmap_borrow(data);
+	test_cache(data);
+	test_buffered_wfile(data);
+	test_copy_files(data);
+	test_padding(data);
+	test_wmemory(data);
+	test_advise(data);
+	test_clones(data);
+	test_copy_failing(data);
+	test_copy_seek_only(data);
+	test_ctr_threads(data);
+	test_cbc_threads(data);
+	test_buffered_threads(data);
+
+	free(data);
+	return 0;
+}
@@ -0,0 +1,439 @@
+#include <nnc/crypto.h>
+#include <nnc/stream.h>
+#include <nnc/romfs.h>
+#include <nnc/exefs.h>
+#include <nnc/ncch.h>
+#include <nnc/ivfc.h>
+#include <nnc/cia.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+void die(const char *fmt, ...);
+
+#define CHECK(expr) do { if(!(expr)) die("%s:%d: check failed: %s", __FILE__, __LINE__, #expr); } while(0)
+
+#define DATA_SIZE 0x40000
+
+static const struct test_file {
+	const char *path;
+	nnc_u32 offset, size;
+} romfs_files[] = {
+	{ "/a.bin",           0x10,    0x1234  },
+	{ "/empty",           0,       0       },
+	{ "/sub/big.bin",     0x3,     0x30001 },
+	{ "/sub/x",           0x777,   1       },
+	{ "/sub/deeper/y",    0x2000,  0x200   },
+}, exefs_files[] = {
+	{ ".code",            0x100,   0x2345  },
+	{ "icon",             0x5000,  0x36C0  },
+	{ "banner",           0x9000,  0x1001  },
+};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+static void add_file(nnc_vfs_directory_node *dir, const char *name, const nnc_u8 *data, const struct test_file *file)
+{
+	nnc_memory mem;
+	nnc_mem_open(&mem, data + file->offset, file->size);
+	CHECK(nnc_vfs_add_file(dir, name, NNC_VFS_READER_COPY(mem, 0)) == NNC_R_OK);
+}
+
+static void build_romfs_vfs(nnc_vfs *vfs, const nnc_u8 *data)
+{
+	nnc_vfs_directory_node *sub, *deeper;
+	CHECK(nnc_vfs_init(vfs) == NNC_R_OK);
+	CHECK(nnc_vfs_add_directory(&vfs->root_directory, "sub", &sub) == NNC_R_OK);
+	CHECK(nnc_vfs_add_directory(sub, "deeper", &deeper) == NNC_R_OK);
+	add_file(&vfs->root_directory, "a.bin", data, &romfs_files[0]);
+	add_file(&vfs->root_directory, "empty", data, &romfs_files[1]);
+	add_file(sub, "big.bin", data, &romfs_files[2]);
+	add_file(sub, "x", data, &romfs_files[3]);
+	add_file(deeper, "y", data, &romfs_files[4]);
+}
+
+static void build_exefs_vfs(nnc_vfs *vfs, const nnc_u8 *data)
+{
+	CHECK(nnc_vfs_init(vfs) == NNC_R_OK);
+	for(unsigned i = 0; i < ARRAY_SIZE(exefs_files); ++i)
+		add_file(&vfs->root_directory, exefs_files[i].path, data, &exefs_files[i]);
+}
+
+static void check_range(nnc_rstream *rs, nnc_u64 pos, const nnc_u8 *want, nnc_u32 size)
+{
+	nnc_u8 *buf = malloc(size + 1);
+	nnc_u32 got;
+	if(!buf) die("out of memory");
+	CHECK(nnc_rs_read_at(rs, pos, buf, size, &got) == NNC_R_OK && got == size);
+	CHECK(memcmp(buf, want, size) == 0);
+	free(buf);
+}
+
+static nnc_u64 le(const nnc_u8 *p, int size)
+{
+	nnc_u64 ret = 0;
+	while(size--) ret = (ret << 8) | p[size];
+	return ret;
+}
+
+static void check_romfs_section(const struct nnc_romfs_header_oflen *got, const struct nnc_romfs_header_oflen *want)
+{
+	CHECK(got->offset == want->offset && got->length == want->length);
+}
+
+static void test_romfs_plan(const nnc_u8 *data)
+{
+	nnc_romfs_header header;
+	nnc_romfs_plan plan;
+	nnc_sha256_hash hash;
+	nnc_romfs_info info;
+	nnc_romfs_ctx ctx;
+	nnc_wmemory wm;
+	nnc_memory img;
+	nnc_subview sv;
+	nnc_u8 ivfc[0x60];
+	nnc_vfs vfs;
+	nnc_u32 got;
+	build_romfs_vfs(&vfs, data);
+	CHECK(nnc_plan_romfs(&vfs, &plan) == NNC_R_OK);
+	CHECK(nnc_wmemory_open(&wm, 0) == NNC_R_OK);
+	CHECK(nnc_write_romfs(&vfs, NNC_WSP(&wm)) == NNC_R_OK);
+	nnc_mem_open(&img, wm.buf, wm.size);
+	CHECK(plan.size == wm.size);
+
+	CHECK(nnc_read_romfs_header(NNC_RSP(&img), &header) == NNC_R_OK);
+	check_romfs_section(&header.dir_hash, &plan.header.dir_hash);
+	check_romfs_section(&header.dir_meta, &plan.header.dir_meta);
+	check_romfs_section(&header.file_hash, &plan.header.file_hash);
+	check_romfs_section(&header.file_meta, &plan.header.file_meta);
+	CHECK(header.data_offset == plan.header.data_offset);
+	CHECK(header.data_offset + plan.data_size <= plan.ivfc.level_offset[plan.ivfc.header.number_levels - 1]
+		+ plan.ivfc.header.level[plan.ivfc.header.number_levels - 1].size);
+
+	/* the level descriptors are read by hand, the reader also expects a terminator the RomFS doesn't have */
+	check_range(NNC_RSP(&img), 0, (const nnc_u8 *) "IVFC\x00\x00\x01\x00", 8);
+	CHECK(nnc_rs_read_at(&img, 0, ivfc, sizeof(ivfc), &got) == NNC_R_OK && got == sizeof(ivfc));
+	CHECK(le(&ivfc[0x08], 4) == plan.ivfc.header.l0_size && plan.ivfc.header.number_levels == NNC_IVFC_LEVELS_ROMFS);
+	for(nnc_u32 i = 0; i < plan.ivfc.header.number_levels; ++i)
+	{
+		const nnc_u8 *desc = &ivfc[0x0C + 0x18 * i];
+		nnc_u32 block_size = 1 << plan.ivfc.header.level[i].block_size_log2;
+		CHECK(le(&desc[0x00], 8) == plan.ivfc.header.level[i].logical_offset);
+		CHECK(le(&desc[0x08], 8) == plan.ivfc.header.level[i].size);
+		CHECK(le(&desc[0x10], 4) == plan.ivfc.header.level[i].block_size_log2);
+		/* the first hash of each level is of the first block of the next one, the
+		 * master hash after the header of the first block of level 1 */
+		CHECK(nnc_rs_seek_abs(&img, plan.ivfc.level_offset[i]) == NNC_R_OK);
+		CHECK(nnc_crypto_sha256_part(NNC_RSP(&img), hash, block_size) == NNC_R_OK);
+		check_range(NNC_RSP(&img), i == 0 ? 0x60 : plan.ivfc.level_offset[i - 1], hash, sizeof(hash));
+	}
+
+	CHECK(nnc_init_romfs(NNC_RSP(&img), &ctx) == NNC_R_OK);
+	for(unsigned i = 0; i < ARRAY_SIZE(romfs_files); ++i)
+	{
+		CHECK(nnc_get_info(&ctx, &info, romfs_files[i].path) == NNC_R_OK);
+		CHECK(info.type == NNC_ROMFS_FILE && info.u.f.size == romfs_files[i].size);
+		CHECK(info.u.f.offset + info.u.f.size <= plan.data_size);
+		CHECK(nnc_romfs_open_subview(&ctx, &sv, &info) == NNC_R_OK);
+		if(romfs_files[i].size)
+			check_range(NNC_RSP(&sv), 0, data + romfs_files[i].offset, romfs_files[i].size);
+	}
+	nnc_free_romfs(&ctx);
+	NNC_WS_CALL0(wm, close);
+	nnc_vfs_free(&vfs);
+	puts("romfs plan: ok");
+}
+
+static void test_exefs_plan(const nnc_u8 *data)
+{
+	nnc_exefs_file_header headers[NNC_EXEFS_MAX_FILES];
+	nnc_exefs_plan plan;
+	nnc_wmemory wm;
+	nnc_memory img;
+	nnc_vfs vfs;
+	nnc_u8 count;
+	build_exefs_vfs(&vfs, data);
+	CHECK(nnc_plan_exefs(&vfs, &plan) == NNC_R_OK);
+	CHECK(nnc_wmemory_open(&wm, 0) == NNC_R_OK);
+	CHECK(nnc_write_exefs(&vfs, NNC_WSP(&wm)) == NNC_R_OK);
+	nnc_mem_open(&img, wm.buf, wm.size);
+	CHECK(plan.size == wm.size);
+
+	CHECK(nnc_read_exefs_header(NNC_RSP(&img), headers, &count) == NNC_R_OK);
+	CHECK(count == ARRAY_SIZE(exefs_files));
+	for(unsigned i = 0; i < count; ++i)
+	{
+		CHECK(strcmp(headers[i].name, plan.headers[i].name) == 0);
+		CHECK(headers[i].offset == plan.headers[i].offset && headers[i].size == plan.headers[i].size);
+		for(unsigned j = 0; j < ARRAY_SIZE(exefs_files); ++j)
+			if(strcmp(headers[i].name, exefs_files[j].path) == 0)
+				check_range(NNC_RSP(&img), NNC_EXEFS_HEADER_SIZE + headers[i].offset, data + exefs_files[j].offset, exefs_files[j].size);
+	}
+	for(unsigned i = count; i < NNC_EXEFS_MAX_FILES; ++i)
+		CHECK(plan.headers[i].size == 0 && plan.headers[i].name[0] == '\0');
+	NNC_WS_CALL0(wm, close);
+	nnc_vfs_free(&vfs);
+	puts("exefs plan: ok");
+}
+
+/* the sizes in the header are rounded up to media units */
+static void check_section(const struct nnc_ncch_plan_section *section, nnc_u32 offset, nnc_u32 size)
+{
+	CHECK(section->offset == NNC_MU_TO_BYTE(offset));
+	CHECK((section->size + NNC_MEDIA_UNIT - 1) / NNC_MEDIA_UNIT == size);
+}
+
+static void build_ncch(nnc_buildable_ncch *ncch, nnc_memory *exheader, nnc_memory *logo, nnc_memory *plain,
+	nnc_vfs *exefs, nnc_vfs *romfs, const nnc_u8 *data)
+{
+	memset(ncch, 0, sizeof(*ncch));
+	ncch->chdr.partition_id = ncch->chdr.title_id = 0x0004000000123400ULL;
+	ncch->chdr.platform = 1;
+	strcpy(ncch->chdr.product_code, "CTR-P-TEST");
+	strcpy(ncch->chdr.maker_code, "00");
+	nnc_mem_open(exheader, data, 0x800);
+	nnc_mem_open(logo, data + 0x1000, 0x2000);
+	nnc_mem_open(plain, data + 0x4000, 0x201);
+	build_exefs_vfs(exefs, data);
+	build_romfs_vfs(romfs, data);
+	ncch->exheader = exheader;
+	ncch->logo = NNC_RSP(logo);
+	ncch->plain = NNC_RSP(plain);
+	ncch->exefs = exefs;
+	ncch->romfs = romfs;
+	ncch->wflags = NNC_NCCH_WF_EXHEADER_STREAM | NNC_NCCH_WF_EXEFS_VFS | NNC_NCCH_WF_ROMFS_VFS;
+}
+
+static void test_ncch_plan(const nnc_u8 *data)
+{
+	nnc_memory exheader, logo, plain, img;
+	nnc_buildable_ncch ncch;
+	nnc_ncch_header header;
+	nnc_vfs exefs, romfs;
+	nnc_ncch_plan plan;
+	nnc_wmemory wm;
+	build_ncch(&ncch, &exheader, &logo, &plain, &exefs, &romfs, data);
+	CHECK(nnc_plan_ncch(ncch.wflags, ncch.exheader, ncch.logo, ncch.plain, ncch.exefs, ncch.romfs, &plan) == NNC_R_OK);
+	CHECK(nnc_wmemory_open(&wm, 0) == NNC_R_OK);
+	CHECK(nnc_write_ncch_from_buildable(&ncch, NNC_WSP(&wm)) == NNC_R_OK);
+	nnc_mem_open(&img, wm.buf, wm.size);
+	CHECK(plan.size == wm.size);
+
+	CHECK(nnc_read_ncch_header(NNC_RSP(&img), &header) == NNC_R_OK);
+	check_section(&plan.logo, header.logo_offset, header.logo_size);
+	check_section(&plan.plain, header.plain_offset, header.plain_size);
+	check_section(&plan.exefs, header.exefs_offset, header.exefs_size);
+	check_section(&plan.romfs, header.romfs_offset, header.romfs_size);
+	CHECK(plan.exheader.size == 0x800 && header.exheader_size == 0x400);
+	CHECK(plan.exefs.size == plan.exefs_layout.size && plan.romfs.size == plan.romfs_layout.size);
+
+	check_range(NNC_RSP(&img), plan.exheader.offset, data, 0x800);
+	check_range(NNC_RSP(&img), plan.logo.offset, data + 0x1000, 0x2000);
+	check_range(NNC_RSP(&img), plan.plain.offset, data + 0x4000, 0x201);
+	check_range(NNC_RSP(&img), plan.exefs.offset + NNC_EXEFS_HEADER_SIZE + plan.exefs_layout.headers[0].offset,
+		data + exefs_files[0].offset, exefs_files[0].size);
+
+	NNC_WS_CALL0(wm, close);
+	nnc_vfs_free(&exefs);
+	nnc_vfs_free(&romfs);
+	puts("ncch plan: ok");
+}
+
+static void test_cia_plan(const nnc_u8 *data)
+{
+	const nnc_u8 wflags = NNC_CIA_WF_CERTCHAIN_STREAM | NNC_CIA_WF_TICKET_STREAM | NNC_CIA_WF_TMD_STREAM;
+	nnc_memory exheader, logo, plain, cert, ticket, tmd, blob, img;
+	nnc_cia_content_plan content_plans[3];
+	nnc_buildable_ncch ncch;
+	nnc_cia_header header;
+	nnc_vfs exefs, romfs;
+	nnc_ncch_plan ncch_plan;
+	nnc_cia_plan plan;
+	nnc_wmemory wm;
+	nnc_subview sv;
+	build_ncch(&ncch, &exheader, &logo, &plain, &exefs, &romfs, data);
+	CHECK(nnc_plan_ncch(ncch.wflags, ncch.exheader, ncch.logo, ncch.plain, ncch.exefs, ncch.romfs, &ncch_plan) == NNC_R_OK);
+	/* unaligned sizes so every section needs padding */
+	nnc_mem_open(&cert, data + 0x100, 0xA01);
+	nnc_mem_open(&ticket, data + 0x200, 0x351);
+	nnc_mem_open(&tmd, data + 0x300, 0xB35);
+	nnc_mem_open(&blob, data + 0x400, 77777);
+	nnc_cia_writable_ncch contents[3] = {
+		{ &ncch, NNC_CIA_NCCHBUILD_BUILD },
+		{ NULL, NNC_CIA_NCCHBUILD_NONE },
+		{ &blob, NNC_CIA_NCCHBUILD_STREAM },
+	};
+	CHECK(nnc_plan_cia(wflags, &cert, &ticket, &tmd, 3, contents, &plan, content_plans) == NNC_R_OK);
+	CHECK(nnc_wmemory_open(&wm, 0) == NNC_R_OK);
+	CHECK(nnc_write_cia(wflags, &cert, &ticket, &tmd, 3, contents, NNC_WSP(&wm)) == NNC_R_OK);
+	nnc_mem_open(&img, wm.buf, wm.size);
+	CHECK(plan.size == wm.size);
+
+	CHECK(nnc_read_cia_header(NNC_RSP(&img), &header) == NNC_R_OK);
+	CHECK(plan.cert_chain_size == header.cert_chain_size && plan.ticket_size == header.ticket_size);
+	CHECK(plan.tmd_size == header.tmd_size && plan.content_size == header.content_size);
+	nnc_cia_open_ticket(&header, NNC_RSP(&img), &sv);
+	CHECK(plan.ticket_offset == sv.off);
+	nnc_cia_open_tmd(&header, NNC_RSP(&img), &sv);
+	CHECK(plan.tmd_offset == sv.off);
+
+	check_range(NNC_RSP(&img), plan.certchain_offset, data + 0x100, 0xA01);
+	check_range(NNC_RSP(&img), plan.ticket_offset, data + 0x200, 0x351);
+	check_range(NNC_RSP(&img), plan.tmd_offset, data + 0x300, 0xB35);
+	CHECK(content_plans[0].offset == plan.content_offset && content_plans[0].size == ncch_plan.size);
+	CHECK(content_plans[1].offset == 0);
+	CHECK(content_plans[2].size == 77777);
+	check_range(NNC_RSP(&img), content_plans[2].offset, data + 0x400, 77777);
+	check_range(NNC_RSP(&img), content_plans[0].offset + ncch_plan.logo.offset, data + 0x1000, 0x2000);
+
+	NNC_WS_CALL0(wm, close);
+	nnc_vfs_free(&exefs);
+	nnc_vfs_free(&romfs);
+	puts("cia plan: ok");
+}
+
+/* writes an NCCH after some padding like in a CIA, encrypted if enc isn't NULL */
+static void write_ncch_image(nnc_ncch_encryption *enc, const nnc_u8 *data, nnc_wmemory *wm)
+{
+	nnc_memory exheader, logo, plain;
+	nnc_buildable_ncch ncch;
+	nnc_vfs exefs, romfs;
+	build_ncch(&ncch, &exheader, &logo, &plain, &exefs, &romfs, data);
+	CHECK(nnc_wmemory_open(wm, 0) == NNC_R_OK);
+	CHECK(nnc_write_padding(NNC_WSP(wm), 0x40) == NNC_R_OK);
+	CHECK(nnc_write_ncch_encrypted(&ncch.chdr, enc, ncch.wflags, ncch.exheader, ncch.logo, ncch.plain,
+		ncch.exefs, ncch.romfs, NNC_WSP(wm)) == NNC_R_OK);
+	nnc_vfs_free(&exefs);
+	nnc_vfs_free(&romfs);
+}
+
+static void check_section_stream(nnc_rstream *rs, nnc_u64 pos, const nnc_u8 *want, nnc_u32 size)
+{
+	check_range(rs, pos, want, size);
+	NNC_RS_PCALL0(rs, close);
+}
+
+static void check_encrypted_ncch(nnc_ncch_encryption *enc, nnc_keyset *ks, nnc_seeddb *seeddb,
+	const nnc_u8 *data, const nnc_wmemory *plain_img)
+{
+	nnc_exefs_file_header headers[NNC_EXEFS_MAX_FILES];
+	nnc_ncch_header header, plain_header;
+	nnc_ncch_section_stream section;
+	nnc_memory img, plain_mem;
+	nnc_romfs_info info;
+	nnc_romfs_ctx ctx;
+	nnc_subview sv, plain_sv;
+	nnc_wmemory wm;
+	nnc_keypair kp;
+	nnc_u8 count;
+	write_ncch_image(enc, data, &wm);
+	CHECK(wm.size == plain_img->size);
+	nnc_mem_open(&img, wm.buf, wm.size);
+	nnc_mem_open(&plain_mem, plain_img->buf, plain_img->size);
+	nnc_subview_open(&sv, NNC_RSP(&img), 0x40, wm.size - 0x40);
+	nnc_subview_open(&plain_sv, NNC_RSP(&plain_mem), 0x40, wm.size - 0x40);
+
+	/* the hashes are of the plaintext */
+	CHECK(nnc_read_ncch_header(NNC_RSP(&sv), &header) == NNC_R_OK);
+	CHECK(nnc_read_ncch_header(NNC_RSP(&plain_sv), &plain_header) == NNC_R_OK);
+	CHECK(!(header.flags & NNC_NCCH_NO_CRYPTO) && (plain_header.flags & NNC_NCCH_NO_CRYPTO));
+	CHECK(header.crypt_method == enc->crypt_method);
+	CHECK(memcmp(header.exheader_hash, plain_header.exheader_hash, sizeof(header.exheader_hash)) == 0);
+	CHECK(memcmp(header.exefs_hash, plain_header.exefs_hash, sizeof(header.exefs_hash)) == 0);
+	CHECK(memcmp(header.romfs_hash, plain_header.romfs_hash, sizeof(header.romfs_hash)) == 0);
+	CHECK(header.exefs_offset == plain_header.exefs_offset && header.romfs_offset == plain_header.romfs_offset);
+
+	/* the logo is stored as-is, the encrypted sections are not */
+	check_range(NNC_RSP(&sv), NNC_MU_TO_BYTE(header.logo_offset), data + 0x1000, 0x2000);
+	CHECK(memcmp(wm.buf + 0x40 + 0x200, plain_img->buf + 0x40 + 0x200, 0x800) != 0);
+	CHECK(memcmp(wm.buf + 0x40 + NNC_MU_TO_BYTE(header.exefs_offset),
+		plain_img->buf + 0x40 + NNC_MU_TO_BYTE(header.exefs_offset), NNC_EXEFS_HEADER_SIZE) != 0);
+	CHECK(memcmp(wm.buf + 0x40 + NNC_MU_TO_BYTE(header.romfs_offset),
+		plain_img->buf + 0x40 + NNC_MU_TO_BYTE(header.romfs_offset), 0x200) != 0);
+
+	CHECK(nnc_fill_keypair(&kp, ks, seeddb, &header) == NNC_R_OK);
+	CHECK(nnc_ncch_section_exheader(&header, NNC_RSP(&sv), &kp, &section) == NNC_R_OK);
+	check_section_stream(NNC_RSP(&section), 0, data, 0x800);
+
+	/* the ExeFS files use different keys */
+	CHECK(nnc_ncch_section_exefs_header(&header, NNC_RSP(&sv), &kp, &section) == NNC_R_OK);
+	CHECK(nnc_read_exefs_header(NNC_RSP(&section), headers, &count) == NNC_R_OK);
+	NNC_RS_CALL0(section, close);
+	CHECK(count == ARRAY_SIZE(exefs_files));
+	for(unsigned i = 0; i < count; ++i)
+		for(unsigned j = 0; j < ARRAY_SIZE(exefs_files); ++j)
+			if(strcmp(headers[i].name, exefs_files[j].path) == 0)
+			{
+				CHECK(nnc_ncch_exefs_subview(&header, NNC_RSP(&sv), &kp, &section, &headers[i]) == NNC_R_OK);
+				check_section_stream(NNC_RSP(&section), 0, data + exefs_files[j].offset, exefs_files[j].size);
+			}
+
+	CHECK(nnc_ncch_section_romfs(&header, NNC_RSP(&sv), &kp, &section) == NNC_R_OK);
+	CHECK(nnc_init_romfs(NNC_RSP(&section), &ctx) == NNC_R_OK);
+	for(unsigned i = 0; i < ARRAY_SIZE(romfs_files); ++i)
+	{
+		nnc_subview file;
+		CHECK(nnc_get_info(&ctx, &info, romfs_files[i].path) == NNC_R_OK);
+		CHECK(info.u.f.size == romfs_files[i].size);
+		CHECK(nnc_romfs_open_subview(&ctx, &file, &info) == NNC_R_OK);
+		if(romfs_files[i].size)
+			check_range(NNC_RSP(&file), 0, data + romfs_files[i].offset, romfs_files[i].size);
+	}
+	nnc_free_romfs(&ctx);
+	NNC_RS_CALL0(section, close);
+	NNC_WS_CALL0(wm, close);
+}
+
+static void test_ncch_encrypted(const nnc_u8 *data)
+{
+	struct nnc_seeddb_entry seed = { .title_id = 0x0004000000123400ULL };
+	nnc_seeddb seeddb = { .size = 1, .entries = &seed };
+	nnc_u128 keyy = NNC_PROMOTE128(0xABCDEF);
+	nnc_keyset ks = NNC_KEYSET_INIT;
+	nnc_condensed_ncch_header chdr;
+	nnc_wmemory plain, wm;
+	/* made up keys are fine as long as the same are used to decrypt */
+	ks.flags = 0x02;
+	ks.kx_ncch0 = (nnc_u128) NNC_PROMOTE128(0x1111);
+	ks.kx_ncch1 = (nnc_u128) NNC_PROMOTE128(0x2222);
+	ks.kx_ncchA = (nnc_u128) NNC_PROMOTE128(0x3333);
+	ks.kx_ncchB = (nnc_u128) NNC_PROMOTE128(0x4444);
+	for(int i = 0; i < NNC_SEED_SIZE; ++i)
+		seed.seed[i] = i * 7 + 1;
+	write_ncch_image(NULL, data, &plain);
+
+	nnc_ncch_encryption seeded = { &ks, &seeddb, keyy, NNC_CRYPT_960, NNC_NCCH_USES_SEED };
+	check_encrypted_ncch(&seeded, &ks, &seeddb, data, &plain);
+	nnc_ncch_encryption initial = { &ks, NULL, keyy, NNC_CRYPT_INITIAL, 0 };
+	check_encrypted_ncch(&initial, &ks, NULL, data, &plain);
+	nnc_ncch_encryption fixed = { NULL, NULL, keyy, NNC_CRYPT_INITIAL, NNC_NCCH_FIXED_KEY };
+	check_encrypted_ncch(&fixed, NULL, NULL, data, &plain);
+
+	nnc_ncch_encryption no_seed = { &ks, NULL, keyy, NNC_CRYPT_960, NNC_NCCH_USES_SEED };
+	memset(&chdr, 0, sizeof(chdr));
+	chdr.title_id = 1;
+	CHECK(nnc_wmemory_open(&wm, 0) == NNC_R_OK);
+	CHECK(nnc_write_ncch_encrypted(&chdr, &no_seed, 0, NULL, NULL, NULL, NULL, NULL, NNC_WSP(&wm)) == NNC_R_SEED_NOT_FOUND);
+	NNC_WS_CALL0(wm, close);
+	NNC_WS_CALL0(plain, close);
+	puts("encrypted ncch: ok");
+}
+
+int writers_main(int argc, char *argv[])
+{
+	if(argc != 1) die("usage: %s", argv[0]);
+	nnc_u8 *data = malloc(DATA_SIZE);
+	if(!data) die("out of memory");
+	srand(0);
+	for(size_t i = 0; i < DATA_SIZE; ++i)
+		data[i] = rand();
+
+	test_romfs_plan(data);
+	test_exefs_plan(data);
+	test_ncch_plan(data);
+	test_cia_plan(data);
+	test_ncch_encrypted(data);
+
+	free(data);
+	return 0;
+}